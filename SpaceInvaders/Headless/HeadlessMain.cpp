@@ -0,0 +1,2680 @@
+//-----------------------------------------------------------------------------
+// File: HeadlessMain.cpp
+//
+// Desc: Runs CGameWorld without a window, as fast as the CPU allows, for
+//	   soak, balance and performance runs. Not part of Game.vcxproj; on
+//	   Linux, from the SpaceInvaders directory:
+//
+//	   g++ -std=c++14 -O2 -IIncludes Headless/HeadlessMain.cpp
+//	       Source/GameWorld.cpp Source/Formation.cpp Source/Projectiles.cpp
+//	       Source/BoxSet.cpp Source/Animations.cpp Source/TimerWheel.cpp
+//	       Source/Random.cpp Source/GameEvents.cpp Source/FlowField.cpp
+//	       Source/SpatialGrid.cpp Source/Levels.cpp Source/Replay.cpp
+//	       Source/Vec2.cpp Source/WorkerPool.cpp Source/ImageFile.cpp
+//	       Source/AssetLoader.cpp Source/Convolution.cpp
+//	       Source/ImagePipeline.cpp Source/ResizeEngine.cpp Source/Input.cpp
+//	       Source/TickClock.cpp Source/PostProcess.cpp Source/IndexedImage.cpp
+//	       Source/SaveFile.cpp -pthread -o headless
+//
+//	   headless [-ticks N] [-seed S] [-script file] [-record file] [-levels file]
+//	   headless -replay file [-levels file]
+//	   headless -rollback [-ticks N] [-seed S] [-levels file] [-budget-ns N]
+//	   headless -save [-ticks N] [-seed S] [-levels file]
+//	   headless -pacing [-ticks N] [-seed S] [-script file] [-levels file]
+//	   headless -formation N [-ticks N] [-seed S]
+//	   headless -projectiles N [-ticks N] [-seed S]
+//	   headless -collide N [-ticks N] [-seed S]
+//	   headless -timers N [-ticks N] [-seed S]
+//	   headless -random N [-ticks N] [-seed S]
+//	   headless -flow N [-ticks N] [-seed S]
+//	   headless -spatial N [-ticks N] [-seed S]
+//	   headless -levelcache N [-ticks N] [-seed S]
+//	   headless -assets dir
+//	   headless -convolve N
+//	   headless -pipeline N
+//	   headless -resize N
+//	   headless -input N
+//	   headless -postprocess N
+//	   headless -indexed dir
+//
+//	   A script holds one line per input change, "tick dir1 fire1 dir2 fire2
+//	   actions1 actions2", the numbers being the STickInput fields; each line
+//	   applies from its tick on. Without a script both players are driven by
+//	   a simple seeded bot. Finished games are restarted until N ticks ran,
+//	   except when recording, which stops at the end of the first game.
+//
+//	   -replay plays a recording made here or by the game (last.replay) at
+//	   full speed and checks it ends on the recorded checksum, so a session
+//	   doubles as a repeatable benchmark. The game records with its levels,
+//	   so its replays need -levels data/levels.txt; a recording made with
+//	   other levels than the run's is refused.
+//
+//	   -levels plays the levels of a file, see Levels.h, compiled each run
+//	   without a cache; without it the world's built in wave repeats.
+//
+//	   -rollback plays a bot game in which every tick is simulated twice:
+//	   state saved, tick stepped, state restored, tick stepped again. Both
+//	   runs have to agree; the save and restore costs are reported by the
+//	   number of shots in flight, marked where either one averages over
+//	   1 us. Only a restored tick that differs fails the run, unless
+//	   -budget-ns makes the timings a gate as well.
+//
+//	   -save plays a bot game for N ticks and writes its state through
+//	   CSaveFile, as the game saves, to savefile.sav in the current
+//	   directory. Read back into a fresh world it has to play on exactly
+//	   like the original. Then the file with a payload byte flipped, cut
+//	   short, a newer version or no magic, no file at all, and an old
+//	   build's test.out text (savefile.out) whole and cut, each have to
+//	   give the load result the game acts on.
+//
+//	   -pacing turns the game's tick inputs (script or bot) into key presses
+//	   and plays them through CInput and CTickClock, the way the game runs,
+//	   at 30, 60, 144 and 240 Hz with jittered frame times and at 60 Hz
+//	   with a long frame every two seconds. Every tick has to end on the
+//	   same checksum as stepping the inputs directly, with no tick dropped.
+//
+//	   -formation times CFormation alone with a wave of N invaders, 64 to
+//	   a column, a quarter of them shot down at random: the march step and
+//	   picking the bottom invader of every column, per tick.
+//
+//	   -projectiles times CProjectiles alone with N shots in flight: every
+//	   tick integrates and culls them, and emitters top the count back up
+//	   with rings, spirals, fans and aimed shots from random points.
+//
+//	   -collide first checks CBoxSet against the old RECT test, every box
+//	   size up to 8 x 8 at quarter pixel offsets either side of zero, and
+//	   its sweeps against sampling along the path, then times N ticks'
+//	   worth of queries against N boxes.
+//
+//	   -timers keeps N timers pending in a CTimerWheel, due up to 100000
+//	   ticks out and a sixteenth of them periodic. Each tick it restarts
+//	   the ones that went off and cancels and restarts another hundred at
+//	   random, checks every timer goes off on the tick it was due, and
+//	   reports the cost per tick.
+//
+//	   -random checks CRandomBatch fills the same numbers as its lanes do
+//	   one at a time, and that bounded numbers spread evenly, then times
+//	   N numbers a tick from rand(), std::mt19937, CRandom and CRandomBatch.
+//
+//	   -flow steers N enemies towards two wandering players through a
+//	   CFlowField with a sixth of its cells blocked, once building the field
+//	   inline and once on its worker thread. Both runs and a bot game played
+//	   both ways have to end the same, and every cell has to lead downhill;
+//	   reports the field builds and the steering cost per tick.
+//
+//	   -spatial rebuilds a CSpatialGrid over N wandering targets every
+//	   tick and asks it 2N questions: a quarter each nearest, nearest 8,
+//	   within 40 pixels and nearest within a cone, from anywhere on and
+//	   around the screen. Every sixteenth answer has to match trying every
+//	   target; reports the build and query costs against trying them all.
+//
+//	   -levelcache writes a level file with N spawn spots over 8 levels and
+//	   loads it through CLevelSet: once compiling and writing the cache,
+//	   then repeatedly from the cache. It checks the cached image matches
+//	   the compiled one, that editing the text, a damaged cache and errors
+//	   in the text are noticed, and that a one line file of the default
+//	   level plays the same game as no levels. Reports each way's cost.
+//
+//	   -assets loads the game's bitmaps from dir (its Data directory) the
+//	   way BuildObjects requests them, through CAssetLoader: once with the
+//	   pool stopped, which runs every load inline as the game did before,
+//	   and once on the started pool while a loop stands in for the message
+//	   pump. Both have to give the same pixels. Reports the time to the
+//	   first frame (the critical assets in) and to fully loaded.
+//
+//	   -convolve blurs an 800 x 600 frame with kernels 3 to 31 taps across:
+//	   gaussians through the taps, boxes and FastGaussian's three boxes
+//	   through running sums, each inline and on the worker pool, N times.
+//	   The pool has to match inline bit for bit and the running sums the
+//	   taps of the same box within one level. Reports the median cost of
+//	   each against the 1 ms frame budget.
+//
+//	   -pipeline runs one channel chains (extract, LUT, convolve, insert)
+//	   over an 800 x 600 frame through CImagePipeline, inline and on the
+//	   pool, and as the old CopyMonoImage, filter, PasteMonoImage steps,
+//	   N times each. Every chain has to give the steps' pixels exactly.
+//
+//	   -resize scales 64 x 64, 256 x 256 and 800 x 600 frames by 0.25 to 2
+//	   with every filter in Filters.h and prints a CSV row for each: the
+//	   median of N Resample calls, Mpix/s out, the weight tables' build
+//	   time and size, the peak memory Resample holds and the PSNR against
+//	   the same resampling in double. Fails below 40 dB.
+//
+//	   -input posts N key events at 1 kHz from a producer thread through
+//	   CInput's lock free queue to 120 Hz ticks run off CTickClock. Every
+//	   event has to come out once, in order, in the first tick that ends
+//	   after its time stamp and was built after it was posted.
+//
+//	   -postprocess runs CPostProcess over an 800 x 600 frame at every
+//	   quality level with bloom and flash at full strength, inline and on
+//	   the pool, N times each. The pool has to match inline, a budget spent
+//	   before the first band has to leave only the flash, and the bloom of
+//	   a bright square has to reach its radius out on all four sides and no
+//	   further. Reports the median cost and the bytes each frame moves
+//	   against the 1 ms frame budget.
+//
+//	   -indexed quantizes the game's bitmaps from dir (its Data directory)
+//	   through CIndexedImage, masks and colour keys as the sprites use them.
+//	   Images that keep every colour have to expand back bit for bit, the
+//	   others stay above 30 dB PSNR, and no pixel the sprite does not draw
+//	   is touched. Then draws a busy 800 x 600 frame, background and
+//	   sprites, indexed and from the 32 bit bitmaps as the game does without
+//	   indexed storage, and reports the median ms and bytes moved a frame.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Headless Specific Includes
+//-----------------------------------------------------------------------------
+#include "GameWorld.h"
+#include "Replay.h"
+#include "SaveFile.h"
+#include "Input.h"
+#include "TickClock.h"
+#include "TimerWheel.h"
+#include "Random.h"
+#include "FlowField.h"
+#include "SpatialGrid.h"
+#include "Levels.h"
+#include "AssetLoader.h"
+#include "Convolution.h"
+#include "ImagePipeline.h"
+#include "ResizeEngine.h"
+#include "PostProcess.h"
+#include "IndexedImage.h"
+#include <math.h>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <random>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Name : CHeadlessPlatform (Class)
+// Desc : Counts what the game would have played and shown.
+//-----------------------------------------------------------------------------
+class CHeadlessPlatform : public IPlatform
+{
+public:
+	CHeadlessPlatform() { memset( m_nSounds, 0, sizeof(m_nSounds) ); memset( m_nEffects, 0, sizeof(m_nEffects) ); }
+
+	void OnSound( ESound eSound ) { m_nSounds[eSound]++; }
+	void OnEffect( EEffect eEffect, float ) { m_nEffects[eEffect]++; }
+
+	unsigned long m_nSounds[SOUND_COUNT];
+	unsigned long m_nEffects[EFFECT_COUNT];
+};
+
+//-----------------------------------------------------------------------------
+// Name : SScriptLine (Struct)
+//-----------------------------------------------------------------------------
+struct SScriptLine
+{
+	uint32_t	 Tick;
+	STickInput	 Input;
+};
+
+//-----------------------------------------------------------------------------
+// Name : LoadScript ()
+// Desc : Reads a script file, false if it can't be opened.
+//-----------------------------------------------------------------------------
+static bool LoadScript( const char *szFile, std::vector<SScriptLine>& Script )
+{
+	FILE *f = fopen( szFile, "r" );
+	if ( !f ) return false;
+
+	SScriptLine Line;
+	unsigned t, d1, f1, d2, f2, a1, a2;
+	char Buffer[256];
+
+	while ( fgets( Buffer, sizeof(Buffer), f ) )
+	{
+		if ( sscanf( Buffer, "%u %u %u %u %u %u %u", &t, &d1, &f1, &d2, &f2, &a1, &a2 ) != 7 ) continue;
+
+		memset( &Line, 0, sizeof(Line) );
+		Line.Tick				= t;
+		Line.Input.Direction[0]	= d1;
+		Line.Input.bFire[0]		= f1 != 0;
+		Line.Input.Direction[1]	= d2;
+		Line.Input.bFire[1]		= f2 != 0;
+		Line.Input.Actions[0]	= a1;
+		Line.Input.Actions[1]	= a2;
+		Script.push_back( Line );
+	}
+
+	fclose( f );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : BotInput ()
+// Desc : Picks a new heading and trigger state for each player every half
+//		second, from its own generator so the game's rand() is untouched.
+//-----------------------------------------------------------------------------
+static void BotInput( uint32_t nTick, uint32_t& nState, STickInput& Input )
+{
+	if ( nTick % (SIM_TICK_RATE / 2) != 0 ) return;
+
+	for ( int i = 0; i < WORLD_PLAYERS; i++ )
+	{
+		nState = nState * 1664525u + 1013904223u;
+		Input.Direction[i]	= (nState >> 24) & 15;
+		Input.bFire[i]		= ((nState >> 20) & 3) != 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : NextInput ()
+// Desc : The input of tick nTick, from the script when there is one, from
+//		the bot otherwise.
+//-----------------------------------------------------------------------------
+static void NextInput( uint32_t nTick, const std::vector<SScriptLine> *pScript, size_t& nLine, uint32_t& nBot, STickInput& Input )
+{
+	if ( pScript )
+	{
+		// Actions fire once, on the tick of their line
+		memset( Input.Actions, 0, sizeof(Input.Actions) );
+		while ( nLine < pScript->size() && (*pScript)[nLine].Tick <= nTick ) Input = (*pScript)[nLine++].Input;
+	}
+	else
+	{
+		BotInput( nTick, nBot, Input );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : Replay ()
+// Desc : Plays a recording back as fast as possible. Returns the exit code,
+//		non zero when it does not end on the recorded checksum.
+//-----------------------------------------------------------------------------
+static int Replay( const char *szFile, const CLevelSet *pLevels )
+{
+	CHeadlessPlatform Platform;
+	CGameWorld World( &Platform );
+	CReplayReader Reader;
+	STickInput Input;
+
+	World.SetLevels( pLevels );
+	if ( !Reader.Load( szFile ) )
+	{
+		fprintf( stderr, "Can't read replay %s\n", szFile );
+		return 1;
+	}
+
+	if ( !Reader.Start( World ) )
+	{
+		fprintf( stderr, "Replay %s was recorded with levels %016llx, this run plays %016llx (0 is the built in wave); pass the -levels it was made with\n",
+			szFile, (unsigned long long)Reader.GetLevelHash(), (unsigned long long)(pLevels ? pLevels->GetSourceHash() : 0) );
+		return 1;
+	}
+
+	auto Start = std::chrono::steady_clock::now();
+	while ( Reader.Next( Input ) ) World.Step( Input );
+	double fSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - Start ).count();
+
+	uint32_t nTicks = World.GetTick();
+	printf( "replay seed %u, ticks %u of %u (%.1f s of play) in %.3f s: %.0f ticks/s, %.2f us/tick\n",
+		Reader.GetSeed(), nTicks, Reader.GetTicks(), nTicks / (double)SIM_TICK_RATE, fSeconds, nTicks / fSeconds, fSeconds * 1e6 / nTicks );
+	printf( "lives %d - %d, score %d - %d\n", World.Player(0).Lives, World.Player(1).Lives, World.Player(0).Score, World.Player(1).Score );
+
+	if ( nTicks != Reader.GetTicks() || World.Checksum() != Reader.GetChecksum() )
+	{
+		printf( "checksum %08x, recorded %08x: DIVERGED\n", World.Checksum(), Reader.GetChecksum() );
+		return 2;
+	}
+
+	printf( "checksum %08x matches\n", World.Checksum() );
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Rollback ()
+// Desc : Benchmarks CGameWorld::SaveState / LoadState on a live game and
+//		checks that a restored world steps exactly like the original.
+//		Timings over budget are marked; with nBudgetNs they fail the run.
+//-----------------------------------------------------------------------------
+static int Rollback( uint32_t nTicks, unsigned nSeed, const CLevelSet *pLevels, unsigned nBudgetNs )
+{
+	typedef std::chrono::steady_clock Clock;
+	const double fBudget = nBudgetNs ? (double)nBudgetNs : 1000.0;		// ns a save or load
+	const int BUCKETS = 5;
+	static const unsigned BucketStart[BUCKETS] = { 0, 2, 4, 8, 16 };
+
+	CHeadlessPlatform Platform;
+	CGameWorld World( &Platform );
+	STickInput Input;
+	uint32_t nBot = nSeed, nGames = 1;
+	std::vector<double> Buffer( 4096 );		// doubles, for the alignment
+	double fSave[BUCKETS] = { 0 }, fLoad[BUCKETS] = { 0 };
+	size_t nBytes[BUCKETS] = { 0 };
+	uint32_t nCount[BUCKETS] = { 0 };
+
+	memset( &Input, 0, sizeof(Input) );
+	World.SetLevels( pLevels );
+	World.Reset( nSeed );
+
+	for ( uint32_t t = 0; t < nTicks; t++ )
+	{
+		BotInput( t, nBot, Input );
+
+		unsigned nShots = (unsigned)(World.Bullets().GetCount() + World.EnemyBullets().GetCount());
+		int b = BUCKETS - 1;
+		while ( nShots < BucketStart[b] ) b--;
+
+		if ( World.GetStateSize() > Buffer.size() * sizeof(double) ) Buffer.resize( World.GetStateSize() / sizeof(double) + 1 );
+
+		auto t0 = Clock::now();
+		size_t nSize = World.SaveState( Buffer.data(), Buffer.size() * sizeof(double) );
+		auto t1 = Clock::now();
+
+		World.Step( Input );
+		uint32_t nChecksum = World.Checksum();
+
+		auto t2 = Clock::now();
+		bool bLoaded = World.LoadState( Buffer.data(), nSize );
+		auto t3 = Clock::now();
+
+		World.Step( Input );
+		if ( !bLoaded || World.Checksum() != nChecksum )
+		{
+			printf( "tick %u: restored world diverged (%08x, expected %08x)\n", t, World.Checksum(), nChecksum );
+			return 2;
+		}
+
+		fSave[b]	+= std::chrono::duration<double>( t1 - t0 ).count();
+		fLoad[b]	+= std::chrono::duration<double>( t3 - t2 ).count();
+		nBytes[b]	+= nSize;
+		nCount[b]++;
+
+		if ( World.IsGameOver() ) World.Reset( nSeed + nGames++ );
+	}
+
+	printf( "rollback over %u ticks, %u games, all restored ticks matched\n", nTicks, nGames );
+	printf( "shots   ticks    bytes   save ns   load ns\n" );
+	bool bOver = false;
+	for ( int b = 0; b < BUCKETS; b++ )
+	{
+		if ( !nCount[b] ) continue;
+		double fSaveNs = fSave[b] * 1e9 / nCount[b], fLoadNs = fLoad[b] * 1e9 / nCount[b];
+		bool bBucketOver = fSaveNs > fBudget || fLoadNs > fBudget;
+		printf( "%3u+  %7u  %7.0f  %8.1f  %8.1f%s\n", BucketStart[b], nCount[b], nBytes[b] / (double)nCount[b],
+			fSaveNs, fLoadNs, bBucketOver ? "  over budget" : "" );
+		bOver |= bBucketOver;
+	}
+
+	if ( bOver ) printf( "save or load over the %.0f ns budget\n", fBudget );
+	return bOver && nBudgetNs ? 3 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Formation ()
+// Desc : Benchmarks CFormation::Step and LowestAlive on a huge wave.
+//-----------------------------------------------------------------------------
+static int Formation( int nInvaders, uint32_t nTicks, unsigned nSeed )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	SFormationDesc Desc;
+	Desc.Rows		= FORMATION_MAX_ROWS;
+	Desc.Columns	= (nInvaders + Desc.Rows - 1) / Desc.Rows;
+	Desc.Left		= 0.0f;
+	Desc.Top		= 0.0f;
+	Desc.SpacingX	= 4.0f;
+	Desc.SpacingY	= 4.0f;
+	Desc.Width		= 4;
+	Desc.Height		= 4;
+	Desc.MinX		= -100.0f;
+	Desc.MaxX		= Desc.Columns * Desc.SpacingX + 100.0f;
+	Desc.Speed		= 60.0f;
+	Desc.Drop		= 0.0f;				// Marches on for as long as it takes
+
+	CFormation Wave;
+	Wave.Create( Desc );
+
+	srand( nSeed );
+	for ( int i = Wave.GetAliveCount() / 4; i > 0; )
+	{
+		int c = rand() % Desc.Columns, r = rand() % Desc.Rows;
+		if ( Wave.IsAlive( c, r ) ) { Wave.Kill( c, r ); i--; }
+	}
+
+	long long nRows = 0;
+	auto t0 = Clock::now();
+	for ( uint32_t t = 0; t < nTicks; t++ ) Wave.Step( SIM_TICK );
+	auto t1 = Clock::now();
+	for ( uint32_t t = 0; t < nTicks; t++ )
+		for ( int c = 0; c < Desc.Columns; c++ ) nRows += Wave.LowestAlive( c );
+	auto t2 = Clock::now();
+
+	double fStep = std::chrono::duration<double>( t1 - t0 ).count() * 1e6 / nTicks;
+	double fScan = std::chrono::duration<double>( t2 - t1 ).count() * 1e6 / nTicks;
+	printf( "formation %d x %d, %d alive, %u ticks\n", Desc.Columns, Desc.Rows, Wave.GetAliveCount(), nTicks );
+	printf( "step %.2f us/tick, bottom of every column %.2f us/tick (%lld)\n", fStep, fScan, nRows );
+	printf( "checksum %08x\n", Wave.Checksum( 2166136261u ) );
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Projectiles ()
+// Desc : Benchmarks CProjectiles::Integrate and Cull with N shots alive.
+//-----------------------------------------------------------------------------
+static int Projectiles( int nShots, uint32_t nTicks, unsigned nSeed )
+{
+	typedef std::chrono::steady_clock Clock;
+	const float fSize = 2000.0f;
+
+	static const SEmitter Guns[] =
+	{
+		{ SEmitter::PATTERN_RING,	64, 200.0f, 0.0f,  0.0f, 0.0f,  50.0f },
+		{ SEmitter::PATTERN_SPIRAL,	64, 100.0f, 10.0f, 0.0f, 0.3f,  0.0f },
+		{ SEmitter::PATTERN_SPREAD,	16, 300.0f, 0.0f,  1.0f, 1.2f,  0.0f },
+		{ SEmitter::PATTERN_AIMED,	8,	400.0f, 0.0f,  0.0f, 0.4f, -20.0f },
+	};
+
+	CProjectiles Shots;
+	Shots.Reserve( nShots + 64 );
+	srand( nSeed );
+
+	double fIntegrate = 0, fCull = 0;
+	long long nWork = 0, nCulled = 0;
+
+	for ( uint32_t t = 0; t < nTicks; t++ )
+	{
+		while ( Shots.GetCount() < (size_t)nShots )
+		{
+			Vec2 Origin( rand() % (int)fSize, rand() % (int)fSize );
+			Shots.Emit( Guns[rand() % 4], Origin, Vec2( fSize / 2, fSize / 2 ) );
+		}
+
+		nWork += Shots.GetCount();
+
+		auto t0 = Clock::now();
+		Shots.Integrate( SIM_TICK );
+		auto t1 = Clock::now();
+		nCulled += Shots.Cull( 0.0f, 0.0f, fSize, fSize );
+		auto t2 = Clock::now();
+
+		fIntegrate	+= std::chrono::duration<double>( t1 - t0 ).count();
+		fCull		+= std::chrono::duration<double>( t2 - t1 ).count();
+	}
+
+	printf( "projectiles %d, %u ticks, %.1f culled per tick\n", nShots, nTicks, nCulled / (double)nTicks );
+	printf( "integrate %.2f ns, cull %.2f ns per projectile per tick; %.1f us per tick, %.1f%% of a %u Hz tick\n",
+		fIntegrate * 1e9 / nWork, fCull * 1e9 / nWork, (fIntegrate + fCull) * 1e6 / nTicks,
+		(fIntegrate + fCull) * SIM_TICK_RATE * 100.0 / nTicks, SIM_TICK_RATE );
+	printf( "checksum %08x\n", Shots.Checksum( 2166136261u ) );
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : RectOverlap ()
+// Desc : The box test as the game first had it, for -collide to check
+//		CBoxSet against.
+//-----------------------------------------------------------------------------
+static bool RectOverlap( const Vec2& p1, int w1, int h1, const Vec2& p2, int w2, int h2 )
+{
+	long l1 = (long)(p1.x - w1 / 2), r1 = (long)(p1.x + w1 / 2);
+	long t1 = (long)(p1.y - h1 / 2), b1 = (long)(p1.y + h1 / 2);
+	long l2 = (long)(p2.x - w2 / 2), r2 = (long)(p2.x + w2 / 2);
+	long t2 = (long)(p2.y - h2 / 2), b2 = (long)(p2.y + h2 / 2);
+
+	return r1 > l2 && l1 < r2 && b1 > t2 && t1 < b2;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Collide ()
+// Desc : Checks CBoxSet hit for hit against RectOverlap, then benchmarks
+//		one query against N boxes, SSE2 and one box at a time.
+//-----------------------------------------------------------------------------
+static int Collide( int nBoxes, uint32_t nTicks, unsigned nSeed )
+{
+	typedef std::chrono::steady_clock Clock;
+	const int nGrid = 25, nSizes = 8;		// -3 to +3 in quarter pixels
+
+	// Every size, every offset, with every other box killed along the way
+	std::vector<float> X, Y;
+	std::vector<uint32_t> Live;
+	std::vector<int> W, H;
+	for ( int w = 1; w <= nSizes; w++ )
+		for ( int h = 1; h <= nSizes; h++ )
+			for ( int i = 0; i < nGrid * nGrid; i++ )
+			{
+				X.push_back( -3.0f + (i % nGrid) * 0.25f );
+				Y.push_back( -3.0f + (i / nGrid) * 0.25f );
+				Live.push_back( (X.size() % 7) ? ~0u : 0 );
+				W.push_back( w );
+				H.push_back( h );
+			}
+
+	size_t nTargets = X.size(), nChunk = nGrid * nGrid;
+	CBoxSet Targets, Sides;
+	Targets.Resize( nTargets );
+	Sides.Resize( nTargets );
+	for ( size_t i = 0; i < nTargets; i += nChunk )
+	{
+		Targets.SetCentred( i, &X[i], &Y[i], &Live[i], nChunk, W[i], H[i] );
+		Sides.SetCentred( i, &X[i], &Y[i], NULL, nChunk, W[i], H[i] );
+		Sides.SetCentred( i, &X[i], NULL, &Live[i], nChunk, W[i], H[i] );
+	}
+
+	long long nErrors = 0, nTests = 0, nHits = 0;
+	for ( size_t i = 0; i < nTargets; i++ )
+	{
+		SBox a = Targets.Get( i ), b = Sides.Get( i ), c = CBoxSet::MakeBox( Vec2( X[i], Y[i] ), W[i], H[i] );
+		if ( Live[i] && memcmp( &a, &c, sizeof(a) ) ) nErrors++;
+		if ( b.Left != a.Left || b.Right != a.Right || b.Top != c.Top || b.Bottom != c.Bottom ) nErrors++;
+	}
+
+	std::vector<uint32_t> Hits( Targets.GetWords() ), Scalar( Targets.GetWords() );
+	for ( int q = 0; q < nGrid * nGrid * nSizes * nSizes; q += 3 )
+	{
+		Vec2 Centre( -3.0f + (q % nGrid) * 0.25f, -3.0f + (q / nGrid % nGrid) * 0.25f );
+		int w = q / (nGrid * nGrid) % nSizes + 1, h = q / (nGrid * nGrid * nSizes) + 1;
+		SBox Query = CBoxSet::MakeBox( Centre, w, h );
+
+		size_t nCount = Targets.Overlaps( Query, Hits.data() );
+		if ( nCount != Targets.OverlapsScalar( Query, Scalar.data() ) || Hits != Scalar ) nErrors++;
+
+		int iFirst = -1, iFrom = q % 4000, iFirstFrom = -1;
+		for ( size_t i = 0; i < nTargets; i++ )
+		{
+			bool bHit = Live[i] && RectOverlap( Centre, w, h, Vec2( X[i], Y[i] ), W[i], H[i] );
+			if ( bHit != (((Hits[i >> 5] >> (i & 31)) & 1) != 0) ) nErrors++;
+			if ( bHit && iFirst < 0 ) iFirst = (int)i;
+			if ( bHit && iFirstFrom < 0 && i >= (size_t)iFrom ) iFirstFrom = (int)i;
+			nHits += bHit;
+		}
+		if ( Targets.FirstOverlap( Query ) != iFirst || Targets.FirstOverlap( Query, iFrom ) != iFirstFrom ) nErrors++;
+		nTests += nTargets;
+	}
+
+	printf( "checked %lld box pairs, %lld overlapping: %lld errors\n", nTests, nHits, nErrors );
+	if ( nErrors ) return 1;
+
+	// Sweeps against the same boxes, sampled at 64 points along the path
+	const int nSamples = 64;
+	srand( nSeed );
+	for ( int q = 0; q < 2000; q++ )
+	{
+		SBox Box = CBoxSet::MakeBox( Vec2( rand() % 41 - 20, rand() % 41 - 20 ), rand() % nSizes + 1, rand() % nSizes + 1 );
+		float dx = (rand() % 801 - 400) * 0.1f, dy = (rand() % 801 - 400) * 0.1f, t = 0.0f;
+		if ( q % 10 == 0 ) dx = dy = 0.0f;
+
+		int i = Targets.FirstSweep( Box, dx, dy, t );
+		if ( !dx && !dy && (i != Targets.FirstOverlap( Box ) || (i >= 0 && t != 0.0f)) ) nErrors++;
+
+		// The first sampled contact can come no earlier than the swept one
+		for ( int k = 0; k <= nSamples; k++ )
+		{
+			float s = (float)k / nSamples;
+			float l = Box.Left + dx * s, r = Box.Right + dx * s, u = Box.Top + dy * s, b = Box.Bottom + dy * s;
+			size_t j = 0;
+			for ( ; j < nTargets; j++ )
+			{
+				SBox a = Targets.Get( j );
+				if ( Live[j] && r > a.Left && l < a.Right && b > a.Top && u < a.Bottom ) break;
+			}
+			if ( j == nTargets ) continue;
+			if ( i < 0 || t > s ) nErrors++;
+			nHits++;
+			break;
+		}
+	}
+
+	printf( "swept 2000 boxes through them: %lld errors\n", nErrors );
+	if ( nErrors ) return 1;
+
+	// N shot sized boxes over a large field, queried by invader sized boxes
+	const int nField = 2000;
+	srand( nSeed );
+	X.resize( nBoxes );
+	Y.resize( nBoxes );
+	for ( int i = 0; i < nBoxes; i++ )
+	{
+		X[i] = (float)(rand() % (nField * 4)) * 0.25f;
+		Y[i] = (float)(rand() % (nField * 4)) * 0.25f;
+	}
+
+	CBoxSet Boxes;
+	Boxes.Resize( nBoxes );
+	auto t0 = Clock::now();
+	Boxes.SetCentred( 0, X.data(), Y.data(), NULL, nBoxes, 36, 56 );
+	auto t1 = Clock::now();
+
+	std::vector<SBox> Queries( nTicks );
+	for ( uint32_t t = 0; t < nTicks; t++ ) Queries[t] = CBoxSet::MakeBox( Vec2( rand() % nField, rand() % nField ), 53, 55 );
+
+	Hits.resize( Boxes.GetWords() * nTicks );
+	long long nFound = 0, nFoundScalar = 0;
+	auto t2 = Clock::now();
+	nFound = Boxes.Overlaps( Queries.data(), nTicks, Hits.data() );
+	auto t3 = Clock::now();
+	for ( uint32_t t = 0; t < nTicks; t++ ) nFoundScalar += Boxes.OverlapsScalar( Queries[t], &Hits[t * Boxes.GetWords()] );
+	auto t4 = Clock::now();
+
+	double fTests = (double)nBoxes * nTicks;
+	printf( "boxes %d, %u queries, %lld hits (%lld one at a time)\n", nBoxes, nTicks, nFound, nFoundScalar );
+	printf( "set %.2f ns per box; overlaps %.3f ns per box tested, %.3f ns one at a time\n",
+		std::chrono::duration<double>( t1 - t0 ).count() * 1e9 / nBoxes,
+		std::chrono::duration<double>( t3 - t2 ).count() * 1e9 / fTests,
+		std::chrono::duration<double>( t4 - t3 ).count() * 1e9 / fTests );
+	return nFound == nFoundScalar ? 0 : 1;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Timers ()
+// Desc : Checks and benchmarks CTimerWheel with N timers pending.
+//-----------------------------------------------------------------------------
+static int Timers( int nTimers, uint32_t nTicks, unsigned nSeed )
+{
+	typedef std::chrono::steady_clock Clock;
+	const int nChurn = 100;
+
+	CTimerWheel Wheel;
+	std::vector<uint32_t> Handles( nTimers ), Due( nTimers ), Period( nTimers );
+	auto Delay = []() { return ((uint32_t)rand() * 32768u + (uint32_t)rand()) % 100000u + 1; };
+	auto Restart = [&]( int i )
+	{
+		uint32_t nDelay = Delay();
+		Period[i]	= 0;
+		Due[i]		= Wheel.GetTick() + nDelay;
+		Handles[i]	= Wheel.Start( nDelay, 0, i );
+	};
+
+	srand( nSeed );
+	Wheel.Reserve( nTimers );
+	for ( int i = 0; i < nTimers; i++ )
+	{
+		Restart( i );
+		if ( i % 16 ) continue;
+
+		// Periodic ones replace the one just started
+		Wheel.Cancel( Handles[i] );
+		Period[i]	= Delay() % 1000 + 1;
+		Due[i]		= Wheel.GetTick() + Period[i];
+		Handles[i]	= Wheel.Start( Period[i], 0, i, Period[i] );
+	}
+
+	long long nErrors = 0, nFired = 0;
+	double fTime = 0;
+
+	for ( uint32_t t = 0; t < nTicks; t++ )
+	{
+		auto t0 = Clock::now();
+		size_t nExpired = Wheel.Advance();
+		for ( size_t e = 0; e < nExpired; e++ )
+		{
+			int i = Wheel.GetExpired( e ).Data;
+			if ( Due[i] != Wheel.GetTick() ) nErrors++;
+			if ( Period[i] ) Due[i] += Period[i];
+			else Restart( i );
+		}
+
+		for ( int k = 0; k < nChurn; k++ )
+		{
+			int i = ((uint32_t)rand() * 32768u + (uint32_t)rand()) % nTimers;
+			uint32_t hOld = Handles[i];
+			if ( !Wheel.Cancel( hOld ) ) nErrors++;
+			Restart( i );
+			if ( Wheel.Cancel( hOld ) ) nErrors++;		// Stale now
+		}
+		auto t1 = Clock::now();
+
+		fTime += std::chrono::duration<double>( t1 - t0 ).count();
+		nFired += nExpired;
+	}
+
+	if ( Wheel.GetPending() != (size_t)nTimers ) nErrors++;
+
+	// A restored wheel carries on exactly as the original
+	std::vector<uint64_t> State( (Wheel.GetStateSize() + 7) / 8 );
+	CTimerWheel Copy;
+	Wheel.SaveState( State.data() );
+	if ( !Copy.LoadState( State.data(), Wheel.GetStateSize() ) ) nErrors++;
+	for ( int t = 0; t < 1000; t++ )
+	{
+		size_t nExpired = Wheel.Advance();
+		if ( Copy.Advance() != nExpired ) nErrors++;
+		for ( size_t e = 0; e < nExpired && e < Copy.GetExpiredCount(); e++ )
+			if ( Copy.GetExpired( e ).Handle != Wheel.GetExpired( e ).Handle ) nErrors++;
+	}
+
+	printf( "timers %d pending, %u ticks, %.1f fired and %d cancelled per tick: %lld errors\n",
+		nTimers, nTicks, nFired / (double)nTicks, nChurn, nErrors );
+	printf( "%.2f us per tick, %.1f ns per timer started, fired or cancelled\n",
+		fTime * 1e6 / nTicks, fTime * 1e9 / (nFired * 2.0 + nTicks * nChurn * 3.0) );
+	printf( "checksum %08x\n", Wheel.Checksum( 2166136261u ) );
+	return nErrors ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : RandomNumbers ()
+// Desc : Checks CRandomBatch against CRandom and benchmarks both against
+//		rand() and std::mt19937, N numbers a tick.
+//-----------------------------------------------------------------------------
+static int RandomNumbers( int nCount, uint32_t nTicks, unsigned nSeed )
+{
+	typedef std::chrono::steady_clock Clock;
+	const uint32_t Bounds[] = { 1, 16, 500, 3000000000u };
+	const int nBuckets = 16;
+
+	std::vector<uint32_t> Bits( nCount ), Below( nCount );
+	std::vector<float> Floats( nCount );
+	long long nErrors = 0;
+
+	// Every lane goes on as a CRandom would, whichever way it is filled
+	CRandomBatch Batch( nSeed, 0 );
+	for ( int b = 0; b < 4; b++ )
+	{
+		CRandom Lanes[RANDOM_LANES];
+		for ( int k = 0; k < RANDOM_LANES; k++ ) Lanes[k] = Batch.GetLane( k );
+
+		size_t n = nCount > b ? nCount - b : 0;		// Whole steps and partial ones
+		Batch.Fill( Bits.data(), n );
+		Batch.FillFloats( Floats.data(), n );
+		Batch.FillBelow( Below.data(), n, Bounds[b] );
+
+		size_t nSteps = (n + RANDOM_LANES - 1) / RANDOM_LANES;
+		for ( size_t i = 0; i < nSteps * RANDOM_LANES; i++ )
+		{
+			uint32_t x = Lanes[i % RANDOM_LANES].Next();
+			if ( i < n && x != Bits[i] ) nErrors++;
+		}
+		for ( size_t i = 0; i < nSteps * RANDOM_LANES; i++ )
+		{
+			float f = Lanes[i % RANDOM_LANES].NextFloat();
+			if ( i < n && (f != Floats[i] || f < 0.0f || f >= 1.0f) ) nErrors++;
+		}
+		for ( size_t i = 0; i < nSteps * RANDOM_LANES; i++ )
+		{
+			uint32_t x = Lanes[i % RANDOM_LANES].Below( Bounds[b] );
+			if ( i < n && (x != Below[i] || x >= Bounds[b]) ) nErrors++;
+		}
+		for ( int k = 0; k < RANDOM_LANES; k++ )
+			if ( Lanes[k].Next() != Batch.GetLane( k ).Next() ) nErrors++;
+	}
+
+	// A chi-square test over 16 buckets, each stream on its own; 60 is far
+	// past anything an even generator gives
+	double fWorst = 0;
+	for ( int s = 0; s < 8; s++ )
+	{
+		CRandom Random( nSeed, s );
+		long long Buckets[nBuckets] = { 0 };
+		const long long nDraws = 1 << 20;
+		for ( long long i = 0; i < nDraws; i++ ) Buckets[Random.Below( nBuckets )]++;
+
+		double fChi = 0, fExpect = (double)nDraws / nBuckets;
+		for ( int k = 0; k < nBuckets; k++ ) fChi += (Buckets[k] - fExpect) * (Buckets[k] - fExpect) / fExpect;
+		if ( fChi > fWorst ) fWorst = fChi;
+		if ( fChi > 60.0 ) nErrors++;
+	}
+
+	// Each sums what it makes, so none of it is optimised away
+	uint64_t nSum = 0;
+	double fTimes[7] = { 0 };
+	double fTotal = (double)nCount * nTicks;
+	std::mt19937 Twister( nSeed );
+	CRandom Random( nSeed, 0 );
+
+	srand( nSeed );
+	for ( uint32_t t = 0; t < nTicks; t++ )
+	{
+		auto t0 = Clock::now();
+		for ( int i = 0; i < nCount; i++ ) nSum += rand();
+		auto t1 = Clock::now();
+		for ( int i = 0; i < nCount; i++ ) nSum += rand() % 500;
+		auto t2 = Clock::now();
+		for ( int i = 0; i < nCount; i++ ) nSum += Twister();
+		auto t3 = Clock::now();
+		for ( int i = 0; i < nCount; i++ ) nSum += Random.Next();
+		auto t4 = Clock::now();
+		for ( int i = 0; i < nCount; i++ ) nSum += Random.Below( 500 );
+		auto t5 = Clock::now();
+		Batch.Fill( Bits.data(), nCount );
+		auto t6 = Clock::now();
+		Batch.FillBelow( Below.data(), nCount, 500 );
+		auto t7 = Clock::now();
+		nSum += Bits[t % nCount] + Below[t % nCount];
+
+		fTimes[0] += std::chrono::duration<double>( t1 - t0 ).count();
+		fTimes[1] += std::chrono::duration<double>( t2 - t1 ).count();
+		fTimes[2] += std::chrono::duration<double>( t3 - t2 ).count();
+		fTimes[3] += std::chrono::duration<double>( t4 - t3 ).count();
+		fTimes[4] += std::chrono::duration<double>( t5 - t4 ).count();
+		fTimes[5] += std::chrono::duration<double>( t6 - t5 ).count();
+		fTimes[6] += std::chrono::duration<double>( t7 - t6 ).count();
+	}
+
+	printf( "random %d numbers a tick, %u ticks: %lld errors, worst chi-square %.1f\n", nCount, nTicks, nErrors, fWorst );
+	printf( "ns per number: rand() %.2f, rand() %% 500 %.2f, mt19937 %.2f\n",
+		fTimes[0] * 1e9 / fTotal, fTimes[1] * 1e9 / fTotal, fTimes[2] * 1e9 / fTotal );
+	printf( "               CRandom %.2f, Below( 500 ) %.2f, CRandomBatch %.2f, FillBelow( 500 ) %.2f\n",
+		fTimes[3] * 1e9 / fTotal, fTimes[4] * 1e9 / fTotal, fTimes[5] * 1e9 / fTotal, fTimes[6] * 1e9 / fTotal );
+	printf( "sum %016llx\n", (unsigned long long)nSum );
+	return nErrors ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : FlowHorde ()
+// Desc : Checks and benchmarks CFlowField with N enemies steering by it.
+//-----------------------------------------------------------------------------
+static int FlowHorde( int nEnemies, uint32_t nTicks, unsigned nSeed )
+{
+	typedef std::chrono::steady_clock Clock;
+	const int nColumns = 40, nRows = 30;
+	const double fCell = 20.0, fEnemySpeed = 60.0, fPlayerSpeed = 240.0;
+	long long nErrors = 0;
+	double fBuild[2] = { 0 }, fSteer[2] = { 0 };
+	size_t nBuilds = 0;
+	uint32_t nHash[2] = { 0 };
+
+	for ( int iRun = 0; iRun < 2; iRun++ )
+	{
+		CFlowField Field;
+		CRandom Random( nSeed, 0 );
+		Field.Create( nColumns, nRows, fCell );
+		Field.SetThreaded( iRun == 1 );
+		for ( int i = 0; i < nColumns * nRows / 6; i++ )
+		{
+			int c = Random.Below( nColumns );
+			int r = Random.Below( nRows );
+			Field.SetBlocked( c, r, true );
+		}
+
+		std::vector<Vec2> Enemies( nEnemies );
+		for ( int i = 0; i < nEnemies; i++ )
+		{
+			double x = Random.NextFloat() * nColumns * fCell;
+			double y = Random.NextFloat() * nRows * fCell;
+			Enemies[i] = Vec2( x, y );
+		}
+
+		Vec2 Players[2] = { Vec2( 100, 100 ), Vec2( 700, 500 ) }, Heading[2];
+		for ( uint32_t t = 0; t < nTicks; t++ )
+		{
+			// The players change heading now and then and bounce off the edges
+			for ( int p = 0; p < 2; p++ )
+			{
+				if ( t % SIM_TICK_RATE == 0 )
+				{
+					double a = Random.NextFloat() * 6.2831853;
+					Heading[p] = Vec2( cos( a ), sin( a ) ) * fPlayerSpeed;
+				}
+				Players[p] += Heading[p] * SIM_TICK;
+				if ( Players[p].x < 0 || Players[p].x >= nColumns * fCell ) { Heading[p].x = -Heading[p].x; Players[p].x = Players[p].x < 0 ? 0 : nColumns * fCell - 1; }
+				if ( Players[p].y < 0 || Players[p].y >= nRows * fCell ) { Heading[p].y = -Heading[p].y; Players[p].y = Players[p].y < 0 ? 0 : nRows * fCell - 1; }
+			}
+
+			// As the world does: the field asked for last tick is waited
+			// for, everyone steers by it, then the next one is asked for
+			auto t0 = Clock::now();
+			Field.Wait();
+			auto t1 = Clock::now();
+			for ( int i = 0; i < nEnemies; i++ )
+			{
+				Vec2& Enemy = Enemies[i];
+				Enemy += Field.Sample( Enemy ) * (fEnemySpeed * SIM_TICK);
+			}
+			auto t2 = Clock::now();
+			Field.Request( Players, 2 );
+			auto t3 = Clock::now();
+
+			fBuild[iRun] += std::chrono::duration<double>( (t1 - t0) + (t3 - t2) ).count();
+			fSteer[iRun] += std::chrono::duration<double>( t2 - t1 ).count();
+		}
+		Field.Wait();
+
+		// Following the flow from any cell that leads somewhere goes downhill
+		for ( int r = 0; r < nRows; r++ )
+		for ( int c = 0; c < nColumns; c++ )
+		{
+			Vec2 Centre( (c + 0.5) * fCell, (r + 0.5) * fCell );
+			uint16_t nDistance = Field.GetDistance( Centre );
+			if ( nDistance == 0 || nDistance == FLOW_UNREACHED ) continue;
+
+			Vec2 Flow = Field.Sample( Centre );
+			Vec2 Next( Centre.x + (Flow.x > 0.1 ? fCell : Flow.x < -0.1 ? -fCell : 0), Centre.y + (Flow.y > 0.1 ? fCell : Flow.y < -0.1 ? -fCell : 0) );
+			if ( Field.GetDistance( Next ) >= nDistance ) nErrors++;
+		}
+
+		nHash[iRun] = 2166136261u;
+		const unsigned char *b = (const unsigned char*)Enemies.data();
+		for ( size_t i = 0; i < Enemies.size() * sizeof(Vec2); i++ ) nHash[iRun] = (nHash[iRun] ^ b[i]) * 16777619u;
+		nBuilds = Field.GetBuilds();
+	}
+	if ( nHash[0] != nHash[1] ) nErrors++;
+
+	// A game plays the same with the field built on the worker
+	uint32_t nChecksum[2];
+	for ( int iRun = 0; iRun < 2; iRun++ )
+	{
+		CGameWorld World;
+		STickInput Input;
+		uint32_t nBot = nSeed;
+		memset( &Input, 0, sizeof(Input) );
+		World.SetThreaded( iRun == 1 );
+		World.Reset( nSeed );
+		for ( uint32_t t = 0; t < nTicks && !World.IsGameOver(); t++ )
+		{
+			BotInput( t, nBot, Input );
+			World.Step( Input );
+		}
+		nChecksum[iRun] = World.Checksum();
+	}
+	if ( nChecksum[0] != nChecksum[1] ) nErrors++;
+
+	printf( "flow %d enemies, %dx%d cells, %u ticks: %zu builds (%.2f per tick), %lld errors\n",
+		nEnemies, nColumns, nRows, nTicks, nBuilds, nBuilds / (double)nTicks, nErrors );
+	printf( "inline:   %.2f us per build, steering %.2f ns per enemy, %.2f us per tick\n",
+		fBuild[0] * 1e6 / nBuilds, fSteer[0] * 1e9 / ((double)nTicks * nEnemies), (fBuild[0] + fSteer[0]) * 1e6 / nTicks );
+	printf( "threaded: %.2f us per tick waiting for and asking for builds, %.2f us per tick\n",
+		fBuild[1] * 1e6 / nTicks, (fBuild[1] + fSteer[1]) * 1e6 / nTicks );
+	printf( "a search per enemy would be about %.0f us per tick\n", fBuild[0] * 1e6 / nBuilds * nEnemies * nBuilds / nTicks );
+	printf( "enemies %08x, game %08x\n", nHash[0], nChecksum[0] );
+	return nErrors ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SpatialQueries ()
+// Desc : Checks and benchmarks CSpatialGrid with N targets moving about.
+//-----------------------------------------------------------------------------
+static int SpatialQueries( int nTargets, uint32_t nTicks, unsigned nSeed )
+{
+	typedef std::chrono::steady_clock Clock;
+	const float fWidth = 800.0f, fHeight = 600.0f, fSpeed = 120.0f, fRadius = 40.0f, fCos = 0.8f;
+	const int nQuarter = (nTargets + 1) / 2, nQueries = nQuarter * 4, nCheckEvery = 16;
+	const size_t k = 8;
+	long long nErrors = 0, nChecked[4] = { 0 }, nFound[4] = { 0 };
+	double fBuild = 0, fQuery[4] = { 0 }, fBrute = 0;
+
+	CRandom Random( nSeed, 0 );
+	CSpatialGrid Grid;
+	std::vector<float> X( nTargets ), Y( nTargets ), DX( nTargets ), DY( nTargets );
+	std::vector<float> QX( nQueries ), QY( nQueries );
+	std::vector<int32_t> Answers( (size_t)nQueries * k ), Results( nQueries ), Ids, Written;
+	for ( int i = 0; i < nTargets; i++ )
+	{
+		X[i] = Random.NextFloat() * fWidth;
+		Y[i] = Random.NextFloat() * fHeight;
+		float a = Random.NextFloat() * 6.2831853f;
+		DX[i] = cosf( a ) * fSpeed * (float)SIM_TICK;
+		DY[i] = sinf( a ) * fSpeed * (float)SIM_TICK;
+	}
+
+	for ( uint32_t t = 0; t < nTicks; t++ )
+	{
+		// Quarter pixel steps, so some targets sit exactly as far as others
+		for ( int i = 0; i < nTargets; i++ )
+		{
+			X[i] = floorf( (X[i] + DX[i]) * 4.0f ) / 4.0f;
+			Y[i] = floorf( (Y[i] + DY[i]) * 4.0f ) / 4.0f;
+			if ( X[i] < 0 || X[i] >= fWidth ) { DX[i] = -DX[i]; X[i] = X[i] < 0 ? 0 : fWidth - 1; }
+			if ( Y[i] < 0 || Y[i] >= fHeight ) { DY[i] = -DY[i]; Y[i] = Y[i] < 0 ? 0 : fHeight - 1; }
+		}
+		for ( int q = 0; q < nQueries; q++ )
+		{
+			QX[q] = floorf( (Random.NextFloat() * 1.2f - 0.1f) * fWidth );
+			QY[q] = floorf( (Random.NextFloat() * 1.2f - 0.1f) * fHeight );
+		}
+
+		auto t0 = Clock::now();
+		Grid.Build( X.data(), Y.data(), NULL, nTargets );
+
+		// A quarter of the queries of each kind
+		auto t1 = Clock::now();
+		int q = 0;
+		for ( ; q < nQuarter; q++ ) Results[q] = Grid.Nearest( QX[q], QY[q] );
+		auto t2 = Clock::now();
+		for ( ; q < nQuarter * 2; q++ ) Results[q] = (int32_t)Grid.KNearest( QX[q], QY[q], k, &Answers[q * k] );
+		auto t3 = Clock::now();
+		for ( ; q < nQuarter * 3; q++ ) Results[q] = (int32_t)Grid.Radius( QX[q], QY[q], fRadius, &Answers[q * k], k );
+		auto t4 = Clock::now();
+		for ( ; q < nQuarter * 4; q++ ) Results[q] = Grid.NearestInCone( QX[q], QY[q], 0.0f, 1.0f, fCos );
+		auto t5 = Clock::now();
+
+		fBuild		+= std::chrono::duration<double>( t1 - t0 ).count();
+		fQuery[0]	+= std::chrono::duration<double>( t2 - t1 ).count();
+		fQuery[1]	+= std::chrono::duration<double>( t3 - t2 ).count();
+		fQuery[2]	+= std::chrono::duration<double>( t4 - t3 ).count();
+		fQuery[3]	+= std::chrono::duration<double>( t5 - t4 ).count();
+
+		// Against every target, closest first and the lower id on a tie
+		auto t6 = Clock::now();
+		int nStep = nQuarter >= nCheckEvery ? nCheckEvery : 1;
+		for ( int iCheck = 0; iCheck < nQueries; iCheck += nStep )
+		{
+			int iKind = (iCheck / nStep) % 4;
+			q = iKind * nQuarter + iCheck / 4;
+			Ids.clear();
+			for ( int i = 0; i < nTargets; i++ )
+			{
+				float dx = X[i] - QX[q], dy = Y[i] - QY[q], d2 = dx * dx + dy * dy;
+				if ( iKind == 2 && d2 > fRadius * fRadius ) continue;
+				if ( iKind == 3 && dy < fCos * sqrtf( d2 ) ) continue;
+				Ids.push_back( i );
+			}
+			auto Closer = [&]( int32_t a, int32_t b )
+			{
+				float ax = X[a] - QX[q], ay = Y[a] - QY[q], bx = X[b] - QX[q], by = Y[b] - QY[q];
+				float da = ax * ax + ay * ay, db = bx * bx + by * by;
+				return da < db || (da == db && a < b);
+			};
+			std::sort( Ids.begin(), Ids.end(), Closer );
+			nChecked[iKind]++;
+
+			switch ( iKind )
+			{
+			case 0:
+			case 3:
+				nFound[iKind] += Results[q] >= 0;
+				if ( Results[q] != (Ids.empty() ? -1 : Ids[0]) ) nErrors++;
+				break;
+
+			case 1:
+				nFound[1] += Results[q];
+				if ( (size_t)Results[q] != std::min( k, Ids.size() ) || !std::equal( Ids.begin(), Ids.begin() + Results[q], &Answers[q * k] ) ) nErrors++;
+				break;
+
+			case 2:
+				// In no particular order, and only the first k written
+				nFound[2] += Results[q];
+				Written.assign( &Answers[q * k], &Answers[q * k] + std::min<size_t>( Results[q], k ) );
+				if ( (size_t)Results[q] != Ids.size() ) { nErrors++; break; }
+				for ( size_t i = 0; i < Written.size(); i++ )
+					if ( std::find( Ids.begin(), Ids.end(), Written[i] ) == Ids.end() ) nErrors++;
+				break;
+			}
+		}
+		fBrute += std::chrono::duration<double>( Clock::now() - t6 ).count();
+	}
+
+	double fPerKind = (double)nTicks * nQuarter;
+	long long nAll = nChecked[0] + nChecked[1] + nChecked[2] + nChecked[3];
+	printf( "spatial %d targets, %d queries a tick, %u ticks: %lld checked, %lld errors\n",
+		nTargets, nQueries, nTicks, nAll, nErrors );
+	printf( "found %.2f nearest, %.2f of %zu nearest, %.2f within %.0f, %.2f in the cone per query\n",
+		nFound[0] / (double)nChecked[0], nFound[1] / (double)nChecked[1], k, nFound[2] / (double)nChecked[2], fRadius, nFound[3] / (double)nChecked[3] );
+	printf( "build %.2f us per tick; ns per query: nearest %.1f, %zu nearest %.1f, radius %.1f, cone %.1f\n",
+		fBuild * 1e6 / nTicks, fQuery[0] * 1e9 / fPerKind, k, fQuery[1] * 1e9 / fPerKind, fQuery[2] * 1e9 / fPerKind, fQuery[3] * 1e9 / fPerKind );
+	printf( "grid %.2f us per tick, trying every target about %.0f us per tick\n",
+		(fBuild + fQuery[0] + fQuery[1] + fQuery[2] + fQuery[3]) * 1e6 / nTicks, fBrute * 1e6 / nAll * nQueries );
+	return nErrors ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : WriteText () (Static)
+// Desc : Replaces a file with some text.
+//-----------------------------------------------------------------------------
+static bool WriteText( const char *szFile, const std::string& Text )
+{
+	FILE *pFile = fopen( szFile, "wb" );
+	if ( !pFile ) return false;
+	bool bResult = fwrite( Text.data(), 1, Text.size(), pFile ) == Text.size();
+	return fclose( pFile ) == 0 && bResult;
+}
+
+//-----------------------------------------------------------------------------
+// Name : LevelCache ()
+// Desc : Checks and benchmarks CLevelSet with N spawn spots.
+//-----------------------------------------------------------------------------
+static int LevelCache( int nSpawns, uint32_t nTicks, unsigned nSeed )
+{
+	typedef std::chrono::steady_clock Clock;
+	const char *szSource = "levelcache.txt", *szCache = "levelcache.cache";
+	const int nLevels = 8, nLoads = 200;
+	const SLevel Defaults = CGameWorld::DefaultLevel();
+	long long nErrors = 0;
+	CRandom Random( nSeed, 0 );
+	CLevelSet Levels;
+	char Line[96];
+
+	// Waves growing level by level, the spots mostly where to reappear
+	std::string Text = "# Written by headless -levelcache\n";
+	for ( int l = 0; l < nLevels; l++ )
+	{
+		snprintf( Line, sizeof(Line), "level\nwave %d %d\nmarch %d 20\nfire %d %d\n", 8 + l, 3 + l / 2, 30 + 4 * l, 1200 - 50 * l, 2400 );
+		Text += Line;
+		for ( int i = l * nSpawns / nLevels; i < (l + 1) * nSpawns / nLevels; i++ )
+		{
+			static const char *const Kinds[4] = { "respawn", "respawn", "jump", "star" };
+			snprintf( Line, sizeof(Line), "%s %.2f %.2f\n", Kinds[Random.Below( 4 )], Random.NextFloat() * 700.0f + 50.0f, Random.NextFloat() * 500.0f + 50.0f );
+			Text += Line;
+		}
+	}
+	if ( !WriteText( szSource, Text ) )
+	{
+		fprintf( stderr, "Can't write %s\n", szSource );
+		return 1;
+	}
+	remove( szCache );
+
+	auto CountSpawns = [&Levels]()
+	{
+		size_t nTotal = 0, n;
+		for ( size_t l = 0; l < Levels.GetCount(); l++ )
+			for ( int k = 0; k < SLevel::SPAWN_COUNT; k++ )
+			{
+				Levels.GetSpawns( Levels.GetLevel( l ), (SLevel::ESpawn)k, n );
+				nTotal += n;
+			}
+		return nTotal;
+	};
+
+	// Compiled the first time, the cache written
+	auto t0 = Clock::now();
+	if ( !Levels.Load( szSource, szCache, Defaults ) || Levels.IsCached() ) nErrors++;
+	double fFirst = std::chrono::duration<double>( Clock::now() - t0 ).count();
+	if ( Levels.GetCount() != (size_t)nLevels || CountSpawns() != (size_t)nSpawns ) nErrors++;
+	std::vector<uint8_t> Compiled( (const uint8_t*)Levels.GetImage(), (const uint8_t*)Levels.GetImage() + Levels.GetImageSize() );
+
+	// Mapped from then on, byte for byte what was compiled
+	double fCached = 0, fUse = 0, fSum = 0;
+	for ( int i = 0; i < nLoads; i++ )
+	{
+		auto t1 = Clock::now();
+		if ( !Levels.Load( szSource, szCache, Defaults ) || !Levels.IsCached() ) nErrors++;
+		auto t2 = Clock::now();
+		for ( size_t l = 0; l < Levels.GetCount(); l++ )
+		{
+			size_t n;
+			const SLevelSpawn *pSpawns = Levels.GetSpawns( Levels.GetLevel( l ), SLevel::SPAWN_RESPAWN, n );
+			for ( size_t s = 0; s < n; s++ ) fSum += pSpawns[s].x;
+		}
+		auto t3 = Clock::now();
+		fCached += std::chrono::duration<double>( t2 - t1 ).count();
+		fUse += std::chrono::duration<double>( t3 - t2 ).count();
+	}
+	if ( Levels.GetImageSize() != Compiled.size() || memcmp( Levels.GetImage(), Compiled.data(), Compiled.size() ) ) nErrors++;
+
+	// What the cached load pays to know the text did not change, and what
+	// compiling costs without reading the file
+	auto t4 = Clock::now();
+	uint64_t nHash = 0;
+	for ( int i = 0; i < nLoads; i++ ) nHash += CLevelSet::Hash( Text.data(), Text.size(), nHash );
+	auto t5 = Clock::now();
+	for ( int i = 0; i < nLoads / 20 + 1; i++ )
+		if ( !Levels.Compile( Text.data(), Text.size(), Defaults ) ) nErrors++;
+	auto t6 = Clock::now();
+	double fHash = std::chrono::duration<double>( t5 - t4 ).count() / nLoads;
+	double fCompile = std::chrono::duration<double>( t6 - t5 ).count() / (nLoads / 20 + 1);
+
+	// An edit to the text is compiled again, once
+	std::string Edited = Text + "jump 1 2\n";
+	WriteText( szSource, Edited );
+	if ( !Levels.Load( szSource, szCache, Defaults ) || Levels.IsCached() || CountSpawns() != (size_t)nSpawns + 1 ) nErrors++;
+	if ( !Levels.Load( szSource, szCache, Defaults ) || !Levels.IsCached() || CountSpawns() != (size_t)nSpawns + 1 ) nErrors++;
+
+	// As do other defaults, and a damaged or cut short cache
+	SLevel Faster = Defaults;
+	Faster.Speed *= 2;
+	if ( !Levels.Load( szSource, szCache, Faster ) || Levels.IsCached() ) nErrors++;
+	Levels.Clear();
+	std::string Damaged( (const char*)Compiled.data(), Compiled.size() );
+	Damaged[sizeof(uint32_t) * 4] ^= 1;
+	WriteText( szCache, Damaged );
+	WriteText( szSource, Text );
+	if ( !Levels.Load( szSource, szCache, Defaults ) || Levels.IsCached() ) nErrors++;
+	Levels.Clear();
+	WriteText( szCache, std::string( (const char*)Compiled.data(), Compiled.size() - 1 ) );
+	if ( !Levels.Load( szSource, szCache, Defaults ) || Levels.IsCached() ) nErrors++;
+	if ( !Levels.Load( szSource, szCache, Defaults ) || !Levels.IsCached() ) nErrors++;
+
+	// Mistakes are reported by line
+	static const struct { const char *szText; int nLine; } Bad[] =
+	{
+		{ "wave 8 3\n", 1 },
+		{ "level\nwave 0 3\n", 2 },
+		{ "level\n# fine\nwave 8 65\n", 3 },
+		{ "level\nmarch 30\n", 2 },
+		{ "level\nfire 1200.5 10\n", 2 },
+		{ "level\nstar 1 2 3\n", 2 },
+		{ "level\nstars 1 2\n", 2 },
+		{ "level\njump 1 x\n", 2 },
+		{ "# nothing\n", 2 },
+	};
+	for ( size_t i = 0; i < sizeof(Bad) / sizeof(Bad[0]); i++ )
+		if ( Levels.Compile( Bad[i].szText, strlen( Bad[i].szText ), Defaults ) || Levels.GetErrorLine() != Bad[i].nLine ) nErrors++;
+
+	// A level that only takes the defaults plays the game without levels
+	uint32_t nChecksum[2];
+	if ( !Levels.Compile( "level\n", 6, Defaults ) ) nErrors++;
+	for ( int iRun = 0; iRun < 2; iRun++ )
+	{
+		CGameWorld World;
+		STickInput Input;
+		uint32_t nBot = nSeed;
+		memset( &Input, 0, sizeof(Input) );
+		World.SetLevels( iRun ? &Levels : NULL );
+		World.Reset( nSeed );
+		for ( uint32_t t = 0; t < nTicks && !World.IsGameOver(); t++ )
+		{
+			BotInput( t, nBot, Input );
+			World.Step( Input );
+		}
+		nChecksum[iRun] = World.Checksum();
+	}
+	if ( nChecksum[0] != nChecksum[1] ) nErrors++;
+
+	Levels.Clear();
+	remove( szSource );
+	remove( szCache );
+
+	printf( "levelcache %d spawns in %d levels, text %.1f KB, cache %.1f KB: %lld errors\n",
+		nSpawns, nLevels, Text.size() / 1024.0, Compiled.size() / 1024.0, nErrors );
+	printf( "first load %.3f ms: read, hash, compile and write the cache\n", fFirst * 1e3 );
+	printf( "cached load %.2f us, of which hashing the text %.2f us; reading every respawn spot %.2f us\n",
+		fCached * 1e6 / nLoads, fHash * 1e6, fUse * 1e6 / nLoads );
+	printf( "compiling alone %.3f ms, %.1f ns per spawn line\n", fCompile * 1e3, fCompile * 1e9 / nSpawns );
+	printf( "game %08x, spots %.0f\n", nChecksum[0], fSum / nLoads );
+	return nErrors ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SaveGames ()
+// Desc : Round trips a played world through CSaveFile and checks that
+//		damaged, cut, newer and legacy saves give the load result the game
+//		expects.
+//-----------------------------------------------------------------------------
+static int SaveGames( uint32_t nTicks, unsigned nSeed, const CLevelSet *pLevels )
+{
+	typedef std::chrono::steady_clock Clock;
+	const char *szSave = "savefile.sav", *szLegacy = "savefile.out";
+	static const char *const Results[] = { "ok", "missing", "corrupt", "newer" };
+
+	CHeadlessPlatform Platform;
+	CGameWorld World( &Platform ), Loaded( &Platform );
+	STickInput Input;
+	uint32_t nBot = nSeed, nGames = 1;
+	int nErrors = 0;
+
+	memset( &Input, 0, sizeof(Input) );
+	World.SetLevels( pLevels );
+	Loaded.SetLevels( pLevels );
+	World.Reset( nSeed );
+	for ( uint32_t t = 0; t < nTicks; t++ )
+	{
+		BotInput( t, nBot, Input );
+		World.Step( Input );
+		if ( World.IsGameOver() ) World.Reset( nSeed + nGames++ );
+	}
+
+	// As CGameApp::CaptureSave and LoadGame do it
+	std::vector<double> Buffer( World.GetStateSize() / sizeof(double) + 1 ), State;
+	size_t nSize = World.SaveState( Buffer.data(), Buffer.size() * sizeof(double) ), nRead = 0;
+
+	auto t0 = Clock::now();
+	bool bWritten = CSaveFile::Write( szSave, Buffer.data(), nSize );
+	auto t1 = Clock::now();
+	CSaveFile::ELoadResult eResult = CSaveFile::Read( szSave, State, nRead );
+	auto t2 = Clock::now();
+
+	bool bSame = bWritten && eResult == CSaveFile::LOAD_OK && nRead == nSize && Loaded.LoadState( State.data(), nRead ) &&
+		Loaded.Checksum() == World.Checksum();
+
+	// Both have to carry on as one game, ten seconds or to its end
+	for ( uint32_t t = nTicks; bSame && !World.IsGameOver() && t < nTicks + 10 * SIM_TICK_RATE; t++ )
+	{
+		BotInput( t, nBot, Input );
+		World.Step( Input );
+		Loaded.Step( Input );
+		bSame = Loaded.Checksum() == World.Checksum();
+	}
+	if ( !bSame ) nErrors++;
+
+	printf( "save of %u ticks, %u bytes: write %.3f ms, read %.3f ms, loaded world %s\n", nTicks, (unsigned)nSize,
+		std::chrono::duration<double>( t1 - t0 ).count() * 1e3, std::chrono::duration<double>( t2 - t1 ).count() * 1e3,
+		bSame ? "plays on the same" : "DIFFERS" );
+
+	// The file as written, changed one way at a time
+	std::vector<uint8_t> Good( SAVE_HEADER_SIZE + nSize );
+	CSaveFile::EncodeHeader( Good.data(), Buffer.data(), nSize );
+	memcpy( Good.data() + SAVE_HEADER_SIZE, Buffer.data(), nSize );
+
+	auto Check = [&]( const char *szCase, const std::vector<uint8_t>& File, CSaveFile::ELoadResult eExpected )
+	{
+		size_t nHeader = 0, nPayload = 0;
+		CSaveFile::ELoadResult eVerified = CSaveFile::Verify( File.data(), File.size(), nHeader, nPayload );
+		CSaveFile::ELoadResult eLoaded = WriteText( szSave, std::string( File.begin(), File.end() ) ) ? CSaveFile::Read( szSave, State, nRead ) : CSaveFile::LOAD_MISSING;
+		bool bRight = eVerified == eExpected && eLoaded == eExpected;
+		if ( !bRight ) nErrors++;
+		printf( "%-24s %-8s %s\n", szCase, Results[eLoaded], bRight ? "" : "WRONG" );
+	};
+
+	std::vector<uint8_t> File = Good;
+	Check( "as written", File, CSaveFile::LOAD_OK );
+	File[SAVE_HEADER_SIZE + nSize / 2] ^= 0x10;
+	Check( "payload byte flipped", File, CSaveFile::LOAD_CORRUPT );
+	File = Good;
+	File.resize( File.size() - 1 );
+	Check( "cut by a byte", File, CSaveFile::LOAD_CORRUPT );
+	File.resize( SAVE_HEADER_SIZE / 2 );
+	Check( "cut in the header", File, CSaveFile::LOAD_CORRUPT );
+	File = Good;
+	File[4]++;
+	Check( "version bumped", File, CSaveFile::LOAD_NEWER );
+	File = Good;
+	File[0] = 'X';
+	Check( "not a save", File, CSaveFile::LOAD_CORRUPT );
+
+	remove( szSave );
+	eResult = CSaveFile::Read( szSave, State, nRead );
+	if ( eResult != CSaveFile::LOAD_MISSING ) nErrors++;
+	printf( "%-24s %-8s %s\n", "no file", Results[eResult], eResult == CSaveFile::LOAD_MISSING ? "" : "WRONG" );
+
+	// The test.out text older builds saved, of the world as it now is
+	char Text[256];
+	snprintf( Text, sizeof(Text), "%d\n%d\n%g %g\n%g %g\n%d\n%d\n", World.Player(0).Lives, World.Player(1).Lives,
+		World.Player(0).Position.x, World.Player(0).Position.y, World.Player(1).Position.x, World.Player(1).Position.y,
+		World.Player(0).Score, World.Player(1).Score );
+
+	SLegacySave Legacy;
+	eResult = WriteText( szLegacy, Text ) ? CSaveFile::ReadLegacy( szLegacy, Legacy ) : CSaveFile::LOAD_MISSING;
+	bool bLegacy = eResult == CSaveFile::LOAD_OK;
+	for ( int i = 0; i < 2 && bLegacy; i++ )
+		bLegacy = Legacy.Lives[i] == World.Player(i).Lives && Legacy.Score[i] == World.Player(i).Score &&
+			fabsf( Legacy.Position[i].x - World.Player(i).Position.x ) < 0.01f && fabsf( Legacy.Position[i].y - World.Player(i).Position.y ) < 0.01f;
+	if ( !bLegacy ) nErrors++;
+	printf( "%-24s %-8s %s\n", "legacy test.out", Results[eResult], bLegacy ? "" : "WRONG" );
+
+	// Cut after the first player's position
+	std::string Cut( Text );
+	Cut.resize( Cut.find( '\n', Cut.find( '\n', Cut.find( '\n' ) + 1 ) + 1 ) );
+	eResult = WriteText( szLegacy, Cut ) ? CSaveFile::ReadLegacy( szLegacy, Legacy ) : CSaveFile::LOAD_MISSING;
+	if ( eResult != CSaveFile::LOAD_CORRUPT ) nErrors++;
+	printf( "%-24s %-8s %s\n", "legacy test.out cut", Results[eResult], eResult == CSaveFile::LOAD_CORRUPT ? "" : "WRONG" );
+	remove( szLegacy );
+
+	printf( "%d errors\n", nErrors );
+	return nErrors ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : LoadAssets ()
+// Desc : Times one start up's worth of asset loading, -assets below.
+//-----------------------------------------------------------------------------
+static bool LoadAssets( const char *szDir, bool bThreaded, double& fFirstFrame, double& fLoaded, uint32_t& nPixelHash )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// As CGameApp::BuildObjects asks for them; the file names as they are on disk
+	static const struct { const char *szFile; CAssetLoader::EAssetPriority ePriority; } Assets[] =
+	{
+		{ "PlaneImgAndMask.bmp",		CAssetLoader::AP_CRITICAL },
+		{ "PlaneImgAndMaskLeft.bmp",	CAssetLoader::AP_CRITICAL },
+		{ "PlaneImgAndMaskRight.bmp",	CAssetLoader::AP_CRITICAL },
+		{ "PlaneImgAndMaskk.bmp",		CAssetLoader::AP_CRITICAL },
+		{ "enemyMask.bmp",				CAssetLoader::AP_CRITICAL },
+		{ "starMask.bmp",				CAssetLoader::AP_CRITICAL },
+		{ "explosion.bmp",				CAssetLoader::AP_CRITICAL },
+		{ "explosionmask.bmp",			CAssetLoader::AP_CRITICAL },
+		{ "upBullet.bmp",				CAssetLoader::AP_GAMEPLAY },
+		{ "upBulletMask.bmp",			CAssetLoader::AP_GAMEPLAY },
+		{ "Background.bmp",				CAssetLoader::AP_BACKGROUND },
+	};
+	const size_t nAssets = sizeof(Assets) / sizeof(Assets[0]);
+
+	CWorkerPool Pool;
+	CAssetLoader Loader( &Pool );
+	CImageFile Images[nAssets];
+	std::shared_future<bool> Loaded[nAssets];
+	std::string Path;
+
+	auto Start = Clock::now();
+	if ( bThreaded ) Pool.Start();
+
+	for ( size_t i = 0; i < nAssets; i++ )
+	{
+		Path = std::string( szDir ) + "/" + Assets[i].szFile;
+		Loaded[i] = Loader.RequestImage( &Images[i], Path.c_str(), Assets[i].ePriority );
+	}
+
+	// The game's loop: draw the loading screen until the critical assets
+	// are in, then play while the rest arrive
+	fFirstFrame = -1;
+	while ( !Loader.IsLoaded( CAssetLoader::AP_BACKGROUND ) )
+	{
+		if ( fFirstFrame < 0 && Loader.IsLoaded( CAssetLoader::AP_CRITICAL ) )
+			fFirstFrame = std::chrono::duration<double>( Clock::now() - Start ).count();
+		std::this_thread::yield();
+	}
+	fLoaded = std::chrono::duration<double>( Clock::now() - Start ).count();
+	if ( fFirstFrame < 0 ) fFirstFrame = fLoaded;
+
+	// FNV-1a over every image, its size included
+	bool bResult = Loader.GetLoadedCount() == nAssets;
+	nPixelHash = 2166136261u;
+	for ( size_t i = 0; i < nAssets; i++ )
+	{
+		if ( !Loaded[i].get() || !Images[i].Bits() ) { bResult = false; continue; }
+
+		const uint8_t *p = (const uint8_t*)Images[i].Bits();
+		size_t nBytes = Images[i].Width() * Images[i].Height() * sizeof(RGBQUAD);
+		nPixelHash = (nPixelHash ^ (uint32_t)Images[i].Width()) * 16777619u;
+		for ( size_t b = 0; b < nBytes; b++ ) nPixelHash = (nPixelHash ^ p[b]) * 16777619u;
+	}
+
+	return bResult;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Assets ()
+// Desc : Start up loading inline against CAssetLoader on the worker pool.
+//-----------------------------------------------------------------------------
+static int Assets( const char *szDir )
+{
+	const int nRuns = 20;
+	double fFirst[2][nRuns], fLoaded[2][nRuns];
+	uint32_t nHash[2] = { 0, 0 }, nRunHash;
+	int nErrors = 0;
+
+	// Alternated, so both see the same disk cache
+	for ( int r = 0; r < nRuns; r++ )
+		for ( int t = 0; t < 2; t++ )
+		{
+			if ( !LoadAssets( szDir, t != 0, fFirst[t][r], fLoaded[t][r], nRunHash ) ) nErrors++;
+			if ( r == 0 ) nHash[t] = nRunHash;
+			else if ( nRunHash != nHash[t] ) nErrors++;
+		}
+	if ( nHash[0] != nHash[1] ) nErrors++;
+
+	if ( nErrors )
+	{
+		printf( "assets from %s: %d errors, images missing or different\n", szDir, nErrors );
+		return 1;
+	}
+
+	printf( "assets from %s, %d runs each, pixels %08x, %u worker threads\n", szDir, nRuns, nHash[0], std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1 );
+	printf( "            first frame ms      fully loaded ms\n" );
+	printf( "            median    best      median    best\n" );
+	for ( int t = 0; t < 2; t++ )
+	{
+		std::sort( fFirst[t], fFirst[t] + nRuns );
+		std::sort( fLoaded[t], fLoaded[t] + nRuns );
+		printf( "%-10s  %7.2f  %7.2f     %7.2f  %7.2f\n", t ? "pool" : "inline",
+			fFirst[t][nRuns / 2] * 1e3, fFirst[t][0] * 1e3, fLoaded[t][nRuns / 2] * 1e3, fLoaded[t][0] * 1e3 );
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : TestPicture () (Static)
+// Desc : Something like a frame of the game to filter: gradients, hard
+//		edged discs and some grain.
+//-----------------------------------------------------------------------------
+static void TestPicture( std::vector<RGBQUAD>& Pixels, int nWidth, int nHeight, unsigned nSeed )
+{
+	CRandom Random( nSeed, 1 );
+	float Discs[16][4];
+	for ( int i = 0; i < 16; i++ )
+	{
+		Discs[i][0] = Random.NextFloat() * nWidth;
+		Discs[i][1] = Random.NextFloat() * nHeight;
+		Discs[i][2] = (Random.NextFloat() * 0.1f + 0.02f) * nWidth;
+		Discs[i][3] = (float)Random.Below( 256 );
+	}
+
+	Pixels.resize( nWidth * nHeight );
+	for ( int y = 0; y < nHeight; y++ )
+		for ( int x = 0; x < nWidth; x++ )
+		{
+			RGBQUAD& c = Pixels[y * nWidth + x];
+			int nGrain = (int)Random.Below( 32 ) - 16;
+			c.rgbRed		= (BYTE)(x * 255 / nWidth);
+			c.rgbGreen		= (BYTE)(y * 255 / nHeight);
+			c.rgbBlue		= (BYTE)std::min( 255, std::max( 0, 128 + nGrain ) );
+			c.rgbReserved	= 0;
+			for ( int i = 0; i < 16; i++ )
+			{
+				float dx = x - Discs[i][0], dy = y - Discs[i][1];
+				if ( dx * dx + dy * dy < Discs[i][2] * Discs[i][2] ) c.rgbBlue = c.rgbGreen = (BYTE)Discs[i][3];
+			}
+		}
+}
+
+//-----------------------------------------------------------------------------
+// Name : Convolve ()
+// Desc : Benchmarks CConvolution over kernel sizes 3 to 31.
+//-----------------------------------------------------------------------------
+static int Convolve( int nRuns )
+{
+	typedef std::chrono::steady_clock Clock;
+	const int nWidth = 800, nHeight = 600;
+	const double fBudget = 1.0;			// ms a frame
+
+	std::vector<RGBQUAD> Source, Inline( nWidth * nHeight ), Pooled( nWidth * nHeight ), Taps( nWidth * nHeight );
+	TestPicture( Source, nWidth, nHeight, 1 );
+
+	CWorkerPool Pool;
+	Pool.Start();
+	CConvolution Convolutions[2] = { CConvolution( NULL ), CConvolution( &Pool ) };
+	std::vector<double> Times( nRuns );
+	int nErrors = 0, nOver = 0;
+
+	auto Median = [&]( CConvolution& Convolution, const CKernel& Kernel, std::vector<RGBQUAD>& Out )
+	{
+		for ( int r = 0; r < nRuns; r++ )
+		{
+			auto t0 = Clock::now();
+			Convolution.Apply( Source.data(), Out.data(), nWidth, nHeight, Kernel, EBM_MIRROR );
+			Times[r] = std::chrono::duration<double>( Clock::now() - t0 ).count() * 1e3;
+		}
+		std::sort( Times.begin(), Times.end() );
+		return Times[nRuns / 2];
+	};
+	auto MaxDifference = []( const std::vector<RGBQUAD>& a, const std::vector<RGBQUAD>& b )
+	{
+		int nMax = 0;
+		const BYTE *pa = (const BYTE*)a.data(), *pb = (const BYTE*)b.data();
+		for ( size_t i = 0; i < a.size() * 4; i++ ) nMax = std::max( nMax, abs( pa[i] - pb[i] ) );
+		return nMax;
+	};
+
+	printf( "convolve %d x %d, median of %d, %u pool threads, budget %.1f ms\n", nWidth, nHeight, nRuns, Pool.ThreadCount(), fBudget );
+	printf( "taps  kernel         inline ms  pool ms  Mpix/s  running sums\n" );
+
+	for ( int nTaps = 3; nTaps <= 31; nTaps += nTaps < 11 ? 2 : 4 )
+	{
+		int nRadius = nTaps / 2;
+		std::vector<double> Box( nTaps, 1.0 / nTaps );
+		static const char *const Names[4] = { "gaussian", "box taps", "box", "fast gaussian" };
+		CKernel Kernels[4] =
+		{
+			CKernel::Gaussian( nRadius ),
+			CKernel::Separable( Box.data(), nTaps, Box.data(), nTaps ),
+			CKernel::Box( nRadius ),
+			CKernel::FastGaussian( nRadius ),
+		};
+
+		for ( int k = 0; k < 4; k++ )
+		{
+			double fInline = Median( Convolutions[0], Kernels[k], Inline );
+			double fPooled = Median( Convolutions[1], Kernels[k], Pooled );
+			if ( memcmp( Inline.data(), Pooled.data(), Inline.size() * sizeof(RGBQUAD) ) ) nErrors++;
+
+			// The box's running sums against its taps
+			int nDifference = -1;
+			if ( k == 1 ) Taps = Inline;
+			if ( k == 2 && (nDifference = MaxDifference( Inline, Taps )) > 1 ) nErrors++;
+
+			double fBest = std::min( fInline, fPooled );
+			bool bOver = Kernels[k].IsBoxBlur() && fBest > fBudget;
+			if ( bOver ) nOver++;
+			printf( "%4d  %-13s  %9.3f  %7.3f  %6.0f  %s%s\n", nTaps, Names[k], fInline, fPooled, nWidth * nHeight / (fBest * 1e3),
+				nDifference < 0 ? "" : (nDifference ? "1 level" : "same"), bOver ? "  over budget" : "" );
+		}
+	}
+
+	printf( "%d errors, %d running sum blurs over budget\n", nErrors, nOver );
+	return nErrors ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : CTestImage (Class)
+// Desc : A CImageFile, or a class built on it, made in memory instead of
+//		loaded from a file.
+//-----------------------------------------------------------------------------
+template <class TImage> class CTestImage : public TImage
+{
+public:
+	CTestImage( int nWidth, int nHeight ) { Resize( nWidth, nHeight ); }
+
+	void Set( const std::vector<RGBQUAD>& Pixels, int nWidth, int nHeight )
+	{
+		Resize( nWidth, nHeight );
+		memcpy( this->m_pRGB, Pixels.data(), nWidth * nHeight * sizeof(RGBQUAD) );
+	}
+
+private:
+	void Resize( int nWidth, int nHeight )
+	{
+		if ( this->m_pRGB && this->Width() == nWidth && this->Height() == nHeight ) return;
+
+		delete[] this->m_pRGB;
+		this->m_biInfo.biSize			= sizeof(BITMAPINFOHEADER);
+		this->m_biInfo.biWidth			= nWidth;
+		this->m_biInfo.biHeight			= nHeight;
+		this->m_biInfo.biPlanes			= 1;
+		this->m_biInfo.biBitCount		= 32;
+		this->m_biInfo.biCompression	= BI_RGB;
+		this->m_pRGB = new RGBQUAD[nWidth * nHeight];
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Name : MonoSteps () (Static)
+// Desc : One channel chain the way it was written before CImagePipeline:
+//		CopyMonoImage, the LUT over the plane, CConvolution on a grey image
+//		and PasteMonoImage, each over the whole image.
+//-----------------------------------------------------------------------------
+static void MonoSteps( CImageFile& Image, EColorChannel In, const BYTE *pLut, const CKernel& Kernel, EColorChannel Out,
+	CConvolution& Convolution, std::vector<RGBQUAD>& Grey, std::vector<RGBQUAD>& Filtered )
+{
+	int nPixels = Image.Width() * Image.Height();
+	BYTE *pMono = Image.CopyMonoImage( In );
+
+	Grey.resize( nPixels );
+	Filtered.resize( nPixels );
+	for ( int i = 0; i < nPixels; i++ )
+	{
+		BYTE v = pLut ? pLut[pMono[i]] : pMono[i];
+		RGBQUAD q = { v, v, v, 0 };
+		Grey[i] = q;
+	}
+
+	Convolution.Apply( Grey.data(), Filtered.data(), Image.Width(), Image.Height(), Kernel );
+	for ( int i = 0; i < nPixels; i++ ) pMono[i] = Filtered[i].rgbRed;
+
+	Image.PasteMonoImage( pMono, Out );
+	delete[] pMono;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Pipeline ()
+// Desc : Times one channel chains through CImagePipeline against the same
+//		steps done one whole image pass at a time.
+//-----------------------------------------------------------------------------
+static int Pipeline( int nRuns )
+{
+	typedef std::chrono::steady_clock Clock;
+	const int nWidth = 800, nHeight = 600;
+
+	std::vector<RGBQUAD> Source, Grey, Filtered;
+	TestPicture( Source, nWidth, nHeight, 2 );
+	CTestImage<CImageFile> Image( nWidth, nHeight ), Expected( nWidth, nHeight );
+
+	BYTE Gamma[256];
+	for ( int i = 0; i < 256; i++ ) Gamma[i] = (BYTE)(pow( i / 255.0, 1.0 / 2.2 ) * 255.0 + 0.5);
+
+	struct SChain
+	{
+		const char		*szName;
+		EColorChannel	In;
+		const BYTE		*pLut;
+		CKernel			Kernel;
+		EColorChannel	Out;
+	};
+	const SChain Chains[] =
+	{
+		{ "luminosity gamma blur5 excl red",	ECC_LUMINOSITY,	Gamma,	CKernel::Gaussian( 2 ),	ECC_EXCLUSIVERED },
+		{ "green sharpen green",				ECC_GREEN,		NULL,	CKernel::Sharpen(),		ECC_GREEN },
+		{ "hue blur9 blue",						ECC_HUE,		NULL,	CKernel::Gaussian( 4 ),	ECC_BLUE },
+		{ "red edge excl green",				ECC_RED,		NULL,	CKernel::Edge(),		ECC_EXCLUSIVEGREEN },
+	};
+
+	CWorkerPool Pool;
+	Pool.Start();
+	CConvolution Convolution;
+	CImagePipeline Pipelines[2] = { CImagePipeline( NULL ), CImagePipeline( &Pool ) };
+	std::vector<double> Times( nRuns );
+	int nErrors = 0;
+
+	auto Median = [&]( const std::function<void()>& Run )
+	{
+		for ( int r = 0; r < nRuns; r++ )
+		{
+			Image.Set( Source, nWidth, nHeight );
+			auto t0 = Clock::now();
+			Run();
+			Times[r] = std::chrono::duration<double>( Clock::now() - t0 ).count() * 1e3;
+		}
+		std::sort( Times.begin(), Times.end() );
+		return Times[nRuns / 2];
+	};
+
+	printf( "pipeline %d x %d, median of %d, %u pool threads\n", nWidth, nHeight, nRuns, Pool.ThreadCount() );
+	printf( "chain                             steps ms  inline ms  pool ms  speedup\n" );
+
+	for ( const SChain& Chain : Chains )
+	{
+		double fSteps = Median( [&]() { MonoSteps( Image, Chain.In, Chain.pLut, Chain.Kernel, Chain.Out, Convolution, Grey, Filtered ); } );
+		memcpy( Expected.Bits(), Image.Bits(), Source.size() * sizeof(RGBQUAD) );
+
+		double fTimes[2];
+		for ( int p = 0; p < 2; p++ )
+		{
+			CImagePipeline& Steps = Pipelines[p];
+			Steps.Clear();
+			Steps.Extract( Chain.In );
+			if ( Chain.pLut ) Steps.Point( Chain.pLut );
+			Steps.Convolve( Chain.Kernel ).Insert( Chain.Out );
+
+			fTimes[p] = Median( [&]() { Steps.Run( Image ); } );
+			if ( memcmp( Image.Bits(), Expected.Bits(), Source.size() * sizeof(RGBQUAD) ) ) nErrors++;
+		}
+
+		printf( "%-32s  %8.3f  %9.3f  %7.3f  %6.1fx\n", Chain.szName, fSteps, fTimes[0], fTimes[1], fSteps / std::min( fTimes[0], fTimes[1] ) );
+	}
+
+	printf( "%d chains differ from the whole image steps\n", nErrors );
+	return nErrors ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ResampleReference () (Static)
+// Desc : The two passes of CResizableImage with the same weights, kept in
+//		double throughout and neither rounded nor clamped in between.
+//-----------------------------------------------------------------------------
+static void ResampleReference( const std::vector<RGBQUAD>& Source, int nWidth, int nHeight, CGenericFilter *pFilter,
+	int nDstWidth, int nDstHeight, std::vector<double>& Out )
+{
+	CWeightsTable Columns( pFilter, nDstWidth, nWidth ), Rows( pFilter, nDstHeight, nHeight );
+	std::vector<double> Mid( nDstWidth * nHeight * 3 );
+
+	for ( int y = 0; y < nHeight; y++ )
+		for ( int x = 0; x < nDstWidth; x++ )
+		{
+			double *pMid = &Mid[(y * nDstWidth + x) * 3];
+			pMid[0] = pMid[1] = pMid[2] = 0;
+			int nLeft = nDstWidth == nWidth ? x : Columns.getLeftBoundary( x );
+			int nRight = nDstWidth == nWidth ? x : Columns.getRightBoundary( x );
+			for ( int i = nLeft; i <= nRight; i++ )
+			{
+				const RGBQUAD& q = Source[y * nWidth + i];
+				double w = nDstWidth == nWidth ? 1.0 : Columns.getWeight( x, i - nLeft );
+				pMid[0] += w * q.rgbRed;
+				pMid[1] += w * q.rgbGreen;
+				pMid[2] += w * q.rgbBlue;
+			}
+		}
+
+	Out.assign( nDstWidth * nDstHeight * 3, 0.0 );
+	for ( int y = 0; y < nDstHeight; y++ )
+	{
+		int nTop = nDstHeight == nHeight ? y : Rows.getLeftBoundary( y );
+		int nBottom = nDstHeight == nHeight ? y : Rows.getRightBoundary( y );
+		for ( int i = nTop; i <= nBottom; i++ )
+		{
+			double w = nDstHeight == nHeight ? 1.0 : Rows.getWeight( y, i - nTop );
+			for ( int x = 0; x < nDstWidth * 3; x++ ) Out[y * nDstWidth * 3 + x] += w * Mid[i * nDstWidth * 3 + x];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : Resize ()
+// Desc : Times CResizableImage over the filters in Filters.h, a few source
+//		sizes and scales, and measures its PSNR against the reference.
+//-----------------------------------------------------------------------------
+static int Resize( int nRuns )
+{
+	typedef std::chrono::steady_clock Clock;
+	const double fMinPsnr = 40.0;		// dB, the 8 bit rounding costs far less
+
+	CBoxFilter		Box;
+	CBilinearFilter	Bilinear;
+	CBicubicFilter	Bicubic;
+	CLanczos3Filter	Lanczos3;
+	CBSplineFilter	BSpline;
+	struct SFilter { const char *szName; CGenericFilter *pFilter; };
+	const SFilter Filters[] = { { "box", &Box }, { "bilinear", &Bilinear }, { "bicubic", &Bicubic }, { "lanczos3", &Lanczos3 }, { "bspline", &BSpline } };
+	const int Sizes[][2] = { { 64, 64 }, { 256, 256 }, { 800, 600 } };
+	const double Scales[] = { 0.25, 0.5, 0.75, 1.5, 2.0 };
+
+	CTestImage<CResizableImage> Image( 1, 1 );
+	std::vector<RGBQUAD> Source;
+	std::vector<double> Times( nRuns ), Reference;
+	int nLow = 0;
+
+	printf( "filter,src_w,src_h,dst_w,dst_h,scale,ms,mpix_s,table_ms,table_kb,peak_kb,psnr_db\n" );
+	for ( const SFilter& Filter : Filters )
+		for ( const auto& Size : Sizes )
+			for ( double fScale : Scales )
+			{
+				int nWidth = Size[0], nHeight = Size[1];
+				int nDstWidth = (int)(nWidth * fScale + 0.5), nDstHeight = (int)(nHeight * fScale + 0.5);
+				TestPicture( Source, nWidth, nHeight, 3 );
+				Image.SetFilter( Filter.pFilter );
+
+				for ( int r = 0; r < nRuns; r++ )
+				{
+					Image.Set( Source, nWidth, nHeight );
+					auto t0 = Clock::now();
+					Image.Resample( nDstWidth, nDstHeight );
+					Times[r] = std::chrono::duration<double>( Clock::now() - t0 ).count() * 1e3;
+				}
+				std::sort( Times.begin(), Times.end() );
+				double fMs = Times[nRuns / 2];
+
+				// Both tables on their own, and the most Resample holds at once:
+				// the source, the first pass and its table, then the first
+				// pass, the result and the second table
+				auto t0 = Clock::now();
+				CWeightsTable *pColumns = new CWeightsTable( Filter.pFilter, nDstWidth, nWidth );
+				CWeightsTable *pRows = new CWeightsTable( Filter.pFilter, nDstHeight, nHeight );
+				double fTableMs = std::chrono::duration<double>( Clock::now() - t0 ).count() * 1e3;
+				size_t nColumns = pColumns->getSize(), nRows = pRows->getSize();
+				delete pColumns;
+				delete pRows;
+
+				bool bColumnsFirst = (size_t)nDstWidth * nHeight <= (size_t)nDstHeight * nWidth;
+				size_t nMid = (bColumnsFirst ? (size_t)nDstWidth * nHeight : (size_t)nWidth * nDstHeight) * sizeof(RGBQUAD);
+				size_t nPeak = std::max( (size_t)nWidth * nHeight * sizeof(RGBQUAD) + nMid + (bColumnsFirst ? nColumns : nRows),
+					nMid + (size_t)nDstWidth * nDstHeight * sizeof(RGBQUAD) + (bColumnsFirst ? nRows : nColumns) );
+
+				// Error against the reference, over the three colour channels
+				ResampleReference( Source, nWidth, nHeight, Filter.pFilter, nDstWidth, nDstHeight, Reference );
+				double fError = 0;
+				for ( int i = 0; i < nDstWidth * nDstHeight; i++ )
+				{
+					const RGBQUAD& q = Image.Bits()[i];
+					const BYTE Channels[3] = { q.rgbRed, q.rgbGreen, q.rgbBlue };
+					for ( int c = 0; c < 3; c++ )
+					{
+						double d = Channels[c] - std::min( 255.0, std::max( 0.0, Reference[i * 3 + c] ) );
+						fError += d * d;
+					}
+				}
+				fError /= nDstWidth * nDstHeight * 3.0;
+				double fPsnr = fError > 0 ? 10.0 * log10( 255.0 * 255.0 / fError ) : 99.0;
+				if ( fPsnr < fMinPsnr ) nLow++;
+
+				printf( "%s,%d,%d,%d,%d,%.2f,%.3f,%.1f,%.3f,%.1f,%.1f,%.2f\n", Filter.szName, nWidth, nHeight, nDstWidth, nDstHeight, fScale,
+					fMs, nDstWidth * nDstHeight / (fMs * 1e3), fTableMs, (nColumns + nRows) / 1024.0, nPeak / 1024.0, fPsnr );
+			}
+
+	fflush( stdout );
+	fprintf( stderr, "%d resizes under %.0f dB\n", nLow, fMinPsnr );
+	return nLow ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : InputEvents () (Static)
+// Desc : The key presses that give Input on tick nTick after Last, at the
+//		times a player would have made them: actions tapped a quarter into
+//		the tick, everything else changed half way through it.
+//-----------------------------------------------------------------------------
+static void InputEvents( uint32_t nTick, const STickInput& Last, const STickInput& Input, std::vector<SInputEvent>& Events )
+{
+	static const uint32_t Directions[4] = { SActor::DIR_FORWARD, SActor::DIR_BACKWARD, SActor::DIR_LEFT, SActor::DIR_RIGHT };
+	static const CInput::CONTROL Controls[4] = { CInput::CONTROL_FORWARD, CInput::CONTROL_BACKWARD, CInput::CONTROL_LEFT, CInput::CONTROL_RIGHT };
+
+	SInputEvent Event;
+	for ( int i = 0; i < WORLD_PLAYERS; i++ )
+	{
+		uint8_t Keys = (uint8_t)(1 + i * CInput::CONTROL_COUNT);
+		Event.fTime = (nTick + 0.25) * SIM_TICK;
+		Event.Type = CInput::EVENT_DOWN;
+		if ( Input.Actions[i] & CGameWorld::ACTION_ROTATE ) { Event.Key = Keys + CInput::CONTROL_ROTATE; Events.push_back( Event ); }
+		if ( Input.Actions[i] & CGameWorld::ACTION_SELF_DESTRUCT ) { Event.Key = Keys + CInput::CONTROL_SELF_DESTRUCT; Events.push_back( Event ); }
+	}
+
+	for ( int i = 0; i < WORLD_PLAYERS; i++ )
+	{
+		uint8_t Keys = (uint8_t)(1 + i * CInput::CONTROL_COUNT);
+		Event.fTime = (nTick + 0.5) * SIM_TICK;
+		Event.Type = CInput::EVENT_UP;
+		if ( Input.Actions[i] & CGameWorld::ACTION_ROTATE ) { Event.Key = Keys + CInput::CONTROL_ROTATE; Events.push_back( Event ); }
+		if ( Input.Actions[i] & CGameWorld::ACTION_SELF_DESTRUCT ) { Event.Key = Keys + CInput::CONTROL_SELF_DESTRUCT; Events.push_back( Event ); }
+
+		for ( int d = 0; d < 4; d++ )
+		{
+			bool bWas = (Last.Direction[i] & Directions[d]) != 0, bIs = (Input.Direction[i] & Directions[d]) != 0;
+			if ( bWas == bIs ) continue;
+			Event.Key = (uint8_t)(Keys + Controls[d]);
+			Event.Type = bIs ? CInput::EVENT_DOWN : CInput::EVENT_UP;
+			Events.push_back( Event );
+		}
+
+		if ( Last.bFire[i] != Input.bFire[i] )
+		{
+			Event.Key = (uint8_t)(Keys + CInput::CONTROL_FIRE);
+			Event.Type = Input.bFire[i] ? CInput::EVENT_DOWN : CInput::EVENT_UP;
+			Events.push_back( Event );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : Pacing ()
+// Desc : Plays the same game as key presses through CInput and CTickClock at
+//		several render rates, and checks every tick's checksum against the
+//		game stepped straight from its tick inputs.
+//-----------------------------------------------------------------------------
+static int Pacing( uint32_t nTicks, unsigned nSeed, const std::vector<SScriptLine> *pScript, const CLevelSet *pLevels )
+{
+	struct SRate
+	{
+		double		fHz;
+		double		fJitter;		// Frame times vary by up to this fraction either way
+		double		fHitch;			// One frame this long every two seconds, if not 0
+	};
+	static const SRate Rates[] = { { 30, 0.2, 0 }, { 60, 0.2, 0 }, { 144, 0.2, 0 }, { 240, 0.2, 0 }, { 60, 0.2, 0.06 } };
+
+	CHeadlessPlatform Platform;
+	CGameWorld World( &Platform );
+	STickInput Input, Last;
+	std::vector<uint32_t> Checksums( nTicks );
+	std::vector<SInputEvent> Events;
+	uint32_t nBot = nSeed, nGames = 1;
+	size_t nLine = 0;
+
+	// The reference, and the key presses making up its input
+	memset( &Input, 0, sizeof(Input) );
+	memset( &Last, 0, sizeof(Last) );
+	World.SetLevels( pLevels );
+	World.Reset( nSeed );
+	for ( uint32_t t = 0; t < nTicks; t++ )
+	{
+		NextInput( t, pScript, nLine, nBot, Input );
+		InputEvents( t, Last, Input, Events );
+		Last = Input;
+
+		World.Step( Input );
+		Checksums[t] = World.Checksum();
+		if ( World.IsGameOver() ) World.Reset( nSeed + nGames++ );
+	}
+
+	printf( "pacing over %u ticks, %u games, %u key events\n", nTicks, nGames, (unsigned)Events.size() );
+	printf( "  rate  jitter  hitch ms   frames  most ticks  dropped  result\n" );
+
+	int nFailed = 0;
+	for ( const SRate& Rate : Rates )
+	{
+		CInput Keys;
+		CTickClock Clock;
+		CRandom Random( nSeed, 2 );
+		for ( int i = 0; i < WORLD_PLAYERS; i++ )
+			for ( int c = 0; c < CInput::CONTROL_COUNT; c++ )
+				Keys.Bind( i, (CInput::CONTROL)c, (uint8_t)(1 + i * CInput::CONTROL_COUNT + c) );
+
+		World.Reset( nSeed );
+		nGames = 1;
+
+		double fNow = 0.0, fNextHitch = 2.0;
+		size_t nEvent = 0;
+		uint32_t t = 0, nFrames = 0, nMost = 0, nDiverged = nTicks;
+		Clock.Reset( fNow );
+
+		while ( t < nTicks && nDiverged == nTicks )
+		{
+			double fFrame = (1.0 + Rate.fJitter * (Random.NextFloat() * 2.0 - 1.0)) / Rate.fHz;
+			if ( Rate.fHitch > 0 && fNow >= fNextHitch )
+			{
+				fFrame = Rate.fHitch;
+				fNextHitch += 2.0;
+			}
+			fNow += fFrame;
+			nFrames++;
+
+			// The host has received every key pressed up to now
+			while ( nEvent < Events.size() && Events[nEvent].fTime <= fNow )
+			{
+				const SInputEvent& Event = Events[nEvent++];
+				Keys.Post( Event.Key, (CInput::EVENT)Event.Type, Event.fTime );
+			}
+
+			Clock.Advance( fNow );
+			uint32_t nFrameTicks = 0;
+			double fTickEnd;
+			while ( t < nTicks && Clock.NextTick( fTickEnd ) )
+			{
+				Keys.BuildTick( fTickEnd, Input );
+				World.Step( Input );
+				if ( World.Checksum() != Checksums[t] )
+				{
+					nDiverged = t;
+					break;
+				}
+				if ( World.IsGameOver() ) World.Reset( nSeed + nGames++ );
+				t++;
+				nFrameTicks++;
+			}
+			nMost = std::max( nMost, nFrameTicks );
+		}
+
+		bool bFailed = nDiverged < nTicks || Clock.GetDropped() || Keys.GetLost();
+		if ( bFailed ) nFailed++;
+
+		char szResult[64];
+		if ( nDiverged < nTicks ) snprintf( szResult, sizeof(szResult), "DIVERGED at tick %u", nDiverged );
+		else if ( bFailed ) snprintf( szResult, sizeof(szResult), "%lu keys lost", Keys.GetLost() );
+		else snprintf( szResult, sizeof(szResult), "matched" );
+
+		printf( "%6.0f  %5.0f%%  %8.0f  %7u  %10u  %7u  %s\n", Rate.fHz, Rate.fJitter * 100.0, Rate.fHitch * 1000.0,
+			nFrames, nMost, Clock.GetDropped(), szResult );
+	}
+
+	return nFailed ? 2 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : InputQueue ()
+// Desc : A producer thread stamps and posts nEvents key events at 1 kHz
+//		while this thread runs 120 Hz ticks off CTickClock and takes each
+//		tick's events the way CInput::BuildTick does, through the same
+//		queue. Checks that every event arrives once, in order, and in the
+//		first tick ending after its stamp that was built after it was posted.
+//-----------------------------------------------------------------------------
+static int InputQueue( int nEvents )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	CSpscQueue<SInputEvent, INPUT_QUEUE_SIZE> Queue;
+	std::vector<double> Stamps( nEvents ), Posted( nEvents );
+	std::vector<double> Received, TickEnds, BuildStarts;
+	std::vector<uint32_t> Ticks;
+	std::atomic<int> nFull( 0 );
+
+	auto Start = Clock::now();
+	auto Seconds = [&]() { return std::chrono::duration<double>( Clock::now() - Start ).count(); };
+
+	std::thread Producer( [&]()
+	{
+		for ( int i = 0; i < nEvents; i++ )
+		{
+			std::this_thread::sleep_until( Start + std::chrono::microseconds( 1000 * (i + 1) ) );
+
+			SInputEvent Event;
+			Event.fTime	= Stamps[i] = Seconds();
+			Event.Key	= (uint8_t)i;
+			Event.Type	= (uint8_t)(i & 1 ? CInput::EVENT_UP : CInput::EVENT_DOWN);
+			while ( !Queue.Push( Event ) ) nFull++;
+			Posted[i] = Seconds();
+		}
+	} );
+
+	CTickClock TickClock;
+	TickClock.Reset( 0.0 );
+	Received.reserve( nEvents );
+	Ticks.reserve( nEvents );
+
+	// Past the last stamp a tick is bound to come that takes it
+	double fLastEnd = 0.0;
+	while ( (int)Received.size() < nEvents && Seconds() < nEvents * 0.001 + 1.0 )
+	{
+		TickClock.Advance( Seconds() );
+
+		double fTickEnd;
+		while ( TickClock.NextTick( fTickEnd ) )
+		{
+			TickEnds.push_back( fTickEnd );
+			BuildStarts.push_back( Seconds() );
+			fLastEnd = fTickEnd;
+
+			while ( const SInputEvent *pEvent = Queue.Peek() )
+			{
+				if ( pEvent->fTime >= fTickEnd ) break;
+				Received.push_back( pEvent->fTime );
+				Ticks.push_back( (uint32_t)(TickEnds.size() - 1) );
+				Queue.Pop();
+			}
+		}
+
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	}
+	Producer.join();
+
+	int nMissing = std::max( 0, nEvents - (int)Received.size() ), nOrder = 0, nEarly = 0, nPassed = 0, nLate = 0;
+	double fMostLate = 0.0;
+	for ( size_t i = 0; i < Received.size(); i++ )
+	{
+		if ( Received[i] != Stamps[i] )
+		{
+			nOrder++;
+			continue;
+		}
+
+		// The tick it went to has to end after the stamp, and every earlier
+		// tick that also did must have been built before the event was posted
+		uint32_t a = Ticks[i], k = a;
+		if ( TickEnds[a] <= Stamps[i] ) nEarly++;
+		while ( k > 0 && TickEnds[k - 1] > Stamps[i] ) k--;
+		for ( uint32_t j = k; j < a; j++ )
+			if ( BuildStarts[j] >= Posted[i] ) { nPassed++; break; }
+
+		if ( a > k ) nLate++;
+		fMostLate = std::max( fMostLate, TickEnds[a] - Stamps[i] );
+	}
+
+	uint32_t nTicks = (uint32_t)TickEnds.size();
+	printf( "input %d events at 1 kHz over %u ticks (%.2f s), ring full %d times\n", nEvents, nTicks, fLastEnd, nFull.load() );
+	printf( "received %u, missing %d, out of order %d, early %d, skipped a tick %d\n", (unsigned)Received.size(), nMissing, nOrder, nEarly, nPassed );
+	printf( "posted after their tick was built %d, longest stamp to tick end %.2f ms\n", nLate, fMostLate * 1000.0 );
+
+	return nMissing || nOrder || nEarly || nPassed ? 2 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : PostProcess ()
+// Desc : Benchmarks CPostProcess at every quality level and checks the
+//		bloom spreads both ways and a spent budget leaves only the flash.
+//-----------------------------------------------------------------------------
+static int PostProcess( int nRuns )
+{
+	typedef std::chrono::steady_clock Clock;
+	const int nWidth = 800, nHeight = 600;
+	const double fBudget = 1.0;			// ms a frame, the game's
+
+	std::vector<RGBQUAD> Source, Frames[2], FlashOnly;
+	TestPicture( Source, nWidth, nHeight, 3 );
+
+	CWorkerPool Pool;
+	Pool.Start();
+	std::vector<double> Times( nRuns );
+	int nErrors = 0;
+
+	// The effects at full strength, no time passes so they do not fade.
+	// Returns the ms Apply took.
+	auto Run = []( CPostProcess& Effects, std::vector<RGBQUAD>& Frame, const std::vector<RGBQUAD>& From, CPostProcess::EQuality eQuality,
+		double fMilliseconds, float fFlash )
+	{
+		Frame = From;
+		Effects.SetQuality( eQuality );
+		Effects.SetBudget( fMilliseconds );
+		Effects.TriggerBloom( 1.0f );
+		if ( fFlash > 0.0f ) Effects.TriggerDamageFlash( fFlash );
+
+		auto t0 = Clock::now();
+		Effects.Apply( Frame.data(), nWidth, nHeight, 0.0f );
+		return std::chrono::duration<double>( Clock::now() - t0 ).count() * 1e3;
+	};
+	auto Same = []( const std::vector<RGBQUAD>& a, const std::vector<RGBQUAD>& b )
+	{
+		return a.size() == b.size() && !memcmp( a.data(), b.data(), a.size() * sizeof(RGBQUAD) );
+	};
+	auto Hash = []( const std::vector<RGBQUAD>& Frame )
+	{
+		uint32_t h = 2166136261u;
+		const BYTE *p = (const BYTE*)Frame.data();
+		for ( size_t i = 0; i < Frame.size() * sizeof(RGBQUAD); i++ ) h = (h ^ p[i]) * 16777619u;
+		return h;
+	};
+
+	printf( "postprocess %d x %d, median of %d, %u pool threads, budget %.1f ms\n", nWidth, nHeight, nRuns, Pool.ThreadCount(), fBudget );
+	printf( "quality     inline ms  pool ms  MB/frame  pixels\n" );
+
+	static const char *const Names[4] = { "flash only", "low", "medium", "high" };
+	for ( int q = CPostProcess::PPQ_FLASH_ONLY; q <= CPostProcess::PPQ_HIGH; q++ )
+	{
+		double fTimes[2];
+		for ( int p = 0; p < 2; p++ )
+		{
+			CPostProcess Effects;
+			Effects.SetPool( p ? &Pool : NULL );
+			for ( int r = 0; r < nRuns; r++ )
+				Times[r] = Run( Effects, Frames[p], Source, (CPostProcess::EQuality)q, 1e6, 0.5f );
+			std::sort( Times.begin(), Times.end() );
+			fTimes[p] = Times[nRuns / 2];
+		}
+
+		if ( !Same( Frames[0], Frames[1] ) ) nErrors++;
+		if ( q == CPostProcess::PPQ_FLASH_ONLY ) FlashOnly = Frames[0];
+
+		// The frame read and written; with bloom it is read once more and
+		// the glow, as big again, written once and read twice
+		double fBytes = nWidth * nHeight * 4.0 * (q >= CPostProcess::PPQ_MEDIUM ? 6.0 : 2.0);
+		double fBest = std::min( fTimes[0], fTimes[1] );
+		printf( "%-10s  %9.3f  %7.3f  %8.1f  %08x%s\n", Names[q], fTimes[0], fTimes[1], fBytes / (1 << 20), Hash( Frames[0] ),
+			fBest > fBudget ? "  over budget" : "" );
+	}
+
+	// With the budget gone before the first band every band only flashes
+	CPostProcess Late;
+	Run( Late, Frames[0], Source, CPostProcess::PPQ_HIGH, 0.0, 0.5f );
+	bool bLate = Same( Frames[0], FlashOnly );
+	if ( !bLate ) nErrors++;
+
+	// A bright square on black glows the bloom radius out on every side, the
+	// same up as down and left as right, and no further
+	const int nRadius = 8, nSide = 24, cx = nWidth / 2, cy = nHeight / 2;
+	std::vector<RGBQUAD> Square( nWidth * nHeight );
+	memset( Square.data(), 0, Square.size() * sizeof(RGBQUAD) );
+	for ( int y = cy - nSide / 2; y < cy + nSide / 2; y++ )
+		for ( int x = cx - nSide / 2; x < cx + nSide / 2; x++ ) memset( &Square[y * nWidth + x], 255, 3 );
+
+	CPostProcess Glow;
+	Run( Glow, Frames[0], Square, CPostProcess::PPQ_HIGH, 1e6, 0.0f );
+	auto Red = [&]( int x, int y ) { return (int)Frames[0][y * nWidth + x].rgbRed; };
+	int nTop = cy - nSide / 2 - 1, nBottom = cy + nSide / 2, nLeft = cx - nSide / 2 - 1, nRight = cx + nSide / 2;
+	bool bSpread = Red( cx, nTop - nRadius + 1 ) > 0 && Red( cx, nTop - nRadius ) == 0 && Red( nLeft - nRadius + 1, cy ) > 0 && Red( nLeft - nRadius, cy ) == 0;
+	for ( int d = 0; d <= nRadius; d++ )
+		if ( Red( cx, nTop - d ) != Red( cx, nBottom + d ) || Red( nLeft - d, cy ) != Red( nRight + d, cy ) ) bSpread = false;
+	if ( !bSpread ) nErrors++;
+
+	printf( "late budget %s, bloom %s\n", bLate ? "flashes only" : "did more than flash", bSpread ? "spreads evenly both ways" : "spreads wrongly" );
+	printf( "%d errors\n", nErrors );
+	return nErrors ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SSpriteArt (Struct)
+// Desc : One of the game's bitmaps for -indexed below, top-down, with the
+//		pixels the sprite does not draw marked.
+//-----------------------------------------------------------------------------
+struct SSpriteArt
+{
+	const char				*szImage;
+	const char				*szMask;		// NULL for the magenta colour key
+	std::vector<RGBQUAD>	Pixels;
+	std::vector<BYTE>		Transparent;
+	int						nWidth, nHeight;
+	CIndexedImage			Indexed;
+};
+
+//-----------------------------------------------------------------------------
+// Name : LoadTopDown () (Static)
+// Desc : Loads a bitmap through CImageFile and turns its rows top-down.
+//-----------------------------------------------------------------------------
+static bool LoadTopDown( const std::string& Path, std::vector<RGBQUAD>& Pixels, int& nWidth, int& nHeight )
+{
+	CImageFile Image;
+	if ( !Image.LoadBitmapFromFile( Path.c_str(), NULL ) || !Image.Bits() ) return false;
+
+	nWidth = Image.Width();
+	nHeight = Image.Height();
+	Pixels.resize( nWidth * nHeight );
+	for ( int y = 0; y < nHeight; y++ )
+		memcpy( &Pixels[y * nWidth], Image.Bits() + (nHeight - 1 - y) * nWidth, nWidth * sizeof(RGBQUAD) );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Blit32 () (Static)
+// Desc : Draws a sprite from its 32 bit pixels as the game does without
+//		indexed storage: masked images ANDed and ORed on like BitBlt's
+//		SRCAND and SRCPAINT, keyed ones copied where they are not magenta.
+//		Clipped like CIndexedImage::Blit. Returns the bytes read and written.
+//-----------------------------------------------------------------------------
+static double Blit32( const SSpriteArt& Art, RGBQUAD *pDst, int nDstWidth, int nDstHeight, int x, int y, const RECT& rcSource )
+{
+	int sx = rcSource.left, sy = rcSource.top, w = rcSource.right - rcSource.left, h = rcSource.bottom - rcSource.top;
+	if ( x < 0 ) { sx -= x; w += x; x = 0; }
+	if ( y < 0 ) { sy -= y; h += y; y = 0; }
+	w = std::min( w, nDstWidth - x );
+	h = std::min( h, nDstHeight - y );
+	if ( w <= 0 || h <= 0 ) return 0.0;
+
+	for ( int j = 0; j < h; j++ )
+	{
+		const DWORD *pSource = (const DWORD*)&Art.Pixels[(sy + j) * Art.nWidth + sx];
+		const BYTE *pTransparent = &Art.Transparent[(sy + j) * Art.nWidth + sx];
+		DWORD *pRow = (DWORD*)(pDst + (y + j) * nDstWidth + x);
+
+		if ( !Art.szMask )
+		{
+			for ( int i = 0; i < w; i++ )
+				if ( !pTransparent[i] ) pRow[i] = pSource[i];
+		}
+		else
+		{
+			for ( int i = 0; i < w; i++ )
+				pRow[i] = (pRow[i] & (pTransparent[i] ? 0xFFFFFFFF : 0)) | pSource[i];
+		}
+	}
+
+	// Keyed: image read, surface written. Masked: mask, image and surface
+	// read, surface written.
+	return (double)w * h * (Art.szMask ? 16 : 8);
+}
+
+//-----------------------------------------------------------------------------
+// Name : Indexed ()
+// Desc : Checks CIndexedImage on the game's art and times whole frames of
+//		it against the 32 bit bitmaps.
+//-----------------------------------------------------------------------------
+static int Indexed( const char *szDir )
+{
+	typedef std::chrono::steady_clock Clock;
+	const int nWidth = 800, nHeight = 600, nRuns = 50;
+	const double fMinimumPsnr = 30.0;	// dB, for the images that do not keep every colour
+
+	// As CPlayer, Bullet and CGameApp draw them; the file names as they are on disk
+	enum { ART_BACKGROUND, ART_PLANE, ART_PLANE_LEFT, ART_PLANE_RIGHT, ART_PLANE_BACK, ART_ENEMY, ART_STAR, ART_BULLET, ART_EXPLOSION, ART_COUNT };
+	SSpriteArt Art[ART_COUNT];
+	static const char *const Files[ART_COUNT][2] =
+	{
+		{ "Background.bmp",				NULL },
+		{ "PlaneImgAndMask.bmp",		NULL },
+		{ "PlaneImgAndMaskLeft.bmp",	NULL },
+		{ "PlaneImgAndMaskRight.bmp",	NULL },
+		{ "PlaneImgAndMaskk.bmp",		NULL },
+		{ "enemyMask.bmp",				NULL },
+		{ "starMask.bmp",				NULL },
+		{ "upBullet.bmp",				"upBulletMask.bmp" },
+		{ "explosion.bmp",				"explosionmask.bmp" },
+	};
+
+	int nErrors = 0;
+	size_t nBitmapBytes = 0, nIndexedBytes = 0;
+
+	printf( "indexed art from %s\n", szDir );
+	printf( "image                      size  colours  palette  PSNR dB\n" );
+
+	for ( int a = 0; a < ART_COUNT; a++ )
+	{
+		SSpriteArt& Sprite = Art[a];
+		Sprite.szImage = Files[a][0];
+		Sprite.szMask = Files[a][1];
+		if ( !LoadTopDown( std::string( szDir ) + "/" + Sprite.szImage, Sprite.Pixels, Sprite.nWidth, Sprite.nHeight ) )
+		{
+			printf( "can't load %s/%s\n", szDir, Sprite.szImage );
+			return 1;
+		}
+
+		// The rules of CIndexedImage::CreateFromBitmap: white mask pixels or
+		// the colour key are not drawn, the background has neither
+		int nPixels = Sprite.nWidth * Sprite.nHeight;
+		Sprite.Transparent.assign( nPixels, 0 );
+		if ( Sprite.szMask )
+		{
+			std::vector<RGBQUAD> Mask;
+			int nMaskWidth, nMaskHeight;
+			if ( !LoadTopDown( std::string( szDir ) + "/" + Sprite.szMask, Mask, nMaskWidth, nMaskHeight ) || nMaskWidth != Sprite.nWidth || nMaskHeight != Sprite.nHeight )
+			{
+				printf( "can't load %s/%s or it does not fit its image\n", szDir, Sprite.szMask );
+				return 1;
+			}
+			for ( int i = 0; i < nPixels; i++ ) Sprite.Transparent[i] = (Mask[i].rgbRed + Mask[i].rgbGreen + Mask[i].rgbBlue) >= 3 * 128;
+		}
+		else if ( a != ART_BACKGROUND )
+		{
+			for ( int i = 0; i < nPixels; i++ )
+				Sprite.Transparent[i] = Sprite.Pixels[i].rgbRed == 0xFF && Sprite.Pixels[i].rgbGreen == 0 && Sprite.Pixels[i].rgbBlue == 0xFF;
+		}
+
+		// The 32 bit bitmaps hold no alpha, the palette does not keep it
+		for ( int i = 0; i < nPixels; i++ ) Sprite.Pixels[i].rgbReserved = 0;
+
+		if ( !Sprite.Indexed.Create( Sprite.Pixels.data(), Sprite.nWidth, Sprite.nHeight, a == ART_BACKGROUND ? NULL : Sprite.Transparent.data() ) )
+		{
+			printf( "can't quantize %s\n", Sprite.szImage );
+			return 1;
+		}
+		nBitmapBytes += nPixels * sizeof(RGBQUAD) * (Sprite.szMask ? 2 : 1);
+		nIndexedBytes += Sprite.Indexed.GetMemorySize();
+
+		// Expanded over a colour no palette entry can have: the drawn pixels
+		// have to be the art's, exactly unless the palette had to be cut,
+		// and the rest untouched
+		const DWORD nUntouched = 0xA5A5A5A5;
+		std::vector<DWORD> Expanded( nPixels, nUntouched );
+		Sprite.Indexed.Blit( (RGBQUAD*)Expanded.data(), Sprite.nWidth, Sprite.nHeight, 0, 0 );
+
+		double fSquares = 0.0;
+		int nDrawn = 0, nWrong = 0;
+		for ( int i = 0; i < nPixels; i++ )
+		{
+			DWORD nSource = *(const DWORD*)&Sprite.Pixels[i];
+			if ( Sprite.Transparent[i] && a != ART_BACKGROUND )
+			{
+				if ( Expanded[i] != nUntouched ) nWrong++;
+				continue;
+			}
+
+			nDrawn++;
+			if ( Expanded[i] == nUntouched || (Sprite.Indexed.IsExact() && Expanded[i] != nSource) ) nWrong++;
+			for ( int s = 0; s < 24; s += 8 )
+			{
+				double d = (double)((Expanded[i] >> s) & 0xFF) - (double)((nSource >> s) & 0xFF);
+				fSquares += d * d;
+			}
+		}
+
+		double fPsnr = fSquares > 0.0 ? 10.0 * log10( 255.0 * 255.0 * 3.0 * nDrawn / fSquares ) : INFINITY;
+		bool bBad = nWrong || fPsnr < fMinimumPsnr;
+		if ( bBad ) nErrors++;
+
+		char szSize[16];
+		snprintf( szSize, sizeof(szSize), "%dx%d", Sprite.nWidth, Sprite.nHeight );
+		printf( "%-24s %9s  %7d  %-7s  %7.1f%s\n", Sprite.szImage, szSize, Sprite.Indexed.PaletteSize() - (Sprite.Indexed.HasTransparency() ? 1 : 0),
+			Sprite.Indexed.IsExact() ? "exact" : "cut", fPsnr, bBad ? (nWrong ? "  pixels wrong" : "  below minimum") : "" );
+	}
+
+	// A busy frame: the background, both planes, a wave of invaders, stars,
+	// shots in flight and explosions, some hanging off the edges
+	struct SDraw { int nArt, x, y; RECT rcSource; };
+	std::vector<SDraw> Scene;
+	CRandom Random( 5, 1 );
+	auto Add = [&]( int nArt, int nCount )
+	{
+		for ( int n = 0; n < nCount; n++ )
+		{
+			const SSpriteArt& Sprite = Art[nArt];
+			SDraw Draw = { nArt, 0, 0, { 0, 0, Sprite.nWidth, Sprite.nHeight } };
+			if ( nArt == ART_EXPLOSION )
+			{
+				// 128 x 128 frames, four to a row
+				int nFrame = (int)Random.Below( EXPLOSION_FRAMES );
+				Draw.rcSource.left = (nFrame % 4) * 128;
+				Draw.rcSource.top = (nFrame / 4) * 128;
+				Draw.rcSource.right = Draw.rcSource.left + 128;
+				Draw.rcSource.bottom = Draw.rcSource.top + 128;
+			}
+			int w = Draw.rcSource.right - Draw.rcSource.left, h = Draw.rcSource.bottom - Draw.rcSource.top;
+			Draw.x = (int)Random.Below( nWidth + w ) - w / 2 - w / 4;
+			Draw.y = (int)Random.Below( nHeight + h ) - h / 2 - h / 4;
+			Scene.push_back( Draw );
+		}
+	};
+	Add( ART_BACKGROUND, 1 );
+	Scene[0].x = Scene[0].y = 0;
+	Add( ART_STAR, 24 );
+	Add( ART_ENEMY, 40 );
+	Add( ART_PLANE, 1 );
+	Add( ART_PLANE_LEFT + (int)Random.Below( 3 ), 1 );
+	Add( ART_BULLET, 32 );
+	Add( ART_EXPLOSION, 4 );
+
+	std::vector<RGBQUAD> Frames[2] = { std::vector<RGBQUAD>( nWidth * nHeight ), std::vector<RGBQUAD>( nWidth * nHeight ) };
+	std::vector<double> Times[2] = { std::vector<double>( nRuns ), std::vector<double>( nRuns ) };
+	double fBytes[2] = { 0.0, 0.0 };
+
+	// Alternated, so both see the same caches
+	for ( int r = 0; r < nRuns; r++ )
+		for ( int t = 0; t < 2; t++ )
+		{
+			double fFrameBytes = 0.0;
+			auto t0 = Clock::now();
+			for ( size_t d = 0; d < Scene.size(); d++ )
+			{
+				const SDraw& Draw = Scene[d];
+				const SSpriteArt& Sprite = Art[Draw.nArt];
+				if ( t == 0 )
+				{
+					Sprite.Indexed.Blit( Frames[0].data(), nWidth, nHeight, Draw.x, Draw.y, &Draw.rcSource );
+				}
+				else if ( Draw.nArt == ART_BACKGROUND )
+				{
+					memcpy( Frames[1].data(), Sprite.Pixels.data(), nWidth * nHeight * sizeof(RGBQUAD) );
+					fFrameBytes += nWidth * nHeight * 8.0;
+				}
+				else
+				{
+					fFrameBytes += Blit32( Sprite, Frames[1].data(), nWidth, nHeight, Draw.x, Draw.y, Draw.rcSource );
+				}
+			}
+			Times[t][r] = std::chrono::duration<double>( Clock::now() - t0 ).count() * 1e3;
+			fBytes[1] = fFrameBytes;
+		}
+
+	// What the indexed frame moved: an index read and a pixel written, and
+	// the surface read under images with transparency, which is the most
+	// CIndexedImage::Blit does
+	for ( size_t d = 0; d < Scene.size(); d++ )
+	{
+		const SDraw& Draw = Scene[d];
+		int x0 = std::max( 0, Draw.x ), y0 = std::max( 0, Draw.y );
+		int x1 = std::min( nWidth, Draw.x + (int)(Draw.rcSource.right - Draw.rcSource.left) );
+		int y1 = std::min( nHeight, Draw.y + (int)(Draw.rcSource.bottom - Draw.rcSource.top) );
+		if ( x1 > x0 && y1 > y0 ) fBytes[0] += (double)(x1 - x0) * (y1 - y0) * (Art[Draw.nArt].Indexed.HasTransparency() ? 9 : 5);
+	}
+
+	// Both frames have to agree wherever the art kept every colour
+	double fSquares = 0.0;
+	for ( size_t i = 0; i < Frames[0].size(); i++ )
+	{
+		const BYTE *p0 = (const BYTE*)&Frames[0][i], *p1 = (const BYTE*)&Frames[1][i];
+		for ( int c = 0; c < 3; c++ ) fSquares += (double)(p0[c] - p1[c]) * (p0[c] - p1[c]);
+	}
+	double fFramePsnr = fSquares > 0.0 ? 10.0 * log10( 255.0 * 255.0 * 3.0 * Frames[0].size() / fSquares ) : INFINITY;
+	if ( fFramePsnr < fMinimumPsnr ) nErrors++;
+
+	printf( "storage %.0f KB as 32 bit bitmaps and masks, %.0f KB indexed\n", nBitmapBytes / 1024.0, nIndexedBytes / 1024.0 );
+	printf( "frame %d x %d, %u draws, median of %d, PSNR %.1f dB against 32 bit\n", nWidth, nHeight, (unsigned)Scene.size(), nRuns, fFramePsnr );
+	printf( "           ms/frame    best  MB/frame\n" );
+	for ( int t = 0; t < 2; t++ )
+	{
+		std::sort( Times[t].begin(), Times[t].end() );
+		printf( "%-8s  %9.3f  %6.3f  %8.2f\n", t ? "32 bit" : "indexed", Times[t][nRuns / 2], Times[t][0], fBytes[t] / (1 << 20) );
+	}
+	printf( "%d errors\n", nErrors );
+	return nErrors ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : main () (Application Entry Point)
+//-----------------------------------------------------------------------------
+int main( int argc, char **argv )
+{
+	uint32_t	nTicks = SIM_TICK_RATE * 600;	// ten minutes of play
+	unsigned	nSeed = 1;
+	const char	*szScript = NULL;
+	const char	*szRecord = NULL;
+	bool		bRollback = false;
+	unsigned	nBudgetNs = 0;
+	bool		bSave = false;
+	bool		bPacing = false;
+	int			nFormation = 0;
+	int			nProjectiles = 0;
+	int			nCollide = 0;
+	int			nTimers = 0;
+	int			nRandom = 0;
+	int			nFlow = 0;
+	int			nSpatial = 0;
+	int			nLevelCache = 0;
+	const char	*szReplay = NULL;
+	const char	*szLevels = NULL;
+	const char	*szAssets = NULL;
+	int			nConvolve = 0;
+	int			nPipeline = 0;
+	int			nResize = 0;
+	int			nInput = 0;
+	int			nPostProcess = 0;
+	const char	*szIndexed = NULL;
+	CLevelSet	Levels;
+	std::vector<SScriptLine> Script;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !strcmp( argv[i], "-ticks" ) && i + 1 < argc ) nTicks = (uint32_t)strtoul( argv[++i], NULL, 10 );
+		else if ( !strcmp( argv[i], "-seed" ) && i + 1 < argc ) nSeed = (unsigned)strtoul( argv[++i], NULL, 10 );
+		else if ( !strcmp( argv[i], "-script" ) && i + 1 < argc ) szScript = argv[++i];
+		else if ( !strcmp( argv[i], "-record" ) && i + 1 < argc ) szRecord = argv[++i];
+		else if ( !strcmp( argv[i], "-replay" ) && i + 1 < argc ) szReplay = argv[++i];
+		else if ( !strcmp( argv[i], "-levels" ) && i + 1 < argc ) szLevels = argv[++i];
+		else if ( !strcmp( argv[i], "-rollback" ) ) bRollback = true;
+		else if ( !strcmp( argv[i], "-budget-ns" ) && i + 1 < argc ) nBudgetNs = (unsigned)strtoul( argv[++i], NULL, 10 );
+		else if ( !strcmp( argv[i], "-save" ) ) bSave = true;
+		else if ( !strcmp( argv[i], "-pacing" ) ) bPacing = true;
+		else if ( !strcmp( argv[i], "-formation" ) && i + 1 < argc ) nFormation = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-projectiles" ) && i + 1 < argc ) nProjectiles = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-collide" ) && i + 1 < argc ) nCollide = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-timers" ) && i + 1 < argc ) nTimers = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-random" ) && i + 1 < argc ) nRandom = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-flow" ) && i + 1 < argc ) nFlow = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-spatial" ) && i + 1 < argc ) nSpatial = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-levelcache" ) && i + 1 < argc ) nLevelCache = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-assets" ) && i + 1 < argc ) szAssets = argv[++i];
+		else if ( !strcmp( argv[i], "-convolve" ) && i + 1 < argc ) nConvolve = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-pipeline" ) && i + 1 < argc ) nPipeline = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-resize" ) && i + 1 < argc ) nResize = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-input" ) && i + 1 < argc ) nInput = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-postprocess" ) && i + 1 < argc ) nPostProcess = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "-indexed" ) && i + 1 < argc ) szIndexed = argv[++i];
+		else
+		{
+			fprintf( stderr, "usage: %s [-ticks N] [-seed S] [-script file] [-record file] [-levels file]\n       %s -replay file [-levels file]\n       %s -rollback [-ticks N] [-seed S] [-levels file] [-budget-ns N]\n       %s -save [-ticks N] [-seed S] [-levels file]\n       %s -pacing [-ticks N] [-seed S] [-script file] [-levels file]\n       %s -formation N [-ticks N] [-seed S]\n       %s -projectiles N [-ticks N] [-seed S]\n       %s -collide N [-ticks N] [-seed S]\n       %s -timers N [-ticks N] [-seed S]\n       %s -random N [-ticks N] [-seed S]\n       %s -flow N [-ticks N] [-seed S]\n       %s -spatial N [-ticks N] [-seed S]\n       %s -levelcache N [-ticks N] [-seed S]\n       %s -assets dir\n       %s -convolve N\n       %s -pipeline N\n       %s -resize N\n       %s -input N\n       %s -postprocess N\n       %s -indexed dir\n", argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0] );
+			return 1;
+		}
+	}
+
+	if ( szLevels && !Levels.Load( szLevels, NULL, CGameWorld::DefaultLevel() ) )
+	{
+		fprintf( stderr, "Can't load levels %s, error on line %d\n", szLevels, Levels.GetErrorLine() );
+		return 1;
+	}
+	const CLevelSet *pLevels = szLevels ? &Levels : NULL;
+
+	if ( szReplay ) return Replay( szReplay, pLevels );
+	if ( bRollback ) return Rollback( nTicks, nSeed, pLevels, nBudgetNs );
+	if ( bSave ) return SaveGames( nTicks, nSeed, pLevels );
+	if ( nFormation > 0 ) return Formation( nFormation, nTicks, nSeed );
+	if ( nProjectiles > 0 ) return Projectiles( nProjectiles, nTicks, nSeed );
+	if ( nCollide > 0 ) return Collide( nCollide, nTicks, nSeed );
+	if ( nTimers > 0 ) return Timers( nTimers, nTicks, nSeed );
+	if ( nRandom > 0 ) return RandomNumbers( nRandom, nTicks, nSeed );
+	if ( nFlow > 0 ) return FlowHorde( nFlow, nTicks, nSeed );
+	if ( nSpatial > 0 ) return SpatialQueries( nSpatial, nTicks, nSeed );
+	if ( nLevelCache > 0 ) return LevelCache( nLevelCache, nTicks, nSeed );
+	if ( szAssets ) return Assets( szAssets );
+	if ( nConvolve > 0 ) return Convolve( nConvolve );
+	if ( nPipeline > 0 ) return Pipeline( nPipeline );
+	if ( nResize > 0 ) return Resize( nResize );
+	if ( nInput > 0 ) return InputQueue( nInput );
+	if ( nPostProcess > 0 ) return PostProcess( nPostProcess );
+	if ( szIndexed ) return Indexed( szIndexed );
+
+	if ( szScript && !LoadScript( szScript, Script ) )
+	{
+		fprintf( stderr, "Can't read script %s\n", szScript );
+		return 1;
+	}
+
+	if ( bPacing ) return Pacing( nTicks, nSeed, szScript ? &Script : NULL, pLevels );
+
+	CHeadlessPlatform Platform;
+	CGameWorld World( &Platform );
+	CReplayWriter Recorder;
+	STickInput Input;
+	uint32_t nBot = nSeed, nGames = 1;
+	size_t nLine = 0;
+
+	memset( &Input, 0, sizeof(Input) );
+	World.SetLevels( pLevels );
+	World.Reset( nSeed );
+	if ( szRecord ) Recorder.Begin( nSeed, World );
+
+	auto Start = std::chrono::steady_clock::now();
+
+	for ( uint32_t t = 0; t < nTicks; t++ )
+	{
+		NextInput( t, szScript ? &Script : NULL, nLine, nBot, Input );
+
+		Recorder.Record( Input );
+		World.Step( Input );
+
+		if ( World.IsGameOver() )
+		{
+			if ( szRecord )
+			{
+				nTicks = t + 1;
+				break;
+			}
+			World.Reset( nSeed + nGames++ );
+		}
+	}
+
+	double fSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - Start ).count();
+
+	printf( "ticks %u (%.1f s of play) in %.3f s: %.0f ticks/s, %.2f us/tick\n",
+		nTicks, nTicks / (double)SIM_TICK_RATE, fSeconds, nTicks / fSeconds, fSeconds * 1e6 / nTicks );
+	printf( "games %u, last: lives %d - %d, score %d - %d, bullets %u + %u\n", nGames,
+		World.Player(0).Lives, World.Player(1).Lives, World.Player(0).Score, World.Player(1).Score,
+		(unsigned)World.Bullets().GetCount(), (unsigned)World.EnemyBullets().GetCount() );
+	printf( "sounds %lu, explosions %lu, bloom %lu, damage %lu\n",
+		Platform.m_nSounds[IPlatform::SOUND_JET_START] + Platform.m_nSounds[IPlatform::SOUND_JET_STOP] + Platform.m_nSounds[IPlatform::SOUND_JET_CABIN],
+		Platform.m_nSounds[IPlatform::SOUND_EXPLOSION], Platform.m_nEffects[IPlatform::EFFECT_BLOOM], Platform.m_nEffects[IPlatform::EFFECT_DAMAGE_FLASH] );
+	printf( "checksum %08x\n", World.Checksum() );
+
+	if ( szRecord && !Recorder.Save( szRecord, World.Checksum() ) )
+	{
+		fprintf( stderr, "Can't write replay %s\n", szRecord );
+		return 1;
+	}
+
+	return 0;
+}
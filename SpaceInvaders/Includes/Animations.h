@@ -0,0 +1,90 @@
+//-----------------------------------------------------------------------------
+// File: Animations.h
+//
+// Desc: Frame animations playing in the simulation, advanced by elapsed
+//	   time once per tick.
+//-----------------------------------------------------------------------------
+
+#ifndef _ANIMATIONS_H_
+#define _ANIMATIONS_H_
+
+//-----------------------------------------------------------------------------
+// CAnimations Specific Includes
+//-----------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Name : SAnimClip (Struct)
+// Desc : A run of frames and how fast it plays.
+//-----------------------------------------------------------------------------
+struct SAnimClip
+{
+	int32_t	Frames;
+	float	FrameRate;		// Frames per second
+};
+
+//-----------------------------------------------------------------------------
+// Name : SAnimation (Struct)
+// Desc : One clip playing for one owner.
+//-----------------------------------------------------------------------------
+struct SAnimation
+{
+	int32_t	Clip;
+	int32_t	Owner;			// Whatever the caller numbers its objects by
+	float	Phase;			// Frames played, with the fraction towards the next
+	int32_t	Frame;			// Whole frames played
+};
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CAnimations (Class)
+// Desc : The animations playing right now, packed at the front of one
+//		array; an owner plays one at a time, so the array never outgrows the
+//		number of owners and never allocates after Create. Advance moves
+//		each on by the elapsed time at its clip's frame rate and retires
+//		the finished ones by moving the last one into their place, so a
+//		tick costs as much as there are animations playing, however many
+//		objects could play one.
+//-----------------------------------------------------------------------------
+class CAnimations
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CAnimations();
+	virtual ~CAnimations();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Create( const SAnimClip *pClips, int nClips, int nOwners );
+	void			Clear()					{ m_Active.clear(); }
+	bool			Play( int iClip, int iOwner );
+	size_t			Advance( float dt, int32_t *pFinished );
+
+	size_t			GetCount() const		{ return m_Active.size(); }
+	const SAnimation& Get( size_t i ) const	{ return m_Active[i]; }
+	int				Find( int iOwner ) const;
+
+	size_t			GetStateSize() const;
+	void			SaveState( void *pBuffer ) const;
+	bool			IsState( const void *pBuffer, size_t nSize ) const;
+	bool			LoadState( const void *pBuffer, size_t nSize );
+	uint32_t		Checksum( uint32_t h ) const;
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	const SAnimClip*		m_pClips;
+	int						m_nClips;
+	int						m_nOwners;
+	std::vector<SAnimation>	m_Active;		// Capacity m_nOwners
+};
+
+#endif // _ANIMATIONS_H_
@@ -0,0 +1,95 @@
+//-----------------------------------------------------------------------------
+// File: AssetLoader.h
+//
+// Desc: Asynchronous asset loader. Bitmaps and images are decoded on a worker
+//	   pool while the main loop keeps pumping messages, and every request
+//	   hands back a future the game can poll or wait on.
+//-----------------------------------------------------------------------------
+
+#ifndef _ASSETLOADER_H_
+#define _ASSETLOADER_H_
+
+//-----------------------------------------------------------------------------
+// CAssetLoader Specific Includes
+//-----------------------------------------------------------------------------
+#include "Win32Types.h"
+#include "WorkerPool.h"
+#include "ImageFile.h"
+#include <map>
+#include <string>
+#include <atomic>
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CAssetLoader (Class)
+// Desc : Queues bitmap loads on a worker pool and caches the decoded handles
+//		by file name, so sprites created later can pick them up for free.
+//		Until the pool has been started requests are served synchronously.
+//		Bitmap handles are GDI objects, so only images load without Win32.
+//-----------------------------------------------------------------------------
+class CAssetLoader
+{
+public:
+	//-------------------------------------------------------------------------
+	// Enumerators
+	//-------------------------------------------------------------------------
+	enum EAssetPriority
+	{
+		AP_CRITICAL		= 0,	// needed before the first gameplay frame
+		AP_GAMEPLAY		= 1,	// needed soon after, e.g. bullets
+		AP_BACKGROUND	= 2		// scenery, alternate sprites
+	};
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CAssetLoader( CWorkerPool *pPool );
+	virtual ~CAssetLoader();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	std::shared_future<bool>	RequestImage( CImageFile *pImage, const char *szFileName, EAssetPriority ePriority );
+
+#ifdef _WIN32
+	std::shared_future<HBITMAP>	RequestBitmap( const char *szFileName, EAssetPriority ePriority );
+
+	// Returns a private copy of the bitmap, the caller owns and deletes it.
+	// Waits if the bitmap is still being decoded, loads it on the spot if it
+	// was never requested.
+	HBITMAP		AcquireBitmap( const char *szFileName );
+#endif
+
+	bool		IsLoaded( EAssetPriority ePriority ) const;
+	UINT		GetRequestCount( ) const { return m_nRequested; }
+	UINT		GetLoadedCount( ) const { return m_nLoaded; }
+
+
+	template<typename T>
+	static bool	IsReady( const std::shared_future<T>& f )
+	{
+		return f.valid() && f.wait_for( std::chrono::seconds(0) ) == std::future_status::ready;
+	}
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class
+	//-------------------------------------------------------------------------
+	std::string	MakeKey( const char *szFileName ) const;
+	void		Complete( EAssetPriority ePriority );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	CWorkerPool									*m_pPool;
+	mutable std::mutex							m_Lock;
+	std::map<std::string, std::shared_future<HBITMAP> >	m_Bitmaps;
+
+	UINT					m_nPending[AP_BACKGROUND + 1];	// outstanding requests per priority
+	std::atomic<UINT>		m_nRequested;
+	std::atomic<UINT>		m_nLoaded;
+};
+
+#endif // _ASSETLOADER_H_
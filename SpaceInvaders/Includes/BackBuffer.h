@@ -20,6 +20,10 @@ public:
 	int width() const { return mWidth; }
 	int height() const { return mHeight; }
 
+	// Direct access to the 32 bit, top-down surface pixels. Call
+	// GdiFlush() before touching them if GDI has been drawing.
+	RGBQUAD* bits() const { return mpBits; }
+
 private:
 	// Make copy constructor and assignment operator private
 	// so client cannot copy BackBuffers. We do this because
@@ -36,6 +40,7 @@ private:
 	HDC mhDC;
 	HBITMAP mhSurface;
 	HBITMAP mhOldObject;
+	RGBQUAD* mpBits;
 	int mWidth;
 	int mHeight;
 };
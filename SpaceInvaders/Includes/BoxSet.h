@@ -0,0 +1,93 @@
+//-----------------------------------------------------------------------------
+// File: BoxSet.h
+//
+// Desc: Integer collision boxes kept side by side, tested against a query
+//	   box several at a time.
+//-----------------------------------------------------------------------------
+
+#ifndef _BOXSET_H_
+#define _BOXSET_H_
+
+//-----------------------------------------------------------------------------
+// CBoxSet Specific Includes
+//-----------------------------------------------------------------------------
+#include "Vec2.h"
+#include "Platform.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Name : SBox (Struct)
+// Desc : Box edges in whole pixels, as the old RECT based test had them.
+//-----------------------------------------------------------------------------
+struct SBox
+{
+	int32_t	Left, Top, Right, Bottom;
+};
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CBoxSet (Class)
+// Desc : The boxes of many objects, one int32 array per edge, padded to a
+//		multiple of eight with empty boxes. Edges are worked out once, when
+//		an object moves, with the same rounding as the RECT test; a query
+//		is then nothing but integer compares, four boxes per SSE2 compare
+//		and eight per loop, and hits come back as one bit per box.
+//
+//		Two boxes overlap when each one's right edge is past the other's
+//		left and each one's bottom is past the other's top; touching edges
+//		do not count. An empty box overlaps nothing.
+//
+//		A box moving by (dx, dy) over a tick is swept against the set: the
+//		box covering its whole path picks the candidates, then each one
+//		gets the exact time of first contact.
+//-----------------------------------------------------------------------------
+class CBoxSet
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CBoxSet();
+	virtual ~CBoxSet();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Resize( size_t nCount );
+	size_t			GetCount() const		{ return m_nCount; }
+	size_t			GetWords() const		{ return (m_nCount + 31) / 32; }
+
+	void			Set( size_t i, const SBox& Box );
+	void			SetEmpty( size_t i )	{ Set( i, Empty() ); }
+	void			SetCentred( size_t iFirst, const float *pX, const float *pY, const uint32_t *pLive,
+								size_t nCount, int iWidth, int iHeight );
+	SBox			Get( size_t i ) const;
+
+	size_t			Overlaps( const SBox& Query, uint32_t *pHits ) const;
+	size_t			Overlaps( const SBox *pQueries, size_t nQueries, uint32_t *pHits ) const;
+	size_t			OverlapsScalar( const SBox& Query, uint32_t *pHits ) const;
+	int				FirstOverlap( const SBox& Query, size_t iStart = 0 ) const;
+	int				FirstSweep( const SBox& Box, float dx, float dy, float& fTime ) const;
+
+	static SBox		MakeBox( const Vec2& Centre, int iWidth, int iHeight );
+	static SBox		Empty();
+	static bool		Overlap( const SBox& a, const SBox& b )
+	{
+		return a.Right > b.Left && a.Left < b.Right && a.Bottom > b.Top && a.Top < b.Bottom;
+	}
+	static bool		Sweep( const SBox& Box, float dx, float dy, const SBox& Target, float& fTime );
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	size_t					m_nCount;
+	std::vector<int32_t>	m_Left, m_Top;		// All sized to the same multiple of 8
+	std::vector<int32_t>	m_Right, m_Bottom;
+};
+
+#endif // _BOXSET_H_
@@ -1,8 +1,8 @@
 //-----------------------------------------------------------------------------
-// File: CPlayer.cpp
+// File: Bullet.h
 //
-// Desc: This file stores the player object class. This class performs tasks
-//	   such as player movement, some minor physics as well as rendering.
+// Desc: This file stores the bullet class, which draws the shots of the
+//	   game world. Their movement is done by CGameWorld.
 //
 // Original design by Adam Hoult & Gary Simmons. Modified by Mihai Popescu.
 //-----------------------------------------------------------------------------
@@ -11,38 +11,22 @@
 #define _BULLET_H_
 
 //-----------------------------------------------------------------------------
-// CPlayer Specific Includes
+// Bullet Specific Includes
 //-----------------------------------------------------------------------------
 #include "Main.h"
 #include "Sprite.h"
+#include "GameWorld.h"
 
 //-----------------------------------------------------------------------------
 // Main Class Definitions
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
-// Name : CPlayer (Class)
-// Desc : Player class handles all player manipulation, update and management.
+// Name : Bullet (Class)
+// Desc : One sprite, drawn once for every shot in flight.
 //-----------------------------------------------------------------------------
 class Bullet
 {
 public:
-	//-------------------------------------------------------------------------
-	// Enumerators
-	//-------------------------------------------------------------------------
-	enum DIRECTION
-	{
-		DIR_FORWARD = 1,
-		DIR_BACKWARD = 2,
-		DIR_LEFT = 4,
-		DIR_RIGHT = 8,
-	};
-
-	enum ESpeedStates
-	{
-		SPEED_START,
-		SPEED_STOP
-	};
-
 	//-------------------------------------------------------------------------
 	// Constructors & Destructors for This Class.
 	//-------------------------------------------------------------------------
@@ -52,28 +36,15 @@ public:
 	//-------------------------------------------------------------------------
 	// Public Functions for This Class.
 	//-------------------------------------------------------------------------
-	void					Update(float dt);
-	void					Draw();
-	void					Move(ULONG ulDirection);
-	void					MoveDown(ULONG ulDirection);
-	Vec2& Position();
-	Vec2& Velocity();
-	bool                    Hit = false;
-	void					Explode();
-	bool					AdvanceExplosion();
-	Sprite*                  m_pSprite;
+	void					Draw(const SBullet& bullet);
+	int						getWidth();
+	int						getHeight();
 
 private:
 	//-------------------------------------------------------------------------
 	// Private Variables for This Class.
 	//-------------------------------------------------------------------------
-	//Sprite*                  m_pSprite;
-	ESpeedStates			m_eSpeedState;
-	float					m_fTimer;
-
-	bool					m_bExplosion;
-	AnimatedSprite* m_pExplosionSprite;
-	int						m_iExplosionFrame;
+	Sprite*                 m_pSprite;
 };
 
 #endif // _BULLET_H_
@@ -17,8 +17,42 @@
 #include "CPlayer.h"
 #include "BackBuffer.h"
 #include "ImageFile.h"
+#include "IndexedImage.h"
 #include "Bullet.h"
-#include<vector>
+#include "AssetLoader.h"
+#include "PostProcess.h"
+#include "GameWorld.h"
+#include "Input.h"
+#include "Replay.h"
+#include "SaveFile.h"
+#include "TripleBuffer.h"
+#include "TickClock.h"
+#include <thread>
+#include <atomic>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const char   SAVE_FILE[]		= "game.sav";				// Save game, see SaveFile.h
+const char   LEGACY_SAVE_FILE[]	= "test.out";				// Version 1 save of older builds
+const int    SAVE_TASK_PRIORITY	= CAssetLoader::AP_BACKGROUND;	// Saves queue behind asset loads
+const double STATUS_TIME		= 3.0;						// Seconds a status message stays in the title
+const char   REPLAY_FILE[]		= "last.replay";			// Recording of the latest game, see Replay.h
+const char   LEVEL_FILE[]		= "data/levels.txt";		// Waves and spawn spots, see Levels.h
+const char   LEVEL_CACHE_FILE[]	= "data/levels.cache";		//   compiled on the first run after a change
+
+//-----------------------------------------------------------------------------
+// Name : SFrameState (Struct)
+// Desc : What the simulation hands to the renderer after its ticks.
+//-----------------------------------------------------------------------------
+struct SFrameState
+{
+	SWorldSnapshot	World;
+	double			fTime;			// When the newest tick in World was due, CTimer time
+	double			fSimCost;		// Smoothed cost of one tick in ms
+	ULONG			ulDropped;		// Ticks dropped by the spiral of death cap so far
+	double			fInputLatency;	// Smoothed ms from a key event to the end of its tick
+};
 
 //-----------------------------------------------------------------------------
 // Forward Declarations
@@ -31,8 +65,9 @@
 //-----------------------------------------------------------------------------
 // Name : CGameApp (Class)
 // Desc : Central game engine, initialises the game and handles core processes.
+//		Hosts the CGameWorld simulation and provides its platform services.
 //-----------------------------------------------------------------------------
-class CGameApp
+class CGameApp : public IPlatform
 {
 public:
 	//-------------------------------------------------------------------------
@@ -50,26 +85,52 @@ public:
 	bool		ShutDown( );
 	BackBuffer*      m_pBBuffer;
 	//void        DrawBackground();
-	
+
+	//-------------------------------------------------------------------------
+	// IPlatform Functions
+	//-------------------------------------------------------------------------
+	void		OnSound( ESound eSound );
+	void		OnEffect( EEffect eEffect, float fIntensity );
 	
 private:
+	//-------------------------------------------------------------------------
+	// Private Enumerators
+	//-------------------------------------------------------------------------
+	enum SAVE_STATE
+	{
+		SAVE_IDLE,
+		SAVE_REQUESTED,		// The next RunTicks captures the world
+		SAVE_WRITING,		// A worker writes m_SaveBuffer out
+		SAVE_DONE,
+		SAVE_FAILED,
+	};
 
 	//-------------------------------------------------------------------------
 	// Private Functions for This Class
 	//-------------------------------------------------------------------------
 	bool		BuildObjects	  ( );
+	bool		BuildGameObjects  ( );
+	void		DrawLoadingScreen ( );
 	void		ReleaseObjects	( );
 	void		FrameAdvance	  ( );
 	bool		CreateDisplay	 ( );
 	void		ChangeDevice	  ( );
 	void		SetupGameState	( );
-	void		AnimateObjects	( );
-	void		DrawObjects	   ( );
+	void		DrawObjects	   ( const SWorldSnapshot& World );
 	void		ProcessInput	  ( );
-	int          getHeight();
+	ULONG		RunTicks		  ( double fNow );
+	void		PublishFrame	  ( double fNow );
+	void		StartSimulation   ( );
+	void		StopSimulation	( );
+	void		SimulationThread  ( );
+	void		SetLowLatency	 ( bool bEnable );
+	void		ShowGameOver	  ( const SWorldSnapshot& World );
 	void        DrawBackground();
-	void         SaveGame(CPlayer* m_pPlayer, CPlayer* Player1);
-	void        LoadGame(CPlayer* m_pPlayer, CPlayer* Player1);
+	void         SaveGame();
+	void        LoadGame();
+	void		SaveReplay		  ( );
+	void		CaptureSave	   ( );
+	void		SetStatus		  ( LPCTSTR szStatus );
 	
 	
 	//-------------------------------------------------------------------------
@@ -98,12 +159,49 @@ private:
 	HINSTANCE				m_hInstance;
 
 	CImageFile				m_imgBackground;
-
+	CIndexedImage			m_idxBackground;  // 8 bit copy, replaces m_imgBackground once loaded
+	CPostProcess			m_PostProcess;	  // Full screen effects run before present
+	std::shared_future<bool> m_BackgroundLoaded; // Ready once the background has been decoded
+
+	bool					m_bLoading;		 // Still waiting for the critical assets ?
+	double					m_fStartTime;	   // Time stamp taken when loading started
+	double					m_fFirstFrameTime;  // Seconds until the first gameplay frame
+	double					m_fLoadedTime;	  // Seconds until every asset was loaded
+	double					m_fDrawTime;	  // Smoothed DrawObjects cost in ms
+
+	// Owned by whichever thread runs the ticks: the simulation thread, or
+	// the window thread in low latency mode
+	CLevelSet				m_Levels;		  // Read by the world, so made before it
+	CGameWorld				m_World;		  // The game itself
+	CTickClock				m_Clock;		  // Real time to fixed ticks
+	double					m_fSimCost;		  // Smoothed cost of one tick in ms
+
+	CInput					m_Input;		  // Key events, posted here and read by the ticks
+	CReplayWriter			m_Recorder;		  // Every tick of the current game
+	std::atomic<int>		m_eSave;		  // SAVE_STATE
+	std::vector<double>		m_SaveBuffer;	  // World state being written, owned by the worker while SAVE_WRITING
+	std::shared_future<void> m_SaveTask;
+	CTripleBuffer<SFrameState> m_Frames;	  // Simulation to renderer hand over
+	std::thread				m_SimThread;
+	std::atomic<bool>		m_bSimRunning;
+	std::atomic<float>		m_fPendingBloom;  // Effects raised by the simulation, not yet started
+	std::atomic<float>		m_fPendingFlash;
+
+	bool					m_bLowLatency;	  // Simulate on the window thread right before drawing ?
+	double					m_fLastFrameTime; // Time stamp of the previous frame
+	double					m_fFrameAge;	  // Smoothed age of the drawn state in ms
+	double					m_fPresentTime;	  // Smoothed present cost in ms
+
+	bool					m_bShowTiming;	  // Report interpolation and frame pacing in the title ?
+	LPCTSTR					m_szStatus;		  // Shown after the title for STATUS_TIME
+	double					m_fStatusTime;
+	double					m_fFrameAverage;  // Smoothed frame time in seconds
+	double					m_fFrameJitter;	  // Smoothed deviation from m_fFrameAverage in seconds
+
+	// Views drawing the world's actors
 	CPlayer*				 m_pPlayer;
 	CPlayer*                 Player1;
-	CPlayer*                 m_pEnemy;
-	CPlayer*                 m_pEnemy2;
-	CPlayer*                 m_pEnemy3;
+	CPlayer*                 m_pEnemy;		// Every invader and invader explosion
 
 	CPlayer* star1;
 	CPlayer* star2;
@@ -111,12 +209,7 @@ private:
 
 	
 
-	std::vector<Bullet*>     m_pBullet;
-
-	std::vector<Bullet*>     m_pBulletEnemy;
-
-	_int64 m_BulletTime = timeGetTime();
-		
+	Bullet*                  m_pBullet;
 };
 
 #endif // _CGAMEAPP_H_
\ No newline at end of file
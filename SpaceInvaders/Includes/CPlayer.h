@@ -1,8 +1,9 @@
 //-----------------------------------------------------------------------------
-// File: CPlayer.cpp
+// File: CPlayer.h
 //
-// Desc: This file stores the player object class. This class performs tasks
-//	   such as player movement, some minor physics as well as rendering.
+// Desc: This file stores the player object class. This class draws the
+//	   players, enemies and stars; their movement and physics are done by
+//	   CGameWorld.
 //
 // Original design by Adam Hoult & Gary Simmons. Modified by Mihai Popescu.
 //-----------------------------------------------------------------------------
@@ -15,38 +16,19 @@
 //-----------------------------------------------------------------------------
 #include "Main.h"
 #include "Sprite.h"
-#include "Bullet.h"
+#include "GameWorld.h"
 
 //-----------------------------------------------------------------------------
 // Main Class Definitions
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // Name : CPlayer (Class)
-// Desc : Player class handles all player manipulation, update and management.
+// Desc : Draws a player, enemy or star of the game world. The state itself
+//		lives in the SActor, this class only holds the sprites.
 //-----------------------------------------------------------------------------
 class CPlayer
 {
 public:
-	//-------------------------------------------------------------------------
-	// Enumerators
-	//-------------------------------------------------------------------------
-	enum DIRECTION 
-	{ 
-		DIR_FORWARD	 = 1, 
-		DIR_BACKWARD	= 2, 
-		DIR_LEFT		= 4, 
-		DIR_RIGHT	   = 8, 
-	};
-
-	enum ESpeedStates
-	{
-		SPEED_START,
-		SPEED_STOP
-	};
-
-	int playerLives;
-	int playerScore = 0;
-
 	//-------------------------------------------------------------------------
 	// Constructors & Destructors for This Class.
 	//-------------------------------------------------------------------------
@@ -56,51 +38,37 @@ public:
 	//-------------------------------------------------------------------------
 	// Public Functions for This Class.
 	//-------------------------------------------------------------------------
-	void					Update( float dt );
-	void					Draw();
-	void					Move(ULONG ulDirection);
-	void					MoveEnemies();
-	Vec2&					Position();
-	Vec2&					Velocity();
+	void					Draw(const SActor& actor);
+	void					Draw(const Vec2& position, const Vec2& prevPosition);
+	int						getWidth();
+	int						getHeight();
 
-	void					Explode();
-	bool					AdvanceExplosion();
-	int                     getHeight();
-	void					SetPosition(Vec2 position);
-	void                    RotateLeft();
-	DIRECTION               rotateDirection;
-	bool                    Collision(CPlayer* p1, CPlayer* p2);
-	int                     GetLives();
-	void                    DecreaseLives();
-	void					SetLives(int lives);
-	void					SetScore(int score);
-	int						GetScore();
-	void					IncreaseScore(int score);
-	void                    IncreaseLives(int score1);
-	Sprite*                  m_pSprite;
-	void					MoveStar();
-	
+private:
+	//-------------------------------------------------------------------------
+	// Private Enumerators for This Class.
+	//-------------------------------------------------------------------------
+	enum FACING
+	{
+		FACING_FORWARD,
+		FACING_BACKWARD,
+		FACING_LEFT,
+		FACING_RIGHT,
+		FACING_COUNT
+	};
 
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class.
+	//-------------------------------------------------------------------------
+	void					SetFacing(int facing);
 
-private:
 	//-------------------------------------------------------------------------
 	// Private Variables for This Class.
 	//-------------------------------------------------------------------------
-	//Sprite*					m_pSprite;
-	ESpeedStates			m_eSpeedState;
-	float					m_fTimer;
-	
-	bool					m_bExplosion;
+	Sprite*					m_pSprite;
+	Sprite*					m_pFacingSprites[FACING_COUNT];	// A player's planes, NULL for enemies and stars
 	AnimatedSprite*			m_pExplosionSprite;
-	int						m_iExplosionFrame;
 	const BackBuffer*       mBackBuffer;
-	
-private:
-	
-	float						add = 0.1;
-	float                       add_s =0.1;
-	float                       add1 = 0.1;
-	float                       add2 = 0.1;
+	int						m_iFacing;		// SActor::DIRECTION m_pSprite is drawn for
 };
 
 #endif // _CPLAYER_H_
\ No newline at end of file
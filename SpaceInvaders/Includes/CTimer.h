@@ -46,6 +46,8 @@ public:
 	unsigned long	GetFrameRate( LPTSTR lpszString = NULL, size_t size = 0 ) const;
 	float			GetTimeElapsed() const;
 
+	static double	GetAbsoluteTime();
+
 private:
 	//------------------------------------------------------------
 	// Private Variables For This Class
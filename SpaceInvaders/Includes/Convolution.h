@@ -0,0 +1,97 @@
+#pragma once
+// Convolution.h
+// Fixed point convolution of 32 bit CImageFile buffers (blur, sharpen, edges).
+#include "Win32Types.h"
+#include "ImageFile.h"
+#include "WorkerPool.h"
+#include <vector>
+
+// Fraction bits kept between the horizontal and the vertical pass
+#define CONV_MID_BITS 4
+
+enum EBorderMode
+{
+	EBM_CLAMP,		// repeat the edge pixel
+	EBM_WRAP,		// tile the image
+	EBM_MIRROR		// reflect around the edge pixel
+};
+
+
+// A convolution kernel with its weights already converted to fixed point.
+// Separable kernels keep one row and one column of weights, general ones
+// keep the full matrix. Box blurs also remember their boxes: CConvolution
+// runs those as running sums, whose cost does not grow with the radius,
+// anything else reading kernels uses the taps.
+class CKernel
+{
+public:
+	CKernel();
+
+	static CKernel Gaussian(int radius, double sigma = 0.0);
+	static CKernel Box(int radius);
+	// passes boxes of 2 * radius + 1 in a row, a gaussian of sigma
+	// sqrt(passes * radius * (radius + 1) / 3) as passes grows
+	static CKernel BoxBlur(int radius, int passes = 3);
+	// Close to Gaussian(radius) from three boxes, from radius 3 up; below
+	// that it is Gaussian(radius), whose few taps cost less
+	static CKernel FastGaussian(int radius);
+	static CKernel Sharpen(double amount = 1.0);
+	static CKernel Edge();
+	static CKernel Separable(const double *row, int rowSize, const double *col, int colSize, double bias = 0.0);
+	static CKernel General(const double *weights, int kernelWidth, int kernelHeight, double bias = 0.0);
+
+	bool IsSeparable() const { return m_bSeparable; }
+	int Width() const { return m_iWidth; }
+	int Height() const { return m_iHeight; }
+	int RadiusX() const { return m_iWidth / 2; }
+	int RadiusY() const { return m_iHeight / 2; }
+	bool IsBoxBlur() const { return !m_Boxes.empty(); }
+
+private:
+	static int ChooseShift(const double *weights, int count, int passes);
+	static void Quantize(const double *weights, int count, int shift, std::vector<short> &out);
+	static CKernel Boxes(const std::vector<int> &radii);
+
+	friend class CConvolution;
+	friend class CImagePipeline;
+
+	bool m_bSeparable;
+	int m_iWidth, m_iHeight;	// odd sizes, the anchor is the centre tap
+
+	// Weights in fixed point, padded to an even number of taps per row
+	// so they can be consumed two at a time.
+	std::vector<short> m_Row;	// separable: horizontal taps
+	std::vector<short> m_Col;	// separable: vertical taps
+	std::vector<short> m_Matrix;	// general: m_iHeight rows of padded taps
+	int m_iRowShift, m_iColShift, m_iMatrixShift;
+	int m_iBias;				// added to every channel after scaling
+	std::vector<int> m_Boxes;	// box blurs: radius of each pass, both ways
+};
+
+
+// Runs kernels over images strip by strip. Each strip is filtered through a
+// small buffer that stays in cache, and strips are spread over the worker
+// pool when one is given.
+class CConvolution
+{
+public:
+	CConvolution(CWorkerPool *pPool = NULL);
+
+	void SetStripHeight(int rows) { m_iStripHeight = rows > 0 ? rows : 1; }
+
+	void Apply(CImageFile &img, const CKernel &kernel, EBorderMode border = EBM_CLAMP);
+	void Apply(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int height, const CKernel &kernel, EBorderMode border = EBM_CLAMP);
+
+	static int MapBorder(int i, int size, EBorderMode border);
+
+private:
+	void SeparableStrip(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int height, int y0, int y1, const CKernel &kernel, EBorderMode border);
+	void GeneralStrip(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int height, int y0, int y1, const CKernel &kernel, EBorderMode border);
+	void BoxRows(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int y0, int y1, const CKernel &kernel, EBorderMode border);
+	void BoxColumns(RGBQUAD *pA, RGBQUAD *pB, int width, int height, int x0, int x1, const CKernel &kernel, EBorderMode border);
+	void ApplyBoxes(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int height, const CKernel &kernel, EBorderMode border);
+
+	CWorkerPool *m_pPool;
+	int m_iStripHeight;
+	std::vector<RGBQUAD> m_Plane;	// box blurs: between the passes
+};
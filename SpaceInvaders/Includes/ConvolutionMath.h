@@ -0,0 +1,32 @@
+#pragma once
+// ConvolutionMath.h
+// Fixed point helpers shared by CConvolution and CImagePipeline, so the 32
+// bit and the single channel paths round and pack weights the same way.
+// Internal to those two files, nothing else needs to include it.
+#include "Win32Types.h"
+#include <vector>
+
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+
+static inline int Saturate16(int v) { return v < -32768 ? -32768 : (v > 32767 ? 32767 : v); }
+static inline BYTE Saturate8(int v) { return (BYTE)(v < 0 ? 0 : (v > 255 ? 255 : v)); }
+
+#ifdef USE_SSE2
+// Broadcasts every pair of taps four times over, ready to load for
+// _mm_madd_epi16. Kept as ints: a vector of __m128i is not aligned on
+// every compiler, so these are loaded unaligned.
+static inline void SplatWeights(const short *weights, int taps, std::vector<int> &out)
+{
+	out.resize(taps * 2);
+	for(int k = 0; k < taps; k += 2)
+		for(int i = 0; i < 4; i++)
+			out[k * 2 + i] = (int)(unsigned short)weights[k] | ((int)weights[k + 1] << 16);
+}
+
+static inline __m128i PairWeights(const int *weights, int pair)
+{
+	return _mm_loadu_si128((const __m128i*)(weights + pair * 4));
+}
+#endif
@@ -0,0 +1,117 @@
+//-----------------------------------------------------------------------------
+// File: FlowField.h
+//
+// Desc: A coarse grid over the playfield that knows, for every cell, how far
+//	   the nearest player is and which way leads there, so any number of
+//	   objects can steer by looking up the cell they are in.
+//-----------------------------------------------------------------------------
+
+#ifndef _FLOWFIELD_H_
+#define _FLOWFIELD_H_
+
+//-----------------------------------------------------------------------------
+// CFlowField Specific Includes
+//-----------------------------------------------------------------------------
+#include "Vec2.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const int      FLOW_MAX_GOALS	= 4;		// Cells the field can lead to at once
+const uint16_t FLOW_UNREACHED	= 0xFFFF;	// Distance of blocked cells and those cut off
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CFlowField (Class)
+// Desc : A breadth first search from the goal cells gives every cell its
+//		distance in steps; each cell then points at its lowest neighbour,
+//		diagonals included where both sides are open. Sample and GetDistance
+//		are one lookup, however many objects ask.
+//
+//		There are two copies of the field. Request starts building the back
+//		one for new goals, on a worker thread when SetThreaded is on, and
+//		does nothing if every goal is still in the cell it was built for.
+//		Goals one of the copies was built for, as after a rollback, just
+//		pick that copy. Wait finishes the build and swaps it to the front,
+//		which is all the lookups ever read. Built inline or on the worker,
+//		the front field only follows from the goals of the last Request, so
+//		threading never changes what the simulation does.
+//-----------------------------------------------------------------------------
+class CFlowField
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CFlowField();
+	virtual ~CFlowField();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Create( int nColumns, int nRows, double fCellSize );
+	void			SetThreaded( bool bThreaded );
+	void			SetBlocked( int iColumn, int iRow, bool bBlocked );
+	void			Request( const Vec2 *pGoals, int nGoals );
+	bool			Wait();
+
+	int				GetCell( const Vec2& Position ) const;
+	uint16_t		GetDistance( const Vec2& Position ) const;
+	Vec2			Sample( const Vec2& Position ) const;
+	int				GetColumns() const		{ return m_nColumns; }
+	int				GetRows() const			{ return m_nRows; }
+	size_t			GetBuilds() const		{ return m_nBuilds; }
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Structures for This Class.
+	//-------------------------------------------------------------------------
+	struct SField
+	{
+		std::vector<uint16_t>	Distance;	// Steps to the nearest goal, by GetCell index
+		std::vector<float>		Flow;		// Unit direction to go, x and y by cell
+		int32_t					Goals[FLOW_MAX_GOALS];	// Cells it was built for
+		int						nGoals;		// -1 if it leads nowhere yet
+	};
+
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Build( SField& Field );
+	bool			IsBuiltFor( const SField& Field ) const;
+	void			WorkerLoop();
+	void			Finish( std::unique_lock<std::mutex>& Lock );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	int						m_nColumns;
+	int						m_nRows;
+	int						m_nStride;		// Cells a row, with the border
+	double					m_fInvCell;		// 1 / pixels across a cell
+	std::vector<uint8_t>	m_Blocked;		// Border cells are always
+	std::vector<int32_t>	m_Frontier;		// The search's queue, kept between builds
+	SField					m_Fields[2];
+	int						m_iFront;
+	int32_t					m_Goals[FLOW_MAX_GOALS];	// Cells of the last Request
+	int						m_nGoals;		// -1 until the first, or after SetBlocked
+	size_t					m_nBuilds;
+
+	std::thread				m_Worker;
+	std::mutex				m_Lock;
+	std::condition_variable	m_Wake;			// Tells the worker there is a build
+	std::condition_variable	m_Done;			// Tells Wait it is finished
+	bool					m_bPending;		// Build asked for and not finished
+	bool					m_bReady;		// Back field finished and not swapped in
+	bool					m_bStop;
+};
+
+#endif // _FLOWFIELD_H_
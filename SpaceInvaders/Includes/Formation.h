@@ -0,0 +1,128 @@
+//-----------------------------------------------------------------------------
+// File: Formation.h
+//
+// Desc: A wave of invaders marching as one block: sideways until the
+//	   outermost survivor reaches an edge, then one step down and back.
+//-----------------------------------------------------------------------------
+
+#ifndef _FORMATION_H_
+#define _FORMATION_H_
+
+//-----------------------------------------------------------------------------
+// CFormation Specific Includes
+//-----------------------------------------------------------------------------
+#include "Vec2.h"
+#include "Platform.h"
+#include "BoxSet.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const int FORMATION_MAX_ROWS = 64;		// One alive bit per row in a uint64_t
+
+//-----------------------------------------------------------------------------
+// Name : SFormationDesc (Struct)
+// Desc : Layout and march of a wave.
+//-----------------------------------------------------------------------------
+struct SFormationDesc
+{
+	int32_t	Columns;
+	int32_t	Rows;				// At most FORMATION_MAX_ROWS
+	float	Left, Top;			// Centre of the top left invader
+	float	SpacingX, SpacingY;	// Centre to centre
+	int32_t	Width, Height;		// Of one invader; the block turns when an
+	float	MinX, MaxX;			//   invader's edge reaches MinX or MaxX
+	float	Speed;				// Pixels per second with the wave complete,
+								//   up to three times that with one left
+	float	Drop;				// Pixels down at each turn
+};
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CFormation (Class)
+// Desc : Positions are kept column by column in two float arrays, each
+//		column padded to a multiple of four rows, so a whole wave moves with
+//		one SSE2 add per four invaders. Alongside runs an all-ones/all-zeros
+//		lane mask per slot, which lets the same pass take the minimum and
+//		maximum x over the survivors without a branch.
+//
+//		Who is alive is also kept as one bit per row in a uint64_t per
+//		column, plus one bit per column that still has anybody in it; the
+//		bottom survivor of a column, the one that shoots, is a single bit
+//		scan.
+//
+//		The collision box of every slot is kept in a CBoxSet, refreshed
+//		whenever the wave moves; dead and padding slots have empty boxes.
+//-----------------------------------------------------------------------------
+class CFormation
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CFormation();
+	virtual ~CFormation();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Create( const SFormationDesc& Desc );
+	void			Step( float dt );
+	void			Kill( int iColumn, int iRow );
+	bool			Sweep( const Vec2& From, const Vec2& To, int iWidth, int iHeight,
+						   int& iColumn, int& iRow, float& fTime ) const;
+
+	int				GetColumns() const		{ return m_Desc.Columns; }
+	int				GetRows() const			{ return m_Desc.Rows; }
+	int				GetAliveCount() const	{ return m_nAlive; }
+	uint64_t		GetAliveRows( int iColumn ) const { return m_Alive[iColumn]; }
+	bool			IsAlive( int iColumn, int iRow ) const { return (m_Alive[iColumn] >> iRow) & 1; }
+
+	int				LowestAlive( int iColumn ) const;
+	int				NextOccupiedColumn( int iColumn ) const;
+	float			GetBottom() const;
+
+	Vec2			GetPosition( int iColumn, int iRow ) const;
+	Vec2			GetPrevPosition( int iColumn, int iRow ) const;
+	float			GetColumnX( int iColumn ) const	{ return m_X[iColumn * m_nStride]; }
+	float			GetY( int iColumn, int iRow ) const { return m_Y[iColumn * m_nStride + iRow]; }
+
+	size_t			GetStateSize() const;
+	void			SaveState( void *pBuffer ) const;
+	bool			LoadState( const void *pBuffer, size_t nSize );
+	uint32_t		Checksum( uint32_t h ) const;
+
+	static int		HighestBit( uint64_t n );
+	static int		LowestBit( uint64_t n );
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			RebuildMasks();
+	void			UpdateBoxes( bool bDropped = true );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	SFormationDesc			m_Desc;
+	int						m_nStride;		// Slots per column, Rows rounded up to 4
+	int						m_nAlive;
+	float					m_fDirection;	// +1 marching right, -1 left
+	float					m_fLastDX;		// Movement of the last Step, for interpolation
+	float					m_fLastDY;
+
+	std::vector<float>		m_X;			// Columns * m_nStride slots
+	std::vector<float>		m_Y;
+	std::vector<uint32_t>	m_Mask;			// ~0 for a live invader, 0 otherwise
+	std::vector<uint64_t>	m_Alive;		// Row bits per column
+	std::vector<uint64_t>	m_Occupied;		// Column bits, set while a column has survivors
+	CBoxSet					m_Boxes;		// One per slot
+};
+
+#endif // _FORMATION_H_
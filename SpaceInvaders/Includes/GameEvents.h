@@ -0,0 +1,93 @@
+//-----------------------------------------------------------------------------
+// File: GameEvents.h
+//
+// Desc: What happened during a simulation tick, queued by the systems that
+//	   found out and handled in batches once they are all done.
+//-----------------------------------------------------------------------------
+
+#ifndef _GAMEEVENTS_H_
+#define _GAMEEVENTS_H_
+
+//-----------------------------------------------------------------------------
+// CEventQueue Specific Includes
+//-----------------------------------------------------------------------------
+#include "Vec2.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const size_t EVENT_RESERVE	= 64;		// Room kept for each type of event
+
+//-----------------------------------------------------------------------------
+// Name : SGameEvent (Struct)
+// Desc : One thing that happened to one actor.
+//-----------------------------------------------------------------------------
+struct SGameEvent
+{
+	enum EType
+	{
+		EVENT_EXPLOSION,		// The actor blew up at Position
+		EVENT_SCORE,			// The actor scored Value points
+		EVENT_LIFE,				// The actor gained Value lives, lost some if negative
+		EVENT_SOUND,			// The actor made sound Value, an IPlatform::ESound
+		EVENT_COUNT
+	};
+
+	int32_t	Actor;				// As CGameWorld numbers its actors
+	int32_t	Value;
+	Vec2	Position;			// Where the actor was when it happened
+};
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CEventQueue (Class)
+// Desc : A queue per type of event, each in the order they were pushed, so
+//		whoever handles one type runs down one packed array of them. Clear
+//		keeps the memory; once a tick with the most events of each type has
+//		been through, pushing never allocates again. The queues are plain
+//		data, so systems running side by side can each fill their own.
+//-----------------------------------------------------------------------------
+class CEventQueue
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CEventQueue();
+	virtual ~CEventQueue();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Clear();
+	size_t			GetCount() const;
+
+	//-------------------------------------------------------------------------
+	// Name : Push ()
+	// Desc : Queues an event behind those of its type.
+	//-------------------------------------------------------------------------
+	void Push( SGameEvent::EType eType, int32_t iActor, int32_t nValue, const Vec2& Position )
+	{
+		SGameEvent Event;
+		Event.Actor		= iActor;
+		Event.Value		= nValue;
+		Event.Position	= Position;
+		m_Queues[eType].push_back( Event );
+	}
+
+	size_t			GetCount( SGameEvent::EType eType ) const				{ return m_Queues[eType].size(); }
+	const SGameEvent& Get( SGameEvent::EType eType, size_t i ) const		{ return m_Queues[eType][i]; }
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	std::vector<SGameEvent>	m_Queues[SGameEvent::EVENT_COUNT];
+};
+
+#endif // _GAMEEVENTS_H_
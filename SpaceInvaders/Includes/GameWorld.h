@@ -0,0 +1,261 @@
+//-----------------------------------------------------------------------------
+// File: GameWorld.h
+//
+// Desc: The game simulation: players, enemies, stars and bullets, stepped
+//	   one fixed tick at a time. Knows nothing about windows, sprites or
+//	   the clock, so it builds on any platform and runs headless.
+//-----------------------------------------------------------------------------
+
+#ifndef _GAMEWORLD_H_
+#define _GAMEWORLD_H_
+
+//-----------------------------------------------------------------------------
+// CGameWorld Specific Includes
+//-----------------------------------------------------------------------------
+#include "Vec2.h"
+#include "Platform.h"
+#include "Formation.h"
+#include "Projectiles.h"
+#include "Animations.h"
+#include "TimerWheel.h"
+#include "Random.h"
+#include "GameEvents.h"
+#include "FlowField.h"
+#include "SpatialGrid.h"
+#include "Levels.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <type_traits>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const uint32_t SIM_TICK_RATE	= 120;						// Simulation ticks per second
+const float    SIM_TICK			= 1.0f / SIM_TICK_RATE;		// Seconds simulated by one tick
+
+const int   WORLD_PLAYERS		= 2;
+const int   FORMATION_COLUMNS	= 8;		// Invaders in a wave, across
+const int   FORMATION_ROWS		= 3;		//   and down
+const int   WORLD_BLASTS		= 8;		// Invader explosions on screen at once
+const int   WORLD_STARS			= 3;
+const int   WORLD_ACTORS		= WORLD_PLAYERS + WORLD_BLASTS + WORLD_STARS;
+const int   WORLD_STREAMS		= WORLD_ACTORS + 1;	// Random streams: one per actor, one for the wave
+const int   EXPLOSION_FRAMES	= 15;		// Frames in data/explosion.bmp
+const float EXPLOSION_FPS		= 120.0f;	// Explosion frames shown per second
+
+const float PLAYER_THRUST		= 372.0f;	// Velocity gained per second a direction is held
+const float ENEMY_SPEED			= 30.0f;	// March of a full wave, pixels per second
+const float ENEMY_DROP			= 20.0f;	// Pixels a wave comes down at each turn
+const float STAR_SPEED			= 12.0f;	// Star drift on each axis, pixels per second
+const float STAR_FLEE_SPEED		= 40.0f;	// Stars slip away from a player this fast
+const int   STAR_FLEE_CELLS		= 4;		//   once one is this many field cells away
+const float BULLET_SPEED		= 180.0f;	// Player shots, pixels per second upwards
+const float ENEMY_BULLET_SPEED	= 240.0f;	// Enemy shots, pixels per second downwards
+
+//-----------------------------------------------------------------------------
+// Name : STickInput (Struct)
+// Desc : Everything the simulation reads from the input devices for a tick.
+//-----------------------------------------------------------------------------
+struct STickInput
+{
+	uint32_t Direction[WORLD_PLAYERS];	// SActor::DIRECTION flags for both players
+	bool	 bFire[WORLD_PLAYERS];		// Fire button held for both players
+	uint32_t Actions[WORLD_PLAYERS];	// One shot CGameWorld::ACTION flags
+};
+
+//-----------------------------------------------------------------------------
+// Name : SActor (Struct)
+// Desc : A player, star or invader explosion. Sizes are those of the sprite drawn for it.
+//-----------------------------------------------------------------------------
+struct SActor
+{
+	enum DIRECTION
+	{
+		DIR_FORWARD		= 1,
+		DIR_BACKWARD	= 2,
+		DIR_LEFT		= 4,
+		DIR_RIGHT		= 8,
+	};
+
+	Vec2	Position;
+	Vec2	PrevPosition;		// Position before the last tick, for interpolation
+	Vec2	Velocity;
+	Vec2	Drift;				// Star motion, pixels per second
+	int		Width;
+	int		Height;
+	int		Lives;
+	int		Score;
+	int		Facing;				// DIRECTION the sprite points to
+	bool	bExploding;			// While its explosion animation plays
+	Vec2	ExplosionPosition;	// Where the actor was when it blew up
+	int		ExplosionFrame;		// Explosion frames shown so far, kept by the animation
+	bool	bEngineOn;			// Jet sound state
+	float	SoundTimer;
+};
+
+// World state is saved and restored with memcpy
+static_assert( std::is_trivially_copyable<SActor>::value, "SActor must stay plain data" );
+static_assert( std::is_trivially_copyable<CRandom>::value, "CRandom must stay plain data" );
+
+//-----------------------------------------------------------------------------
+// Name : SBullet (Struct)
+// Desc : A shot in flight as the renderer sees it.
+//-----------------------------------------------------------------------------
+struct SBullet
+{
+	Vec2	Position;
+	Vec2	PrevPosition;
+};
+
+//-----------------------------------------------------------------------------
+// Name : SInvader (Struct)
+// Desc : A live invader as the renderer sees it.
+//-----------------------------------------------------------------------------
+struct SInvader
+{
+	Vec2	Position;
+	Vec2	PrevPosition;
+};
+
+//-----------------------------------------------------------------------------
+// Name : SWorldSnapshot (Struct)
+// Desc : Copy of what the renderer needs from the world after a tick. The
+//		vectors keep their capacity, so capturing into a reused snapshot
+//		does not allocate once the bullet and invader counts have settled.
+//-----------------------------------------------------------------------------
+struct SWorldSnapshot
+{
+	uint32_t				Tick;
+	SActor					Players[WORLD_PLAYERS];
+	SActor					Blasts[WORLD_BLASTS];
+	SActor					Stars[WORLD_STARS];
+	std::vector<SInvader>	Invaders;
+	std::vector<SBullet>	Bullets;
+	std::vector<SBullet>	EnemyBullets;
+	bool					bGameOver;
+};
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CGameWorld (Class)
+// Desc : Owns the whole game state. Step advances it by one tick from the
+//		given input; the same seed and inputs always give the same game.
+//-----------------------------------------------------------------------------
+class CGameWorld
+{
+public:
+	//-------------------------------------------------------------------------
+	// Enumerators
+	//-------------------------------------------------------------------------
+	enum ACTION
+	{
+		ACTION_ROTATE		= 1,	// Turn the plane a quarter to the left
+		ACTION_SELF_DESTRUCT	= 2,	// Blow up and lose a life
+	};
+
+	enum ESpriteKind
+	{
+		KIND_PLAYER,
+		KIND_ENEMY,
+		KIND_STAR,
+		KIND_BULLET,
+		KIND_COUNT
+	};
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CGameWorld( IPlatform *pPlatform = 0 );
+	virtual ~CGameWorld();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			SetPlatform( IPlatform *pPlatform ) { m_pPlatform = pPlatform; }
+	void			SetThreaded( bool bThreaded ) { m_Field.SetThreaded( bThreaded ); }
+	void			SetLevels( const CLevelSet *pLevels ) { m_pLevels = pLevels; }	// Kept, from the next Reset on
+	const CLevelSet	*GetLevels() const { return m_pLevels; }
+	void			SetSpriteSize( ESpriteKind eKind, int iWidth, int iHeight );
+	void			GetSpriteSize( ESpriteKind eKind, int& iWidth, int& iHeight ) const { iWidth = m_Size[eKind][0]; iHeight = m_Size[eKind][1]; }
+	void			Reset( unsigned int nSeed );
+	void			Step( const STickInput& Input );
+
+	bool			IsGameOver() const;
+	uint32_t		GetTick() const { return m_nTick; }
+	uint32_t		Checksum() const;
+	void			Capture( SWorldSnapshot& Snapshot ) const;
+	size_t			GetStateSize() const;
+	size_t			SaveState( void *pBuffer, size_t nCapacity ) const;
+	bool			LoadState( const void *pBuffer, size_t nSize );
+	static uint32_t	MsToTicks( uint32_t ms ) { return ms * SIM_TICK_RATE / 1000; }
+	static SLevel	DefaultLevel();
+
+	SActor&			Player( int i )	{ return m_Players[i]; }
+	const CFormation& Formation() const { return m_Formation; }
+	SActor&			Star( int i )	{ return m_Stars[i]; }
+	const CProjectiles& Bullets() const		 { return m_Bullets; }
+	const CProjectiles& EnemyBullets() const { return m_EnemyBullets; }
+	const CEventQueue& Events() const		 { return m_Events; }	// Of the last tick
+
+	void			SetPosition( SActor& Actor, Vec2 Position );
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			InitActor( SActor& Actor, ESpriteKind eKind );
+	void			SavePrevious();
+	void			MovePlayer( SActor& Actor, uint32_t ulDirection, float dt );
+	void			NewWave();
+	void			FireInvader();
+	const SLevel&	Level() const;
+	Vec2			Spawn( SLevel::ESpawn eKind, CRandom& Random ) const;
+	void			MoveStar( SActor& Actor, float dt );
+	void			UpdatePlayer( SActor& Actor, float dt );
+	void			Rotate( SActor& Actor );
+	void			Fire( CProjectiles& Shots, const SEmitter& Gun, const Vec2& Position, const Vec2& Target );
+	void			MoveBullets( float dt );
+	void			CaptureShots( const CProjectiles& Shots, std::vector<SBullet>& Bullets ) const;
+	void			CheckCollisions();
+	void			ApplyEvents();
+	void			RequestField();
+	void			DispatchEvents();
+	void			Animate( float dt );
+	void			RunTimers();
+	int				ActorIndex( const SActor& Actor ) const;
+	SActor&			Actor( int i );
+	static SBox		Box( const SActor& Actor ) { return CBoxSet::MakeBox( Actor.Position, Actor.Width, Actor.Height ); }
+	void			Event( SGameEvent::EType eType, const SActor& Actor, int32_t nValue ) { m_Events.Push( eType, ActorIndex( Actor ), nValue, Actor.Position ); }
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	IPlatform*				m_pPlatform;
+	int						m_Size[KIND_COUNT][2];	// Sprite width and height per kind
+
+	SActor					m_Players[WORLD_PLAYERS];
+	CFormation				m_Formation;
+	SActor					m_Blasts[WORLD_BLASTS];
+	SActor					m_Stars[WORLD_STARS];
+	CProjectiles			m_Bullets;
+	CProjectiles			m_EnemyBullets;
+	CAnimations				m_Animations;	// Owners are ActorIndex numbers
+	CTimerWheel				m_Timers;
+	CRandom					m_Random[WORLD_STREAMS];	// By ActorIndex, the wave's last
+	CEventQueue				m_Events;		// Cleared as a tick starts
+	CFlowField				m_Field;		// Towards the players as the last tick ended
+	CSpatialGrid			m_Targets;		// The players, as an invader last fired
+	const CLevelSet			*m_pLevels;		// NULL plays DefaultLevel
+	SLevel					m_Default;
+
+	uint32_t				m_nTick;		// Ticks run since Reset
+	uint32_t				m_hGuns[WORLD_PLAYERS];	// Cooldown timer of each player's gun
+	uint32_t				m_hWave;		// Timer bringing on the next wave
+	uint32_t				m_nLevel;		// Waves shot down since Reset, the level is this one round the set
+	uint32_t				m_nBlast;		// Next of m_Blasts to use
+};
+
+#endif // _GAMEWORLD_H_
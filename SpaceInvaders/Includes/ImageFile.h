@@ -2,11 +2,16 @@
 // ImageFile.h
 // by Mihai Popescu
 // March 2009
-#include "main.h"
+#include "Win32Types.h"
 
 
 typedef BYTE (*RGBQUAD_TO_BYTE)(const RGBQUAD &q);
 
+// HSL conversions of a single pixel, scaled to 0..255
+BYTE RGBToHue(const RGBQUAD &q);
+BYTE RGBToSaturation(const RGBQUAD &q);
+BYTE RGBToLuminosity(const RGBQUAD &q);
+
 enum EColorChannel
 {
 	ECC_RED,
@@ -32,18 +37,28 @@ protected:
 	LONG &width;
 	char m_szFileName[MAX_PATH];
 
+	// drops the GDI bitmap Paint caches, it is made again when needed
+	void DeleteBitmap();
+
 public:
 	CImageFile(void);
 	virtual ~CImageFile(void);
 
+	// Without Win32 the file is read as it is, so only uncompressed 1, 4, 8,
+	// 24 and 32 bit bitmaps load, and hdc is ignored
 	bool LoadBitmapFromFile(const char* szFileName, HDC hdc);
 	virtual void Paint(HDC hdc, int x, int y);
 
 	LONG Height() const { return height; }
 	LONG Width() const { return width; }
 
+	// Raw 32 bit pixels, width * height of them, bottom-up as GetDIBits gives them
+	RGBQUAD* Bits() { return m_pRGB; }
+	const RGBQUAD* Bits() const { return m_pRGB; }
+
 	void Clear() { ZeroMemory(m_pRGB, sizeof(RGBQUAD) * width * height); }
 	void Reload(HDC hdc);
+	void Release();
 
 	BYTE* CopyMonoImage(EColorChannel chn, const RECT* rc = NULL);
 	void PasteMonoImage(const BYTE *img, EColorChannel chn, const RECT* rc = NULL);
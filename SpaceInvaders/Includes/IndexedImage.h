@@ -0,0 +1,57 @@
+#pragma once
+// IndexedImage.h
+// 8 bit palettized images, quantized at load and expanded while blitting.
+#include "Win32Types.h"
+#include "ImageFile.h"
+#include <vector>
+
+
+// One byte per pixel plus a palette of up to 256 colours. Images with
+// transparency reserve index 0 for it. The palette is built by the
+// quantizer when the image is created: exact when the art has few enough
+// colours, median cut over a 15 bit histogram otherwise.
+class CIndexedImage
+{
+public:
+	CIndexedImage();
+
+	// Top-down 32 bit pixels. pTransparent (optional, one byte per pixel) marks
+	// the pixels to skip when blitting.
+	bool Create(const RGBQUAD *pPixels, int width, int height, const BYTE *pTransparent = NULL);
+
+#ifdef _WIN32
+	// Bitmaps as the sprites hold them: either an image and mask pair
+	// (black mask pixels are drawn) or an image with a colour key.
+	bool CreateFromBitmap(HBITMAP hImage, HBITMAP hMask, COLORREF crTransparent);
+#endif
+	bool CreateFromImage(const CImageFile &img);
+
+	void Release();
+
+	int Width() const { return m_iWidth; }
+	int Height() const { return m_iHeight; }
+	bool HasTransparency() const { return m_bTransparent; }
+	int PaletteSize() const { return m_iColors; }
+	bool IsExact() const { return m_bExact; }
+
+	// Bytes held by the indices and the palette
+	size_t GetMemorySize() const { return m_Indices.size() + sizeof(m_Palette); }
+
+	// Draws the image, or the part of it in pSrcRect, with its upper left
+	// corner at x, y on a top-down 32 bit surface. Clipped to the surface.
+	void Blit(RGBQUAD *pDst, int dstWidth, int dstHeight, int x, int y, const RECT *pSrcRect = NULL) const;
+
+private:
+	void Quantize(const RGBQUAD *pPixels, const BYTE *pTransparent);
+	bool BuildExactPalette(const RGBQUAD *pPixels, const BYTE *pTransparent, int first);
+	void BuildMedianCutPalette(const RGBQUAD *pPixels, const BYTE *pTransparent, int first);
+
+	static void ExpandRow(const BYTE *pIndices, DWORD *pDst, int count, const DWORD *pPalette, bool bTransparent);
+
+	std::vector<BYTE> m_Indices;	// top-down rows of m_iWidth
+	DWORD m_Palette[256];			// RGBQUAD layout, index 0 unused when transparent
+	int m_iWidth, m_iHeight;
+	int m_iColors;
+	bool m_bTransparent;
+	bool m_bExact;					// every colour kept, no quantization error
+};
@@ -0,0 +1,108 @@
+//-----------------------------------------------------------------------------
+// File: Input.h
+//
+// Desc: Keyboard input as a stream of timestamped key transitions, turned
+//	   into STickInput one simulation tick at a time. Portable: key codes
+//	   are plain bytes and the bindings are set by the host.
+//-----------------------------------------------------------------------------
+
+#ifndef _INPUT_H_
+#define _INPUT_H_
+
+//-----------------------------------------------------------------------------
+// CInput Specific Includes
+//-----------------------------------------------------------------------------
+#include "GameWorld.h"
+#include "SpscQueue.h"
+#include <atomic>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const size_t INPUT_QUEUE_SIZE = 1024;	// Four seconds of 250 Hz key transitions
+
+//-----------------------------------------------------------------------------
+// Name : SInputEvent (Struct)
+// Desc : One key going down or up, stamped with CTimer::GetAbsoluteTime when
+//		the host received it.
+//-----------------------------------------------------------------------------
+struct SInputEvent
+{
+	double		fTime;
+	uint8_t		Key;
+	uint8_t		Type;		// CInput::EVENT
+};
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CInput (Class)
+// Desc : The host thread posts key transitions as they arrive; whoever runs
+//		the ticks builds each tick's input from the events stamped before the
+//		tick ends, in the order they happened. A key pressed and released
+//		within one tick still counts for that tick.
+//-----------------------------------------------------------------------------
+class CInput
+{
+public:
+	//-------------------------------------------------------------------------
+	// Enumerators
+	//-------------------------------------------------------------------------
+	enum CONTROL
+	{
+		CONTROL_FORWARD,
+		CONTROL_BACKWARD,
+		CONTROL_LEFT,
+		CONTROL_RIGHT,
+		CONTROL_FIRE,
+		CONTROL_ROTATE,
+		CONTROL_SELF_DESTRUCT,
+		CONTROL_COUNT
+	};
+
+	enum EVENT
+	{
+		EVENT_DOWN,
+		EVENT_UP,
+		EVENT_RELEASE_ALL,		// Focus lost, the key ups will never come
+	};
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CInput();
+	virtual ~CInput();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Bind( int iPlayer, CONTROL eControl, uint8_t Key );
+
+	// Producer side
+	bool			Post( uint8_t Key, EVENT eType, double fTime );
+
+	// Consumer side
+	void			BuildTick( double fTickEnd, STickInput& Input );
+
+	unsigned long	GetLost() const { return m_nLost; }
+	double			GetLatency() const { return m_fLatency; }
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class.
+	//-------------------------------------------------------------------------
+	bool			Apply( const SInputEvent& Event, bool bPressed[256], STickInput& Input );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	CSpscQueue<SInputEvent, INPUT_QUEUE_SIZE> m_Queue;
+
+	uint8_t						m_Bindings[WORLD_PLAYERS][CONTROL_COUNT];
+	bool						m_bHeld[256];	// Consumer only
+	std::atomic<unsigned long>	m_nLost;		// Events dropped on a full queue
+	double						m_fLatency;		// Average ms from event to end of its tick
+};
+
+#endif // _INPUT_H_
@@ -0,0 +1,155 @@
+//-----------------------------------------------------------------------------
+// File: Levels.h
+//
+// Desc: Wave and level definitions, written as text and compiled on first
+//	   load into a binary cache that later runs map and use as it is.
+//
+//	   The text is a list of levels, each opened by "level" and followed by
+//	   lines of a keyword and two numbers; # starts a comment:
+//
+//	     wave C R         invaders across and down
+//	     origin X Y       top left invader
+//	     spacing X Y      between invaders
+//	     march S D        pixels per second, pixels down at each turn
+//	     fire M S         ms between invader shots, plus up to S at random
+//	     player X Y       where the next player starts
+//	     star X Y         where the next star starts
+//	     respawn X Y      a place a player that was hit may reappear
+//	     jump X Y         a place a collected star may jump to
+//
+//	   A level starts with the wave of the one before, the first with the
+//	   defaults the game passes in; its spawn spots are its own.
+//
+//	   The cache is a 32 byte header, the SLevel records and then every
+//	   spawn spot, grouped by level and kind:
+//
+//	     "SILC", version (uint16), header size (uint16), source hash
+//	     (uint64), source size (uint32), level count (uint32), spawn count
+//	     (uint32), file size (uint32)
+//
+//	   in the machine's own byte order: it is rebuilt wherever it does not
+//	   fit, never shipped.
+//-----------------------------------------------------------------------------
+
+#ifndef _LEVELS_H_
+#define _LEVELS_H_
+
+//-----------------------------------------------------------------------------
+// CLevelSet Specific Includes
+//-----------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <type_traits>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const int LEVEL_MAX_COLUMNS = 64;		// Widest wave a level may ask for
+
+//-----------------------------------------------------------------------------
+// Name : SLevelSpawn (Struct)
+// Desc : A spot something is placed at.
+//-----------------------------------------------------------------------------
+struct SLevelSpawn
+{
+	float	x, y;
+};
+
+//-----------------------------------------------------------------------------
+// Name : SLevel (Struct)
+// Desc : One level as the cache holds it. First and Count pick its spawn
+//		spots of each kind out of those of the whole set.
+//-----------------------------------------------------------------------------
+struct SLevel
+{
+	enum ESpawn
+	{
+		SPAWN_PLAYER,		// Player starts, in player order
+		SPAWN_STAR,			// Star starts, in star order
+		SPAWN_RESPAWN,		// Where hit players reappear, one at random
+		SPAWN_JUMP,			// Where collected stars go, one at random
+		SPAWN_COUNT
+	};
+
+	int32_t		Columns;
+	int32_t		Rows;
+	float		Left, Top;			// Top left invader
+	float		SpacingX, SpacingY;
+	float		Speed;				// March of a full wave, pixels per second
+	float		Drop;				// Pixels the wave comes down at each turn
+	uint32_t	FireMs;				// Invader shots are this far apart,
+	uint32_t	FireSpreadMs;		//   plus up to this much at random
+	uint32_t	First[SPAWN_COUNT];
+	uint32_t	Count[SPAWN_COUNT];
+};
+
+// The cache is used straight from the mapped file
+static_assert( std::is_trivially_copyable<SLevel>::value && sizeof(SLevel) == 72, "SLevel must stay packed plain data" );
+static_assert( sizeof(SLevelSpawn) == 8, "SLevelSpawn must stay packed plain data" );
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CLevelSet (Class)
+// Desc : Load hashes the source text, with the defaults, and maps the cache
+//		if it was built from that same hash; then it is ready, nothing is
+//		parsed or copied. Otherwise it compiles the text into memory and
+//		writes that image as the new cache, going on without one if that
+//		fails.
+//
+//		The levels and spawn spots are read in place, so they stay valid
+//		until the next Load, Compile or Clear.
+//-----------------------------------------------------------------------------
+class CLevelSet
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CLevelSet();
+	virtual ~CLevelSet();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	bool				Load( const char *szSource, const char *szCache, const SLevel& Defaults );
+	bool				Compile( const char *pText, size_t nSize, const SLevel& Defaults );
+	void				Clear();
+
+	size_t				GetCount() const;
+	const SLevel&		GetLevel( size_t iLevel ) const;
+	const SLevelSpawn	*GetSpawns( const SLevel& Level, SLevel::ESpawn eKind, size_t& nCount ) const;
+
+	bool				IsCached() const		{ return m_bCached; }		// The last Load mapped the cache
+	int					GetErrorLine() const	{ return m_nErrorLine; }	// Of the text the last Load or Compile failed on
+	const void			*GetImage() const		{ return m_pImage; }
+	size_t				GetImageSize() const	{ return m_nImage; }
+	uint64_t			GetSourceHash() const;
+
+	static uint64_t		Hash( const void *pData, size_t nSize, uint64_t nSeed = 0 );
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class.
+	//-------------------------------------------------------------------------
+	bool				Map( const char *szFileName );
+	void				Unmap();
+	bool				IsImage( const void *pImage, size_t nSize, uint64_t nHash, size_t nSource ) const;
+	bool				WriteCache( const char *szFileName ) const;
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	const uint8_t				*m_pImage;		// Mapped cache or m_Compiled, whichever is in use
+	size_t						m_nImage;
+	void						*m_pView;		// Mapping of the cache, if that is in use
+	size_t						m_nView;
+	std::vector<uint64_t>		m_Compiled;		// Image compiled here, 8 byte aligned
+	std::vector<SLevelSpawn>	m_Spawns[SLevel::SPAWN_COUNT];	// Of the level being compiled
+	bool						m_bCached;
+	int							m_nErrorLine;
+};
+
+#endif // _LEVELS_H_
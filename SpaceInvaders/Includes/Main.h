@@ -21,6 +21,7 @@
 #include <tchar.h>
 #include <stdio.h>
 #include <math.h>
+#include "Platform.h"
 
 
 //-----------------------------------------------------------------------------
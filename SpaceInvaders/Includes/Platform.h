@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// File: Platform.h
+//
+// Desc: The few services the game simulation needs from whatever hosts it.
+//	   CGameApp implements them on top of Win32, the headless driver with
+//	   counters. Must not include windows.h.
+//-----------------------------------------------------------------------------
+
+#ifndef _PLATFORM_H_
+#define _PLATFORM_H_
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+// SSE2 is always there on x64 and with /arch:SSE2 (the VS default) on x86.
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define USE_SSE2
+#endif
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : IPlatform (Interface)
+// Desc : Outputs of the simulation that leave it: sounds and screen effects.
+//		Called in a batch as each simulation tick ends, still on the thread
+//		that runs it, so implementations should only queue or fire and forget.
+//-----------------------------------------------------------------------------
+class IPlatform
+{
+public:
+	//-------------------------------------------------------------------------
+	// Enumerators
+	//-------------------------------------------------------------------------
+	enum ESound
+	{
+		SOUND_JET_START,
+		SOUND_JET_STOP,
+		SOUND_JET_CABIN,
+		SOUND_EXPLOSION,
+		SOUND_COUNT
+	};
+
+	enum EEffect
+	{
+		EFFECT_BLOOM,			// an enemy went down
+		EFFECT_DAMAGE_FLASH,	// a player lost a life
+		EFFECT_COUNT
+	};
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	virtual ~IPlatform() { }
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	virtual void			OnSound( ESound eSound ) = 0;
+	virtual void			OnEffect( EEffect eEffect, float fIntensity ) = 0;
+};
+
+#endif // _PLATFORM_H_
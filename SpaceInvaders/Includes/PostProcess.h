@@ -0,0 +1,118 @@
+//-----------------------------------------------------------------------------
+// File: PostProcess.h
+//
+// Desc: Full screen effects applied to the back buffer right before it is
+//	   presented: CRT scanlines, bloom around explosions and a red flash
+//	   when a player takes damage. The bloom is a separable box blur of the
+//	   bright parts: a horizontal pass into a glow buffer, then a vertical
+//	   pass fused with the other effects into one read and write per row.
+//	   The passes watch their own cost against a per frame budget.
+//-----------------------------------------------------------------------------
+
+#ifndef _POSTPROCESS_H_
+#define _POSTPROCESS_H_
+
+//-----------------------------------------------------------------------------
+// CPostProcess Specific Includes
+//-----------------------------------------------------------------------------
+#include "Win32Types.h"
+#include "WorkerPool.h"
+#include <vector>
+
+#ifdef _WIN32
+#include "BackBuffer.h"
+#endif
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CPostProcess (Class)
+// Desc : Runs the fused effect pass and degrades its quality whenever it
+//		does not fit the frame budget.
+//-----------------------------------------------------------------------------
+class CPostProcess
+{
+public:
+	//-------------------------------------------------------------------------
+	// Enumerators
+	//-------------------------------------------------------------------------
+	enum EQuality
+	{
+		PPQ_FLASH_ONLY	= 0,	// damage flash only
+		PPQ_LOW			= 1,	// + scanlines
+		PPQ_MEDIUM		= 2,	// + narrow bloom
+		PPQ_HIGH		= 3		// + wide bloom
+	};
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CPostProcess();
+	virtual ~CPostProcess();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	void		SetPool( CWorkerPool *pPool ) { m_pPool = pPool; }
+	void		SetEnabled( bool bEnabled ) { m_bEnabled = bEnabled; }
+	bool		IsEnabled( ) const { return m_bEnabled; }
+	void		SetBudget( double dMilliseconds ) { m_dBudget = dMilliseconds; }
+	void		SetQuality( EQuality eQuality ) { m_eQuality = m_eMaxQuality = eQuality; }
+
+	void		TriggerBloom( float fIntensity );
+	void		TriggerDamageFlash( float fIntensity );
+
+#ifdef _WIN32
+	void		Apply( BackBuffer *pBuffer, float dt );
+#endif
+	void		Apply( RGBQUAD *pBits, int iWidth, int iHeight, float dt );
+
+	// Frame statistics
+	double		GetLastCost( ) const { return m_dLastCost; }		// ms
+	double		GetAverageCost( ) const { return m_dAverageCost; }	// ms
+	EQuality	GetQuality( ) const { return m_eQuality; }
+	ULONG		GetOverBudgetCount( ) const { return m_ulOverBudget; }
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Structures for This Class
+	//-------------------------------------------------------------------------
+	struct SParams
+	{
+		int		iScanline;		// odd row multiplier, 256 = unchanged
+		int		iBloomRadius;	// 0 = no bloom
+		int		iBloomGain;		// bloom strength, 256 = full
+		int		iFlash;			// red added by the damage flash
+	};
+
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class
+	//-------------------------------------------------------------------------
+	void		GlowRows( const RGBQUAD *pRows[2], int iWidth, int iRadius, BYTE *pGlow[2] ) const;
+	void		ProcessRow( RGBQUAD *pRow, int iWidth, int y, const SParams &Params, const WORD *pSums ) const;
+	bool		IsGlowReady( int y0, int y1, int iHeight ) const;
+	void		UpdateQuality( );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	CWorkerPool		*m_pPool;
+	bool			m_bEnabled;
+	double			m_dBudget;			// ms per frame
+	EQuality		m_eQuality;
+	EQuality		m_eMaxQuality;
+	ULONG			m_ulCalmFrames;		// frames in a row well under budget
+	ULONG			m_ulOverBudget;		// frames that blew the budget
+
+	float			m_fBloom;			// decaying effect intensities (0..1)
+	float			m_fFlash;
+
+	std::vector<BYTE>	m_Glow;			// horizontal bloom of the bright pass, 4 per pixel
+	std::vector<BYTE>	m_GlowReady;	// by band, whether its glow rows were done in time
+
+	double			m_dLastCost;
+	double			m_dAverageCost;
+};
+
+#endif // _POSTPROCESS_H_
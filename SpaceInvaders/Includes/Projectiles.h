@@ -0,0 +1,111 @@
+//-----------------------------------------------------------------------------
+// File: Projectiles.h
+//
+// Desc: Shots in flight, kept as parallel float arrays, and the emitters
+//	   that spawn them in patterns.
+//-----------------------------------------------------------------------------
+
+#ifndef _PROJECTILES_H_
+#define _PROJECTILES_H_
+
+//-----------------------------------------------------------------------------
+// CProjectiles Specific Includes
+//-----------------------------------------------------------------------------
+#include "Vec2.h"
+#include "Platform.h"
+#include "BoxSet.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Name : SEmitter (Struct)
+// Desc : A shot pattern. Angles are in radians, 0 pointing straight down
+//		the screen and growing towards +x.
+//-----------------------------------------------------------------------------
+struct SEmitter
+{
+	enum EPattern
+	{
+		PATTERN_SPREAD,		// Count shots fanned over Arc round Angle
+		PATTERN_AIMED,		// Like SPREAD, centred on the target instead
+		PATTERN_RING,		// Count shots evenly round the full circle
+		PATTERN_SPIRAL,		// Count shots from Angle on, Arc further each,
+							//   SpeedStep faster each: one spiral arm
+	};
+
+	int32_t	Pattern;
+	int32_t	Count;
+	float	Speed;			// Pixels per second of the first shot
+	float	SpeedStep;		// Added for each further shot
+	float	Angle;
+	float	Arc;
+	float	Accel;			// Pixels per second squared, along the flight
+};
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CProjectiles (Class)
+// Desc : Every shot of one side. Position, previous position, velocity and
+//		acceleration each live in their own float array, padded to a
+//		multiple of four, so Integrate moves four shots per SSE2 operation.
+//		Cull drops the shots that left the given box or were killed, and
+//		packs the rest to the front without a branch per shot; the order
+//		of the survivors is kept, so the world stays deterministic.
+//		Hits are found along each shot's path over the last Integrate, so
+//		a fast shot cannot step over anything thin.
+//-----------------------------------------------------------------------------
+class CProjectiles
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CProjectiles();
+	virtual ~CProjectiles();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Clear() { m_nCount = 0; }
+	void			Reserve( size_t nCount );
+	void			Spawn( float x, float y, float vx, float vy, float ax = 0.0f, float ay = 0.0f );
+	int				Emit( const SEmitter& Emitter, const Vec2& Origin, const Vec2& Target );
+	void			Integrate( float dt );
+	size_t			Cull( float fLeft, float fTop, float fRight, float fBottom );
+	int				Sweep( const SBox& Target, const Vec2& TargetMove, int iWidth, int iHeight, float& fTime ) const;
+
+	size_t			GetCount() const		{ return m_nCount; }
+	void			Kill( size_t i )		{ m_Keep[i] = 0; }
+	bool			IsLive( size_t i ) const { return m_Keep[i] != 0; }
+	Vec2			GetPosition( size_t i ) const		{ return Vec2( m_X[i], m_Y[i] ); }
+	Vec2			GetPrevPosition( size_t i ) const	{ return Vec2( m_PrevX[i], m_PrevY[i] ); }
+
+	size_t			GetStateSize() const;
+	void			SaveState( void *pBuffer ) const;
+	bool			LoadState( const void *pBuffer, size_t nSize );
+	static bool		IsState( const void *pBuffer, size_t nSize );
+	uint32_t		Checksum( uint32_t h ) const;
+
+	static void		SinCos( float fAngle, float& fSin, float& fCos );
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Resize( size_t nSlots );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	size_t					m_nCount;
+	std::vector<float>		m_X, m_Y;			// All sized to the same multiple of 4
+	std::vector<float>		m_PrevX, m_PrevY;	// Position before the last Integrate
+	std::vector<float>		m_VX, m_VY;
+	std::vector<float>		m_AX, m_AY;
+	std::vector<uint32_t>	m_Keep;				// ~0 while live, 0 once killed
+};
+
+#endif // _PROJECTILES_H_
@@ -0,0 +1,140 @@
+//-----------------------------------------------------------------------------
+// File: Random.h
+//
+// Desc: Seedable random number streams for the simulation: one generator
+//	   per subsystem or object, and a four lane one for filling arrays.
+//-----------------------------------------------------------------------------
+
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+//-----------------------------------------------------------------------------
+// CRandom Specific Includes
+//-----------------------------------------------------------------------------
+#include "Platform.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const int RANDOM_LANES	= 4;		// Generators CRandomBatch runs side by side
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CRandom (Class)
+// Desc : xoshiro128++, 128 bits of state and a period of 2^128 - 1. A seed
+//		and a stream number are hashed into the state with splitmix64, so
+//		every object can draw from a stream of its own that does not depend
+//		on how often any other one was used, or on which thread runs it.
+//		Plain data, saved and restored with memcpy.
+//-----------------------------------------------------------------------------
+class CRandom
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CRandom()										{ Seed( 0, 0 ); }
+			 CRandom( uint64_t nSeed, uint64_t nStream )	{ Seed( nSeed, nStream ); }
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Seed( uint64_t nSeed, uint64_t nStream );
+	CRandom			Split( uint64_t nStream ) const;
+	uint32_t		Checksum( uint32_t h ) const;
+
+	//-------------------------------------------------------------------------
+	// Name : Next ()
+	// Desc : The next 32 random bits.
+	//-------------------------------------------------------------------------
+	uint32_t Next()
+	{
+		uint32_t nResult = Rotate( m_s[0] + m_s[3], 7 ) + m_s[0];
+		uint32_t t = m_s[1] << 9;
+
+		m_s[2] ^= m_s[0];
+		m_s[3] ^= m_s[1];
+		m_s[1] ^= m_s[2];
+		m_s[0] ^= m_s[3];
+		m_s[2] ^= t;
+		m_s[3] = Rotate( m_s[3], 11 );
+		return nResult;
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : NextFloat ()
+	// Desc : Uniform in [0, 1), a multiple of 2^-24 so every value is exact.
+	//-------------------------------------------------------------------------
+	float NextFloat()
+	{
+		return (float)(Next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : Below ()
+	// Desc : 0 to n - 1, by multiplying instead of dividing. Values are off
+	//		being uniform by at most n / 2^32, far below what a game can show.
+	//-------------------------------------------------------------------------
+	uint32_t Below( uint32_t n )
+	{
+		return (uint32_t)(((uint64_t)Next() * n) >> 32);
+	}
+
+	//-------------------------------------------------------------------------
+	// Name : Range ()
+	// Desc : nMin to nMax, both included.
+	//-------------------------------------------------------------------------
+	int32_t Range( int32_t nMin, int32_t nMax )
+	{
+		return nMin + (int32_t)Below( (uint32_t)(nMax - nMin) + 1 );
+	}
+
+	static uint32_t	Rotate( uint32_t x, int k ) { return (x << k) | (x >> (32 - k)); }
+
+private:
+	friend class CRandomBatch;
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	uint32_t		m_s[4];
+};
+
+//-----------------------------------------------------------------------------
+// Name : CRandomBatch (Class)
+// Desc : Four xoshiro128++ generators, each split from one CRandom stream,
+//		stepped together to fill arrays; with SSE2 a step is one pass over
+//		four lanes. Element i comes from lane i % 4, so the plain C build
+//		fills exactly the same numbers. Arrays are filled in whole steps:
+//		a count that is not a multiple of 4 still moves every lane on.
+//-----------------------------------------------------------------------------
+class CRandomBatch
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CRandomBatch()										{ Seed( 0, 0 ); }
+			 CRandomBatch( uint64_t nSeed, uint64_t nStream )	{ Seed( nSeed, nStream ); }
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Seed( uint64_t nSeed, uint64_t nStream );
+	void			Fill( uint32_t *pOut, size_t n );
+	void			FillFloats( float *pOut, size_t n );
+	void			FillBelow( uint32_t *pOut, size_t n, uint32_t nBound );
+	CRandom			GetLane( int iLane ) const;
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	uint32_t		m_s[4][RANDOM_LANES];	// State word, then lane, as SSE2 loads it
+};
+
+#endif // _RANDOM_H_
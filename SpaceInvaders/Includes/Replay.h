@@ -0,0 +1,117 @@
+//-----------------------------------------------------------------------------
+// File: Replay.h
+//
+// Desc: Recording of a game as its seed plus the input of every tick, and
+//	   playback of such a recording. CGameWorld is deterministic, so this is
+//	   all it takes to play the same game again, bit for bit.
+//
+//	   File layout, all numbers LEB128 varints unless noted:
+//	     "SIRP", version byte
+//	     tick rate, seed, level set (8 bytes, little endian, the source
+//	     hash of its CLevelSet or 0 for the built in wave), width and
+//	     height per CGameWorld::ESpriteKind
+//	     tick count, checksum after the last tick (4 bytes, little endian)
+//	     runs: input code, number of ticks it lasted
+//
+//	   An input code holds 8 bits per player: direction (4), fire (1) and
+//	   actions (2). Held keys give long runs, so ten minutes of play take a
+//	   few kilobytes.
+//-----------------------------------------------------------------------------
+
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+//-----------------------------------------------------------------------------
+// CReplay Specific Includes
+//-----------------------------------------------------------------------------
+#include "GameWorld.h"
+#include <stddef.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CReplayWriter (Class)
+// Desc : Begin with the world right after its Reset, Record the input of each
+//		tick before stepping, Save once done.
+//-----------------------------------------------------------------------------
+class CReplayWriter
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CReplayWriter();
+	virtual ~CReplayWriter();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Begin( unsigned int nSeed, const CGameWorld& World );
+	void			Record( const STickInput& Input );
+	bool			Save( const char *szFileName, uint32_t nChecksum ) const;
+
+	bool			IsRecording() const { return m_bRecording; }
+	void			Stop() { m_bRecording = false; }
+	uint32_t		GetTicks() const { return m_nTicks; }
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	bool				 m_bRecording;
+	uint32_t			 m_nSeed;
+	uint64_t			 m_nLevelHash;	// CLevelSet::GetSourceHash, 0 for none
+	int					 m_Size[CGameWorld::KIND_COUNT][2];
+	uint32_t			 m_nTicks;
+	std::vector<uint8_t> m_Runs;		// Finished runs, encoded
+	uint32_t			 m_nRunCode;	// The run still open
+	uint32_t			 m_nRunLength;
+};
+
+//-----------------------------------------------------------------------------
+// Name : CReplayReader (Class)
+// Desc : Load a recording, Start a world from it, then feed Next into Step
+//		until it returns false. Start refuses a world that plays other
+//		levels than the recording did.
+//-----------------------------------------------------------------------------
+class CReplayReader
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CReplayReader();
+	virtual ~CReplayReader();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	bool			Load( const char *szFileName );
+	bool			Start( CGameWorld& World );
+	bool			Next( STickInput& Input );
+
+	uint32_t		GetSeed() const		{ return m_nSeed; }
+	uint64_t		GetLevelHash() const { return m_nLevelHash; }
+	uint32_t		GetTicks() const	{ return m_nTicks; }
+	uint32_t		GetChecksum() const	{ return m_nChecksum; }
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	uint32_t			 m_nSeed;
+	uint64_t			 m_nLevelHash;
+	int					 m_Size[CGameWorld::KIND_COUNT][2];
+	uint32_t			 m_nTicks;
+	uint32_t			 m_nChecksum;
+	std::vector<uint8_t> m_Data;
+	size_t				 m_nRunsStart;	// First run in m_Data
+	size_t				 m_nRead;		// Next run in m_Data
+	uint32_t			 m_nRunCode;	// Run being played back
+	uint32_t			 m_nRunLeft;	// Ticks left in it
+	uint32_t			 m_nPlayed;
+};
+
+#endif // _REPLAY_H_
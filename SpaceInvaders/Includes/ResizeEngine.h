@@ -13,6 +13,8 @@ class CWeightsTable
 private:
 	// Row (or column) of contribution weights
 	sContribution *m_WeightTable;
+	// Storage for the weights of all the contributions
+	double *m_Weights;
 	// Filter window size (of affecting source pixels)
 	DWORD m_WindowSize;
 	// Length of line (no. of rows / cols)
@@ -37,6 +39,11 @@ public:
 	int getRightBoundary(int dst_pos) {
 			return m_WeightTable[dst_pos].Right;
 	}
+
+	// Retrieve the memory the table takes
+	size_t getSize() {
+			return m_LineLength * (sizeof(sContribution) + m_WindowSize * sizeof(double));
+	}
 };
 
 
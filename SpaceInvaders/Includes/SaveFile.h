@@ -0,0 +1,82 @@
+//-----------------------------------------------------------------------------
+// File: SaveFile.h
+//
+// Desc: Save game files. A version 2 file is a 16 byte header followed by
+//	   a CGameWorld::SaveState block:
+//
+//	     "SISV", version (uint16), header size (uint16),
+//	     payload size (uint32), CRC32C of the payload (uint32)
+//
+//	   all little endian. Version 1 is the text file older builds wrote to
+//	   test.out: both players' lives, positions and scores.
+//-----------------------------------------------------------------------------
+
+#ifndef _SAVEFILE_H_
+#define _SAVEFILE_H_
+
+//-----------------------------------------------------------------------------
+// CSaveFile Specific Includes
+//-----------------------------------------------------------------------------
+#include "Win32Types.h"
+#include "Vec2.h"
+#include <stdint.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const uint16_t SAVE_VERSION		= 2;
+const size_t   SAVE_HEADER_SIZE	= 16;		// Of the version written
+
+//-----------------------------------------------------------------------------
+// Name : SLegacySave (Struct)
+// Desc : Contents of a version 1 save.
+//-----------------------------------------------------------------------------
+struct SLegacySave
+{
+	int		Lives[2];
+	Vec2	Position[2];
+	int		Score[2];
+};
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CSaveFile (Class)
+// Desc : Reads and writes save files. Write never leaves a half written
+//		file behind: the data goes to a temporary file first, is flushed to
+//		disk, and only then renamed over the old save. Safe to call from a
+//		worker thread.
+//
+//		EncodeHeader and Verify do the header on their own, away from any
+//		file, and are all Write and Read do besides the file handling.
+//-----------------------------------------------------------------------------
+class CSaveFile
+{
+public:
+	//-------------------------------------------------------------------------
+	// Enumerators
+	//-------------------------------------------------------------------------
+	enum ELoadResult
+	{
+		LOAD_OK,
+		LOAD_MISSING,			// No such file
+		LOAD_CORRUPT,			// Not a save, cut short or failing its CRC
+		LOAD_NEWER,				// Written by a newer version of the game
+	};
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	static bool			Write( const char *szFileName, const void *pState, size_t nSize );
+	static ELoadResult	Read( const char *szFileName, std::vector<double>& State, size_t& nSize );
+	static ELoadResult	ReadLegacy( const char *szFileName, SLegacySave& Save );
+
+	static void			EncodeHeader( uint8_t *pHeader, const void *pState, size_t nSize );
+	static ELoadResult	Verify( const uint8_t *pData, size_t nBytes, size_t& nHeader, size_t& nSize );
+
+	static uint32_t		Crc32c( const void *pData, size_t nSize, uint32_t nCrc = 0 );
+};
+
+#endif // _SAVEFILE_H_
@@ -0,0 +1,83 @@
+//-----------------------------------------------------------------------------
+// File: SpatialGrid.h
+//
+// Desc: Points sorted into the cells of a grid each tick, for finding the
+//	   targets nearest to a position, around it or ahead of it.
+//-----------------------------------------------------------------------------
+
+#ifndef _SPATIALGRID_H_
+#define _SPATIALGRID_H_
+
+//-----------------------------------------------------------------------------
+// CSpatialGrid Specific Includes
+//-----------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+#include <float.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const float SPATIAL_CELL_POINTS	= 2.0f;		// Points a cell holds on average
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CSpatialGrid (Class)
+// Desc : Build spreads a grid over the box around the points, sized for a
+//		couple of them per cell, and counting sorts them cell by cell into
+//		one array; a row of cells is then one run of that array. The nearest
+//		searches go out in rings of cells around the query and stop as soon
+//		as no ring further out can hold anything closer.
+//
+//		Distances are compared squared, in float, with the lower id winning
+//		a tie, so the answers are exactly those of trying every point. Build
+//		only allocates while the point count grows.
+//-----------------------------------------------------------------------------
+class CSpatialGrid
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CSpatialGrid();
+	virtual ~CSpatialGrid();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Build( const float *pX, const float *pY, const int32_t *pIds, size_t nPoints );
+	size_t			GetCount() const		{ return m_Id.size(); }
+
+	int32_t			Nearest( float x, float y, float fMaxRadius = FLT_MAX ) const;
+	int32_t			NearestInCone( float x, float y, float fDirX, float fDirY, float fCosHalfAngle, float fMaxRadius = FLT_MAX ) const;
+	size_t			KNearest( float x, float y, size_t k, int32_t *pIds, float fMaxRadius = FLT_MAX ) const;
+	size_t			Radius( float x, float y, float fRadius, int32_t *pIds, size_t nMax ) const;
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class.
+	//-------------------------------------------------------------------------
+	int				Column( float x ) const;
+	int				Row( float y ) const;
+	template <class Scan> void Search( float x, float y, float fMaxRadius, Scan& Scanner ) const;
+	template <class Scan> void ScanRow( int r, int c0, int c1, Scan& Scanner ) const;
+	template <class Scan> void ScanColumn( int c, int r0, int r1, Scan& Scanner ) const;
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	float					m_fLeft, m_fTop;	// Corner of cell 0, 0
+	float					m_fCell;			// Width and height of a cell
+	float					m_fInvCell;
+	int						m_nColumns;
+	int						m_nRows;
+	std::vector<uint32_t>	m_Start;		// First point of each cell, and one past the last
+	std::vector<float>		m_X, m_Y;		// Sorted by cell
+	std::vector<int32_t>	m_Id;
+	std::vector<uint32_t>	m_Cells;		// Cell of each point as given, while building
+};
+
+#endif // _SPATIALGRID_H_
@@ -7,6 +7,7 @@
 #include "main.h"
 #include "Vec2.h"
 #include "BackBuffer.h"
+#include "IndexedImage.h"
 
 class Sprite
 {
@@ -24,11 +25,25 @@ public:
 	void setBackBuffer(const BackBuffer *pBackBuffer);
 	virtual void draw();
 
+	// When enabled (the default), sprites created from then on are
+	// quantized to 8 bit palettized storage and their bitmaps released.
+	static void setIndexedStorage(bool bEnable) { sbIndexedStorage = bEnable; }
+	static bool getIndexedStorage() { return sbIndexedStorage; }
+
+	// Bytes of pixel data held by all live sprites
+	static size_t getTotalMemory() { return sTotalMemory; }
+
+	// Sprites are drawn between mPrevPosition and mPosition, alpha being
+	// how far into the next simulation tick the frame is (0 to 1).
+	static void setInterpolation(float alpha) { sfAlpha = alpha; }
+	static float getInterpolation() { return sfAlpha; }
+
 public:
 	// Keep these public because they need to be
 	// modified externally frequently.
 	Vec2 mPosition;
 	Vec2 mVelocity;
+	Vec2 mPrevPosition;
 
 private:
 	// Make copy constructor and assignment operator private
@@ -50,6 +65,19 @@ protected:
 	COLORREF mcTransparentColor;
 	void drawTransparent();
 	void drawMask();
+
+	// 8 bit copy of the image, drawn straight into the back buffer pixels
+	CIndexedImage *mpIndexed;
+	size_t mMemory;
+	void makeIndexed();
+	void drawIndexed(const RECT *pSrcRect, int w, int h);
+
+	// Where the sprite is drawn this frame
+	Vec2 drawPosition() { return mPrevPosition + (mPosition - mPrevPosition) * sfAlpha; }
+
+	static bool sbIndexedStorage;
+	static size_t sTotalMemory;
+	static float sfAlpha;
 };
 
 // AnimatedSprite
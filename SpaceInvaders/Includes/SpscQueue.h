@@ -0,0 +1,86 @@
+//-----------------------------------------------------------------------------
+// File: SpscQueue.h
+//
+// Desc: Lock free bounded FIFO from exactly one producer thread to exactly
+//	   one consumer thread.
+//-----------------------------------------------------------------------------
+
+#ifndef _SPSCQUEUE_H_
+#define _SPSCQUEUE_H_
+
+//-----------------------------------------------------------------------------
+// CSpscQueue Specific Includes
+//-----------------------------------------------------------------------------
+#include <atomic>
+#include <stddef.h>
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CSpscQueue (Class)
+// Desc : Ring of N slots, N a power of two. The head and tail counters only
+//		ever grow and live on their own cache lines; each side keeps a copy
+//		of the other's counter and reloads it only when the ring looks full
+//		(or empty), so the common case touches no shared line but its own.
+//-----------------------------------------------------------------------------
+template <typename T, size_t N>
+class CSpscQueue
+{
+	static_assert( N && (N & (N - 1)) == 0, "CSpscQueue size must be a power of two" );
+
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	CSpscQueue() : m_nHead( 0 ), m_nTailCache( 0 ), m_nTail( 0 ), m_nHeadCache( 0 ) { }
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	// Producer side, false when the ring is full
+	bool Push( const T& Item )
+	{
+		size_t nTail = m_nTail.load( std::memory_order_relaxed );
+		if ( nTail - m_nHeadCache == N )
+		{
+			m_nHeadCache = m_nHead.load( std::memory_order_acquire );
+			if ( nTail - m_nHeadCache == N ) return false;
+		}
+
+		m_Items[nTail & (N - 1)] = Item;
+		m_nTail.store( nTail + 1, std::memory_order_release );
+		return true;
+	}
+
+	// Consumer side, Peek returns NULL when the ring is empty. The item
+	// stays valid until Pop.
+	const T* Peek()
+	{
+		size_t nHead = m_nHead.load( std::memory_order_relaxed );
+		if ( nHead == m_nTailCache )
+		{
+			m_nTailCache = m_nTail.load( std::memory_order_acquire );
+			if ( nHead == m_nTailCache ) return NULL;
+		}
+
+		return &m_Items[nHead & (N - 1)];
+	}
+
+	void Pop()
+	{
+		m_nHead.store( m_nHead.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+	}
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	alignas(64) std::atomic<size_t>	m_nHead;		// Written by the consumer
+	size_t							m_nTailCache;	// Consumer only
+	alignas(64) std::atomic<size_t>	m_nTail;		// Written by the producer
+	size_t							m_nHeadCache;	// Producer only
+	alignas(64) T					m_Items[N];
+};
+
+#endif // _SPSCQUEUE_H_
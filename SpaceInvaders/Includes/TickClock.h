@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------------
+// File: TickClock.h
+//
+// Desc: The fixed tick accumulator: turns real frame times, however long or
+//	   uneven, into whole simulation ticks. Portable, the host passes the
+//	   time stamps in.
+//-----------------------------------------------------------------------------
+
+#ifndef _TICKCLOCK_H_
+#define _TICKCLOCK_H_
+
+//-----------------------------------------------------------------------------
+// CTickClock Specific Includes
+//-----------------------------------------------------------------------------
+#include "GameWorld.h"
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const uint32_t SIM_MAX_TICKS		= 8;						// Most ticks run for one rendered frame
+const double   SIM_MAX_FRAME_TIME	= 0.25;						// Longest frame fed to the accumulator
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CTickClock (Class)
+// Desc : Real time goes in through Advance, ticks come out of NextTick, the
+//		oldest first, each with the time its SIM_TICK of play ends at. What
+//		is left over stays in the accumulator for the next call, so the
+//		ticks run only depend on the time passed, not on how it was split
+//		into frames.
+//
+//		Gaps longer than SIM_MAX_FRAME_TIME (debugger, window drag) are
+//		clamped, and past SIM_MAX_TICKS in one Advance the backlog is
+//		dropped instead of falling further behind.
+//-----------------------------------------------------------------------------
+class CTickClock
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CTickClock();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Reset( double fNow );
+	void			Resume( double fNow ) { m_fLastTime = fNow; }
+
+	void			Advance( double fNow );
+	bool			NextTick( double& fTickEnd );
+
+	double			GetAccumulator() const { return m_fAccumulator; }
+	uint32_t		GetDropped() const { return m_nDropped; }
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	double			m_fAccumulator;		// Real time not yet simulated, in seconds
+	double			m_fLastTime;		// Time stamp of the previous Advance
+	uint32_t		m_nTicks;			// Ticks handed out since that Advance
+	uint32_t		m_nDropped;			// Ticks discarded by the SIM_MAX_TICKS cap
+};
+
+#endif // _TICKCLOCK_H_
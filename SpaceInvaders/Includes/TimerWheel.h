@@ -0,0 +1,124 @@
+//-----------------------------------------------------------------------------
+// File: TimerWheel.h
+//
+// Desc: Timers counted in simulation ticks: cooldowns, delayed spawns and
+//	   periodic emitters, kept in a hierarchical timing wheel.
+//-----------------------------------------------------------------------------
+
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+//-----------------------------------------------------------------------------
+// CTimerWheel Specific Includes
+//-----------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const int TIMER_WHEEL_BITS		= 8;						// Slots per level, as a power of 2
+const int TIMER_WHEEL_SLOTS		= 1 << TIMER_WHEEL_BITS;
+const int TIMER_WHEEL_LEVELS	= 32 / TIMER_WHEEL_BITS;	// Enough for any uint32_t delay
+
+//-----------------------------------------------------------------------------
+// Name : STimerEvent (Struct)
+// Desc : A timer that went off, as Advance hands it back.
+//-----------------------------------------------------------------------------
+struct STimerEvent
+{
+	uint32_t	Handle;
+	int32_t		Kind;			// As given to Start
+	int32_t		Data;
+};
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CTimerWheel (Class)
+// Desc : Four levels of 256 slots. A timer due within 256 ticks hangs in the
+//		level 0 slot of its tick, one due within 65536 in the level 1 slot
+//		of its tick / 256, and so on; each time the level below wraps, the
+//		next slot up is emptied into the levels below. Slots are doubly
+//		linked lists through one pool of timers, so Start and Cancel are a
+//		few index writes and a tick only touches the timers that are due,
+//		plus now and then one slot being cascaded, however many are pending.
+//
+//		A handle packs the pool index with a generation count, so a handle
+//		to a timer that went off or was cancelled stays harmless. 0 is never
+//		a handle. Everything is plain data and timers due on the same tick
+//		always come back in the same order. A bit per slot tells the ones
+//		in use, so a saved state only holds those heads, not all 1024.
+//-----------------------------------------------------------------------------
+class CTimerWheel
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CTimerWheel();
+	virtual ~CTimerWheel();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Clear( uint32_t nTick = 0 );
+	void			Reserve( size_t nTimers );
+	uint32_t		Start( uint32_t nDelay, int32_t iKind, int32_t iData, uint32_t nPeriod = 0 );
+	bool			Cancel( uint32_t hTimer );
+	bool			IsPending( uint32_t hTimer ) const;
+	uint32_t		GetRemaining( uint32_t hTimer ) const;
+	size_t			Advance();
+
+	uint32_t		GetTick() const			{ return m_nTick; }
+	size_t			GetPending() const		{ return m_nPending; }
+	size_t			GetExpiredCount() const	{ return m_Expired.size(); }
+	const STimerEvent& GetExpired( size_t i ) const { return m_Expired[i]; }
+
+	size_t			GetStateSize() const;
+	void			SaveState( void *pBuffer ) const;
+	static bool		IsState( const void *pBuffer, size_t nSize );
+	bool			LoadState( const void *pBuffer, size_t nSize );
+	uint32_t		Checksum( uint32_t h ) const;
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Structures for This Class.
+	//-------------------------------------------------------------------------
+	struct STimer
+	{
+		uint32_t	Handle;			// Generation and index, of the last use while free
+		uint32_t	Expire;			// Tick it goes off on
+		uint32_t	Period;			// Started again this much later, 0 for once
+		int32_t		Kind;
+		int32_t		Data;
+		int32_t		Slot;			// Slot list it is in, TIMER_FREE if none
+		int32_t		Next;			// Also the free list
+		int32_t		Prev;
+	};
+
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class.
+	//-------------------------------------------------------------------------
+	void			Link( int32_t i );
+	void			Unlink( int32_t i );
+	void			SetHead( int32_t iSlot, int32_t i );
+	void			Cascade( int iLevel );
+	int32_t			Find( uint32_t hTimer ) const;
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	uint32_t				m_nTick;
+	uint32_t				m_nPending;
+	int32_t					m_iFree;		// Head of the free timers, -1 if none
+	int32_t					m_Slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];	// List heads, -1 if empty
+	uint32_t				m_Occupied[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS / 32];	// Bit set where the head is not
+	uint32_t				m_nHeads;		// Bits set
+	std::vector<STimer>		m_Timers;
+	std::vector<STimerEvent> m_Expired;		// Of the last Advance
+};
+
+#endif // _TIMERWHEEL_H_
@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// File: TripleBuffer.h
+//
+// Desc: Lock free hand over of the latest value from one producer thread to
+//	   one consumer thread. Neither side ever waits for the other.
+//-----------------------------------------------------------------------------
+
+#ifndef _TRIPLEBUFFER_H_
+#define _TRIPLEBUFFER_H_
+
+//-----------------------------------------------------------------------------
+// CTripleBuffer Specific Includes
+//-----------------------------------------------------------------------------
+#include <atomic>
+
+//-----------------------------------------------------------------------------
+// Main Class Definitions
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CTripleBuffer (Class)
+// Desc : The producer fills Back() and calls Publish(); the consumer calls
+//		Update() and reads Front(). The third buffer sits in between and is
+//		swapped with either side through one atomic exchange, so the
+//		consumer always sees a complete value and may skip stale ones.
+//-----------------------------------------------------------------------------
+template <typename T>
+class CTripleBuffer
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+	CTripleBuffer() : m_Middle( 1 ), m_iBack( 0 ), m_iFront( 2 ) { }
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class.
+	//-------------------------------------------------------------------------
+	// Producer side
+	T&			Back()			{ return m_Buffers[m_iBack]; }
+	void		Publish()		{ m_iBack = m_Middle.exchange( m_iBack | FRESH ) & INDEX; }
+
+	// Consumer side, Update returns false when nothing new was published
+	const T&	Front() const	{ return m_Buffers[m_iFront]; }
+	bool		Update()
+	{
+		if ( !(m_Middle.load() & FRESH) ) return false;
+		m_iFront = m_Middle.exchange( m_iFront ) & INDEX;
+		return true;
+	}
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class.
+	//-------------------------------------------------------------------------
+	enum { INDEX = 3, FRESH = 4 };
+
+	T					m_Buffers[3];
+	std::atomic<int>	m_Middle;		// Index of the middle buffer, FRESH once published
+	int					m_iBack;		// Producer only
+	int					m_iFront;		// Consumer only
+};
+
+#endif // _TRIPLEBUFFER_H_
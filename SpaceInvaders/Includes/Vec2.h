@@ -17,7 +17,6 @@ public:
 		Vec2() : x(0), y(0){ }
 		Vec2(double a, double b) { x=a; y=b; }
 		Vec2(int a, int b) { x=a; y=b; }
-		~Vec2(){ };
 
 		Vec2& operator-();
 
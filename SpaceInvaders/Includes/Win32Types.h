@@ -0,0 +1,85 @@
+//-----------------------------------------------------------------------------
+// File: Win32Types.h
+//
+// Desc: What the image, worker and asset code takes from Main.h. On Windows
+//	   that is Main.h itself; elsewhere the handful of Win32 types and
+//	   defines that code is written in are declared here instead, so the
+//	   headless driver can build and time it. Nothing here draws or loads
+//	   through GDI, that stays behind _WIN32 in the code using it.
+//-----------------------------------------------------------------------------
+
+#ifndef _WIN32TYPES_H_
+#define _WIN32TYPES_H_
+
+#ifdef _WIN32
+
+#include "Main.h"
+
+#else // _WIN32
+
+//-----------------------------------------------------------------------------
+// Win32Types Specific Includes
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include "Platform.h"
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+typedef uint8_t			BYTE;
+typedef uint16_t		WORD;
+typedef uint32_t		DWORD;
+typedef int32_t			LONG;
+typedef uint32_t		ULONG;
+typedef unsigned int	UINT;
+typedef int				BOOL;
+typedef void			*HDC;
+typedef void			*HBITMAP;
+
+#define MAX_PATH			260
+#define BI_RGB				0
+#define ZeroMemory(p, n)	memset( (p), 0, (n) )
+
+// windows.h has these as macros, the code only ever compares like types
+using std::min;
+using std::max;
+
+#define EPS 1e-3 // epsilon (the smallest float value used)
+#define PI 3.14159265358979323846
+
+struct RGBQUAD
+{
+	BYTE	rgbBlue;
+	BYTE	rgbGreen;
+	BYTE	rgbRed;
+	BYTE	rgbReserved;
+};
+
+struct RECT
+{
+	LONG	left, top, right, bottom;
+};
+
+struct BITMAPINFOHEADER
+{
+	DWORD	biSize;
+	LONG	biWidth;
+	LONG	biHeight;
+	WORD	biPlanes;
+	WORD	biBitCount;
+	DWORD	biCompression;
+	DWORD	biSizeImage;
+	LONG	biXPelsPerMeter;
+	LONG	biYPelsPerMeter;
+	DWORD	biClrUsed;
+	DWORD	biClrImportant;
+};
+
+#endif // !_WIN32
+
+#endif // _WIN32TYPES_H_
@@ -0,0 +1,104 @@
+//-----------------------------------------------------------------------------
+// File: WorkerPool.h
+//
+// Desc: Small fixed size thread pool. Tasks are queued with a priority and
+//	   picked up by the workers most urgent first (lower value = sooner),
+//	   in submission order among tasks of the same priority.
+//-----------------------------------------------------------------------------
+
+#ifndef _WORKERPOOL_H_
+#define _WORKERPOOL_H_
+
+//-----------------------------------------------------------------------------
+// CWorkerPool Specific Includes
+//-----------------------------------------------------------------------------
+#include "Win32Types.h"
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Name : CWorkerPool (Class)
+// Desc : Runs queued tasks on a set of worker threads and hands results back
+//		through futures.
+//-----------------------------------------------------------------------------
+class CWorkerPool
+{
+public:
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors for This Class.
+	//-------------------------------------------------------------------------
+			 CWorkerPool();
+	virtual ~CWorkerPool();
+
+	//-------------------------------------------------------------------------
+	// Public Functions for This Class
+	//-------------------------------------------------------------------------
+	void		Start( UINT nThreads = 0 );
+	void		Stop( );
+	UINT		ThreadCount( ) const { return (UINT)m_Threads.size(); }
+
+	// Queue a task, the returned future becomes ready once it has run.
+	template<typename F>
+	std::shared_future<typename std::result_of<F()>::type> Submit( int iPriority, F fn )
+	{
+		typedef typename std::result_of<F()>::type R;
+
+		std::shared_ptr< std::packaged_task<R()> > task = std::make_shared< std::packaged_task<R()> >( fn );
+		std::shared_future<R> result = task->get_future().share();
+
+		Enqueue( iPriority, [task]() { (*task)(); } );
+		return result;
+	}
+
+	// Run fn(0) .. fn(iCount - 1) spread over the workers and the calling
+	// thread. Returns once every index has been processed.
+	void		ParallelFor( int iCount, const std::function<void(int)>& fn, int iPriority = 0 );
+
+private:
+	//-------------------------------------------------------------------------
+	// Private Structures for This Class
+	//-------------------------------------------------------------------------
+	struct STask
+	{
+		int						iPriority;
+		ULONG					ulSequence;
+		std::function<void()>	fn;
+	};
+
+	struct STaskOrder
+	{
+		bool operator()( const STask& a, const STask& b ) const
+		{
+			if ( a.iPriority != b.iPriority ) return a.iPriority > b.iPriority;
+			return a.ulSequence > b.ulSequence;
+		}
+	};
+
+	//-------------------------------------------------------------------------
+	// Private Functions for This Class
+	//-------------------------------------------------------------------------
+	void		Enqueue( int iPriority, std::function<void()> fn );
+	void		WorkerLoop( );
+
+	//-------------------------------------------------------------------------
+	// Private Variables for This Class
+	//-------------------------------------------------------------------------
+	std::vector<std::thread>								m_Threads;
+	std::priority_queue<STask, std::vector<STask>, STaskOrder>	m_Tasks;
+	std::mutex												m_Lock;
+	std::condition_variable									m_Wake;
+	bool													m_bStop;
+	ULONG													m_ulSequence;
+};
+
+#endif // _WORKERPOOL_H_
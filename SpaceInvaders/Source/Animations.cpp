@@ -0,0 +1,184 @@
+//-----------------------------------------------------------------------------
+// File: Animations.cpp
+//
+// Desc: Frame animations playing in the simulation, advanced by elapsed
+//	   time once per tick.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CAnimations Specific Includes
+//-----------------------------------------------------------------------------
+#include "Animations.h"
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+// Name : SAnimationState (Struct)
+// Desc : Fixed part of saved animations, followed by Count SAnimation.
+//-----------------------------------------------------------------------------
+struct SAnimationState
+{
+	uint32_t	Count;
+	uint32_t	Reserved;
+};
+
+//-----------------------------------------------------------------------------
+// Name : CAnimations () (Constructor)
+// Desc : CAnimations Class Constructor
+//-----------------------------------------------------------------------------
+CAnimations::CAnimations()
+{
+	m_pClips	= NULL;
+	m_nClips	= 0;
+	m_nOwners	= 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CAnimations () (Destructor)
+// Desc : CAnimations Class Destructor
+//-----------------------------------------------------------------------------
+CAnimations::~CAnimations()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : Create ()
+// Desc : Sets the clips, which must outlive the object, and the number of
+//		owners, numbered from 0. Stops everything playing.
+//-----------------------------------------------------------------------------
+void CAnimations::Create( const SAnimClip *pClips, int nClips, int nOwners )
+{
+	m_pClips	= pClips;
+	m_nClips	= nClips;
+	m_nOwners	= nOwners;
+
+	m_Active.clear();
+	m_Active.reserve( nOwners );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Play ()
+// Desc : Starts a clip for an owner, at its first frame. False, changing
+//		nothing, if the owner is still playing one.
+//-----------------------------------------------------------------------------
+bool CAnimations::Play( int iClip, int iOwner )
+{
+	if ( iClip < 0 || iClip >= m_nClips || iOwner < 0 || iOwner >= m_nOwners ) return false;
+	if ( Find( iOwner ) >= 0 ) return false;
+
+	SAnimation Animation;
+	Animation.Clip	= iClip;
+	Animation.Owner	= iOwner;
+	Animation.Phase	= 0.0f;
+	Animation.Frame	= 0;
+	m_Active.push_back( Animation );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Advance ()
+// Desc : Plays every animation dt seconds further. Those past their last
+//		frame are dropped and their owners written to pFinished, which must
+//		have room for GetCount() of them; returns how many finished.
+//-----------------------------------------------------------------------------
+size_t CAnimations::Advance( float dt, int32_t *pFinished )
+{
+	size_t nFinished = 0;
+
+	for ( size_t i = 0; i < m_Active.size(); )
+	{
+		SAnimation& Animation = m_Active[i];
+		const SAnimClip& Clip = m_pClips[Animation.Clip];
+
+		Animation.Phase += dt * Clip.FrameRate;
+		Animation.Frame = (int32_t)Animation.Phase;
+		if ( Animation.Frame < Clip.Frames ) { i++; continue; }
+
+		// The last one takes its place and is advanced next
+		pFinished[nFinished++] = Animation.Owner;
+		Animation = m_Active.back();
+		m_Active.pop_back();
+	}
+
+	return nFinished;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Find ()
+// Desc : Index of the animation the owner is playing, -1 if none.
+//-----------------------------------------------------------------------------
+int CAnimations::Find( int iOwner ) const
+{
+	for ( size_t i = 0; i < m_Active.size(); i++ )
+		if ( m_Active[i].Owner == iOwner ) return (int)i;
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetStateSize ()
+// Desc : Bytes SaveState writes, a multiple of 8.
+//-----------------------------------------------------------------------------
+size_t CAnimations::GetStateSize() const
+{
+	return sizeof(SAnimationState) + m_Active.size() * sizeof(SAnimation);
+}
+
+//-----------------------------------------------------------------------------
+// Name : SaveState ()
+// Desc : Copies the animations to pBuffer, which must hold GetStateSize
+//		bytes.
+//-----------------------------------------------------------------------------
+void CAnimations::SaveState( void *pBuffer ) const
+{
+	SAnimationState *pState = (SAnimationState*)pBuffer;
+	pState->Count		= (uint32_t)m_Active.size();
+	pState->Reserved	= 0;
+	if ( !m_Active.empty() ) memcpy( pState + 1, m_Active.data(), m_Active.size() * sizeof(SAnimation) );
+}
+
+//-----------------------------------------------------------------------------
+// Name : IsState ()
+// Desc : Whether the nSize bytes at pBuffer can be loaded with the clips and
+//		owners given to Create.
+//-----------------------------------------------------------------------------
+bool CAnimations::IsState( const void *pBuffer, size_t nSize ) const
+{
+	const SAnimationState *pState = (const SAnimationState*)pBuffer;
+	if ( nSize < sizeof(SAnimationState) || pState->Count > (uint32_t)m_nOwners ) return false;
+	if ( sizeof(SAnimationState) + pState->Count * sizeof(SAnimation) != nSize ) return false;
+
+	const SAnimation *pAnimations = (const SAnimation*)(pState + 1);
+	for ( uint32_t i = 0; i < pState->Count; i++ )
+	{
+		const SAnimation& Animation = pAnimations[i];
+		if ( Animation.Clip < 0 || Animation.Clip >= m_nClips || Animation.Owner < 0 || Animation.Owner >= m_nOwners ) return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : LoadState ()
+// Desc : Restores animations saved by SaveState. False, with nothing
+//		changed, if IsState is.
+//-----------------------------------------------------------------------------
+bool CAnimations::LoadState( const void *pBuffer, size_t nSize )
+{
+	if ( !IsState( pBuffer, nSize ) ) return false;
+
+	const SAnimationState *pState = (const SAnimationState*)pBuffer;
+	const SAnimation *pAnimations = (const SAnimation*)(pState + 1);
+	m_Active.assign( pAnimations, pAnimations + pState->Count );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Checksum ()
+// Desc : Carries CGameWorld's FNV-1a hash h on over the animations.
+//-----------------------------------------------------------------------------
+uint32_t CAnimations::Checksum( uint32_t h ) const
+{
+	const unsigned char *b = (const unsigned char*)m_Active.data();
+	size_t n = m_Active.size() * sizeof(SAnimation);
+	for ( size_t i = 0; i < n; i++ ) h = (h ^ b[i]) * 16777619u;
+	return h;
+}
@@ -0,0 +1,174 @@
+//-----------------------------------------------------------------------------
+// File: AssetLoader.cpp
+//
+// Desc: Asynchronous asset loader. Bitmaps and images are decoded on a worker
+//	   pool while the main loop keeps pumping messages, and every request
+//	   hands back a future the game can poll or wait on.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CAssetLoader Specific Includes
+//-----------------------------------------------------------------------------
+#include "AssetLoader.h"
+#include <ctype.h>
+
+#ifdef _WIN32
+extern HINSTANCE g_hInst;
+#endif
+
+//-----------------------------------------------------------------------------
+// Name : CAssetLoader () (Constructor)
+// Desc : CAssetLoader Class Constructor
+//-----------------------------------------------------------------------------
+CAssetLoader::CAssetLoader( CWorkerPool *pPool )
+{
+	m_pPool			= pPool;
+	ZeroMemory( m_nPending, sizeof(m_nPending) );
+	m_nRequested	= 0;
+	m_nLoaded		= 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CAssetLoader () (Destructor)
+// Desc : CAssetLoader Class Destructor
+//-----------------------------------------------------------------------------
+CAssetLoader::~CAssetLoader()
+{
+#ifdef _WIN32
+	// Release the cached originals, sprites only ever got copies.
+	std::map<std::string, std::shared_future<HBITMAP> >::iterator it;
+	for ( it = m_Bitmaps.begin(); it != m_Bitmaps.end(); ++it )
+	{
+		HBITMAP hBmp = it->second.get();
+		if ( hBmp ) DeleteObject( hBmp );
+	}
+#endif
+}
+
+#ifdef _WIN32
+
+//-----------------------------------------------------------------------------
+// Name : RequestBitmap ()
+// Desc : Queues the decoding of a bitmap file. Requesting the same file twice
+//		returns the future of the first request.
+//-----------------------------------------------------------------------------
+std::shared_future<HBITMAP> CAssetLoader::RequestBitmap( const char *szFileName, EAssetPriority ePriority )
+{
+	std::string key = MakeKey( szFileName );
+	std::shared_ptr< std::promise<HBITMAP> > promise = std::make_shared< std::promise<HBITMAP> >();
+	std::shared_future<HBITMAP> result = promise->get_future().share();
+
+	{
+		std::lock_guard<std::mutex> lock( m_Lock );
+
+		std::map<std::string, std::shared_future<HBITMAP> >::iterator it = m_Bitmaps.find( key );
+		if ( it != m_Bitmaps.end() ) return it->second;
+
+		m_Bitmaps[key] = result;
+		m_nPending[ePriority]++;
+		m_nRequested++;
+	}
+
+	// Queued outside the lock, the task may run inline if the pool is idle
+	std::string file = szFileName;
+	m_pPool->Submit( ePriority, [this, file, ePriority, promise]()
+	{
+		HBITMAP hBmp = (HBITMAP)LoadImage( g_hInst, file.c_str(), IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE );
+		Complete( ePriority );
+		promise->set_value( hBmp );
+	});
+
+	return result;
+}
+#endif // _WIN32
+
+//-----------------------------------------------------------------------------
+// Name : RequestImage ()
+// Desc : Queues a full CImageFile load (decode and conversion to 32 bit).
+//		The image must not be touched until the future is ready.
+//-----------------------------------------------------------------------------
+std::shared_future<bool> CAssetLoader::RequestImage( CImageFile *pImage, const char *szFileName, EAssetPriority ePriority )
+{
+	{
+		std::lock_guard<std::mutex> lock( m_Lock );
+		m_nPending[ePriority]++;
+		m_nRequested++;
+	}
+
+	std::string file = szFileName;
+	return m_pPool->Submit( ePriority, [this, pImage, file, ePriority]()
+	{
+		// A NULL DC gives us a memory DC compatible with the screen, which
+		// is all the loader needs and is safe to create on any thread.
+		bool bResult = pImage->LoadBitmapFromFile( file.c_str(), NULL );
+		Complete( ePriority );
+		return bResult;
+	});
+}
+
+#ifdef _WIN32
+
+//-----------------------------------------------------------------------------
+// Name : AcquireBitmap ()
+// Desc : Hands out a copy of the decoded bitmap so every sprite can delete
+//		its own handle, exactly as it did when loading straight from disk.
+//-----------------------------------------------------------------------------
+HBITMAP CAssetLoader::AcquireBitmap( const char *szFileName )
+{
+	std::shared_future<HBITMAP> bitmap;
+	{
+		std::lock_guard<std::mutex> lock( m_Lock );
+		std::map<std::string, std::shared_future<HBITMAP> >::iterator it = m_Bitmaps.find( MakeKey( szFileName ) );
+		if ( it != m_Bitmaps.end() ) bitmap = it->second;
+	}
+
+	if ( !bitmap.valid() )
+		return (HBITMAP)LoadImage( g_hInst, szFileName, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE );
+
+	HBITMAP hBmp = bitmap.get();
+	if ( !hBmp ) return 0;
+
+	return (HBITMAP)CopyImage( hBmp, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION );
+}
+#endif // _WIN32
+
+//-----------------------------------------------------------------------------
+// Name : IsLoaded ()
+// Desc : True once every request of the given priority, and of all the more
+//		urgent ones, has finished.
+//-----------------------------------------------------------------------------
+bool CAssetLoader::IsLoaded( EAssetPriority ePriority ) const
+{
+	std::lock_guard<std::mutex> lock( m_Lock );
+	for ( int i = AP_CRITICAL; i <= ePriority; i++ )
+		if ( m_nPending[i] ) return false;
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : MakeKey () (Private)
+// Desc : The data files are referenced with mixed case throughout the game,
+//		so the cache is keyed on the lower case name.
+//-----------------------------------------------------------------------------
+std::string CAssetLoader::MakeKey( const char *szFileName ) const
+{
+	std::string key = szFileName;
+	for ( size_t i = 0; i < key.size(); i++ )
+	{
+		key[i] = (char)tolower( (unsigned char)key[i] );
+		if ( key[i] == '\\' ) key[i] = '/';
+	}
+	return key;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Complete () (Private)
+// Desc : Called from the workers once a request has been decoded.
+//-----------------------------------------------------------------------------
+void CAssetLoader::Complete( EAssetPriority ePriority )
+{
+	std::lock_guard<std::mutex> lock( m_Lock );
+	m_nPending[ePriority]--;
+	m_nLoaded++;
+}
@@ -21,10 +21,22 @@ BackBuffer::BackBuffer(HWND hWnd, int width, int height)
 	// with the window one.
 	mhDC = CreateCompatibleDC(hWndDC);
 
-	// Create the backbuffer surface bitmap that is compatible
-	// with the window device context bitmap format. That is
-	// the surface we will render onto.
-	mhSurface = CreateCompatibleBitmap(hWndDC, width, height);
+	// Create the backbuffer surface bitmap. That is the surface
+	// we will render onto. We use a 32 bit top-down DIB section
+	// rather than a device compatible bitmap so that the pixels
+	// can also be read and written directly, e.g. for full screen
+	// post processing effects.
+	BITMAPINFO bmi;
+	ZeroMemory(&bmi, sizeof(BITMAPINFO));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = width;
+	bmi.bmiHeader.biHeight = -height;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
+	mpBits = NULL;
+	mhSurface = CreateDIBSection(hWndDC, &bmi, DIB_RGB_COLORS, (void**)&mpBits, NULL, 0);
 
 	// Done with window DC.
 	ReleaseDC(hWnd, hWndDC);
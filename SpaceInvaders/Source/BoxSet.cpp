@@ -0,0 +1,348 @@
+//-----------------------------------------------------------------------------
+// File: BoxSet.cpp
+//
+// Desc: Integer collision boxes kept side by side, tested against a query
+//	   box several at a time.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CBoxSet Specific Includes
+//-----------------------------------------------------------------------------
+#include "BoxSet.h"
+#include <limits.h>
+#include <math.h>
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Name : CBoxSet () (Constructor)
+// Desc : CBoxSet Class Constructor
+//-----------------------------------------------------------------------------
+CBoxSet::CBoxSet()
+{
+	m_nCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CBoxSet () (Destructor)
+// Desc : CBoxSet Class Destructor
+//-----------------------------------------------------------------------------
+CBoxSet::~CBoxSet()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : Empty () (Static)
+// Desc : A box nothing overlaps.
+//-----------------------------------------------------------------------------
+SBox CBoxSet::Empty()
+{
+	SBox Box;
+	Box.Left	= INT_MAX;
+	Box.Top		= INT_MAX;
+	Box.Right	= INT_MIN;
+	Box.Bottom	= INT_MIN;
+	return Box;
+}
+
+//-----------------------------------------------------------------------------
+// Name : MakeBox () (Static)
+// Desc : The box of a sprite centred on Centre, rounded as the RECT test
+//		did: half sizes in whole pixels, edges truncated towards zero.
+//-----------------------------------------------------------------------------
+SBox CBoxSet::MakeBox( const Vec2& Centre, int iWidth, int iHeight )
+{
+	SBox Box;
+	Box.Left	= (int32_t)(Centre.x - iWidth / 2);
+	Box.Right	= (int32_t)(Centre.x + iWidth / 2);
+	Box.Top		= (int32_t)(Centre.y - iHeight / 2);
+	Box.Bottom	= (int32_t)(Centre.y + iHeight / 2);
+	return Box;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Resize ()
+// Desc : Sets the number of boxes. Boxes that were not there before start
+//		out empty.
+//-----------------------------------------------------------------------------
+void CBoxSet::Resize( size_t nCount )
+{
+	size_t nSlots = (nCount + 7) & ~(size_t)7;
+	size_t nFirstNew = nCount < m_nCount ? nCount : m_nCount;
+
+	m_Left.resize( nSlots );
+	m_Top.resize( nSlots );
+	m_Right.resize( nSlots );
+	m_Bottom.resize( nSlots );
+
+	m_nCount = nCount;
+	for ( size_t i = nFirstNew; i < nSlots; i++ ) Set( i, Empty() );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Set / Get ()
+//-----------------------------------------------------------------------------
+void CBoxSet::Set( size_t i, const SBox& Box )
+{
+	m_Left[i]	= Box.Left;
+	m_Top[i]	= Box.Top;
+	m_Right[i]	= Box.Right;
+	m_Bottom[i]	= Box.Bottom;
+}
+
+SBox CBoxSet::Get( size_t i ) const
+{
+	SBox Box;
+	Box.Left	= m_Left[i];
+	Box.Top		= m_Top[i];
+	Box.Right	= m_Right[i];
+	Box.Bottom	= m_Bottom[i];
+	return Box;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetCentred ()
+// Desc : Sets nCount boxes from iFirst on, all iWidth x iHeight, centred on
+//		the given float positions; a 0 in pLive, if given, makes that box
+//		empty. A NULL pY moves only the left and right edges, for objects
+//		that went sideways. Same rounding as MakeBox: the SSE2 path widens
+//		to double before adding the half size, as MakeBox does.
+//-----------------------------------------------------------------------------
+void CBoxSet::SetCentred( size_t iFirst, const float *pX, const float *pY, const uint32_t *pLive,
+						  size_t nCount, int iWidth, int iHeight )
+{
+	size_t i = 0;
+
+#ifdef USE_SSE2
+	const __m128i Max = _mm_set1_epi32( INT_MAX ), Min = _mm_set1_epi32( INT_MIN );
+	const __m128i All = _mm_set1_epi32( -1 );
+
+	auto Edges = [&]( const float *p, int iSize, int32_t *pLow, int32_t *pHigh, const __m128i& Live )
+	{
+		const __m128d Half = _mm_set1_pd( iSize / 2 );
+		__m128 v = _mm_loadu_ps( p );
+		__m128d v0 = _mm_cvtps_pd( v ), v1 = _mm_cvtps_pd( _mm_movehl_ps( v, v ) );
+
+		__m128i Low	 = _mm_unpacklo_epi64( _mm_cvttpd_epi32( _mm_sub_pd( v0, Half ) ), _mm_cvttpd_epi32( _mm_sub_pd( v1, Half ) ) );
+		__m128i High = _mm_unpacklo_epi64( _mm_cvttpd_epi32( _mm_add_pd( v0, Half ) ), _mm_cvttpd_epi32( _mm_add_pd( v1, Half ) ) );
+		_mm_storeu_si128( (__m128i*)pLow, _mm_or_si128( _mm_and_si128( Live, Low ), _mm_andnot_si128( Live, Max ) ) );
+		_mm_storeu_si128( (__m128i*)pHigh, _mm_or_si128( _mm_and_si128( Live, High ), _mm_andnot_si128( Live, Min ) ) );
+	};
+
+	for ( ; i + 4 <= nCount; i += 4 )
+	{
+		__m128i Live = pLive ? _mm_loadu_si128( (const __m128i*)(pLive + i) ) : All;
+		size_t j = iFirst + i;
+
+		Edges( pX + i, iWidth, &m_Left[j], &m_Right[j], Live );
+		if ( pY ) Edges( pY + i, iHeight, &m_Top[j], &m_Bottom[j], Live );
+	}
+#endif
+
+	for ( ; i < nCount; i++ )
+	{
+		SBox Box = Empty();
+		if ( !pLive || pLive[i] ) Box = MakeBox( Vec2( pX[i], pY ? pY[i] : 0.0f ), iWidth, iHeight );
+
+		m_Left[iFirst + i]	= Box.Left;
+		m_Right[iFirst + i]	= Box.Right;
+		if ( !pY ) continue;
+		m_Top[iFirst + i]	 = Box.Top;
+		m_Bottom[iFirst + i] = Box.Bottom;
+	}
+}
+
+#ifdef USE_SSE2
+//-----------------------------------------------------------------------------
+// Name : LowestBit () (Static)
+// Desc : Index of the lowest set bit, n must not be 0.
+//-----------------------------------------------------------------------------
+static inline int LowestBit( uint32_t n )
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward( &i, n );
+	return (int)i;
+#else
+	return __builtin_ctz( n );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : Hit4 () (Static)
+// Desc : Overlap of the query with four boxes, all ones in a hit lane.
+//-----------------------------------------------------------------------------
+static inline __m128i Hit4( const __m128i& Left, const __m128i& Top, const __m128i& Right, const __m128i& Bottom,
+							const int32_t *pLeft, const int32_t *pTop, const int32_t *pRight, const int32_t *pBottom )
+{
+	__m128i x = _mm_and_si128( _mm_cmpgt_epi32( Right, _mm_loadu_si128( (const __m128i*)pLeft ) ),
+							   _mm_cmpgt_epi32( _mm_loadu_si128( (const __m128i*)pRight ), Left ) );
+	__m128i y = _mm_and_si128( _mm_cmpgt_epi32( Bottom, _mm_loadu_si128( (const __m128i*)pTop ) ),
+							   _mm_cmpgt_epi32( _mm_loadu_si128( (const __m128i*)pBottom ), Top ) );
+	return _mm_and_si128( x, y );
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// Name : Overlaps ()
+// Desc : Sets bit i of pHits, GetWords() words, for every box i the query
+//		overlaps and clears the others. Returns the number of hits.
+//-----------------------------------------------------------------------------
+size_t CBoxSet::Overlaps( const SBox& Query, uint32_t *pHits ) const
+{
+#ifdef USE_SSE2
+	const __m128i Left = _mm_set1_epi32( Query.Left ), Top = _mm_set1_epi32( Query.Top );
+	const __m128i Right = _mm_set1_epi32( Query.Right ), Bottom = _mm_set1_epi32( Query.Bottom );
+	__m128i Count = _mm_setzero_si128();
+	size_t nSlots = m_Left.size();
+
+	for ( size_t i = 0; i < nSlots; i += 8 )
+	{
+		__m128i h0 = Hit4( Left, Top, Right, Bottom, &m_Left[i], &m_Top[i], &m_Right[i], &m_Bottom[i] );
+		__m128i h1 = Hit4( Left, Top, Right, Bottom, &m_Left[i + 4], &m_Top[i + 4], &m_Right[i + 4], &m_Bottom[i + 4] );
+
+		// A hit lane is -1, so subtracting counts it
+		Count = _mm_sub_epi32( _mm_sub_epi32( Count, h0 ), h1 );
+
+		uint32_t nBits = (uint32_t)(_mm_movemask_ps( _mm_castsi128_ps( h0 ) ) | (_mm_movemask_ps( _mm_castsi128_ps( h1 ) ) << 4));
+		if ( !(i & 31) ) pHits[i >> 5] = 0;
+		pHits[i >> 5] |= nBits << (i & 31);
+	}
+
+	Count = _mm_add_epi32( Count, _mm_shuffle_epi32( Count, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	Count = _mm_add_epi32( Count, _mm_shuffle_epi32( Count, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return (size_t)_mm_cvtsi128_si32( Count );
+#else
+	return OverlapsScalar( Query, pHits );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : Overlaps ()
+// Desc : The same for a batch of queries; the hits of query q start at
+//		pHits + q * GetWords(). Returns the number of hits of all of them.
+//-----------------------------------------------------------------------------
+size_t CBoxSet::Overlaps( const SBox *pQueries, size_t nQueries, uint32_t *pHits ) const
+{
+	size_t nHits = 0, nWords = GetWords();
+	for ( size_t q = 0; q < nQueries; q++ ) nHits += Overlaps( pQueries[q], pHits + q * nWords );
+	return nHits;
+}
+
+//-----------------------------------------------------------------------------
+// Name : OverlapsScalar ()
+// Desc : Overlaps one box at a time; the plain C path, and the reference
+//		the SSE2 path is checked against.
+//-----------------------------------------------------------------------------
+size_t CBoxSet::OverlapsScalar( const SBox& Query, uint32_t *pHits ) const
+{
+	size_t nHits = 0;
+
+	for ( size_t w = 0; w < GetWords(); w++ ) pHits[w] = 0;
+	for ( size_t i = 0; i < m_nCount; i++ )
+	{
+		if ( !Overlap( Query, Get( i ) ) ) continue;
+		pHits[i >> 5] |= 1u << (i & 31);
+		nHits++;
+	}
+
+	return nHits;
+}
+
+//-----------------------------------------------------------------------------
+// Name : FirstOverlap ()
+// Desc : Lowest index from iStart on of a box the query overlaps, -1 if
+//		there is none.
+//-----------------------------------------------------------------------------
+int CBoxSet::FirstOverlap( const SBox& Query, size_t iStart ) const
+{
+#ifdef USE_SSE2
+	const __m128i Left = _mm_set1_epi32( Query.Left ), Top = _mm_set1_epi32( Query.Top );
+	const __m128i Right = _mm_set1_epi32( Query.Right ), Bottom = _mm_set1_epi32( Query.Bottom );
+	size_t nSlots = m_Left.size();
+
+	for ( size_t i = iStart & ~(size_t)7; i < nSlots; i += 8 )
+	{
+		__m128i h0 = Hit4( Left, Top, Right, Bottom, &m_Left[i], &m_Top[i], &m_Right[i], &m_Bottom[i] );
+		__m128i h1 = Hit4( Left, Top, Right, Bottom, &m_Left[i + 4], &m_Top[i + 4], &m_Right[i + 4], &m_Bottom[i + 4] );
+
+		uint32_t nBits = (uint32_t)(_mm_movemask_ps( _mm_castsi128_ps( h0 ) ) | (_mm_movemask_ps( _mm_castsi128_ps( h1 ) ) << 4));
+		if ( i < iStart ) nBits &= ~0u << (iStart - i);
+		if ( nBits ) return (int)i + LowestBit( nBits );
+	}
+#else
+	for ( size_t i = iStart; i < m_nCount; i++ )
+		if ( Overlap( Query, Get( i ) ) ) return (int)i;
+#endif
+
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SweepAxis () (Static)
+// Desc : Narrows [fEnter, fExit] to the times the span a0..a1, moving by d,
+//		overlaps b0..b1 on one axis. False once nothing is left.
+//-----------------------------------------------------------------------------
+static bool SweepAxis( int32_t a0, int32_t a1, float d, int32_t b0, int32_t b1, float& fEnter, float& fExit )
+{
+	if ( d == 0.0f ) return a1 > b0 && a0 < b1;
+
+	// Overlap from when a1 passes b0 until a0 passes b1, or the other way
+	float t0 = ((float)b0 - (float)a1) / d, t1 = ((float)b1 - (float)a0) / d;
+	if ( d < 0.0f ) { float t = t0; t0 = t1; t1 = t; }
+
+	if ( t0 > fEnter ) fEnter = t0;
+	if ( t1 < fExit ) fExit = t1;
+	return fEnter < fExit;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Sweep () (Static)
+// Desc : Whether Box, moving by (dx, dy) over the tick, touches Target on
+//		the way, and if so the fraction of the tick, 0 to 1, at which it
+//		first does; 0 if they already overlap. The box is a ray against
+//		Target grown by the box, one slab per axis.
+//-----------------------------------------------------------------------------
+bool CBoxSet::Sweep( const SBox& Box, float dx, float dy, const SBox& Target, float& fTime )
+{
+	if ( Target.Left > Target.Right ) return false;
+
+	float fEnter = 0.0f, fExit = 1.0f;
+	if ( !SweepAxis( Box.Left, Box.Right, dx, Target.Left, Target.Right, fEnter, fExit ) ) return false;
+	if ( !SweepAxis( Box.Top, Box.Bottom, dy, Target.Top, Target.Bottom, fEnter, fExit ) ) return false;
+
+	fTime = fEnter;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : FirstSweep ()
+// Desc : The box Box, moving by (dx, dy), touches first, with the time it
+//		does; the lower index on a tie. -1 if it touches none.
+//-----------------------------------------------------------------------------
+int CBoxSet::FirstSweep( const SBox& Box, float dx, float dy, float& fTime ) const
+{
+	// Whatever it touches overlaps the box round its whole path
+	SBox Path = Box;
+	Path.Left	+= (int32_t)floorf( dx < 0.0f ? dx : 0.0f );
+	Path.Right	+= (int32_t)ceilf( dx > 0.0f ? dx : 0.0f );
+	Path.Top	+= (int32_t)floorf( dy < 0.0f ? dy : 0.0f );
+	Path.Bottom	+= (int32_t)ceilf( dy > 0.0f ? dy : 0.0f );
+
+	int iFirst = -1;
+	for ( int i = FirstOverlap( Path ); i >= 0; i = FirstOverlap( Path, i + 1 ) )
+	{
+		float t;
+		if ( Sweep( Box, dx, dy, Get( i ), t ) && (iFirst < 0 || t < fTime) )
+		{
+			iFirst = i;
+			fTime = t;
+		}
+	}
+
+	return iFirst;
+}
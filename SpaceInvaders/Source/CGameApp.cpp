@@ -10,12 +10,12 @@
 // CGameApp Specific Includes
 //-----------------------------------------------------------------------------
 #include "CGameApp.h"
-#include<fstream>
-#include "CPlayer.h"
 
 using namespace std;
 
 extern HINSTANCE g_hInst;
+extern CWorkerPool g_Workers;
+extern CAssetLoader g_Assets;
 
 //-----------------------------------------------------------------------------
 // CGameApp Member Functions
@@ -34,12 +34,48 @@ CGameApp::CGameApp()
 	m_pPlayer		= NULL;
 	Player1         = NULL;
 	m_pEnemy        = NULL;
-	m_pEnemy2       = NULL;
-	m_pEnemy3       = NULL;
 	star1           = NULL;
 	star2           = NULL;
 	star3           = NULL;
+	m_pBullet       = NULL;
 	m_LastFrameRate = 0;
+	m_bLoading      = true;
+	m_fStartTime    = 0.0;
+	m_fFirstFrameTime = 0.0;
+	m_fLoadedTime   = 0.0;
+	m_fDrawTime     = 0.0;
+	m_fSimCost      = 0.0;
+	m_bSimRunning   = false;
+	m_fPendingBloom = 0.0f;
+	m_fPendingFlash = 0.0f;
+	m_bLowLatency   = false;
+	m_fLastFrameTime = 0.0;
+	m_fFrameAge     = 0.0;
+	m_fPresentTime  = 0.0;
+	m_bShowTiming   = false;
+	m_szStatus      = NULL;
+	m_fStatusTime   = 0.0;
+	m_eSave         = SAVE_IDLE;
+	m_fFrameAverage = 0.0;
+	m_fFrameJitter  = 0.0;
+
+	// Arrows and B for the first player, WASD and V for the second
+	m_Input.Bind( 0, CInput::CONTROL_FORWARD, VK_UP );
+	m_Input.Bind( 0, CInput::CONTROL_BACKWARD, VK_DOWN );
+	m_Input.Bind( 0, CInput::CONTROL_LEFT, VK_LEFT );
+	m_Input.Bind( 0, CInput::CONTROL_RIGHT, VK_RIGHT );
+	m_Input.Bind( 0, CInput::CONTROL_FIRE, 'B' );
+	m_Input.Bind( 0, CInput::CONTROL_ROTATE, 'O' );
+	m_Input.Bind( 0, CInput::CONTROL_SELF_DESTRUCT, VK_RETURN );
+	m_Input.Bind( 1, CInput::CONTROL_FORWARD, 'W' );
+	m_Input.Bind( 1, CInput::CONTROL_BACKWARD, 'S' );
+	m_Input.Bind( 1, CInput::CONTROL_LEFT, 'A' );
+	m_Input.Bind( 1, CInput::CONTROL_RIGHT, 'D' );
+	m_Input.Bind( 1, CInput::CONTROL_FIRE, 'V' );
+	m_Input.Bind( 1, CInput::CONTROL_ROTATE, 'R' );
+	m_Input.Bind( 1, CInput::CONTROL_SELF_DESTRUCT, 'Q' );
+
+	m_World.SetPlatform( this );
 }
 
 //-----------------------------------------------------------------------------
@@ -69,8 +105,8 @@ bool CGameApp::InitInstance( LPCTSTR lpCmdLine, int iCmdShow )
 		return false; 
 	}
 
-	// Set up all required game states
-	SetupGameState();
+	// Game objects and states are set up by FrameAdvance once the
+	// critical assets have arrived, see BuildGameObjects.
 
 	// Success!
 	return true;
@@ -210,8 +246,6 @@ LRESULT CALLBACK CGameApp::StaticWndProc(HWND hWnd, UINT Message, WPARAM wParam,
 //-----------------------------------------------------------------------------
 LRESULT CGameApp::DisplayWndProc( HWND hWnd, UINT Message, WPARAM wParam, LPARAM lParam )
 {
-	static UINT			fTimer;	
-
 	// Determine message type
 	switch (Message)
 	{
@@ -258,38 +292,46 @@ LRESULT CGameApp::DisplayWndProc( HWND hWnd, UINT Message, WPARAM wParam, LPARAM
 			ReleaseCapture( );
 			break;
 
+		case WM_KEYUP:
+			if ( !m_bLoading && wParam < 256 ) m_Input.Post( (uint8_t)wParam, CInput::EVENT_UP, CTimer::GetAbsoluteTime() );
+			break;
+
+		case WM_KILLFOCUS:
+			// The key ups go to whichever window has the focus now
+			m_Input.Post( 0, CInput::EVENT_RELEASE_ALL, CTimer::GetAbsoluteTime() );
+			break;
+
 		case WM_KEYDOWN:
+			// Nothing to control while the assets are still loading
+			if ( m_bLoading && wParam != VK_ESCAPE ) break;
+
+			// Stamp game keys as they arrive, the ticks they fall in pick
+			// them up. Auto repeats carry no news.
+			if ( wParam < 256 && !(lParam & 0x40000000) )
+				m_Input.Post( (uint8_t)wParam, CInput::EVENT_DOWN, CTimer::GetAbsoluteTime() );
+
 			switch(wParam)
 			{
 			case VK_ESCAPE:
 				PostQuitMessage(0);
 				break;
 
-			case VK_RETURN:
-				fTimer = SetTimer(m_hWnd, 1, 250, NULL);
-
-					m_pPlayer->Explode();
-					m_pPlayer->DecreaseLives();
-
-				break;
-			case 0x51:
-				fTimer = SetTimer(m_hWnd, 2, 250, NULL);
-		
-					Player1->Explode();
-					Player1->DecreaseLives();
-
-				break;
 			case 'S':
-				SaveGame(m_pPlayer, Player1);
+				SaveGame();
 				break;
 			case 'L':
-				LoadGame(m_pPlayer, Player1);
+				LoadGame();
+				break;
+			case 'P':
+				m_PostProcess.SetEnabled(!m_PostProcess.IsEnabled());
 				break;
-			case 'O':
-				m_pPlayer->RotateLeft();
+			case 'I':
+				m_bShowTiming = !m_bShowTiming;
+				m_LastFrameRate = 0;
 				break;
-			case 'R':
-				Player1->RotateLeft();
+			case VK_F2:
+				SetLowLatency(!m_bLowLatency);
+				m_LastFrameRate = 0;
 				break;
 
 			}
@@ -297,66 +339,6 @@ LRESULT CGameApp::DisplayWndProc( HWND hWnd, UINT Message, WPARAM wParam, LPARAM
 			break;
 
 
-		case WM_TIMER:
-			switch(wParam)
-			{
-			case 1:
-				if(!m_pPlayer->AdvanceExplosion())
-					fTimer = SetTimer(m_hWnd, 1, 100, NULL);
-				
-				if( !Player1->AdvanceExplosion())
-				{
-					fTimer = SetTimer(m_hWnd, 1, 100, NULL);
-				}
-
-				if (!m_pEnemy->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-
-				if (!m_pEnemy2->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-
-				if (!m_pEnemy3->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-				if (!m_pPlayer->AdvanceExplosion() && !Player1->AdvanceExplosion())
-				{
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-				if (!m_pPlayer->AdvanceExplosion() && !m_pEnemy->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-				if (!m_pPlayer->AdvanceExplosion() && !m_pEnemy2->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-				if (!m_pPlayer->AdvanceExplosion() && !m_pEnemy3->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-				if (!Player1->AdvanceExplosion() && !m_pEnemy->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-				if (!Player1->AdvanceExplosion() && !m_pEnemy2->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-				if (!Player1->AdvanceExplosion() && !m_pEnemy3->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-				if (!m_pPlayer->AdvanceExplosion() && !Player1->AdvanceExplosion() && !m_pEnemy->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-				if (!m_pPlayer->AdvanceExplosion() && !Player1->AdvanceExplosion() && !m_pEnemy2->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-				if (!m_pPlayer->AdvanceExplosion() && !Player1->AdvanceExplosion() && !m_pEnemy3->AdvanceExplosion()) {
-					fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-				}
-
-
-			}
-
-			break;
-
 		case WM_COMMAND:
 			break;
 
@@ -371,45 +353,124 @@ LRESULT CGameApp::DisplayWndProc( HWND hWnd, UINT Message, WPARAM wParam, LPARAM
 
 //-----------------------------------------------------------------------------
 // Name : BuildObjects ()
-// Desc : Build our demonstration meshes, and the objects that instance them
+// Desc : Creates the back buffer and queues every asset the game needs on the
+//		loader. The game objects themselves are built later by
+//		BuildGameObjects, once the critical sprites have been decoded.
 //-----------------------------------------------------------------------------
 bool CGameApp::BuildObjects()
 {
 	m_pBBuffer = new BackBuffer(m_hWnd, m_nViewWidth, m_nViewHeight);
+
+	m_fStartTime = CTimer::GetAbsoluteTime();
+
+	// From here on loads and post processing bands run on the workers
+	g_Workers.Start();
+	m_PostProcess.SetPool(&g_Workers);
+
+	// Everything CPlayer needs to be constructed comes first
+	g_Assets.RequestBitmap("data/planeimgandmask.bmp", CAssetLoader::AP_CRITICAL);
+	g_Assets.RequestBitmap("data/PlaneImgAndMaskLeft.bmp", CAssetLoader::AP_CRITICAL);
+	g_Assets.RequestBitmap("data/PlaneImgAndMaskRight.bmp", CAssetLoader::AP_CRITICAL);
+	g_Assets.RequestBitmap("data/planeimgandmaskk.bmp", CAssetLoader::AP_CRITICAL);
+	g_Assets.RequestBitmap("data/enemymask.bmp", CAssetLoader::AP_CRITICAL);
+	g_Assets.RequestBitmap("data/starmask.bmp", CAssetLoader::AP_CRITICAL);
+	g_Assets.RequestBitmap("data/explosion.bmp", CAssetLoader::AP_CRITICAL);
+	g_Assets.RequestBitmap("data/explosionmask.bmp", CAssetLoader::AP_CRITICAL);
+
+	// Needed as soon as somebody fires
+	g_Assets.RequestBitmap("data/upBullet.bmp", CAssetLoader::AP_GAMEPLAY);
+	g_Assets.RequestBitmap("data/upBulletMask.bmp", CAssetLoader::AP_GAMEPLAY);
+
+	// Scenery can trickle in
+	m_BackgroundLoaded = g_Assets.RequestImage(&m_imgBackground, "data/background.bmp", CAssetLoader::AP_BACKGROUND);
+
+	// Success!
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : BuildGameObjects ()
+// Desc : Builds the players, enemies and stars from the preloaded sprites.
+//-----------------------------------------------------------------------------
+bool CGameApp::BuildGameObjects()
+{
 	m_pPlayer = new CPlayer(m_pBBuffer,1);
 	Player1= new CPlayer(m_pBBuffer,1);
 	m_pEnemy = new CPlayer(m_pBBuffer,2);
-	m_pEnemy2 = new CPlayer(m_pBBuffer,2);
-	m_pEnemy3 = new CPlayer(m_pBBuffer,2);
 	star1 = new CPlayer(m_pBBuffer, 3);
 	star2 = new CPlayer(m_pBBuffer, 3);
 	star3 = new CPlayer(m_pBBuffer, 3);
+	m_pBullet = new Bullet(m_pBBuffer);
 
-	m_pBullet = {};
+	// Collide with the sizes of what is actually drawn
+	m_World.SetSpriteSize(CGameWorld::KIND_PLAYER, m_pPlayer->getWidth(), m_pPlayer->getHeight());
+	m_World.SetSpriteSize(CGameWorld::KIND_ENEMY, m_pEnemy->getWidth(), m_pEnemy->getHeight());
+	m_World.SetSpriteSize(CGameWorld::KIND_STAR, star1->getWidth(), star1->getHeight());
+	m_World.SetSpriteSize(CGameWorld::KIND_BULLET, m_pBullet->getWidth(), m_pBullet->getHeight());
 
-	if(!m_imgBackground.LoadBitmapFromFile("data/background.bmp", GetDC(m_hWnd)))
-		return false;
+	// The flow field is rebuilt on its own thread between ticks
+	m_World.SetThreaded(true);
+
+	// Without the levels the game plays its built in wave
+	if ( m_Levels.Load( LEVEL_FILE, LEVEL_CACHE_FILE, CGameWorld::DefaultLevel() ) )
+	{
+		m_World.SetLevels( &m_Levels );
+	}
+	else
+	{
+		TCHAR szMessage[128];
+		sprintf_s( szMessage, _T("Can't load %s, error on line %d\n"), LEVEL_FILE, m_Levels.GetErrorLine() );
+		OutputDebugString( szMessage );
+	}
 
 	// Success!
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Name : DrawLoadingScreen ()
+// Desc : Draws a simple progress bar while the loader is busy.
+//-----------------------------------------------------------------------------
+void CGameApp::DrawLoadingScreen()
+{
+	HDC		hDC = m_pBBuffer->getDC();
+	RECT	rc;
+	TCHAR	Text[ 64 ];
+	UINT	nTotal = g_Assets.GetRequestCount();
+	UINT	nLoaded = g_Assets.GetLoadedCount();
+	int		nBarWidth = m_nViewWidth / 2;
+
+	m_pBBuffer->reset();
+
+	// Bar outline and fill
+	rc.left   = (m_nViewWidth - nBarWidth) / 2;
+	rc.right  = rc.left + nBarWidth;
+	rc.top    = m_nViewHeight / 2 - 10;
+	rc.bottom = m_nViewHeight / 2 + 10;
+	FillRect(hDC, &rc, (HBRUSH)GetStockObject(BLACK_BRUSH));
+
+	if (nTotal) rc.right = rc.left + nBarWidth * nLoaded / nTotal;
+	HBRUSH hFill = CreateSolidBrush(RGB(0x40, 0xa0, 0x40));
+	FillRect(hDC, &rc, hFill);
+	DeleteObject(hFill);
+
+	sprintf_s(Text, _T("Loading %u / %u"), nLoaded, nTotal);
+	SetBkMode(hDC, TRANSPARENT);
+	TextOut(hDC, (m_nViewWidth - nBarWidth) / 2, m_nViewHeight / 2 - 30, Text, (int)_tcslen(Text));
+
+	m_pBBuffer->present();
+}
+
 //-----------------------------------------------------------------------------
 // Name : SetupGameState ()
 // Desc : Sets up all the initial states required by the game.
 //-----------------------------------------------------------------------------
 void CGameApp::SetupGameState()
 {
-	m_pPlayer->Position() = Vec2(100, 400);
-	Player1->Position() = Vec2(300, 400);
-
-	m_pEnemy->Position() = Vec2(100, 100);
-	m_pEnemy2->Position() = Vec2(150, 150);
-	m_pEnemy3->Position() = Vec2(200, 200);
+	unsigned int nSeed = GetTickCount();
 
-	star1->Position() = Vec2(200, 350);
-	star2->Position() = Vec2(250, 450);
-	star3->Position() = Vec2(150, 500);
+	m_World.Reset( nSeed );
+	m_Recorder.Begin( nSeed, m_World );
 }
 
 //-----------------------------------------------------------------------------
@@ -419,6 +480,15 @@ void CGameApp::SetupGameState()
 //-----------------------------------------------------------------------------
 void CGameApp::ReleaseObjects( )
 {
+	// Nothing may tick the world while it is torn down
+	StopSimulation();
+	SaveReplay();
+	if ( m_SaveTask.valid() ) m_SaveTask.wait();
+
+	// Finish the queued loads while g_Assets and the images they fill are
+	// still alive; the pool would otherwise drain them from its destructor
+	g_Workers.Stop();
+
 	if(m_pPlayer != NULL)
 	{
 		delete m_pPlayer;
@@ -442,16 +512,13 @@ void CGameApp::ReleaseObjects( )
 		delete m_pEnemy;
 		m_pEnemy = NULL;
 	}
-	if (m_pEnemy2 != NULL)
-	{
-		delete m_pEnemy2;
-		m_pEnemy2 = NULL;
-	}
-	if (m_pEnemy3 != NULL)
-	{
-		delete m_pEnemy3;
-		m_pEnemy3 = NULL;
-	}
+
+	delete star1;
+	delete star2;
+	delete star3;
+	delete m_pBullet;
+	star1 = star2 = star3 = NULL;
+	m_pBullet = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -468,224 +535,280 @@ void CGameApp::FrameAdvance()
 
 	// Skip if app is inactive
 	if ( !m_bActive ) return;
-	
-	// Get / Display the framerate
-	if ( m_LastFrameRate != m_Timer.GetFrameRate() )
-	{
-		m_LastFrameRate = m_Timer.GetFrameRate( FrameRate, 50 );
-		sprintf_s( TitleBuffer, _T("Game : %s  Lives: % d - % d    Score : % d - % d"), FrameRate, m_pPlayer->GetLives(), Player1->GetLives(), m_pPlayer->GetScore(), Player1->GetScore() );
-		SetWindowText( m_hWnd, TitleBuffer );
 
-	} // End if Frame Rate Altered
-
-	if (!m_pPlayer->GetLives() || !Player1->GetLives()) {
-		if (m_pPlayer->GetScore() > Player1->GetScore())
-		{
-			MessageBox(m_hWnd, "First Player Wins", "Game over", MB_OK);
-			PostQuitMessage(0);
-		}
-		else if (m_pPlayer->GetScore() < Player1->GetScore())
-		{
-			MessageBox(m_hWnd, "Second Player Wins", "Game over", MB_OK);
-			PostQuitMessage(0);
-		}
-		else
+	// Keep the window alive with a loading screen until the sprites the
+	// game objects are built from are decoded.
+	if ( m_bLoading )
+	{
+		if ( !g_Assets.IsLoaded( CAssetLoader::AP_CRITICAL ) )
 		{
-			MessageBox(m_hWnd, "Tie", "Game over", MB_OK);
-			PostQuitMessage(0);
+			DrawLoadingScreen();
+			return;
 		}
-	}
 
-	// Poll & Process input devices
-	ProcessInput();
+		BuildGameObjects();
+		SetupGameState();
+		m_bLoading = false;
+		m_fFirstFrameTime = CTimer::GetAbsoluteTime() - m_fStartTime;
 
-	// Animate the game objects
-	AnimateObjects();
+		// The simulation clock starts now, not when loading started
+		m_fLastFrameTime = CTimer::GetAbsoluteTime();
+		m_Clock.Reset( m_fLastFrameTime );
+		PublishFrame( m_fLastFrameTime );
+		if ( !m_bLowLatency ) StartSimulation();
 
-	// Drawing the game objects
-	DrawObjects();
-}
+	} // End if Loading
 
-//-----------------------------------------------------------------------------
-// Name : ProcessInput () (Private)
-// Desc : Simply polls the input devices and performs basic input operations
-//-----------------------------------------------------------------------------
-void CGameApp::ProcessInput( )
-{
-	static UCHAR pKeyBuffer[ 256 ];
-	ULONG		Direction = 0;
-	ULONG		Direction2 = 0;
-	POINT		CursorPos;
-	float		X = 0.0f, Y = 0.0f;
-	ULONG       LaunchBullet = 0;
+	// Note when the last of the assets came in
+	if ( m_fLoadedTime == 0.0 && g_Assets.IsLoaded( CAssetLoader::AP_BACKGROUND ) )
+	{
+		m_fLoadedTime = CTimer::GetAbsoluteTime() - m_fStartTime;
+		sprintf_s( TitleBuffer, _T("First frame after %.1f ms, fully loaded after %.1f ms\n"), m_fFirstFrameTime * 1000.0, m_fLoadedTime * 1000.0 );
+		OutputDebugString( TitleBuffer );
 
-	// Retrieve keyboard state
-	if ( !GetKeyboardState( pKeyBuffer ) ) return;
+		if ( !m_BackgroundLoaded.get() )
+		{
+			MessageBox( 0, _T("Failed to initialize properly. Reinstalling the application may solve this problem.\nIf the problem persists, please contact technical support."), _T("Fatal Error"), MB_OK | MB_ICONSTOP);
+			PostQuitMessage(0);
+			return;
+		}
 
-	// Check the relevant keys
+		// The background only uses a handful of colours, keep it palettized too
+		if ( Sprite::getIndexedStorage() && m_idxBackground.CreateFromImage( m_imgBackground ) )
+			m_imgBackground.Release();
 
-	if ( pKeyBuffer[ VK_UP	] & 0xF0 ) Direction |= CPlayer::DIR_FORWARD;
-	if ( pKeyBuffer[ VK_DOWN  ] & 0xF0 ) Direction |= CPlayer::DIR_BACKWARD;
-	if ( pKeyBuffer[ VK_LEFT  ] & 0xF0 ) Direction |= CPlayer::DIR_LEFT;
-	if ( pKeyBuffer[ VK_RIGHT ] & 0xF0 ) Direction |= CPlayer::DIR_RIGHT;
+		sprintf_s( TitleBuffer, _T("Sprite pixels: %u KB, background: %u KB\n"), (UINT)(Sprite::getTotalMemory() / 1024),
+			(UINT)(m_idxBackground.Width() ? m_idxBackground.GetMemorySize() / 1024 : m_imgBackground.Width() * m_imgBackground.Height() * sizeof(RGBQUAD) / 1024) );
+		OutputDebugString( TitleBuffer );
 
+		m_LastFrameRate = 0;
 
-	if (pKeyBuffer[0x57] & 0xF0) Direction2 |= CPlayer::DIRECTION::DIR_FORWARD;
-	if (pKeyBuffer[0x53] & 0xF0) Direction2 |= CPlayer::DIRECTION::DIR_BACKWARD;
-	if (pKeyBuffer[0x41] & 0xF0) Direction2 |= CPlayer::DIRECTION::DIR_LEFT;
-	if (pKeyBuffer[0x44] & 0xF0) Direction2 |= CPlayer::DIRECTION::DIR_RIGHT;
+	} // End if Fully Loaded
 	
-	// Move the player
-	m_pPlayer->Move(Direction);
-	Player1->Move(Direction2);
-	m_pEnemy->MoveEnemies();
-	m_pEnemy2->MoveEnemies();
-	m_pEnemy3->MoveEnemies();
-	star1->MoveStar();
-	star2->MoveStar();
-	star3->MoveStar();
-
-	static UINT fTimer;
-
+	// Poll & Process input devices
+	ProcessInput();
 
-	if (m_pPlayer->Collision(m_pPlayer, star1))
+	double fNow = CTimer::GetAbsoluteTime();
+	double fFrameTime = fNow - m_fLastFrameTime;
+	m_fLastFrameTime = fNow;
+
+	m_fFrameAverage = m_fFrameAverage * 0.95 + fFrameTime * 0.05;
+	m_fFrameJitter  = m_fFrameJitter * 0.95 + fabs( fFrameTime - m_fFrameAverage ) * 0.05;
+
+	// In low latency mode the ticks run right here, on the input just read,
+	// and the newest state is drawn as is. Otherwise the simulation thread
+	// has been publishing on its own and the latest state it handed over is
+	// drawn between its last two ticks, one tick behind real time.
+	if ( m_bLowLatency && RunTicks( fNow ) ) PublishFrame( fNow );
+
+	m_Frames.Update();
+	const SFrameState& Frame = m_Frames.Front();
+	float fAlpha = m_bLowLatency ? 1.0f : (float)((fNow - Frame.fTime) / SIM_TICK);
+	Sprite::setInterpolation( max( 0.0f, min( fAlpha, 1.0f ) ) );
+	m_fFrameAge = m_fFrameAge * 0.95 + (fNow - Frame.fTime) * 1000.0 * 0.05;
+
+	// Effects raised by the ticks since the last frame
+	float fBloom = m_fPendingBloom.exchange( 0.0f ), fFlash = m_fPendingFlash.exchange( 0.0f );
+	if ( fBloom > 0.0f ) m_PostProcess.TriggerBloom( fBloom );
+	if ( fFlash > 0.0f ) m_PostProcess.TriggerDamageFlash( fFlash );
+
+	// Outcome of a save written in the background
+	int eSave = m_eSave;
+	if ( eSave == SAVE_DONE || eSave == SAVE_FAILED )
 	{
-		fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-
-		m_pPlayer->IncreaseLives(1);
-		
-		star1->Explode();
-		
-		star1->AdvanceExplosion();
-		fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-
-		star1->Position() = Vec2(rand()%500+100, rand()%500+100);
-
+		SetStatus( eSave == SAVE_DONE ? _T("Game saved") : _T("The game could not be saved") );
+		m_eSave = SAVE_IDLE;
 	}
-
-	if (m_pPlayer->Collision(m_pPlayer, star2))
+	if ( m_szStatus && fNow - m_fStatusTime > STATUS_TIME )
 	{
-		fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-
-		m_pPlayer->IncreaseLives(1);
-	
-		star2->Explode();
-
-		star2->AdvanceExplosion();
-		fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-
-		star2->Position() = Vec2(rand()%500+100, rand()%500+100);
-		
+		m_szStatus = NULL;
+		m_LastFrameRate = 0;
 	}
 
-
-	if (m_pPlayer->Collision(m_pPlayer, star3))
+	// Get / Display the framerate
+	if ( m_LastFrameRate != m_Timer.GetFrameRate() )
 	{
-		fTimer = SetTimer(m_hWnd, 1, 50, NULL);
-
-		m_pPlayer->IncreaseLives(1);
-
-		star3->Explode();
-
-		star3->AdvanceExplosion();
-		fTimer = SetTimer(m_hWnd, 1, 50, NULL);
+		const SWorldSnapshot& World = Frame.World;
+		m_LastFrameRate = m_Timer.GetFrameRate( FrameRate, 50 );
+		sprintf_s( TitleBuffer, _T("Game : %s  Lives: % d - % d    Score : % d - % d    Loaded: %.0f / %.0f ms    Draw: %.2f ms    FX: %.2f ms Q%d"), FrameRate, World.Players[0].Lives, World.Players[1].Lives, World.Players[0].Score, World.Players[1].Score, m_fFirstFrameTime * 1000.0, m_fLoadedTime * 1000.0, m_fDrawTime, m_PostProcess.GetAverageCost(), (int)m_PostProcess.GetQuality() );
+		if ( m_szStatus )
+		{
+			size_t nLength = _tcslen( TitleBuffer );
+			_snprintf_s( TitleBuffer + nLength, 255 - nLength, _TRUNCATE, _T("    %s"), m_szStatus );
+		}
+		if ( m_bShowTiming )
+		{
+			size_t nLength = _tcslen( TitleBuffer );
+			_snprintf_s( TitleBuffer + nLength, 255 - nLength, _TRUNCATE, _T("    %s  Sim: %.3f ms  Present: %.2f ms  Age: %.1f ms  Alpha: %.2f  Frame: %.2f ms  Jitter: %.2f ms  Dropped: %u  Input: %.1f ms  Lost: %lu"),
+				m_bLowLatency ? _T("Serial") : _T("Pipelined"), Frame.fSimCost, m_fPresentTime, m_fFrameAge, Sprite::getInterpolation(),
+				m_fFrameAverage * 1000.0, m_fFrameJitter * 1000.0, Frame.ulDropped, Frame.fInputLatency, m_Input.GetLost() );
+		}
+		SetWindowText( m_hWnd, TitleBuffer );
 
-		 star3->Position() = Vec2(rand()%500+100, rand()%500+100);
+	} // End if Frame Rate Altered
 
+	if ( Frame.World.bGameOver )
+	{
+		ShowGameOver( Frame.World );
+		return;
 	}
 
+	// Drawing the game objects
+	DrawObjects( Frame.World );
+}
 
+//-----------------------------------------------------------------------------
+// Name : ShowGameOver () (Private)
+// Desc : Announces the winner and quits.
+//-----------------------------------------------------------------------------
+void CGameApp::ShowGameOver( const SWorldSnapshot& World )
+{
+	StopSimulation();
+	SaveReplay();
 
-
-	if (pKeyBuffer['B'] & 0xF0)
+	if (World.Players[0].Score > World.Players[1].Score)
 	{
-		__int64 m_CurrentTime = timeGetTime();
-		if (m_CurrentTime - m_BulletTime >= 300)  
-		{
-			m_BulletTime = m_CurrentTime;
-			m_pBullet.push_back(new Bullet(m_pBBuffer));
-			m_pBullet.back()->Position() = Vec2(m_pPlayer->Position().x, m_pPlayer->Position().y - m_pPlayer->getHeight() / 2);
-		}
+		MessageBox(m_hWnd, "First Player Wins", "Game over", MB_OK);
+		PostQuitMessage(0);
 	}
-
-	
-	for (auto i = 0; i < m_pBullet.size(); i++)
+	else if (World.Players[0].Score < World.Players[1].Score)
 	{
-		if (m_pBullet[i]->Hit)
-		{
-			delete m_pBullet[i];
-			m_pBullet.erase(m_pBullet.begin() + i);
-			continue;
-		}
-		m_pBullet[i]->Move(CPlayer::DIR_FORWARD);
+		MessageBox(m_hWnd, "Second Player Wins", "Game over", MB_OK);
+		PostQuitMessage(0);
 	}
-	
-
-	if (pKeyBuffer['V'] & 0xF0)
+	else
 	{
-		__int64 m_CurrentTime = timeGetTime();
-		if (m_CurrentTime - m_BulletTime >= 300)
-		{
-			m_BulletTime = m_CurrentTime;
-			m_pBullet.push_back(new Bullet(m_pBBuffer));
-			m_pBullet.back()->Position() = Vec2(Player1->Position().x, Player1->Position().y - Player1->getHeight() / 2);
-		}
+		MessageBox(m_hWnd, "Tie", "Game over", MB_OK);
+		PostQuitMessage(0);
 	}
+}
 
+//-----------------------------------------------------------------------------
+// Name : RunTicks () (Private)
+// Desc : Runs as many fixed ticks as the real time up to fNow calls for,
+//		see CTickClock. Returns the number of ticks run.
+//-----------------------------------------------------------------------------
+ULONG CGameApp::RunTicks( double fNow )
+{
+	m_Clock.Advance( fNow );
 
-	for (auto i = 0; i < m_pBullet.size(); i++)
+	ULONG nTicks = 0;
+	double fTickEnd;
+	for ( ; m_Clock.NextTick( fTickEnd ); nTicks++ )
 	{
-		if (m_pBullet[i]->Hit)
-		{
-			delete m_pBullet[i];
-			m_pBullet.erase(m_pBullet.begin() + i);
-			continue;
-		}
-		m_pBullet[i]->Move(CPlayer::DIR_FORWARD);
+		STickInput Input;
+		m_Input.BuildTick( fTickEnd, Input );
+		m_Recorder.Record( Input );
+
+		double fStart = CTimer::GetAbsoluteTime();
+		m_World.Step( Input );
+		m_fSimCost = m_fSimCost * 0.99 + (CTimer::GetAbsoluteTime() - fStart) * 1000.0 * 0.01;
 	}
 
+	if ( m_eSave == SAVE_REQUESTED ) CaptureSave();
 
+	return nTicks;
+}
 
+//-----------------------------------------------------------------------------
+// Name : PublishFrame () (Private)
+// Desc : Hands the current world state over to the renderer.
+//-----------------------------------------------------------------------------
+void CGameApp::PublishFrame( double fNow )
+{
+	SFrameState& Frame = m_Frames.Back();
 
-		__int64 m_CurrentTime = timeGetTime();
-		if (m_CurrentTime - m_BulletTime >= rand() + 2000)
-		{
-			m_BulletTime = m_CurrentTime;
-			m_pBulletEnemy.push_back(new Bullet(m_pBBuffer));
-			m_pBulletEnemy.back()->Position() = Vec2(m_pEnemy2->Position().x, m_pEnemy2->Position().y - m_pEnemy2->getHeight() / 2);
-		}
+	m_World.Capture( Frame.World );
+	Frame.fTime		= fNow - m_Clock.GetAccumulator();
+	Frame.fSimCost	= m_fSimCost;
+	Frame.ulDropped	= m_Clock.GetDropped();
+	Frame.fInputLatency = m_Input.GetLatency();
 
+	m_Frames.Publish();
+}
 
-		if (m_CurrentTime - m_BulletTime >= rand() + 2000)
-		{
-			m_BulletTime = m_CurrentTime;
-			m_pBulletEnemy.push_back(new Bullet(m_pBBuffer));
-			m_pBulletEnemy.back()->Position() = Vec2(m_pEnemy3->Position().x, m_pEnemy3->Position().y - m_pEnemy3->getHeight() / 2);
-		}
+//-----------------------------------------------------------------------------
+// Name : SimulationThread () (Private)
+// Desc : Ticks the world at its own pace, whatever the renderer is doing,
+//		and sleeps until the next tick is due.
+//-----------------------------------------------------------------------------
+void CGameApp::SimulationThread()
+{
+	// 1 ms sleeps instead of the default 15.6 ms scheduler quantum
+	timeBeginPeriod( 1 );
 
+	while ( m_bSimRunning )
+	{
+		double fNow = CTimer::GetAbsoluteTime();
+		if ( RunTicks( fNow ) ) PublishFrame( fNow );
 
+		double fWait = SIM_TICK - m_Clock.GetAccumulator() - (CTimer::GetAbsoluteTime() - fNow);
+		if ( fWait > 0.002 )
+			Sleep( (DWORD)((fWait - 0.001) * 1000.0) );
+		else
+			Sleep( 0 );
+	}
 
+	timeEndPeriod( 1 );
+}
 
-			if (m_CurrentTime - m_BulletTime >= rand()+2000)
-			{
-				m_BulletTime = m_CurrentTime;
-				m_pBulletEnemy.push_back(new Bullet(m_pBBuffer));
-				m_pBulletEnemy.back()->Position() = Vec2(m_pEnemy->Position().x, m_pEnemy->Position().y - m_pEnemy->getHeight() / 2);
-			}
+//-----------------------------------------------------------------------------
+// Name : StartSimulation () (Private)
+// Desc : Starts ticking the world on its own thread.
+//-----------------------------------------------------------------------------
+void CGameApp::StartSimulation()
+{
+	if ( m_bSimRunning ) return;
 
+	m_Clock.Resume( CTimer::GetAbsoluteTime() );
+	m_bSimRunning = true;
+	m_SimThread = std::thread( &CGameApp::SimulationThread, this );
+}
 
-		for (auto i = 0; i < m_pBulletEnemy.size(); i++)
-			
-		{
-			if (m_pBulletEnemy[i]->Hit)
-			{
-				delete m_pBulletEnemy[i];
-				m_pBulletEnemy.erase(m_pBulletEnemy.begin() + i);
-				continue;
-			}
-			m_pBulletEnemy[i]->MoveDown(CPlayer::DIR_BACKWARD);
-		}
+//-----------------------------------------------------------------------------
+// Name : StopSimulation () (Private)
+// Desc : Waits for the simulation thread to finish its current ticks. The
+//		world then belongs to the window thread again.
+//-----------------------------------------------------------------------------
+void CGameApp::StopSimulation()
+{
+	if ( !m_bSimRunning ) return;
+
+	m_bSimRunning = false;
+	m_SimThread.join();
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetLowLatency () (Private)
+// Desc : Low latency runs input, ticks and drawing back to back on the window
+//		thread and draws the newest state, which is the shortest way from a
+//		key press to the screen. The pipelined default keeps a long draw from
+//		holding the simulation up.
+//-----------------------------------------------------------------------------
+void CGameApp::SetLowLatency( bool bEnable )
+{
+	m_bLowLatency = bEnable;
+	if ( m_bLoading ) return;
+
+	if ( bEnable )
+	{
+		StopSimulation();
+		m_Clock.Resume( CTimer::GetAbsoluteTime() );
+	}
+	else
+	{
+		StartSimulation();
+	}
+}
 
+//-----------------------------------------------------------------------------
+// Name : ProcessInput () (Private)
+// Desc : Polls the mouse once per frame. Keys arrive as events through
+//		DisplayWndProc and go straight to m_Input.
+//-----------------------------------------------------------------------------
+void CGameApp::ProcessInput( )
+{
+	POINT		CursorPos;
 
 	// Now process the mouse (if the button is pressed)
 	if ( GetCapture() == m_hWnd )
@@ -702,128 +825,56 @@ void CGameApp::ProcessInput( )
 	} // End if Captured
 }
 
-//-----------------------------------------------------------------------------
-// Name : AnimateObjects () (Private)
-// Desc : Animates the objects we currently have loaded.
-//-----------------------------------------------------------------------------
-void CGameApp::AnimateObjects()
-{
-	m_pPlayer->Update(m_Timer.GetTimeElapsed());
-	Player1->Update(m_Timer.GetTimeElapsed());
-	for (auto i = 0; i < m_pBullet.size(); i++)
-		m_pBullet[i]->Update(m_Timer.GetTimeElapsed());
-	for (auto i = 0; i < m_pBulletEnemy.size(); i++)
-		m_pBulletEnemy[i]->Update(m_Timer.GetTimeElapsed());
-
-	m_pEnemy->Update(m_Timer.GetTimeElapsed());
-	m_pEnemy2->Update(m_Timer.GetTimeElapsed());
-	m_pEnemy3->Update(m_Timer.GetTimeElapsed());
-	star1->Update(m_Timer.GetTimeElapsed());
-	star2->Update(m_Timer.GetTimeElapsed());
-	star3->Update(m_Timer.GetTimeElapsed());
-}
-
-bool Collision1(Bullet* p1, CPlayer* p2);
-
-
 //-----------------------------------------------------------------------------
 // Name : DrawObjects () (Private)
 // Desc : Draws the game objects
 //-----------------------------------------------------------------------------
-void CGameApp::DrawObjects()
+void CGameApp::DrawObjects( const SWorldSnapshot& World )
 {
+	double fDrawStart = CTimer::GetAbsoluteTime();
 
 	m_pBBuffer->reset();
 	DrawBackground();
 
-	m_pPlayer->Draw();
-	Player1->Draw();
-
-	for (auto i = 0; i < m_pBullet.size(); i++)
-		m_pBullet[i]->Draw();
-	for (auto i = 0; i < m_pBulletEnemy.size(); i++)
-		m_pBulletEnemy[i]->Draw();
-
-	if (m_pPlayer->GetLives()) m_pPlayer->Draw();
-	if (Player1->GetLives()) Player1->Draw();
-
-	m_pEnemy->Draw();
-	m_pEnemy2->Draw();
-	m_pEnemy3->Draw();
-
-	star1->Draw();
-	star2->Draw();
-	star3->Draw();
-
-	for (auto it : m_pBullet)
-	{
-		if (Collision1(it, m_pEnemy))
-		{
-			
-			m_pEnemy->Explode();
-			m_pPlayer->IncreaseScore(1);
-			
-			m_pEnemy->Position() = Vec2(700, 100);
-			break;
-			
-		}
-	}
-	// Player1 attacks the Enemy2
-	for (auto it : m_pBullet)
-	{
-		if (Collision1(it, m_pEnemy2))
-		{
-			m_pEnemy2->Explode();
-			m_pPlayer->IncreaseScore(1);
-		
-			 m_pEnemy2->Position() = Vec2(750, 150);
-
-			break;
-		}
-	}
-	// Player1 attacks the Enemy3
-	for (auto it : m_pBullet)
-	{
-		if (Collision1(it, m_pEnemy3))
-		{
-			m_pEnemy3->Explode();
-			m_pPlayer->IncreaseScore(1);
-			
-			m_pEnemy3->Position() = Vec2(650, 200);
-			break;
-		}
-	}
+	m_pPlayer->Draw(World.Players[0]);
+	Player1->Draw(World.Players[1]);
 
+	for (auto& b : World.Bullets)
+		m_pBullet->Draw(b);
+	for (auto& b : World.EnemyBullets)
+		m_pBullet->Draw(b);
 
-	for (auto it : m_pBulletEnemy)
-	{
-		if (Collision1(it, m_pPlayer))
-		{
+	if (World.Players[0].Lives) m_pPlayer->Draw(World.Players[0]);
+	if (World.Players[1].Lives) Player1->Draw(World.Players[1]);
 
-			m_pPlayer->Explode();
-			m_pPlayer->DecreaseLives();
-			m_pPlayer->Position() = Vec2(rand()%500+100, rand() % 500 + 100);
-			break;
+	for (auto& e : World.Invaders)
+		m_pEnemy->Draw(e.Position, e.PrevPosition);
+	for (auto& b : World.Blasts)
+		if (b.bExploding) m_pEnemy->Draw(b);
 
-		}
-	}
+	star1->Draw(World.Stars[0]);
+	star2->Draw(World.Stars[1]);
+	star3->Draw(World.Stars[2]);
 
-	m_pPlayer->AdvanceExplosion();
-	m_pEnemy->AdvanceExplosion();
-	m_pEnemy2->AdvanceExplosion();
-	m_pEnemy3->AdvanceExplosion();
+	// Everything up to the post processing, blits and GDI calls alike
+	GdiFlush();
+	m_fDrawTime = m_fDrawTime * 0.9 + (CTimer::GetAbsoluteTime() - fDrawStart) * 100.0;
 
-	star1->AdvanceExplosion();
-	star2->AdvanceExplosion();
-	star3->AdvanceExplosion();
+	m_PostProcess.Apply(m_pBBuffer, m_Timer.GetTimeElapsed());
 
+	double fPresentStart = CTimer::GetAbsoluteTime();
 	m_pBBuffer->present();
+	m_fPresentTime = m_fPresentTime * 0.9 + (CTimer::GetAbsoluteTime() - fPresentStart) * 100.0;
 }
 
 
 
 void CGameApp::DrawBackground()
 {
+	// The background is decoded in the background, skip it until it is ready
+	if (!CAssetLoader::IsReady(m_BackgroundLoaded) || !m_BackgroundLoaded.get())
+		return;
+
 	static int currentY = m_imgBackground.Height();
 
 	static size_t lastTime = ::GetTickCount();
@@ -837,75 +888,172 @@ void CGameApp::DrawBackground()
 			currentY = m_imgBackground.Height();
 	}
 
+	if (m_idxBackground.Width())
+	{
+		// Same two blits as CImageFile::Paint, expanded straight into the surface
+		int w = m_idxBackground.Width(), h = m_idxBackground.Height();
+		RECT rcTop = { 0, currentY, w, h };
+		RECT rcBottom = { 0, 0, w, currentY };
+
+		GdiFlush();
+		m_idxBackground.Blit(m_pBBuffer->bits(), m_pBBuffer->width(), m_pBBuffer->height(), 0, 0, &rcTop);
+		m_idxBackground.Blit(m_pBBuffer->bits(), m_pBBuffer->width(), m_pBBuffer->height(), 0, h - currentY, &rcBottom);
+		return;
+	}
+
 	m_imgBackground.Paint(m_pBBuffer->getDC(), 0, currentY);
 
 }
 
-
-
-void CGameApp::SaveGame(CPlayer* m_pPlayer, CPlayer* Player1) 
+//-----------------------------------------------------------------------------
+// Name : SaveGame () (Private)
+// Desc : Asks for a save. The thread running the ticks copies the world out
+//		between two ticks and a worker writes it, so nothing waits on disk.
+//-----------------------------------------------------------------------------
+void CGameApp::SaveGame() 
 { 
-	ofstream fout("test.out");
-	
-	fout << m_pPlayer->GetLives() << '\n' << Player1->GetLives() << '\n';
-	fout <<  m_pPlayer->Position().x << " " << m_pPlayer->Position().y << '\n';
-	fout << Player1->Position().x << " " << Player1->Position().y << '\n';
-	fout << m_pPlayer->GetScore() << '\n' << Player1->GetScore() << '\n';
+	// Still busy with the previous one
+	int eIdle = SAVE_IDLE;
+	if ( m_bLoading || !m_eSave.compare_exchange_strong( eIdle, SAVE_REQUESTED ) ) return;
 
-	::MessageBox(m_hWnd, "Game saved", "Save", MB_OK);
+	SetStatus( _T("Saving...") );
 }
 
+//-----------------------------------------------------------------------------
+// Name : CaptureSave () (Private)
+// Desc : Copies the world into m_SaveBuffer and queues the write. Runs on
+//		whichever thread owns the world, right after its ticks.
+//-----------------------------------------------------------------------------
+void CGameApp::CaptureSave()
+{
+	size_t nSize = m_World.GetStateSize();
+	if ( m_SaveBuffer.size() * sizeof(double) < nSize ) m_SaveBuffer.resize( nSize / sizeof(double) + 1 );
+	m_World.SaveState( m_SaveBuffer.data(), m_SaveBuffer.size() * sizeof(double) );
 
-//-------------------------------------------------------------
-// Load previously saved game
-//-------------------------------------------------------------
-void CGameApp::LoadGame(CPlayer* m_pPlayer, CPlayer* Player1) 
-{ 
-	::MessageBox(m_hWnd, "Loading game", "Load", MB_OK);
-	ifstream fin("test.out");
-	int live1, live2;
-	int score1, score2;
-	Vec2 currentPosition1, currentPosition2;
-	fin >> live1 >> live2;
-	fin >> currentPosition1.x >> currentPosition1.y;
-	fin >> currentPosition2.x >> currentPosition2.y;
-	fin >> score1 >> score2;
-
-	m_pPlayer->SetLives(live1);
-	Player1->SetLives(live2);
-
-	m_pPlayer->SetScore(score1);
-	Player1->SetScore(score2);
-	
-	m_pPlayer->SetPosition(currentPosition1);
-	Player1->SetPosition(currentPosition2);
-	::MessageBox(m_hWnd, "Game loaded", "Load", MB_OK);
+	m_eSave = SAVE_WRITING;
+	m_SaveTask = g_Workers.Submit( SAVE_TASK_PRIORITY, [this, nSize]()
+	{
+		m_eSave = CSaveFile::Write( SAVE_FILE, m_SaveBuffer.data(), nSize ) ? SAVE_DONE : SAVE_FAILED;
+	});
 }
 
-bool Collision1(Bullet* p1, CPlayer* p2)
-{
-	RECT r;
-	r.left = p1->m_pSprite->mPosition.x - p1->m_pSprite->width() / 2;
-	r.right = p1->m_pSprite->mPosition.x + p1->m_pSprite->width() / 2;
-	r.top = p1->m_pSprite->mPosition.y - p1->m_pSprite->height() / 2;
-	r.bottom = p1->m_pSprite->mPosition.y + p1->m_pSprite->height() / 2;
+//-----------------------------------------------------------------------------
+// Name : LoadGame () (Private)
+// Desc : Puts the world back into the saved state. Falls back on the text
+//		save of older builds when there is no save of our own.
+//-----------------------------------------------------------------------------
+void CGameApp::LoadGame() 
+{ 
+	if ( m_bLoading ) return;
 
-	RECT r2;
-	r2.left = p2->m_pSprite->mPosition.x - p2->m_pSprite->width() / 2;
-	r2.right = p2->m_pSprite->mPosition.x + p2->m_pSprite->width() / 2;
-	r2.top = p2->m_pSprite->mPosition.y - p2->m_pSprite->height() / 2;
-	r2.bottom = p2->m_pSprite->mPosition.y + p2->m_pSprite->height() / 2;
+	bool bRunning = m_bSimRunning;
+	StopSimulation();
 
+	std::vector<double> State;
+	size_t nSize = 0;
+	SLegacySave Legacy;
+	bool bLegacy = false;
 
-	if (r.right > r2.left && r.left < r2.right && r.bottom>r2.top && r.top < r2.bottom)
+	CSaveFile::ELoadResult eResult = CSaveFile::Read( SAVE_FILE, State, nSize );
+	if ( eResult == CSaveFile::LOAD_MISSING )
 	{
-		return true;
+		eResult = CSaveFile::ReadLegacy( LEGACY_SAVE_FILE, Legacy );
+		bLegacy = true;
 	}
-	if (r.left > r2.right && r.right < r2.left && r.bottom>r2.top && r.top < r2.bottom)
+
+	LPCTSTR szStatus = _T("Game loaded");
+	switch ( eResult )
 	{
-		return true;
+	case CSaveFile::LOAD_OK:
+		// The game goes off script here, keep what was recorded up to now
+		SaveReplay();
+
+		if ( bLegacy )
+		{
+			for ( int i = 0; i < 2; i++ )
+			{
+				m_World.Player(i).Lives = Legacy.Lives[i];
+				m_World.Player(i).Score = Legacy.Score[i];
+				m_World.SetPosition( m_World.Player(i), Legacy.Position[i] );
+			}
+		}
+		else if ( !m_World.LoadState( State.data(), nSize ) )
+		{
+			szStatus = _T("The saved game is from another version of the game");
+			break;
+		}
+
+		m_Recorder.Stop();
+		break;
+
+	case CSaveFile::LOAD_MISSING:
+		szStatus = _T("No saved game");
+		break;
+	case CSaveFile::LOAD_CORRUPT:
+		szStatus = _T("The saved game is damaged");
+		break;
+	case CSaveFile::LOAD_NEWER:
+		szStatus = _T("The saved game needs a newer version of the game");
+		break;
 	}
 
-	return false;
+	SetStatus( szStatus );
+	PublishFrame( CTimer::GetAbsoluteTime() );
+	if ( bRunning ) StartSimulation();
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetStatus () (Private)
+// Desc : Shows a short message after the window title for a few seconds.
+//-----------------------------------------------------------------------------
+void CGameApp::SetStatus( LPCTSTR szStatus )
+{
+	m_szStatus		= szStatus;
+	m_fStatusTime	= CTimer::GetAbsoluteTime();
+	m_LastFrameRate	= 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : OnSound ()
+// Desc : IPlatform, plays the sound asynchronously.
+//-----------------------------------------------------------------------------
+void CGameApp::OnSound( ESound eSound )
+{
+	static const char *Files[SOUND_COUNT] =
+	{
+		"data/jet-start.wav",
+		"data/jet-stop.wav",
+		"data/jet-cabin.wav",
+		"data/explosion.wav"
+	};
+
+	// NOTE: for each async sound played Windows creates a thread for you
+	// but only one, so you cannot play multiple sounds at once.
+	PlaySound( Files[eSound], NULL, SND_FILENAME | SND_ASYNC );
+}
+
+//-----------------------------------------------------------------------------
+// Name : OnEffect ()
+// Desc : IPlatform, queues the matching post processing effect.
+//-----------------------------------------------------------------------------
+void CGameApp::OnEffect( EEffect eEffect, float fIntensity )
+{
+	// Called from the simulation thread, the next frame starts the effect
+	std::atomic<float>& Pending = eEffect == EFFECT_BLOOM ? m_fPendingBloom : m_fPendingFlash;
+	float fOld = Pending.load();
+	while ( fOld < fIntensity && !Pending.compare_exchange_weak( fOld, fIntensity ) ) { }
+}
+
+//-----------------------------------------------------------------------------
+// Name : SaveReplay () (Private)
+// Desc : Writes the recording of the current game for the headless player.
+//		Only while the simulation is stopped, the checksum must belong to
+//		the last recorded tick.
+//-----------------------------------------------------------------------------
+void CGameApp::SaveReplay()
+{
+	if ( !m_Recorder.IsRecording() || !m_Recorder.GetTicks() ) return;
 
+	if ( !m_Recorder.Save( REPLAY_FILE, m_World.Checksum() ) )
+		OutputDebugString( _T("Can't write the replay file\n") );
 }
@@ -164,3 +164,20 @@ float CTimer::GetTimeElapsed() const
 {
 	return m_TimeElapsed;
 }
+
+//-----------------------------------------------------------------------------
+// Name : GetAbsoluteTime () (Static)
+// Desc : Returns a monotonic time stamp in seconds, only useful for measuring
+//		the distance between two calls.
+//-----------------------------------------------------------------------------
+double CTimer::GetAbsoluteTime()
+{
+	static __int64 PerfFreq = 0;
+	__int64 Counter;
+
+	if ( PerfFreq == 0 && !QueryPerformanceFrequency((LARGE_INTEGER *)&PerfFreq) ) PerfFreq = -1;
+	if ( PerfFreq < 0 ) return timeGetTime() * 0.001;
+
+	QueryPerformanceCounter((LARGE_INTEGER *)&Counter);
+	return (double)Counter / (double)PerfFreq;
+}
@@ -0,0 +1,742 @@
+// Convolution.cpp
+// Fixed point convolution of 32 bit CImageFile buffers (blur, sharpen, edges).
+//
+// All arithmetic is done in integers so the SSE2 and the plain C paths give
+// bit identical results. Weights are 16 bit fixed point numbers and taps are
+// consumed two at a time: two neighbouring pixels are interleaved channel by
+// channel into 16 bit lanes, so one _mm_madd_epi16 multiplies and sums two
+// taps for all four channels at once.
+//
+// Separable kernels run a horizontal pass into a strip of 16 bit rows that
+// keep 4 extra fraction bits, then a vertical pass out of that strip.
+//
+// Box blurs skip the taps: every pass keeps the sum of its window for each
+// channel in 16 bits and slides it along, adding the pixel that comes in
+// and taking out the one that leaves, so a pass costs the same whatever
+// the radius. The mean is rounded through a 16 bit reciprocal, (sum + n / 2)
+// * ceil(65536 / n) >> 16, which _mm_mulhi_epu16 gives for eight channels
+// at once and the plain C path computes the same way.
+#include "Convolution.h"
+#include "ConvolutionMath.h"
+#include <algorithm>
+
+// Largest shift (fraction bits) a weight may use
+#define CONV_MAX_SHIFT 14
+
+// Largest box a running sum takes, 255 * (2 * 127 + 1) + 127 fits 16 bits
+#define CONV_MAX_BOX_RADIUS 127
+
+// Columns a worker takes at a time in the vertical box passes
+#define CONV_BOX_COLUMNS 256
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CKernel::CKernel()
+{
+	m_bSeparable = true;
+	m_iWidth = m_iHeight = 1;
+	m_iRowShift = m_iColShift = m_iMatrixShift = CONV_MAX_SHIFT;
+	m_iBias = 0;
+}
+
+// Picks the largest shift that keeps every weight inside a short and every
+// accumulated sum inside an int.
+int CKernel::ChooseShift(const double *weights, int count, int passes)
+{
+	double maxWeight = 0, sumWeight = 0;
+	for(int i = 0; i < count; i++)
+	{
+		maxWeight = max(maxWeight, fabs(weights[i]));
+		sumWeight += fabs(weights[i]);
+	}
+
+	// input samples are at most 255, or 255 << CONV_MID_BITS for the second pass
+	double sampleRange = passes > 1 ? 255.0 * (1 << CONV_MID_BITS) : 255.0;
+
+	int shift = CONV_MAX_SHIFT;
+	while(shift > CONV_MID_BITS &&
+		(maxWeight * (1 << shift) > 32767.0 || sumWeight * (1 << shift) * sampleRange > 2147483647.0))
+		shift--;
+
+	return shift;
+}
+
+// Converts weights to fixed point. The rounding error is pushed into the
+// centre tap so a kernel summing to one still sums to exactly one.
+void CKernel::Quantize(const double *weights, int count, int shift, std::vector<short> &out)
+{
+	double scale = double(1 << shift);
+	double sum = 0;
+	int isum = 0;
+
+	out.assign(count + (count & 1), 0);
+	for(int i = 0; i < count; i++)
+	{
+		out[i] = (short)floor(weights[i] * scale + 0.5);
+		isum += out[i];
+		sum += weights[i];
+	}
+
+	int error = (int)floor(sum * scale + 0.5) - isum;
+	int centre = out[count / 2] + error;
+	if(centre >= -32768 && centre <= 32767)
+		out[count / 2] = (short)centre;
+}
+
+CKernel CKernel::Separable(const double *row, int rowSize, const double *col, int colSize, double bias)
+{
+	assert((rowSize & 1) && (colSize & 1) && "Kernel sizes must be odd!");
+
+	CKernel k;
+	k.m_bSeparable = true;
+	k.m_iWidth = rowSize;
+	k.m_iHeight = colSize;
+	k.m_iRowShift = ChooseShift(row, rowSize, 1);
+	k.m_iColShift = ChooseShift(col, colSize, 2);
+	k.m_iBias = (int)floor(bias + 0.5);
+	Quantize(row, rowSize, k.m_iRowShift, k.m_Row);
+	Quantize(col, colSize, k.m_iColShift, k.m_Col);
+	return k;
+}
+
+CKernel CKernel::General(const double *weights, int kernelWidth, int kernelHeight, double bias)
+{
+	assert((kernelWidth & 1) && (kernelHeight & 1) && "Kernel sizes must be odd!");
+
+	CKernel k;
+	k.m_bSeparable = false;
+	k.m_iWidth = kernelWidth;
+	k.m_iHeight = kernelHeight;
+	k.m_iMatrixShift = ChooseShift(weights, kernelWidth * kernelHeight, 1);
+	k.m_iBias = (int)floor(bias + 0.5);
+
+	// Quantize the whole matrix at once so the centre correction applies to
+	// the overall sum, then lay the rows out padded to an even tap count.
+	std::vector<short> flat;
+	Quantize(weights, kernelWidth * kernelHeight, k.m_iMatrixShift, flat);
+
+	int padded = kernelWidth + (kernelWidth & 1);
+	k.m_Matrix.assign(padded * kernelHeight, 0);
+	for(int j = 0; j < kernelHeight; j++)
+		for(int i = 0; i < kernelWidth; i++)
+			k.m_Matrix[j * padded + i] = flat[j * kernelWidth + i];
+
+	return k;
+}
+
+CKernel CKernel::Gaussian(int radius, double sigma)
+{
+	if(sigma <= 0)
+		sigma = max(radius / 2.0, 0.5);
+
+	std::vector<double> w(2 * radius + 1);
+	double sum = 0;
+	for(int i = -radius; i <= radius; i++)
+	{
+		w[i + radius] = exp(-(i * i) / (2 * sigma * sigma));
+		sum += w[i + radius];
+	}
+	for(size_t i = 0; i < w.size(); i++)
+		w[i] /= sum;
+
+	return Separable(&w[0], (int)w.size(), &w[0], (int)w.size());
+}
+
+// Boxes of the given radii one after the other. The taps are the boxes
+// convolved together, the radii are kept for the running sum path.
+CKernel CKernel::Boxes(const std::vector<int> &radii)
+{
+	std::vector<double> w(1, 1.0), next;
+	std::vector<int> boxes;
+
+	for(size_t i = 0; i < radii.size(); i++)
+	{
+		int r = radii[i];
+		if(r <= 0)
+			continue;
+
+		next.assign(w.size() + 2 * r, 0.0);
+		for(size_t j = 0; j < w.size(); j++)
+			for(int k = 0; k <= 2 * r; k++)
+				next[j + k] += w[j] / (2 * r + 1);
+		w.swap(next);
+		boxes.push_back(r);
+	}
+
+	CKernel k = Separable(&w[0], (int)w.size(), &w[0], (int)w.size());
+	if(!boxes.empty() && *std::max_element(boxes.begin(), boxes.end()) <= CONV_MAX_BOX_RADIUS)
+		k.m_Boxes = boxes;
+	return k;
+}
+
+CKernel CKernel::Box(int radius)
+{
+	return Boxes(std::vector<int>(1, radius));
+}
+
+CKernel CKernel::BoxBlur(int radius, int passes)
+{
+	return Boxes(std::vector<int>(passes, radius));
+}
+
+CKernel CKernel::FastGaussian(int radius)
+{
+	if(radius < 3)
+		return Gaussian(radius);
+
+	// Three boxes, the narrower first ones and the wider last ones two
+	// pixels apart, sized so their variances add up to that of sigma
+	const int passes = 3;
+	double sigma = radius / 2.0;
+	int wl = (int)floor(sqrt(12 * sigma * sigma / passes + 1));
+	if(!(wl & 1))
+		wl--;
+	int m = (int)floor((12 * sigma * sigma - passes * wl * wl - 4 * passes * wl - 3 * passes) / (-4.0 * wl - 4) + 0.5);
+
+	std::vector<int> radii(passes);
+	for(int i = 0; i < passes; i++)
+		radii[i] = (i < m ? wl : wl + 2) / 2;
+	return Boxes(radii);
+}
+
+CKernel CKernel::Sharpen(double amount)
+{
+	double w[9] =
+	{
+		0,			-amount,			0,
+		-amount,	1 + 4 * amount,		-amount,
+		0,			-amount,			0
+	};
+	return General(w, 3, 3);
+}
+
+CKernel CKernel::Edge()
+{
+	// Laplacian, offset to mid gray so both edge signs stay visible
+	double w[9] =
+	{
+		-1, -1, -1,
+		-1,  8, -1,
+		-1, -1, -1
+	};
+	return General(w, 3, 3, 128.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	// 65536 / n rounded up, so (sum + n / 2) * recip >> 16 rounds sum / n
+	inline int BoxReciprocal(int n) { return (65536 + n - 1) / n; }
+
+	// Builds the padded source line of row y and interleaves every pixel
+	// with its right neighbour into 8 shorts: b0 b1 g0 g1 r0 r1 a0 a1.
+	// pairs must hold width + 2 * radius entries of 8 shorts.
+	void BuildPairLine(const RGBQUAD *pSrcRow, int width, int radius, EBorderMode border,
+		std::vector<RGBQUAD> &line, short *pairs)
+	{
+		int count = width + 2 * radius;
+
+		line.resize(count + 1);
+		for(int i = 0; i < radius; i++)
+			line[i] = pSrcRow[CConvolution::MapBorder(i - radius, width, border)];
+		memcpy(&line[radius], pSrcRow, width * sizeof(RGBQUAD));
+		for(int i = radius + width; i <= count; i++)
+			line[i] = pSrcRow[CConvolution::MapBorder(i - radius, width, border)];
+
+#ifdef USE_SSE2
+		__m128i zero = _mm_setzero_si128();
+		for(int i = 0; i < count; i++)
+		{
+			__m128i v = _mm_loadl_epi64((const __m128i*)&line[i]);
+			v = _mm_unpacklo_epi8(v, zero);
+			v = _mm_unpacklo_epi16(v, _mm_srli_si128(v, 8));
+			_mm_storeu_si128((__m128i*)(pairs + i * 8), v);
+		}
+#else
+		for(int i = 0; i < count; i++)
+		{
+			const RGBQUAD &p0 = line[i], &p1 = line[i + 1];
+			short *d = pairs + i * 8;
+			d[0] = p0.rgbBlue;		d[1] = p1.rgbBlue;
+			d[2] = p0.rgbGreen;		d[3] = p1.rgbGreen;
+			d[4] = p0.rgbRed;		d[5] = p1.rgbRed;
+			d[6] = p0.rgbReserved;	d[7] = p1.rgbReserved;
+		}
+#endif
+	}
+
+	// Sums taps over one pair line for output pixel x, returning four
+	// 32 bit channel sums (b, g, r, a).
+#ifdef USE_SSE2
+	inline __m128i DotPairs(const short *pairs, int x, const int *weights, int taps)
+	{
+		__m128i acc = _mm_setzero_si128();
+		const short *p = pairs + x * 8;
+		for(int k = 0; k < taps; k += 2, p += 16)
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)p), PairWeights(weights, k / 2)));
+		return acc;
+	}
+#else
+	inline void DotPairs(const short *pairs, int x, const short *weights, int taps, int acc[4])
+	{
+		const short *p = pairs + x * 8;
+		for(int k = 0; k < taps; k += 2, p += 16)
+			for(int c = 0; c < 4; c++)
+				acc[c] += p[c * 2] * weights[k] + p[c * 2 + 1] * weights[k + 1];
+	}
+#endif
+}
+
+CConvolution::CConvolution(CWorkerPool *pPool)
+{
+	m_pPool = pPool;
+	m_iStripHeight = 32;
+}
+
+int CConvolution::MapBorder(int i, int size, EBorderMode border)
+{
+	if(i >= 0 && i < size)
+		return i;
+
+	switch(border)
+	{
+	case EBM_WRAP:
+		i %= size;
+		return i < 0 ? i + size : i;
+
+	case EBM_MIRROR:
+		if(size == 1)
+			return 0;
+		{
+			int period = 2 * (size - 1);
+			i %= period;
+			if(i < 0) i += period;
+			return i < size ? i : period - i;
+		}
+
+	case EBM_CLAMP:
+	default:
+		return i < 0 ? 0 : size - 1;
+	}
+}
+
+void CConvolution::Apply(CImageFile &img, const CKernel &kernel, EBorderMode border)
+{
+	if(!img.Bits())
+		return;
+
+	// Strips read their neighbours' rows, so filter out of a copy
+	std::vector<RGBQUAD> src(img.Bits(), img.Bits() + img.Width() * img.Height());
+	Apply(&src[0], img.Bits(), img.Width(), img.Height(), kernel, border);
+}
+
+void CConvolution::Apply(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int height, const CKernel &kernel, EBorderMode border)
+{
+	assert(pSrc != pDst && "Convolution can not run in place!");
+
+	if(kernel.IsBoxBlur())
+	{
+		ApplyBoxes(pSrc, pDst, width, height, kernel, border);
+		return;
+	}
+
+	int stripHeight = m_iStripHeight;
+	int strips = (height + stripHeight - 1) / stripHeight;
+
+	std::function<void(int)> run = [&](int strip)
+	{
+		int y0 = strip * stripHeight;
+		int y1 = min(y0 + stripHeight, height);
+
+		if(kernel.IsSeparable())
+			SeparableStrip(pSrc, pDst, width, height, y0, y1, kernel, border);
+		else
+			GeneralStrip(pSrc, pDst, width, height, y0, y1, kernel, border);
+	};
+
+	if(m_pPool)
+		m_pPool->ParallelFor(strips, run);
+	else
+		for(int i = 0; i < strips; i++)
+			run(i);
+}
+
+void CConvolution::SeparableStrip(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int height, int y0, int y1,
+	const CKernel &kernel, EBorderMode border)
+{
+	// Scratch buffers live per thread and are reused strip after strip
+	static thread_local std::vector<RGBQUAD> line;
+	static thread_local std::vector<short> pairs;
+	static thread_local std::vector<short> mid;
+	static thread_local std::vector<const short*> rows;
+
+	int rx = kernel.RadiusX(), ry = kernel.RadiusY();
+	int rowTaps = (int)kernel.m_Row.size(), colTaps = (int)kernel.m_Col.size();
+	int midRows = (y1 - y0) + 2 * ry;
+	int midStride = (width + 1) * 4;	// one spare pixel so pixel pairs never read past the row
+	int hShift = kernel.m_iRowShift - CONV_MID_BITS;
+	int vShift = kernel.m_iColShift + CONV_MID_BITS;
+
+	pairs.resize((width + 2 * rx) * 8);
+	mid.resize(midRows * midStride);
+
+#ifdef USE_SSE2
+	static thread_local std::vector<int> rowWeights, colWeights;
+	SplatWeights(&kernel.m_Row[0], rowTaps, rowWeights);
+	SplatWeights(&kernel.m_Col[0], colTaps, colWeights);
+#endif
+
+	// Horizontal pass into the strip buffer
+	for(int j = 0; j < midRows; j++)
+	{
+		const RGBQUAD *pSrcRow = pSrc + MapBorder(y0 - ry + j, height, border) * width;
+		short *pMid = &mid[j * midStride];
+
+		BuildPairLine(pSrcRow, width, rx, border, line, &pairs[0]);
+
+#ifdef USE_SSE2
+		__m128i round = _mm_set1_epi32(hShift > 0 ? 1 << (hShift - 1) : 0);
+		__m128i shift = _mm_cvtsi32_si128(hShift);
+		int x = 0;
+		for(; x + 1 < width; x += 2)
+		{
+			__m128i a = _mm_sra_epi32(_mm_add_epi32(DotPairs(&pairs[0], x, &rowWeights[0], rowTaps), round), shift);
+			__m128i b = _mm_sra_epi32(_mm_add_epi32(DotPairs(&pairs[0], x + 1, &rowWeights[0], rowTaps), round), shift);
+			_mm_storeu_si128((__m128i*)(pMid + x * 4), _mm_packs_epi32(a, b));
+		}
+		if(x < width)
+		{
+			__m128i a = _mm_sra_epi32(_mm_add_epi32(DotPairs(&pairs[0], x, &rowWeights[0], rowTaps), round), shift);
+			_mm_storel_epi64((__m128i*)(pMid + x * 4), _mm_packs_epi32(a, a));
+		}
+#else
+		int round = hShift > 0 ? 1 << (hShift - 1) : 0;
+		for(int x = 0; x < width; x++)
+		{
+			int acc[4] = { 0, 0, 0, 0 };
+			DotPairs(&pairs[0], x, &kernel.m_Row[0], rowTaps, acc);
+			for(int c = 0; c < 4; c++)
+				pMid[x * 4 + c] = (short)Saturate16((acc[c] + round) >> hShift);
+		}
+#endif
+	}
+
+	// Vertical pass out of the strip buffer. Odd tap counts are padded with
+	// a zero weight, its row pointer just has to be valid.
+	rows.resize(midRows + 1);
+	for(int j = 0; j < midRows; j++)
+		rows[j] = &mid[j * midStride];
+	rows[midRows] = rows[midRows - 1];
+
+	int bias = kernel.m_iBias;
+
+	for(int y = y0; y < y1; y++)
+	{
+		const short **pRows = &rows[y - y0];
+		RGBQUAD *pDstRow = pDst + y * width;
+
+#ifdef USE_SSE2
+		__m128i round = _mm_set1_epi32(1 << (vShift - 1));
+		__m128i shift = _mm_cvtsi32_si128(vShift);
+		__m128i vbias = _mm_setr_epi32(bias, bias, bias, 0);
+
+		for(int x = 0; x < width; x += 2)
+		{
+			__m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+			for(int k = 0; k < colTaps; k += 2)
+			{
+				__m128i w = PairWeights(&colWeights[0], k / 2);
+				__m128i a = _mm_loadu_si128((const __m128i*)(pRows[k] + x * 4));
+				__m128i b = _mm_loadu_si128((const __m128i*)(pRows[k + 1] + x * 4));
+				acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+				acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+			}
+			acc0 = _mm_add_epi32(_mm_sra_epi32(_mm_add_epi32(acc0, round), shift), vbias);
+			acc1 = _mm_add_epi32(_mm_sra_epi32(_mm_add_epi32(acc1, round), shift), vbias);
+
+			__m128i out = _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_setzero_si128());
+			if(x + 1 < width)
+				_mm_storel_epi64((__m128i*)(pDstRow + x), out);
+			else
+				*(int*)(pDstRow + x) = _mm_cvtsi128_si32(out);
+		}
+#else
+		int round = 1 << (vShift - 1);
+		for(int x = 0; x < width; x++)
+		{
+			int acc[4] = { 0, 0, 0, 0 };
+			for(int k = 0; k < colTaps; k++)
+				for(int c = 0; c < 4; c++)
+					acc[c] += pRows[k][x * 4 + c] * kernel.m_Col[k];
+
+			BYTE out[4];
+			for(int c = 0; c < 4; c++)
+				out[c] = Saturate8(Saturate16(((acc[c] + round) >> vShift) + (c < 3 ? bias : 0)));
+
+			pDstRow[x].rgbBlue = out[0];
+			pDstRow[x].rgbGreen = out[1];
+			pDstRow[x].rgbRed = out[2];
+			pDstRow[x].rgbReserved = out[3];
+		}
+#endif
+	}
+}
+
+void CConvolution::GeneralStrip(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int height, int y0, int y1,
+	const CKernel &kernel, EBorderMode border)
+{
+	static thread_local std::vector<RGBQUAD> line;
+	static thread_local std::vector<short> pairs;
+
+	int rx = kernel.RadiusX(), ry = kernel.RadiusY();
+	int taps = kernel.m_iWidth + (kernel.m_iWidth & 1);
+	int lineRows = (y1 - y0) + 2 * ry;
+	int pairStride = (width + 2 * rx) * 8;
+	int shiftBits = kernel.m_iMatrixShift;
+	int bias = kernel.m_iBias;
+
+	// Every source row the strip touches, as pair lines
+	pairs.resize(lineRows * pairStride);
+	for(int j = 0; j < lineRows; j++)
+		BuildPairLine(pSrc + MapBorder(y0 - ry + j, height, border) * width, width, rx, border, line, &pairs[j * pairStride]);
+
+#ifdef USE_SSE2
+	static thread_local std::vector<int> weights;
+	SplatWeights(&kernel.m_Matrix[0], (int)kernel.m_Matrix.size(), weights);
+
+	__m128i round = _mm_set1_epi32(1 << (shiftBits - 1));
+	__m128i shift = _mm_cvtsi32_si128(shiftBits);
+	__m128i vbias = _mm_setr_epi32(bias, bias, bias, 0);
+#else
+	int round = 1 << (shiftBits - 1);
+#endif
+
+	for(int y = y0; y < y1; y++)
+	{
+		RGBQUAD *pDstRow = pDst + y * width;
+		const short *pLines = &pairs[(y - y0) * pairStride];
+
+		for(int x = 0; x < width; x++)
+		{
+#ifdef USE_SSE2
+			__m128i acc = _mm_setzero_si128();
+			for(int j = 0; j < kernel.m_iHeight; j++)
+				acc = _mm_add_epi32(acc, DotPairs(pLines + j * pairStride, x, &weights[j * taps * 2], taps));
+
+			acc = _mm_add_epi32(_mm_sra_epi32(_mm_add_epi32(acc, round), shift), vbias);
+			__m128i out = _mm_packs_epi32(acc, acc);
+			*(int*)(pDstRow + x) = _mm_cvtsi128_si32(_mm_packus_epi16(out, out));
+#else
+			int acc[4] = { 0, 0, 0, 0 };
+			for(int j = 0; j < kernel.m_iHeight; j++)
+				DotPairs(pLines + j * pairStride, x, &kernel.m_Matrix[j * taps], taps, acc);
+
+			BYTE out[4];
+			for(int c = 0; c < 4; c++)
+				out[c] = Saturate8(Saturate16(((acc[c] + round) >> shiftBits) + (c < 3 ? bias : 0)));
+
+			pDstRow[x].rgbBlue = out[0];
+			pDstRow[x].rgbGreen = out[1];
+			pDstRow[x].rgbRed = out[2];
+			pDstRow[x].rgbReserved = out[3];
+#endif
+		}
+	}
+}
+
+void CConvolution::ApplyBoxes(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int height, const CKernel &kernel, EBorderMode border)
+{
+	// Rows first, then every vertical pass ping pongs between the plane and
+	// pDst; where the rows land depends on the pass count so the last one
+	// ends in pDst
+	int passes = (int)kernel.m_Boxes.size();
+	m_Plane.resize(width * height);
+	RGBQUAD *pFirst = (passes & 1) ? &m_Plane[0] : pDst;
+	RGBQUAD *pSecond = (passes & 1) ? pDst : &m_Plane[0];
+
+	int stripHeight = m_iStripHeight;
+	int strips = (height + stripHeight - 1) / stripHeight;
+	std::function<void(int)> rows = [&](int strip)
+	{
+		int y0 = strip * stripHeight;
+		BoxRows(pSrc, pFirst, width, y0, min(y0 + stripHeight, height), kernel, border);
+	};
+
+	int blocks = (width + CONV_BOX_COLUMNS - 1) / CONV_BOX_COLUMNS;
+	std::function<void(int)> columns = [&](int block)
+	{
+		int x0 = block * CONV_BOX_COLUMNS;
+		BoxColumns(pFirst, pSecond, width, height, x0, min(x0 + CONV_BOX_COLUMNS, width), kernel, border);
+	};
+
+	if(m_pPool)
+	{
+		m_pPool->ParallelFor(strips, rows);
+		m_pPool->ParallelFor(blocks, columns);
+	}
+	else
+	{
+		for(int i = 0; i < strips; i++)
+			rows(i);
+		for(int i = 0; i < blocks; i++)
+			columns(i);
+	}
+}
+
+void CConvolution::BoxRows(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int y0, int y1, const CKernel &kernel, EBorderMode border)
+{
+	static thread_local std::vector<RGBQUAD> line;
+	static thread_local std::vector<RGBQUAD> pass;
+
+	const std::vector<int> &boxes = kernel.m_Boxes;
+	int passes = (int)boxes.size();
+	int lineSize = width + 2 * *std::max_element(boxes.begin(), boxes.end());
+	line.resize(2 * lineSize);
+	pass.resize(2 * width);
+
+	// Two rows at a time, the last one alone given as both
+	for(int y = y0; y < y1; y += 2)
+	{
+		int last = min(y + 1, y1 - 1);
+		const RGBQUAD *pRows[2] = { pSrc + y * width, pSrc + last * width };
+
+		for(int i = 0; i < passes; i++)
+		{
+			int r = boxes[i];
+			RGBQUAD *pLines[2] = { &line[0], &line[lineSize] };
+			RGBQUAD *pOut[2] = { pDst + y * width, pDst + last * width };
+			if(i + 1 < passes)
+			{
+				pOut[0] = &pass[0];
+				pOut[1] = last > y ? &pass[width] : pOut[0];
+			}
+
+			// The rows with r border pixels either side
+			for(int j = 0; j < 2; j++)
+			{
+				for(int x = 0; x < r; x++)
+				{
+					pLines[j][x] = pRows[j][MapBorder(x - r, width, border)];
+					pLines[j][r + width + x] = pRows[j][MapBorder(width + x, width, border)];
+				}
+				memcpy(pLines[j] + r, pRows[j], width * sizeof(RGBQUAD));
+			}
+
+			int recip = BoxReciprocal(2 * r + 1);
+
+#ifdef USE_SSE2
+			// Both rows side by side, eight channels in 16 bit lanes
+			__m128i zero = _mm_setzero_si128();
+			#define LOAD_PIXELS(x) _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(*(const int*)(pLines[0] + (x))), _mm_cvtsi32_si128(*(const int*)(pLines[1] + (x)))), zero)
+
+			__m128i sum = zero;
+			for(int k = 0; k < 2 * r; k++)
+				sum = _mm_add_epi16(sum, LOAD_PIXELS(k));
+
+			__m128i half = _mm_set1_epi16((short)r);
+			__m128i scale = _mm_set1_epi16((short)recip);
+			for(int x = 0; x < width; x++)
+			{
+				sum = _mm_add_epi16(sum, LOAD_PIXELS(x + 2 * r));
+				__m128i mean = _mm_mulhi_epu16(_mm_add_epi16(sum, half), scale);
+				mean = _mm_packus_epi16(mean, mean);
+				*(int*)(pOut[1] + x) = _mm_cvtsi128_si32(_mm_srli_si128(mean, 4));
+				*(int*)(pOut[0] + x) = _mm_cvtsi128_si32(mean);
+				sum = _mm_sub_epi16(sum, LOAD_PIXELS(x));
+			}
+
+			#undef LOAD_PIXELS
+#else
+			for(int j = 0; j < (pOut[1] != pOut[0] ? 2 : 1); j++)
+			{
+				const BYTE *pBytes = (const BYTE*)pLines[j];
+				int sum[4] = { 0, 0, 0, 0 };
+				for(int k = 0; k < 2 * r; k++)
+					for(int c = 0; c < 4; c++)
+						sum[c] += pBytes[k * 4 + c];
+
+				for(int x = 0; x < width; x++)
+				{
+					BYTE *pMean = (BYTE*)(pOut[j] + x);
+					for(int c = 0; c < 4; c++)
+					{
+						sum[c] += pBytes[(x + 2 * r) * 4 + c];
+						pMean[c] = (BYTE)(((unsigned)(sum[c] + r) * recip) >> 16);
+						sum[c] -= pBytes[x * 4 + c];
+					}
+				}
+			}
+#endif
+			pRows[0] = pOut[0];
+			pRows[1] = pOut[1];
+		}
+	}
+}
+
+void CConvolution::BoxColumns(RGBQUAD *pA, RGBQUAD *pB, int width, int height, int x0, int x1, const CKernel &kernel, EBorderMode border)
+{
+	static thread_local std::vector<unsigned short> sums;
+
+	const std::vector<int> &boxes = kernel.m_Boxes;
+	int count = x1 - x0;
+	sums.resize(count * 4);
+	unsigned short *pSums = &sums[0];
+
+	// Every pass over this block of columns before the next block, so the
+	// block stays in cache from one pass to the next
+	for(size_t i = 0; i < boxes.size(); i++)
+	{
+		const RGBQUAD *pIn = (i & 1) ? pB : pA;
+		RGBQUAD *pOut = (i & 1) ? pA : pB;
+		int r = boxes[i];
+		int recip = BoxReciprocal(2 * r + 1);
+
+		memset(pSums, 0, count * 4 * sizeof(unsigned short));
+		for(int k = -r; k <= r; k++)
+		{
+			const BYTE *pRow = (const BYTE*)(pIn + MapBorder(k, height, border) * width + x0);
+			for(int c = 0; c < count * 4; c++)
+				pSums[c] = (unsigned short)(pSums[c] + pRow[c]);
+		}
+
+#ifdef USE_SSE2
+		__m128i zero = _mm_setzero_si128();
+		__m128i half = _mm_set1_epi16((short)r);
+		__m128i scale = _mm_set1_epi16((short)recip);
+#endif
+
+		for(int y = 0; y < height; y++)
+		{
+			BYTE *pMean = (BYTE*)(pOut + y * width + x0);
+			const BYTE *pEnter = (const BYTE*)(pIn + MapBorder(y + r + 1, height, border) * width + x0);
+			const BYTE *pLeave = (const BYTE*)(pIn + MapBorder(y - r, height, border) * width + x0);
+			int c = 0;
+
+#ifdef USE_SSE2
+			// Four pixels, sixteen channels, at a time
+			for(; c + 16 <= count * 4; c += 16)
+			{
+				__m128i s0 = _mm_loadu_si128((const __m128i*)(pSums + c));
+				__m128i s1 = _mm_loadu_si128((const __m128i*)(pSums + c + 8));
+
+				__m128i m0 = _mm_mulhi_epu16(_mm_add_epi16(s0, half), scale);
+				__m128i m1 = _mm_mulhi_epu16(_mm_add_epi16(s1, half), scale);
+				_mm_storeu_si128((__m128i*)(pMean + c), _mm_packus_epi16(m0, m1));
+
+				__m128i enter = _mm_loadu_si128((const __m128i*)(pEnter + c));
+				__m128i leave = _mm_loadu_si128((const __m128i*)(pLeave + c));
+				s0 = _mm_sub_epi16(_mm_add_epi16(s0, _mm_unpacklo_epi8(enter, zero)), _mm_unpacklo_epi8(leave, zero));
+				s1 = _mm_sub_epi16(_mm_add_epi16(s1, _mm_unpackhi_epi8(enter, zero)), _mm_unpackhi_epi8(leave, zero));
+				_mm_storeu_si128((__m128i*)(pSums + c), s0);
+				_mm_storeu_si128((__m128i*)(pSums + c + 8), s1);
+			}
+#endif
+			for(; c < count * 4; c++)
+			{
+				pMean[c] = (BYTE)(((unsigned)(pSums[c] + r) * recip) >> 16);
+				pSums[c] = (unsigned short)(pSums[c] + pEnter[c] - pLeave[c]);
+			}
+		}
+	}
+}
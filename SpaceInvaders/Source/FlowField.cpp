@@ -0,0 +1,333 @@
+//-----------------------------------------------------------------------------
+// File: FlowField.cpp
+//
+// Desc: A coarse grid over the playfield that knows, for every cell, how far
+//	   the nearest player is and which way leads there, so any number of
+//	   objects can steer by looking up the cell they are in.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CFlowField Specific Includes
+//-----------------------------------------------------------------------------
+#include "FlowField.h"
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+// Name : CFlowField () (Constructor)
+// Desc : CFlowField Class Constructor
+//-----------------------------------------------------------------------------
+CFlowField::CFlowField()
+{
+	m_nColumns	= 0;
+	m_nRows		= 0;
+	m_nStride	= 0;
+	m_fInvCell	= 1.0;
+	m_iFront	= 0;
+	m_nGoals	= -1;
+	m_Fields[0].nGoals = m_Fields[1].nGoals = -1;
+	m_nBuilds	= 0;
+	m_bPending	= false;
+	m_bReady	= false;
+	m_bStop		= false;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CFlowField () (Destructor)
+// Desc : CFlowField Class Destructor
+//-----------------------------------------------------------------------------
+CFlowField::~CFlowField()
+{
+	SetThreaded( false );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Create ()
+// Desc : Sizes the grid, nothing blocked. The field leads nowhere until the
+//		first Request and Wait. A blocked border goes round the grid, so the
+//		search never has to check for the edges.
+//-----------------------------------------------------------------------------
+void CFlowField::Create( int nColumns, int nRows, double fCellSize )
+{
+	std::unique_lock<std::mutex> Lock( m_Lock );
+	Finish( Lock );
+
+	m_nColumns	= nColumns;
+	m_nRows		= nRows;
+	m_nStride	= nColumns + 2;
+	m_fInvCell	= 1.0 / fCellSize;
+	m_nGoals	= -1;
+	m_bReady	= false;
+
+	size_t nCells = (size_t)m_nStride * (nRows + 2);
+	m_Blocked.assign( nCells, 1 );
+	for ( int r = 0; r < nRows; r++ )
+		memset( &m_Blocked[(r + 1) * m_nStride + 1], 0, nColumns );
+	m_Frontier.reserve( nCells );
+	for ( int i = 0; i < 2; i++ )
+	{
+		m_Fields[i].Distance.assign( nCells, FLOW_UNREACHED );
+		m_Fields[i].Flow.assign( nCells * 2, 0.0f );
+		m_Fields[i].nGoals = -1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetThreaded ()
+// Desc : Starts or stops the worker that builds the field. Without it
+//		Request builds straight away on the calling thread.
+//-----------------------------------------------------------------------------
+void CFlowField::SetThreaded( bool bThreaded )
+{
+	if ( bThreaded == m_Worker.joinable() ) return;
+
+	if ( bThreaded )
+	{
+		m_bStop = false;
+		m_Worker = std::thread( &CFlowField::WorkerLoop, this );
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> Lock( m_Lock );
+		Finish( Lock );
+		m_bStop = true;
+	}
+	m_Wake.notify_one();
+	m_Worker.join();
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetBlocked ()
+// Desc : Marks a cell nothing can go through. The next Request rebuilds
+//		whether or not the goals moved.
+//-----------------------------------------------------------------------------
+void CFlowField::SetBlocked( int iColumn, int iRow, bool bBlocked )
+{
+	if ( iColumn < 0 || iColumn >= m_nColumns || iRow < 0 || iRow >= m_nRows ) return;
+
+	std::unique_lock<std::mutex> Lock( m_Lock );
+	Finish( Lock );
+	m_Blocked[(iRow + 1) * m_nStride + iColumn + 1] = bBlocked ? 1 : 0;
+	m_nGoals = m_Fields[0].nGoals = m_Fields[1].nGoals = -1;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Request ()
+// Desc : Has the back field built towards up to FLOW_MAX_GOALS positions,
+//		unless each is still in the cell the last one was built for or one
+//		of the two fields already leads there. Goals off the grid are
+//		ignored.
+//-----------------------------------------------------------------------------
+void CFlowField::Request( const Vec2 *pGoals, int nGoals )
+{
+	int32_t Cells[FLOW_MAX_GOALS];
+	int n = nGoals < FLOW_MAX_GOALS ? nGoals : FLOW_MAX_GOALS;
+	for ( int i = 0; i < n; i++ ) Cells[i] = GetCell( pGoals[i] );
+	if ( n == m_nGoals && !memcmp( Cells, m_Goals, n * sizeof(int32_t) ) ) return;
+
+	std::unique_lock<std::mutex> Lock( m_Lock );
+	Finish( Lock );
+	memcpy( m_Goals, Cells, n * sizeof(int32_t) );
+	m_nGoals = n;
+
+	// Back to goals a field is already built for, as after a rollback
+	if ( IsBuiltFor( m_Fields[m_iFront] ) || IsBuiltFor( m_Fields[1 - m_iFront] ) )
+	{
+		m_bReady = !IsBuiltFor( m_Fields[m_iFront] );
+		return;
+	}
+
+	if ( !m_Worker.joinable() )
+	{
+		Build( m_Fields[1 - m_iFront] );
+		m_nBuilds++;
+		m_bReady = true;
+		return;
+	}
+
+	m_bPending = true;
+	m_Wake.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Wait ()
+// Desc : Finishes the build Request started and makes it the field the
+//		lookups read. False if there was none, the front one stays.
+//-----------------------------------------------------------------------------
+bool CFlowField::Wait()
+{
+	std::unique_lock<std::mutex> Lock( m_Lock );
+	Finish( Lock );
+	if ( !m_bReady ) return false;
+
+	m_iFront = 1 - m_iFront;
+	m_bReady = false;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetCell ()
+// Desc : Index of the cell a position is in, counting the border, -1 off
+//		the grid.
+//-----------------------------------------------------------------------------
+int CFlowField::GetCell( const Vec2& Position ) const
+{
+	if ( Position.x < 0 || Position.y < 0 ) return -1;
+
+	int c = (int)(Position.x * m_fInvCell);
+	int r = (int)(Position.y * m_fInvCell);
+	if ( c >= m_nColumns || r >= m_nRows ) return -1;
+	return (r + 1) * m_nStride + c + 1;
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetDistance ()
+// Desc : Steps from a position's cell to the nearest goal, FLOW_UNREACHED
+//		off the grid or where no goal can be reached.
+//-----------------------------------------------------------------------------
+uint16_t CFlowField::GetDistance( const Vec2& Position ) const
+{
+	int i = GetCell( Position );
+	return i < 0 ? FLOW_UNREACHED : m_Fields[m_iFront].Distance[i];
+}
+
+//-----------------------------------------------------------------------------
+// Name : Sample ()
+// Desc : Unit direction towards the nearest goal; zero off the grid, in a
+//		goal's cell and where no goal can be reached.
+//-----------------------------------------------------------------------------
+Vec2 CFlowField::Sample( const Vec2& Position ) const
+{
+	int i = GetCell( Position );
+	if ( i < 0 ) return Vec2( 0, 0 );
+
+	const float *pFlow = &m_Fields[m_iFront].Flow[i * 2];
+	return Vec2( pFlow[0], pFlow[1] );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Build () (Private)
+// Desc : Searches out from the goal cells over the open ones, four ways,
+//		then points every reached cell at its closest neighbour, the first
+//		diagonal, then the first orthogonal one in Steps order.
+//-----------------------------------------------------------------------------
+void CFlowField::Build( SField& Field )
+{
+	static const int Across[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+	static const int Down[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+	const float fDiagonal = 0.70710678f;
+	int Steps[8];
+	for ( int s = 0; s < 8; s++ ) Steps[s] = Across[s] + Down[s] * m_nStride;
+
+	size_t nCells = m_Blocked.size();
+	const uint8_t *pBlocked = m_Blocked.data();
+	uint16_t *pDistance = Field.Distance.data();
+	float *pFlow = Field.Flow.data();
+
+	memset( pDistance, 0xFF, nCells * sizeof(uint16_t) );
+	memset( pFlow, 0, nCells * 2 * sizeof(float) );
+	memcpy( Field.Goals, m_Goals, sizeof(m_Goals) );
+	Field.nGoals = m_nGoals;
+
+	m_Frontier.clear();
+	for ( int g = 0; g < m_nGoals; g++ )
+	{
+		int i = m_Goals[g];
+		if ( i < 0 || pBlocked[i] || pDistance[i] == 0 ) continue;
+		pDistance[i] = 0;
+		m_Frontier.push_back( i );
+	}
+
+	// Every cell goes into the queue once, in order of distance
+	for ( size_t q = 0; q < m_Frontier.size(); q++ )
+	{
+		int i = m_Frontier[q];
+		uint16_t nNext = pDistance[i] + 1;
+
+		for ( int s = 0; s < 4; s++ )
+		{
+			int n = i + Steps[s];
+			if ( pBlocked[n] || pDistance[n] != FLOW_UNREACHED ) continue;
+			pDistance[n] = nNext;
+			m_Frontier.push_back( n );
+		}
+	}
+
+	// Open neighbours differ by one step at most, so a cell one step closer
+	// lies orthogonally and one two steps closer diagonally, between two
+	// one step closer cells; so no corner is cut. Goal cells stay at zero
+	static const int Sides[8] = { 0, 0, 0, 0, 1 | 4, 2 | 4, 1 | 8, 2 | 8 };
+	float Flow[8][2];
+	for ( int s = 0; s < 8; s++ )
+	{
+		float fScale = s >= 4 ? fDiagonal : 1.0f;
+		Flow[s][0] = Across[s] * fScale;
+		Flow[s][1] = Down[s] * fScale;
+	}
+
+	for ( size_t q = 0; q < m_Frontier.size(); q++ )
+	{
+		int i = m_Frontier[q];
+		uint16_t nDistance = pDistance[i];
+		if ( !nDistance ) continue;
+
+		uint16_t nCloser = nDistance - 1;
+		int nMask = (pDistance[i + Steps[0]] == nCloser) | (pDistance[i + Steps[1]] == nCloser) << 1
+				  | (pDistance[i + Steps[2]] == nCloser) << 2 | (pDistance[i + Steps[3]] == nCloser) << 3;
+
+		int iBest = (nMask & 1) ? 0 : (nMask & 2) ? 1 : (nMask & 4) ? 2 : 3;
+		for ( int s = 4; s < 8 && nDistance >= 2; s++ )
+		{
+			if ( (nMask & Sides[s]) != Sides[s] || pDistance[i + Steps[s]] != nDistance - 2 ) continue;
+			iBest = s;
+			break;
+		}
+
+		pFlow[i * 2]		= Flow[iBest][0];
+		pFlow[i * 2 + 1]	= Flow[iBest][1];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : IsBuiltFor () (Private)
+// Desc : Whether a field leads to the goals of the last Request.
+//-----------------------------------------------------------------------------
+bool CFlowField::IsBuiltFor( const SField& Field ) const
+{
+	return Field.nGoals == m_nGoals && !memcmp( Field.Goals, m_Goals, m_nGoals * sizeof(int32_t) );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Finish () (Private)
+// Desc : Blocks, with Lock held on m_Lock, until no build is going on.
+//-----------------------------------------------------------------------------
+void CFlowField::Finish( std::unique_lock<std::mutex>& Lock )
+{
+	m_Done.wait( Lock, [this]() { return !m_bPending; } );
+}
+
+//-----------------------------------------------------------------------------
+// Name : WorkerLoop () (Private)
+// Desc : The worker thread: builds the back field whenever Request asks.
+//-----------------------------------------------------------------------------
+void CFlowField::WorkerLoop()
+{
+	std::unique_lock<std::mutex> Lock( m_Lock );
+
+	for ( ;; )
+	{
+		m_Wake.wait( Lock, [this]() { return m_bPending || m_bStop; } );
+		if ( m_bStop ) return;
+
+		// Nobody touches the back field or the goals while a build is pending
+		SField& Back = m_Fields[1 - m_iFront];
+		Lock.unlock();
+		Build( Back );
+		Lock.lock();
+
+		m_nBuilds++;
+		m_bPending	= false;
+		m_bReady	= true;
+		m_Done.notify_all();
+	}
+}
@@ -0,0 +1,443 @@
+//-----------------------------------------------------------------------------
+// File: Formation.cpp
+//
+// Desc: A wave of invaders marching as one block: sideways until the
+//	   outermost survivor reaches an edge, then one step down and back.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CFormation Specific Includes
+//-----------------------------------------------------------------------------
+#include "Formation.h"
+#include <float.h>
+#include <string.h>
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Name : SFormationState (Struct)
+// Desc : Fixed part of a saved formation, followed by the x and y slots and
+//		then the alive bits of every column.
+//-----------------------------------------------------------------------------
+struct SFormationState
+{
+	SFormationDesc	Desc;
+	int32_t			Stride;
+	int32_t			Alive;
+	float			Direction;
+	float			LastDX;
+	float			LastDY;
+	int32_t			Reserved;
+};
+
+// The alive bits that follow are read in place
+static_assert( sizeof(SFormationState) % sizeof(uint64_t) == 0, "SFormationState must keep the alive bits aligned" );
+
+//-----------------------------------------------------------------------------
+// Name : HighestBit / LowestBit ()
+// Desc : Index of the highest / lowest set bit, n must not be 0. Win32 has
+//		no 64 bit scan, so MSVC goes through the two halves.
+//-----------------------------------------------------------------------------
+int CFormation::HighestBit( uint64_t n )
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	if ( _BitScanReverse( &i, (unsigned long)(n >> 32) ) ) return (int)i + 32;
+	_BitScanReverse( &i, (unsigned long)n );
+	return (int)i;
+#else
+	return 63 - __builtin_clzll( n );
+#endif
+}
+
+int CFormation::LowestBit( uint64_t n )
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	if ( _BitScanForward( &i, (unsigned long)n ) ) return (int)i;
+	_BitScanForward( &i, (unsigned long)(n >> 32) );
+	return (int)i + 32;
+#else
+	return __builtin_ctzll( n );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : CFormation () (Constructor)
+// Desc : CFormation Class Constructor
+//-----------------------------------------------------------------------------
+CFormation::CFormation()
+{
+	memset( &m_Desc, 0, sizeof(m_Desc) );
+	m_nStride		= 0;
+	m_nAlive		= 0;
+	m_fDirection	= 1.0f;
+	m_fLastDX		= 0.0f;
+	m_fLastDY		= 0.0f;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CFormation () (Destructor)
+// Desc : CFormation Class Destructor
+//-----------------------------------------------------------------------------
+CFormation::~CFormation()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : Create ()
+// Desc : Lines up a complete wave, marching right. Reuses the arrays of the
+//		previous wave when it was at least as big.
+//-----------------------------------------------------------------------------
+void CFormation::Create( const SFormationDesc& Desc )
+{
+	m_Desc = Desc;
+	if ( m_Desc.Rows > FORMATION_MAX_ROWS ) m_Desc.Rows = FORMATION_MAX_ROWS;
+
+	m_nStride		= (m_Desc.Rows + 3) & ~3;
+	m_fDirection	= 1.0f;
+	m_fLastDX		= 0.0f;
+	m_fLastDY		= 0.0f;
+
+	size_t nSlots = (size_t)m_Desc.Columns * m_nStride;
+	m_X.assign( nSlots, 0.0f );
+	m_Y.assign( nSlots, 0.0f );
+
+	uint64_t nColumnBits = m_Desc.Rows == 64 ? ~0ull : (1ull << m_Desc.Rows) - 1;
+	m_Alive.assign( m_Desc.Columns, nColumnBits );
+
+	for ( int c = 0; c < m_Desc.Columns; c++ )
+	{
+		for ( int r = 0; r < m_nStride; r++ )
+		{
+			m_X[c * m_nStride + r] = m_Desc.Left + c * m_Desc.SpacingX;
+			m_Y[c * m_nStride + r] = m_Desc.Top + (r < m_Desc.Rows ? r : m_Desc.Rows - 1) * m_Desc.SpacingY;
+		}
+	}
+
+	RebuildMasks();
+	UpdateBoxes();
+}
+
+//-----------------------------------------------------------------------------
+// Name : RebuildMasks () (Private)
+// Desc : Derives the lane masks, the column bits and the alive count from
+//		the row bits.
+//-----------------------------------------------------------------------------
+void CFormation::RebuildMasks()
+{
+	m_Mask.assign( m_X.size(), 0 );
+	m_Occupied.assign( (m_Desc.Columns + 63) / 64, 0 );
+	m_nAlive = 0;
+
+	for ( int c = 0; c < m_Desc.Columns; c++ )
+	{
+		uint64_t nBits = m_Alive[c];
+		if ( nBits ) m_Occupied[c >> 6] |= 1ull << (c & 63);
+
+		while ( nBits )
+		{
+			int r = LowestBit( nBits );
+			nBits &= nBits - 1;
+			m_Mask[c * m_nStride + r] = ~0u;
+			m_nAlive++;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : UpdateBoxes () (Private)
+// Desc : Works out the collision box of every slot from where it is now;
+//		only the sides when the wave just went sideways.
+//-----------------------------------------------------------------------------
+void CFormation::UpdateBoxes( bool bDropped )
+{
+	m_Boxes.Resize( m_X.size() );
+	m_Boxes.SetCentred( 0, m_X.data(), bDropped ? m_Y.data() : NULL, m_Mask.data(), m_X.size(), m_Desc.Width, m_Desc.Height );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Step ()
+// Desc : Moves the whole wave sideways and, if that brought a survivor to
+//		the edge it is heading for, turns it round and drops it a row. The
+//		fewer are left, the faster they go.
+//
+//		One pass over the x slots adds the step and keeps the minimum and
+//		maximum over the live lanes; dead lanes are swapped for +/-FLT_MAX
+//		by the mask. Dead invaders keep marching with the rest, so a column
+//		always shares one x. The SSE2 and plain C paths give the same floats.
+//-----------------------------------------------------------------------------
+void CFormation::Step( float dt )
+{
+	m_fLastDX = 0.0f;
+	m_fLastDY = 0.0f;
+	if ( !m_nAlive ) return;
+
+	float fTotal = (float)m_Desc.Columns * m_Desc.Rows;
+	float dx = m_fDirection * m_Desc.Speed * (3.0f - 2.0f * m_nAlive / fTotal) * dt;
+
+	float *pX = m_X.data();
+	const uint32_t *pMask = m_Mask.data();
+	size_t nSlots = m_X.size();
+	float fMin, fMax;
+
+#ifdef USE_SSE2
+	const __m128 Step	 = _mm_set1_ps( dx );
+	const __m128 Highest = _mm_set1_ps( FLT_MAX );
+	const __m128 Lowest	 = _mm_set1_ps( -FLT_MAX );
+	__m128 Min = Highest, Max = Lowest;
+
+	for ( size_t i = 0; i < nSlots; i += 4 )
+	{
+		__m128 x = _mm_add_ps( _mm_loadu_ps( pX + i ), Step );
+		__m128 m = _mm_castsi128_ps( _mm_loadu_si128( (const __m128i*)(pMask + i) ) );
+		_mm_storeu_ps( pX + i, x );
+
+		Min = _mm_min_ps( Min, _mm_or_ps( _mm_and_ps( m, x ), _mm_andnot_ps( m, Highest ) ) );
+		Max = _mm_max_ps( Max, _mm_or_ps( _mm_and_ps( m, x ), _mm_andnot_ps( m, Lowest ) ) );
+	}
+
+	// Fold the four lanes
+	Min = _mm_min_ps( Min, _mm_shuffle_ps( Min, Min, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	Min = _mm_min_ps( Min, _mm_shuffle_ps( Min, Min, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	Max = _mm_max_ps( Max, _mm_shuffle_ps( Max, Max, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	Max = _mm_max_ps( Max, _mm_shuffle_ps( Max, Max, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	fMin = _mm_cvtss_f32( Min );
+	fMax = _mm_cvtss_f32( Max );
+#else
+	fMin = FLT_MAX;
+	fMax = -FLT_MAX;
+	for ( size_t i = 0; i < nSlots; i++ )
+	{
+		pX[i] += dx;
+		if ( pMask[i] && pX[i] < fMin ) fMin = pX[i];
+		if ( pMask[i] && pX[i] > fMax ) fMax = pX[i];
+	}
+#endif
+
+	m_fLastDX = dx;
+
+	float fHalfWidth = (float)(m_Desc.Width / 2);
+	bool bTurn = m_fDirection > 0 ? fMax + fHalfWidth >= m_Desc.MaxX
+								  : fMin - fHalfWidth <= m_Desc.MinX;
+	if ( !bTurn )
+	{
+		UpdateBoxes( false );
+		return;
+	}
+
+	m_fDirection = -m_fDirection;
+	m_fLastDY = m_Desc.Drop;
+
+	float *pY = m_Y.data();
+#ifdef USE_SSE2
+	const __m128 Drop = _mm_set1_ps( m_Desc.Drop );
+	for ( size_t i = 0; i < nSlots; i += 4 )
+		_mm_storeu_ps( pY + i, _mm_add_ps( _mm_loadu_ps( pY + i ), Drop ) );
+#else
+	for ( size_t i = 0; i < nSlots; i++ ) pY[i] += m_Desc.Drop;
+#endif
+
+	UpdateBoxes();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Kill ()
+// Desc : Takes an invader out of the wave.
+//-----------------------------------------------------------------------------
+void CFormation::Kill( int iColumn, int iRow )
+{
+	if ( !IsAlive( iColumn, iRow ) ) return;
+
+	m_Alive[iColumn] &= ~(1ull << iRow);
+	m_Mask[iColumn * m_nStride + iRow] = 0;
+	m_Boxes.SetEmpty( iColumn * m_nStride + iRow );
+	m_nAlive--;
+
+	if ( !m_Alive[iColumn] ) m_Occupied[iColumn >> 6] &= ~(1ull << (iColumn & 63));
+}
+
+//-----------------------------------------------------------------------------
+// Name : Sweep ()
+// Desc : Finds the survivor an iWidth x iHeight box, moving from From to To
+//		during the last Step, touches first, and when. The wave moved too,
+//		so the box is swept by its movement relative to the wave: from
+//		where it was against where the wave is now.
+//-----------------------------------------------------------------------------
+bool CFormation::Sweep( const Vec2& From, const Vec2& To, int iWidth, int iHeight,
+						int& iColumn, int& iRow, float& fTime ) const
+{
+	Vec2 Start( From.x + m_fLastDX, From.y + m_fLastDY );
+	int i = m_Boxes.FirstSweep( CBoxSet::MakeBox( Start, iWidth, iHeight ),
+								(float)(To.x - Start.x), (float)(To.y - Start.y), fTime );
+	if ( i < 0 ) return false;
+
+	iColumn	= i / m_nStride;
+	iRow	= i % m_nStride;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : LowestAlive ()
+// Desc : Bottom row still alive in the column, -1 if it is empty.
+//-----------------------------------------------------------------------------
+int CFormation::LowestAlive( int iColumn ) const
+{
+	uint64_t nBits = m_Alive[iColumn];
+	return nBits ? HighestBit( nBits ) : -1;
+}
+
+//-----------------------------------------------------------------------------
+// Name : NextOccupiedColumn ()
+// Desc : First column from iColumn on, wrapping round, with a survivor in
+//		it; -1 once the wave is gone.
+//-----------------------------------------------------------------------------
+int CFormation::NextOccupiedColumn( int iColumn ) const
+{
+	if ( !m_nAlive ) return -1;
+
+	int nWords = (int)m_Occupied.size();
+	int iWord = iColumn >> 6;
+
+	// The rest of the starting word, then whole words round to it again
+	uint64_t nBits = m_Occupied[iWord] & (~0ull << (iColumn & 63));
+	for ( int i = 0; i <= nWords; i++ )
+	{
+		if ( nBits ) return (iWord << 6) + LowestBit( nBits );
+		iWord = (iWord + 1) % nWords;
+		nBits = m_Occupied[iWord];
+	}
+
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetBottom ()
+// Desc : Centre y of the lowest survivor, or -FLT_MAX with nobody left.
+//-----------------------------------------------------------------------------
+float CFormation::GetBottom() const
+{
+	float fBottom = -FLT_MAX;
+	for ( int c = 0; c < m_Desc.Columns; c++ )
+	{
+		int r = LowestAlive( c );
+		if ( r >= 0 && GetY( c, r ) > fBottom ) fBottom = GetY( c, r );
+	}
+	return fBottom;
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetPosition / GetPrevPosition ()
+// Desc : Where an invader is, and where it was before the last Step.
+//-----------------------------------------------------------------------------
+Vec2 CFormation::GetPosition( int iColumn, int iRow ) const
+{
+	int i = iColumn * m_nStride + iRow;
+	return Vec2( m_X[i], m_Y[i] );
+}
+
+Vec2 CFormation::GetPrevPosition( int iColumn, int iRow ) const
+{
+	int i = iColumn * m_nStride + iRow;
+	return Vec2( m_X[i] - m_fLastDX, m_Y[i] - m_fLastDY );
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetStateSize ()
+// Desc : Bytes SaveState writes, a multiple of 8.
+//-----------------------------------------------------------------------------
+size_t CFormation::GetStateSize() const
+{
+	return sizeof(SFormationState) + m_X.size() * 2 * sizeof(float) + m_Alive.size() * sizeof(uint64_t);
+}
+
+//-----------------------------------------------------------------------------
+// Name : SaveState ()
+// Desc : Copies the formation to pBuffer, which must hold GetStateSize bytes
+//		and be 8 byte aligned.
+//-----------------------------------------------------------------------------
+void CFormation::SaveState( void *pBuffer ) const
+{
+	SFormationState *pState = (SFormationState*)pBuffer;
+	pState->Desc		= m_Desc;
+	pState->Stride		= m_nStride;
+	pState->Alive		= m_nAlive;
+	pState->Direction	= m_fDirection;
+	pState->LastDX		= m_fLastDX;
+	pState->LastDY		= m_fLastDY;
+	pState->Reserved	= 0;
+
+	uint8_t *p = (uint8_t*)(pState + 1);
+	size_t nSlots = m_X.size() * sizeof(float);
+	if ( nSlots )
+	{
+		memcpy( p, m_X.data(), nSlots );
+		memcpy( p + nSlots, m_Y.data(), nSlots );
+	}
+	if ( !m_Alive.empty() ) memcpy( p + nSlots * 2, m_Alive.data(), m_Alive.size() * sizeof(uint64_t) );
+}
+
+//-----------------------------------------------------------------------------
+// Name : LoadState ()
+// Desc : Restores a formation saved by SaveState. False, with the formation
+//		untouched, if the sizes do not add up.
+//-----------------------------------------------------------------------------
+bool CFormation::LoadState( const void *pBuffer, size_t nSize )
+{
+	const SFormationState *pState = (const SFormationState*)pBuffer;
+	if ( nSize < sizeof(SFormationState) ) return false;
+
+	const SFormationDesc& Desc = pState->Desc;
+	if ( Desc.Columns < 0 || Desc.Rows < 0 || Desc.Rows > FORMATION_MAX_ROWS ) return false;
+	if ( pState->Stride != ((Desc.Rows + 3) & ~3) ) return false;
+
+	size_t nSlots = (size_t)Desc.Columns * pState->Stride;
+	if ( sizeof(SFormationState) + nSlots * 2 * sizeof(float) + Desc.Columns * sizeof(uint64_t) != nSize ) return false;
+
+	const float *pSlots = (const float*)(pState + 1);
+	const uint64_t *pAlive = (const uint64_t*)(pSlots + nSlots * 2);
+	uint64_t nColumnBits = Desc.Rows == 64 ? ~0ull : (1ull << Desc.Rows) - 1;
+	for ( int c = 0; c < Desc.Columns; c++ )
+		if ( pAlive[c] & ~nColumnBits ) return false;
+
+	m_Desc			= Desc;
+	m_nStride		= pState->Stride;
+	m_fDirection	= pState->Direction;
+	m_fLastDX		= pState->LastDX;
+	m_fLastDY		= pState->LastDY;
+
+	m_X.assign( pSlots, pSlots + nSlots );
+	m_Y.assign( pSlots + nSlots, pSlots + nSlots * 2 );
+	m_Alive.assign( pAlive, pAlive + Desc.Columns );
+
+	RebuildMasks();
+	UpdateBoxes();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Checksum ()
+// Desc : Carries CGameWorld's FNV-1a hash h on over the formation.
+//-----------------------------------------------------------------------------
+uint32_t CFormation::Checksum( uint32_t h ) const
+{
+	auto Mix = [&h]( const void *p, size_t n )
+	{
+		const unsigned char *b = (const unsigned char*)p;
+		for ( size_t i = 0; i < n; i++ ) h = (h ^ b[i]) * 16777619u;
+	};
+
+	Mix( &m_fDirection, sizeof(m_fDirection) );
+	if ( !m_X.empty() )
+	{
+		Mix( m_X.data(), m_X.size() * sizeof(float) );
+		Mix( m_Y.data(), m_Y.size() * sizeof(float) );
+	}
+	if ( !m_Alive.empty() ) Mix( m_Alive.data(), m_Alive.size() * sizeof(uint64_t) );
+
+	return h;
+}
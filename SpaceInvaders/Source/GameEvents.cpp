@@ -0,0 +1,48 @@
+//-----------------------------------------------------------------------------
+// File: GameEvents.cpp
+//
+// Desc: What happened during a simulation tick, queued by the systems that
+//	   found out and handled in batches once they are all done.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CEventQueue Specific Includes
+//-----------------------------------------------------------------------------
+#include "GameEvents.h"
+
+//-----------------------------------------------------------------------------
+// Name : CEventQueue () (Constructor)
+// Desc : CEventQueue Class Constructor
+//-----------------------------------------------------------------------------
+CEventQueue::CEventQueue()
+{
+	for ( int i = 0; i < SGameEvent::EVENT_COUNT; i++ ) m_Queues[i].reserve( EVENT_RESERVE );
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CEventQueue () (Destructor)
+// Desc : CEventQueue Class Destructor
+//-----------------------------------------------------------------------------
+CEventQueue::~CEventQueue()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : Clear ()
+// Desc : Empties every queue, keeping their memory.
+//-----------------------------------------------------------------------------
+void CEventQueue::Clear()
+{
+	for ( int i = 0; i < SGameEvent::EVENT_COUNT; i++ ) m_Queues[i].clear();
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetCount ()
+// Desc : Events of all types queued.
+//-----------------------------------------------------------------------------
+size_t CEventQueue::GetCount() const
+{
+	size_t n = 0;
+	for ( int i = 0; i < SGameEvent::EVENT_COUNT; i++ ) n += m_Queues[i].size();
+	return n;
+}
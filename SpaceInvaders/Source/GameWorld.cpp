@@ -0,0 +1,912 @@
+//-----------------------------------------------------------------------------
+// File: GameWorld.cpp
+//
+// Desc: The game simulation: players, invaders, stars and bullets, stepped
+//	   one fixed tick at a time. Knows nothing about windows, sprites or
+//	   the clock, so it builds on any platform and runs headless.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CGameWorld Specific Includes
+//-----------------------------------------------------------------------------
+#include "GameWorld.h"
+#include <string.h>
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const int	PLAYER_LIVES		= 10;
+const int	PLAYER_MAX_X		= 785;		// Right edge the players stop at
+const int	PLAYER_MAX_Y		= 560;		// Bottom edge the players stop at
+const int	ENEMY_MAX_X			= 790;		// Right edge the invaders turn at
+const int	FORMATION_FLOOR		= 450;		// An invader this low has landed
+const int	STAR_MAX_X			= 780;		// Right edge the stars turn at
+const int	WORLD_RIGHT			= 800;		// Shots beyond the screen edges are gone
+const int	WORLD_BOTTOM		= 600;
+const int	FIELD_CELL			= 20;		// Pixels across a flow field cell
+const uint32_t SHOT_COOLDOWN_MS	= 300;
+const uint32_t INVADER_FIRE_MS	= 1200;		// Invader shots are this far apart,
+const uint32_t INVADER_FIRE_SPREAD_MS = 2400;	//   plus up to this much at random
+const uint32_t WAVE_DELAY_MS	= 1500;		// Pause after a wave was shot down
+const float INVADER_AIM_COS		= 0.5f;		// Invaders aim at the nearest player within 60 degrees of straight down
+
+const uint32_t STATE_MAGIC		= 0x39535753;	// "SWS9", bump with any state layout change
+
+// The shot patterns. Player shots fly straight up
+static const SEmitter PLAYER_GUN = { SEmitter::PATTERN_SPREAD, 1, BULLET_SPEED, 0.0f, 3.14159265f, 0.0f, 0.0f };
+
+// Invaders fire one of these at random
+static const SEmitter INVADER_GUNS[] =
+{
+	{ SEmitter::PATTERN_SPREAD,	1,	ENEMY_BULLET_SPEED, 0.0f,  0.0f, 0.0f, 0.0f },		// Straight down
+	{ SEmitter::PATTERN_AIMED,	1,	ENEMY_BULLET_SPEED, 0.0f,  0.0f, 0.0f, 0.0f },		// At the player aimed at
+	{ SEmitter::PATTERN_AIMED,	3,	ENEMY_BULLET_SPEED, 0.0f,  0.0f, 0.5f, 0.0f },		// Fan at the player aimed at
+	{ SEmitter::PATTERN_RING,	12, 60.0f,				0.0f,  0.0f, 0.0f, 120.0f },	// Slow ring, speeding up
+	{ SEmitter::PATTERN_SPIRAL,	10, 90.0f,				15.0f, -1.2f, 0.25f, 0.0f },	// Sweeping arm
+};
+
+// What a timer does when it goes off
+enum
+{
+	TIMER_GUN_READY,		// A player's gun may fire again
+	TIMER_INVADER_FIRE,		// The wave shoots, and sets the next shot
+	TIMER_NEXT_WAVE,		// A new wave lines up
+};
+
+// Random stream the invaders draw from, after those of the actors
+const int RANDOM_WAVE = WORLD_ACTORS;
+
+// Animations the actors play, by ANIM_ number
+enum { ANIM_EXPLOSION, ANIM_COUNT };
+static const SAnimClip ANIM_CLIPS[ANIM_COUNT] =
+{
+	{ EXPLOSION_FRAMES, EXPLOSION_FPS },
+};
+
+//-----------------------------------------------------------------------------
+// Name : SWorldState (Struct)
+// Desc : Fixed part of a saved state, followed by the CProjectiles state of
+//		the player shots and the enemy shots, the CFormation state, the
+//		CAnimations state and last the CTimerWheel state.
+//-----------------------------------------------------------------------------
+struct SWorldState
+{
+	uint32_t	Magic;
+	uint32_t	Size;				// Bytes including everything that follows
+	uint32_t	Tick;
+	uint32_t	Blast;
+	uint32_t	Bullets;			// Bytes of player shot state
+	uint32_t	EnemyBullets;		// Bytes of enemy shot state
+	uint32_t	Formation;			// Bytes of formation state
+	uint32_t	Animations;			// Bytes of animation state
+	uint32_t	Timers;				// Bytes of timer state
+	uint32_t	Guns[WORLD_PLAYERS];
+	uint32_t	Wave;
+	uint32_t	Level;
+	CRandom		Random[WORLD_STREAMS];
+	int32_t		SpriteSize[CGameWorld::KIND_COUNT][2];
+	SActor		Players[WORLD_PLAYERS];
+	SActor		Blasts[WORLD_BLASTS];
+	SActor		Stars[WORLD_STARS];
+};
+
+//-----------------------------------------------------------------------------
+// Name : CGameWorld () (Constructor)
+// Desc : CGameWorld Class Constructor
+//-----------------------------------------------------------------------------
+CGameWorld::CGameWorld( IPlatform *pPlatform )
+{
+	m_pPlatform = pPlatform;
+	m_pLevels	= NULL;
+	m_Default	= DefaultLevel();
+
+	// Sizes of the bitmaps in Data, the renderer overrides them with the
+	// sprites it actually loaded.
+	SetSpriteSize( KIND_PLAYER, 100, 143 );
+	SetSpriteSize( KIND_ENEMY, 53, 55 );
+	SetSpriteSize( KIND_STAR, 50, 50 );
+	SetSpriteSize( KIND_BULLET, 36, 56 );
+
+	m_Animations.Create( ANIM_CLIPS, ANIM_COUNT, WORLD_ACTORS );
+	m_Field.Create( WORLD_RIGHT / FIELD_CELL, WORLD_BOTTOM / FIELD_CELL, FIELD_CELL );
+	Reset( 0 );
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CGameWorld () (Destructor)
+// Desc : CGameWorld Class Destructor
+//-----------------------------------------------------------------------------
+CGameWorld::~CGameWorld()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetSpriteSize ()
+// Desc : Collision sizes of each kind of object, applies from the next Reset.
+//-----------------------------------------------------------------------------
+void CGameWorld::SetSpriteSize( ESpriteKind eKind, int iWidth, int iHeight )
+{
+	m_Size[eKind][0] = iWidth;
+	m_Size[eKind][1] = iHeight;
+}
+
+//-----------------------------------------------------------------------------
+// Name : InitActor () (Private)
+//-----------------------------------------------------------------------------
+void CGameWorld::InitActor( SActor& Actor, ESpriteKind eKind )
+{
+	Actor = SActor();
+	Actor.Width		= m_Size[eKind][0];
+	Actor.Height	= m_Size[eKind][1];
+	Actor.Lives		= PLAYER_LIVES;
+	Actor.Facing	= SActor::DIR_FORWARD;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Reset ()
+// Desc : Starts a new game. Everything random in the game follows from nSeed.
+//-----------------------------------------------------------------------------
+void CGameWorld::Reset( unsigned int nSeed )
+{
+	static const Vec2 PlayerStart[WORLD_PLAYERS] = { Vec2(100, 400), Vec2(300, 400) };
+	static const Vec2 StarStart[WORLD_STARS]	 = { Vec2(200, 350), Vec2(250, 450), Vec2(150, 500) };
+	const SLevelSpawn *pPlayers = NULL, *pStars = NULL;
+	size_t nPlayers = 0, nStars = 0;
+	int i;
+
+	// The first level's start spots, the usual ones for any it lacks
+	m_nLevel = 0;
+	if ( m_pLevels )
+	{
+		pPlayers = m_pLevels->GetSpawns( Level(), SLevel::SPAWN_PLAYER, nPlayers );
+		pStars = m_pLevels->GetSpawns( Level(), SLevel::SPAWN_STAR, nStars );
+	}
+
+	for ( i = 0; i < WORLD_STREAMS; i++ ) m_Random[i].Seed( nSeed, i );
+
+	for ( i = 0; i < WORLD_PLAYERS; i++ )
+	{
+		InitActor( m_Players[i], KIND_PLAYER );
+		SetPosition( m_Players[i], (size_t)i < nPlayers ? Vec2( pPlayers[i].x, pPlayers[i].y ) : PlayerStart[i] );
+	}
+
+	for ( i = 0; i < WORLD_BLASTS; i++ ) InitActor( m_Blasts[i], KIND_ENEMY );
+	m_nBlast = 0;
+
+	NewWave();
+
+	for ( i = 0; i < WORLD_STARS; i++ )
+	{
+		InitActor( m_Stars[i], KIND_STAR );
+		SetPosition( m_Stars[i], (size_t)i < nStars ? Vec2( pStars[i].x, pStars[i].y ) : StarStart[i] );
+		m_Stars[i].Drift = Vec2( STAR_SPEED, STAR_SPEED );
+	}
+
+	m_Bullets.Clear();
+	m_EnemyBullets.Clear();
+	m_Animations.Clear();
+	m_Events.Clear();
+
+	m_nTick = 0;
+	m_Timers.Clear( m_nTick );
+	for ( i = 0; i < WORLD_PLAYERS; i++ ) m_hGuns[i] = 0;
+	m_hWave = 0;
+	m_Timers.Start( MsToTicks( Level().FireMs ), TIMER_INVADER_FIRE, 0 );
+	RequestField();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Step ()
+// Desc : Advances the game by exactly one fixed tick. Nothing in here may
+//		read the clock, so the same inputs give the same game whatever the
+//		render rate was. The systems only queue explosions, scores, lives
+//		and sounds; those are carried out together once collisions are
+//		done, and reach the platform as the tick ends.
+//-----------------------------------------------------------------------------
+void CGameWorld::Step( const STickInput& Input )
+{
+	int i;
+
+	m_nTick++;
+	m_Events.Clear();
+	m_Field.Wait();
+
+	SavePrevious();
+	RunTimers();
+
+	for ( i = 0; i < WORLD_PLAYERS; i++ )
+	{
+		if ( Input.Actions[i] & ACTION_ROTATE ) Rotate( m_Players[i] );
+		if ( Input.Actions[i] & ACTION_SELF_DESTRUCT )
+		{
+			Event( SGameEvent::EVENT_EXPLOSION, m_Players[i], 0 );
+			Event( SGameEvent::EVENT_LIFE, m_Players[i], -1 );
+		}
+	}
+
+	// Move everything
+	for ( i = 0; i < WORLD_PLAYERS; i++ ) MovePlayer( m_Players[i], Input.Direction[i], SIM_TICK );
+	m_Formation.Step( SIM_TICK );
+	for ( i = 0; i < WORLD_STARS; i++ ) MoveStar( m_Stars[i], SIM_TICK );
+
+	// The first player collects the stars, which then jump somewhere else
+	for ( i = 0; i < WORLD_STARS; i++ )
+	{
+		SActor& Star = m_Stars[i];
+		if ( !CBoxSet::Overlap( Box( m_Players[0] ), Box( Star ) ) ) continue;
+
+		Event( SGameEvent::EVENT_LIFE, m_Players[0], 1 );
+		Event( SGameEvent::EVENT_EXPLOSION, Star, 0 );
+
+		SetPosition( Star, Spawn( SLevel::SPAWN_JUMP, m_Random[ActorIndex( Star )] ) );
+	}
+
+	// Each gun cools down on its own timer, counted in ticks
+	for ( i = 0; i < WORLD_PLAYERS; i++ )
+	{
+		const SActor& Player = m_Players[i];
+		if ( !Input.bFire[i] || m_Timers.IsPending( m_hGuns[i] ) ) continue;
+
+		Fire( m_Bullets, PLAYER_GUN, Vec2( Player.Position.x, Player.Position.y - Player.Height / 2 ), Player.Position );
+		m_hGuns[i] = m_Timers.Start( MsToTicks( SHOT_COOLDOWN_MS ), TIMER_GUN_READY, i );
+	}
+
+	MoveBullets( SIM_TICK );
+
+	for ( i = 0; i < WORLD_PLAYERS; i++ ) UpdatePlayer( m_Players[i], SIM_TICK );
+
+	CheckCollisions();
+	ApplyEvents();
+	Animate( SIM_TICK );
+	DispatchEvents();
+
+	// Built while the next tick is waited for
+	RequestField();
+}
+
+//-----------------------------------------------------------------------------
+// Name : RunTimers () (Private)
+// Desc : Moves the timers on a tick and does what the ones that went off
+//		stand for, in the order the wheel gives them.
+//-----------------------------------------------------------------------------
+void CGameWorld::RunTimers()
+{
+	size_t nExpired = m_Timers.Advance();
+
+	for ( size_t i = 0; i < nExpired; i++ )
+	{
+		switch ( m_Timers.GetExpired( i ).Kind )
+		{
+		case TIMER_GUN_READY:
+			// Nothing to do, the gun checks whether its timer is pending
+			break;
+
+		case TIMER_INVADER_FIRE:
+			FireInvader();
+			m_Timers.Start( MsToTicks( Level().FireMs + m_Random[RANDOM_WAVE].Below( Level().FireSpreadMs ) ), TIMER_INVADER_FIRE, 0 );
+			break;
+
+		case TIMER_NEXT_WAVE:
+			m_nLevel++;
+			NewWave();
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : SavePrevious () (Private)
+// Desc : Keeps every object's position from before the tick, drawing blends
+//		from there to the new one.
+//-----------------------------------------------------------------------------
+void CGameWorld::SavePrevious()
+{
+	int i;
+	for ( i = 0; i < WORLD_PLAYERS; i++ ) m_Players[i].PrevPosition = m_Players[i].Position;
+	for ( i = 0; i < WORLD_BLASTS; i++ ) m_Blasts[i].PrevPosition = m_Blasts[i].Position;
+	for ( i = 0; i < WORLD_STARS; i++ ) m_Stars[i].PrevPosition = m_Stars[i].Position;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetPosition ()
+// Desc : Places an actor without it sliding there from where it was.
+//-----------------------------------------------------------------------------
+void CGameWorld::SetPosition( SActor& Actor, Vec2 Position )
+{
+	Actor.Position = Position;
+	Actor.PrevPosition = Position;
+}
+
+//-----------------------------------------------------------------------------
+// Name : MovePlayer () (Private)
+// Desc : Thrust in the held directions, stopping at the screen edges.
+//-----------------------------------------------------------------------------
+void CGameWorld::MovePlayer( SActor& Actor, uint32_t ulDirection, float dt )
+{
+	if ( ulDirection & SActor::DIR_LEFT )
+		Actor.Velocity.x -= PLAYER_THRUST * dt;
+	if ( Actor.Position.x < Actor.Width / 2 )
+		Actor.Velocity.x = 0;
+
+	if ( ulDirection & SActor::DIR_RIGHT )
+		Actor.Velocity.x += PLAYER_THRUST * dt;
+	if ( Actor.Position.x > PLAYER_MAX_X - Actor.Width / 2 )
+	{
+		Actor.Velocity.x = 0;
+		Actor.Position.x = PLAYER_MAX_X - Actor.Width / 2;
+	}
+
+	if ( ulDirection & SActor::DIR_FORWARD )
+		Actor.Velocity.y -= PLAYER_THRUST * dt;
+	if ( Actor.Position.y < Actor.Height / 2 )
+		Actor.Velocity.y = 0;
+
+	if ( ulDirection & SActor::DIR_BACKWARD )
+		Actor.Velocity.y += PLAYER_THRUST * dt;
+	if ( Actor.Position.y > PLAYER_MAX_Y - Actor.Height / 2 )
+	{
+		Actor.Velocity.y = 0;
+		Actor.Position.y = PLAYER_MAX_Y - Actor.Height / 2;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : NewWave () (Private)
+// Desc : Lines up the complete wave of the current level.
+//-----------------------------------------------------------------------------
+void CGameWorld::NewWave()
+{
+	const SLevel& Wave = Level();
+
+	SFormationDesc Desc;
+	Desc.Columns	= Wave.Columns;
+	Desc.Rows		= Wave.Rows;
+	Desc.Left		= Wave.Left;
+	Desc.Top		= Wave.Top;
+	Desc.SpacingX	= Wave.SpacingX;
+	Desc.SpacingY	= Wave.SpacingY;
+	Desc.Width		= m_Size[KIND_ENEMY][0];
+	Desc.Height		= m_Size[KIND_ENEMY][1];
+	Desc.MinX		= 0.0f;
+	Desc.MaxX		= (float)ENEMY_MAX_X;
+	Desc.Speed		= Wave.Speed;
+	Desc.Drop		= Wave.Drop;
+
+	m_Formation.Create( Desc );
+}
+
+//-----------------------------------------------------------------------------
+// Name : DefaultLevel () (Static)
+// Desc : The wave played without a level set, and the one a set's first
+//		level starts from. It has no spawn spots.
+//-----------------------------------------------------------------------------
+SLevel CGameWorld::DefaultLevel()
+{
+	SLevel Level;
+	memset( &Level, 0, sizeof(Level) );
+	Level.Columns		= FORMATION_COLUMNS;
+	Level.Rows			= FORMATION_ROWS;
+	Level.Left			= 60.0f;
+	Level.Top			= 80.0f;
+	Level.SpacingX		= 70.0f;
+	Level.SpacingY		= 65.0f;
+	Level.Speed			= ENEMY_SPEED;
+	Level.Drop			= ENEMY_DROP;
+	Level.FireMs		= INVADER_FIRE_MS;
+	Level.FireSpreadMs	= INVADER_FIRE_SPREAD_MS;
+	return Level;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Level () (Private)
+// Desc : The level being played: the set's levels one after another, round
+//		again after the last.
+//-----------------------------------------------------------------------------
+const SLevel& CGameWorld::Level() const
+{
+	if ( !m_pLevels || !m_pLevels->GetCount() ) return m_Default;
+	return m_pLevels->GetLevel( m_nLevel % m_pLevels->GetCount() );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Spawn () (Private)
+// Desc : One of the level's spawn spots of a kind, picked with Random, or
+//		anywhere in the middle of the screen if it has none.
+//-----------------------------------------------------------------------------
+Vec2 CGameWorld::Spawn( SLevel::ESpawn eKind, CRandom& Random ) const
+{
+	size_t nSpawns = 0;
+	const SLevelSpawn *pSpawns = m_pLevels ? m_pLevels->GetSpawns( Level(), eKind, nSpawns ) : NULL;
+	if ( nSpawns )
+	{
+		const SLevelSpawn& Spot = pSpawns[Random.Below( (uint32_t)nSpawns )];
+		return Vec2( Spot.x, Spot.y );
+	}
+
+	int x = Random.Range( 100, 599 );
+	int y = Random.Range( 100, 599 );
+	return Vec2( x, y );
+}
+
+//-----------------------------------------------------------------------------
+// Name : FireInvader () (Private)
+// Desc : The bottom invader of a random column shoots one of the guns; an
+//		empty column passes the shot on to the next one that is not.
+//-----------------------------------------------------------------------------
+void CGameWorld::FireInvader()
+{
+	CRandom& Random = m_Random[RANDOM_WAVE];
+	int iColumn = m_Formation.NextOccupiedColumn( Random.Below( m_Formation.GetColumns() ) );
+	if ( iColumn < 0 ) return;
+
+	Vec2 Position = m_Formation.GetPosition( iColumn, m_Formation.LowestAlive( iColumn ) );
+	Position.y += m_Size[KIND_ENEMY][1] / 2;
+	const SEmitter& Gun = INVADER_GUNS[Random.Below( sizeof(INVADER_GUNS) / sizeof(INVADER_GUNS[0]) )];
+
+	// The nearest player below, else the nearest one anywhere
+	float X[WORLD_PLAYERS], Y[WORLD_PLAYERS];
+	for ( int i = 0; i < WORLD_PLAYERS; i++ )
+	{
+		X[i] = (float)m_Players[i].Position.x;
+		Y[i] = (float)m_Players[i].Position.y;
+	}
+	m_Targets.Build( X, Y, NULL, WORLD_PLAYERS );
+
+	float x = (float)Position.x, y = (float)Position.y;
+	int32_t iTarget = m_Targets.NearestInCone( x, y, 0.0f, 1.0f, INVADER_AIM_COS );
+	if ( iTarget < 0 ) iTarget = m_Targets.Nearest( x, y );
+
+	Fire( m_EnemyBullets, Gun, Position, m_Players[iTarget].Position );
+}
+
+//-----------------------------------------------------------------------------
+// Name : MoveStar () (Private)
+// Desc : Stars drift diagonally and bounce off the side edges. A player
+//		coming close makes them slip away, up the flow field.
+//-----------------------------------------------------------------------------
+void CGameWorld::MoveStar( SActor& Actor, float dt )
+{
+	if ( m_Field.GetDistance( Actor.Position ) <= STAR_FLEE_CELLS )
+		Actor.Position -= m_Field.Sample( Actor.Position ) * (STAR_FLEE_SPEED * dt);
+
+	Actor.Position.x += Actor.Drift.x * dt;
+	Actor.Position.y += Actor.Drift.y * dt;
+
+	if ( Actor.Position.x - Actor.Width / 2 <= 0 || Actor.Position.x + Actor.Width / 2 >= STAR_MAX_X )
+		Actor.Drift.x = -Actor.Drift.x;
+}
+
+//-----------------------------------------------------------------------------
+// Name : UpdatePlayer () (Private)
+// Desc : Integrates the velocity and runs the engine sound state machine.
+//-----------------------------------------------------------------------------
+void CGameWorld::UpdatePlayer( SActor& Actor, float dt )
+{
+	Actor.Position += Actor.Velocity * dt;
+
+	double v = Actor.Velocity.Magnitude();
+
+	// Keeps the jet sounds from overlapping
+	Actor.SoundTimer += dt;
+
+	if ( !Actor.bEngineOn )
+	{
+		if ( v > 35.0 )
+		{
+			Actor.bEngineOn = true;
+			Event( SGameEvent::EVENT_SOUND, Actor, IPlatform::SOUND_JET_START );
+			Actor.SoundTimer = 0;
+		}
+	}
+	else if ( v < 25.0 )
+	{
+		Actor.bEngineOn = false;
+		Event( SGameEvent::EVENT_SOUND, Actor, IPlatform::SOUND_JET_STOP );
+		Actor.SoundTimer = 0;
+	}
+	else if ( Actor.SoundTimer > 1.0f )
+	{
+		Event( SGameEvent::EVENT_SOUND, Actor, IPlatform::SOUND_JET_CABIN );
+		Actor.SoundTimer = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : Rotate () (Private)
+// Desc : Quarter turn to the left, the collision box turns with the plane.
+//-----------------------------------------------------------------------------
+void CGameWorld::Rotate( SActor& Actor )
+{
+	switch ( Actor.Facing )
+	{
+	case SActor::DIR_FORWARD:	Actor.Facing = SActor::DIR_LEFT; break;
+	case SActor::DIR_LEFT:		Actor.Facing = SActor::DIR_BACKWARD; break;
+	case SActor::DIR_BACKWARD:	Actor.Facing = SActor::DIR_RIGHT; break;
+	case SActor::DIR_RIGHT:		Actor.Facing = SActor::DIR_FORWARD; break;
+	}
+
+	std::swap( Actor.Width, Actor.Height );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Fire () (Private)
+// Desc : Spawns the gun's pattern at the muzzle position given, aimed guns
+//		aiming at Target.
+//-----------------------------------------------------------------------------
+void CGameWorld::Fire( CProjectiles& Shots, const SEmitter& Gun, const Vec2& Position, const Vec2& Target )
+{
+	Shots.Emit( Gun, Position, Target );
+}
+
+//-----------------------------------------------------------------------------
+// Name : MoveBullets () (Private)
+// Desc : Moves every shot, then drops those that left the screen and those
+//		that hit something last tick.
+//-----------------------------------------------------------------------------
+void CGameWorld::MoveBullets( float dt )
+{
+	float fHalfWidth = m_Size[KIND_BULLET][0] / 2.0f, fHalfHeight = m_Size[KIND_BULLET][1] / 2.0f;
+
+	m_Bullets.Integrate( dt );
+	m_EnemyBullets.Integrate( dt );
+
+	m_Bullets.Cull( -fHalfWidth, -fHalfHeight, WORLD_RIGHT + fHalfWidth, WORLD_BOTTOM + fHalfHeight );
+	m_EnemyBullets.Cull( -fHalfWidth, -fHalfHeight, WORLD_RIGHT + fHalfWidth, WORLD_BOTTOM + fHalfHeight );
+}
+
+//-----------------------------------------------------------------------------
+// Name : CheckCollisions () (Private)
+// Desc : Bullet hits, run at the end of every tick. A player shot takes out
+//		one invader and is gone; a new wave lines up once the last one is
+//		shot down, or once the wave has landed, which costs a life.
+//-----------------------------------------------------------------------------
+void CGameWorld::CheckCollisions()
+{
+	int w = m_Size[KIND_BULLET][0], h = m_Size[KIND_BULLET][1];
+	float t;
+
+	// Shots are followed along their path over the tick, so however fast
+	// they fly they cannot skip over an invader
+	for ( size_t j = 0; j < m_Bullets.GetCount(); j++ )
+	{
+		int c, r;
+		if ( !m_Bullets.IsLive( j ) ) continue;
+		if ( !m_Formation.Sweep( m_Bullets.GetPrevPosition( j ), m_Bullets.GetPosition( j ), w, h, c, r, t ) ) continue;
+
+		Vec2 Position = m_Formation.GetPosition( c, r );
+		m_Formation.Kill( c, r );
+		SActor& Blast = m_Blasts[m_nBlast++ % WORLD_BLASTS];
+		SetPosition( Blast, Position );
+		Event( SGameEvent::EVENT_EXPLOSION, Blast, 0 );
+		Event( SGameEvent::EVENT_SCORE, m_Players[0], 1 );
+		m_Bullets.Kill( j );
+	}
+
+	if ( !m_Formation.GetAliveCount() )
+	{
+		if ( !m_Timers.IsPending( m_hWave ) ) m_hWave = m_Timers.Start( MsToTicks( WAVE_DELAY_MS ), TIMER_NEXT_WAVE, 0 );
+	}
+	else if ( m_Formation.GetBottom() >= FORMATION_FLOOR )
+	{
+		Event( SGameEvent::EVENT_LIFE, m_Players[0], -1 );
+		NewWave();
+	}
+
+	SActor& Player = m_Players[0];
+	if ( m_EnemyBullets.Sweep( Box( Player ), Player.Position - Player.PrevPosition, w, h, t ) >= 0 )
+	{
+		Event( SGameEvent::EVENT_EXPLOSION, Player, 0 );
+		Event( SGameEvent::EVENT_LIFE, Player, -1 );
+
+		SetPosition( Player, Spawn( SLevel::SPAWN_RESPAWN, m_Random[ActorIndex( Player )] ) );
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// Name : ApplyEvents () (Private)
+// Desc : Carries out what the tick's events do to the game: explosions
+//		start where the actor was when it blew up (one already going carries
+//		on from its frame, moved there), then scores and lives are counted.
+//-----------------------------------------------------------------------------
+void CGameWorld::ApplyEvents()
+{
+	size_t i;
+
+	for ( i = 0; i < m_Events.GetCount( SGameEvent::EVENT_EXPLOSION ); i++ )
+	{
+		const SGameEvent& Explosion = m_Events.Get( SGameEvent::EVENT_EXPLOSION, i );
+		SActor& Exploding = Actor( Explosion.Actor );
+		m_Animations.Play( ANIM_EXPLOSION, Explosion.Actor );
+		Exploding.bExploding		= true;
+		Exploding.ExplosionPosition	= Explosion.Position;
+	}
+
+	for ( i = 0; i < m_Events.GetCount( SGameEvent::EVENT_SCORE ); i++ )
+	{
+		const SGameEvent& Score = m_Events.Get( SGameEvent::EVENT_SCORE, i );
+		Actor( Score.Actor ).Score += Score.Value;
+	}
+
+	for ( i = 0; i < m_Events.GetCount( SGameEvent::EVENT_LIFE ); i++ )
+	{
+		const SGameEvent& Life = m_Events.Get( SGameEvent::EVENT_LIFE, i );
+		Actor( Life.Actor ).Lives += Life.Value;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : RequestField () (Private)
+// Desc : Has the flow field follow the players, if either changed cells.
+//		The next Step waits for it before anything steers.
+//-----------------------------------------------------------------------------
+void CGameWorld::RequestField()
+{
+	Vec2 Goals[WORLD_PLAYERS];
+	for ( int i = 0; i < WORLD_PLAYERS; i++ ) Goals[i] = m_Players[i].Position;
+	m_Field.Request( Goals, WORLD_PLAYERS );
+}
+
+//-----------------------------------------------------------------------------
+// Name : DispatchEvents () (Private)
+// Desc : Hands the tick's events on to the platform as sounds and screen
+//		effects, once the tick is over.
+//-----------------------------------------------------------------------------
+void CGameWorld::DispatchEvents()
+{
+	size_t i;
+	if ( !m_pPlatform ) return;
+
+	for ( i = 0; i < m_Events.GetCount( SGameEvent::EVENT_EXPLOSION ); i++ )
+		m_pPlatform->OnSound( IPlatform::SOUND_EXPLOSION );
+
+	for ( i = 0; i < m_Events.GetCount( SGameEvent::EVENT_SOUND ); i++ )
+		m_pPlatform->OnSound( (IPlatform::ESound)m_Events.Get( SGameEvent::EVENT_SOUND, i ).Value );
+
+	// An invader shot down blooms, a life lost flashes
+	for ( i = 0; i < m_Events.GetCount( SGameEvent::EVENT_SCORE ); i++ )
+		m_pPlatform->OnEffect( IPlatform::EFFECT_BLOOM, 1.0f );
+
+	for ( i = 0; i < m_Events.GetCount( SGameEvent::EVENT_LIFE ); i++ )
+		if ( m_Events.Get( SGameEvent::EVENT_LIFE, i ).Value < 0 ) m_pPlatform->OnEffect( IPlatform::EFFECT_DAMAGE_FLASH, 1.0f );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Animate () (Private)
+// Desc : Plays the animations dt further, copies their frames to the actors
+//		and puts the actors whose explosion ended back to normal.
+//-----------------------------------------------------------------------------
+void CGameWorld::Animate( float dt )
+{
+	int32_t Finished[WORLD_ACTORS];
+	size_t nFinished = m_Animations.Advance( dt, Finished );
+
+	for ( size_t i = 0; i < m_Animations.GetCount(); i++ )
+	{
+		const SAnimation& Animation = m_Animations.Get( i );
+		Actor( Animation.Owner ).ExplosionFrame = Animation.Frame;
+	}
+
+	for ( size_t i = 0; i < nFinished; i++ )
+	{
+		SActor& Done = Actor( Finished[i] );
+		Done.bExploding		= false;
+		Done.ExplosionFrame	= 0;
+		Done.Velocity		= Vec2( 0, 0 );
+		Done.bEngineOn		= false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : ActorIndex / Actor () (Private)
+// Desc : Numbers the players, then the blasts, then the stars from 0 up, so
+//		an animation can name the actor it belongs to.
+//-----------------------------------------------------------------------------
+int CGameWorld::ActorIndex( const SActor& Actor ) const
+{
+	const SActor *p = &Actor;
+	if ( p >= m_Players && p < m_Players + WORLD_PLAYERS ) return (int)(p - m_Players);
+	if ( p >= m_Blasts && p < m_Blasts + WORLD_BLASTS ) return WORLD_PLAYERS + (int)(p - m_Blasts);
+	if ( p >= m_Stars && p < m_Stars + WORLD_STARS ) return WORLD_PLAYERS + WORLD_BLASTS + (int)(p - m_Stars);
+	return -1;
+}
+
+SActor& CGameWorld::Actor( int i )
+{
+	if ( i < WORLD_PLAYERS ) return m_Players[i];
+	if ( i < WORLD_PLAYERS + WORLD_BLASTS ) return m_Blasts[i - WORLD_PLAYERS];
+	return m_Stars[i - WORLD_PLAYERS - WORLD_BLASTS];
+}
+
+//-----------------------------------------------------------------------------
+// Name : IsGameOver ()
+// Desc : A player has run out of lives.
+//-----------------------------------------------------------------------------
+bool CGameWorld::IsGameOver() const
+{
+	return !m_Players[0].Lives || !m_Players[1].Lives;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Capture ()
+// Desc : Copies the drawable state out, so it can be drawn on another thread
+//		while the world moves on.
+//-----------------------------------------------------------------------------
+void CGameWorld::Capture( SWorldSnapshot& Snapshot ) const
+{
+	int i;
+
+	Snapshot.Tick = m_nTick;
+	for ( i = 0; i < WORLD_PLAYERS; i++ ) Snapshot.Players[i] = m_Players[i];
+	for ( i = 0; i < WORLD_BLASTS; i++ ) Snapshot.Blasts[i] = m_Blasts[i];
+	for ( i = 0; i < WORLD_STARS; i++ ) Snapshot.Stars[i] = m_Stars[i];
+
+	Snapshot.Invaders.clear();
+	for ( int c = 0; c < m_Formation.GetColumns(); c++ )
+	{
+		for ( int r = 0; r < m_Formation.GetRows(); r++ )
+		{
+			if ( !m_Formation.IsAlive( c, r ) ) continue;
+
+			SInvader Invader;
+			Invader.Position	 = m_Formation.GetPosition( c, r );
+			Invader.PrevPosition = m_Formation.GetPrevPosition( c, r );
+			Snapshot.Invaders.push_back( Invader );
+		}
+	}
+
+	CaptureShots( m_Bullets, Snapshot.Bullets );
+	CaptureShots( m_EnemyBullets, Snapshot.EnemyBullets );
+	Snapshot.bGameOver = IsGameOver();
+}
+
+//-----------------------------------------------------------------------------
+// Name : CaptureShots () (Private)
+// Desc : The live shots of one side, as the renderer draws them.
+//-----------------------------------------------------------------------------
+void CGameWorld::CaptureShots( const CProjectiles& Shots, std::vector<SBullet>& Bullets ) const
+{
+	Bullets.clear();
+	for ( size_t i = 0; i < Shots.GetCount(); i++ )
+	{
+		if ( !Shots.IsLive( i ) ) continue;
+
+		SBullet Bullet;
+		Bullet.Position		= Shots.GetPosition( i );
+		Bullet.PrevPosition	= Shots.GetPrevPosition( i );
+		Bullets.push_back( Bullet );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetStateSize ()
+// Desc : Bytes SaveState needs right now. Grows with the number of shots.
+//-----------------------------------------------------------------------------
+size_t CGameWorld::GetStateSize() const
+{
+	return sizeof(SWorldState) + m_Bullets.GetStateSize() + m_EnemyBullets.GetStateSize() + m_Formation.GetStateSize()
+		 + m_Animations.GetStateSize() + m_Timers.GetStateSize();
+}
+
+//-----------------------------------------------------------------------------
+// Name : SaveState ()
+// Desc : Copies the complete simulation state into pBuffer, which has to be
+//		aligned for a double (as new and std::vector give). Returns the bytes
+//		written, or 0 if nCapacity is too small. Allocates nothing.
+//-----------------------------------------------------------------------------
+size_t CGameWorld::SaveState( void *pBuffer, size_t nCapacity ) const
+{
+	size_t nSize = GetStateSize();
+	if ( nCapacity < nSize ) return 0;
+
+	SWorldState *pState = (SWorldState*)pBuffer;
+	pState->Magic			= STATE_MAGIC;
+	pState->Size			= (uint32_t)nSize;
+	pState->Tick			= m_nTick;
+	pState->Blast			= m_nBlast;
+	pState->Bullets			= (uint32_t)m_Bullets.GetStateSize();
+	pState->EnemyBullets	= (uint32_t)m_EnemyBullets.GetStateSize();
+	pState->Formation		= (uint32_t)m_Formation.GetStateSize();
+	pState->Animations		= (uint32_t)m_Animations.GetStateSize();
+	pState->Timers			= (uint32_t)m_Timers.GetStateSize();
+	pState->Wave			= m_hWave;
+	pState->Level			= m_nLevel;
+	memcpy( pState->Guns, m_hGuns, sizeof(m_hGuns) );
+	memcpy( pState->Random, m_Random, sizeof(m_Random) );
+	memcpy( pState->SpriteSize, m_Size, sizeof(m_Size) );
+	memcpy( pState->Players, m_Players, sizeof(m_Players) );
+	memcpy( pState->Blasts, m_Blasts, sizeof(m_Blasts) );
+	memcpy( pState->Stars, m_Stars, sizeof(m_Stars) );
+
+	uint8_t *p = (uint8_t*)(pState + 1);
+	m_Bullets.SaveState( p );
+	p += pState->Bullets;
+	m_EnemyBullets.SaveState( p );
+	p += pState->EnemyBullets;
+	m_Formation.SaveState( p );
+	p += pState->Formation;
+	m_Animations.SaveState( p );
+	p += pState->Animations;
+	m_Timers.SaveState( p );
+
+	return nSize;
+}
+
+//-----------------------------------------------------------------------------
+// Name : LoadState ()
+// Desc : Puts the world back into a state taken by SaveState, in place; the
+//		vectors only allocate if they never held that many shots or invaders.
+//		False, with the world untouched, if the data is not a state.
+//-----------------------------------------------------------------------------
+bool CGameWorld::LoadState( const void *pBuffer, size_t nSize )
+{
+	const SWorldState *pState = (const SWorldState*)pBuffer;
+	if ( nSize < sizeof(SWorldState) || pState->Magic != STATE_MAGIC || pState->Size != nSize ) return false;
+	if ( sizeof(SWorldState) + (size_t)pState->Bullets + pState->EnemyBullets + pState->Formation + pState->Animations + pState->Timers != nSize ) return false;
+
+	// The formation checks itself as it loads, so everything else is checked first
+	const uint8_t *pBullets = (const uint8_t*)(pState + 1);
+	const uint8_t *pEnemyBullets = pBullets + pState->Bullets;
+	const uint8_t *pFormation = pEnemyBullets + pState->EnemyBullets;
+	const uint8_t *pAnimations = pFormation + pState->Formation;
+	const uint8_t *pTimers = pAnimations + pState->Animations;
+	if ( !CProjectiles::IsState( pBullets, pState->Bullets ) || !CProjectiles::IsState( pEnemyBullets, pState->EnemyBullets ) ) return false;
+	if ( !m_Animations.IsState( pAnimations, pState->Animations ) || !CTimerWheel::IsState( pTimers, pState->Timers ) ) return false;
+	if ( !m_Formation.LoadState( pFormation, pState->Formation ) ) return false;
+	m_Bullets.LoadState( pBullets, pState->Bullets );
+	m_EnemyBullets.LoadState( pEnemyBullets, pState->EnemyBullets );
+	m_Animations.LoadState( pAnimations, pState->Animations );
+	m_Timers.LoadState( pTimers, pState->Timers );
+
+	m_nTick			= pState->Tick;
+	m_hWave			= pState->Wave;
+	m_nLevel		= pState->Level;
+	memcpy( m_hGuns, pState->Guns, sizeof(m_hGuns) );
+	memcpy( m_Random, pState->Random, sizeof(m_Random) );
+	m_nBlast		= pState->Blast;
+	memcpy( m_Size, pState->SpriteSize, sizeof(m_Size) );
+	memcpy( m_Players, pState->Players, sizeof(m_Players) );
+	memcpy( m_Blasts, pState->Blasts, sizeof(m_Blasts) );
+	memcpy( m_Stars, pState->Stars, sizeof(m_Stars) );
+
+	// Those were the events of a tick that is no longer the last one
+	m_Events.Clear();
+	RequestField();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Checksum ()
+// Desc : FNV-1a over the state that matters for gameplay. Two runs agree on
+//		it after every tick exactly when they played the same game.
+//-----------------------------------------------------------------------------
+uint32_t CGameWorld::Checksum() const
+{
+	uint32_t h = 2166136261u;
+	auto Mix = [&h]( const void *p, size_t n )
+	{
+		const unsigned char *b = (const unsigned char*)p;
+		for ( size_t i = 0; i < n; i++ ) h = (h ^ b[i]) * 16777619u;
+	};
+	auto MixActor = [&Mix]( const SActor& a )
+	{
+		Mix( &a.Position, sizeof(a.Position) );
+		Mix( &a.Velocity, sizeof(a.Velocity) );
+		Mix( &a.Lives, sizeof(a.Lives) );
+		Mix( &a.Score, sizeof(a.Score) );
+		Mix( &a.ExplosionFrame, sizeof(a.ExplosionFrame) );
+	};
+	int i;
+
+	Mix( &m_nTick, sizeof(m_nTick) );
+	for ( i = 0; i < WORLD_STREAMS; i++ ) h = m_Random[i].Checksum( h );
+	for ( i = 0; i < WORLD_PLAYERS; i++ ) MixActor( m_Players[i] );
+	for ( i = 0; i < WORLD_BLASTS; i++ ) MixActor( m_Blasts[i] );
+	for ( i = 0; i < WORLD_STARS; i++ ) MixActor( m_Stars[i] );
+	h = m_Bullets.Checksum( h );
+	h = m_EnemyBullets.Checksum( h );
+	h = m_Animations.Checksum( h );
+	h = m_Timers.Checksum( h );
+	return m_Formation.Checksum( h );
+}
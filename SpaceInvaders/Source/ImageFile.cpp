@@ -3,7 +3,11 @@
 // March 2009
 #include "ImageFile.h"
 
+#ifdef _WIN32
 extern HINSTANCE g_hInst;
+#else
+#include <vector>
+#endif
 
 
 CImageFile::CImageFile() : height(m_biInfo.biHeight), width(m_biInfo.biWidth)
@@ -13,6 +17,8 @@ CImageFile::CImageFile() : height(m_biInfo.biHeight), width(m_biInfo.biWidth)
 	ZeroMemory(&m_biInfo, sizeof(BITMAPINFOHEADER));
 }
 
+#ifdef _WIN32
+
 bool CImageFile::LoadBitmapFromFile(const char *szFileName, HDC hdc)
 {
 	BYTE *pData;
@@ -27,11 +33,7 @@ bool CImageFile::LoadBitmapFromFile(const char *szFileName, HDC hdc)
 		m_pRGB = NULL;
 	}
 
-	if(m_hBMP)
-	{
-		DeleteObject(m_hBMP);
-		m_hBMP = 0;
-	}
+	DeleteBitmap();
 
 	// Loads the image.
 	m_hBMP = (HBITMAP)LoadImage(g_hInst, szFileName, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE);	
@@ -74,8 +76,7 @@ bool CImageFile::LoadBitmapFromFile(const char *szFileName, HDC hdc)
 
 	m_biInfo.biBitCount = 32;
 
-	DeleteObject(m_hBMP);
-	m_hBMP = 0;
+	DeleteBitmap();
 
 	DeleteDC(mdc);
 
@@ -84,11 +85,142 @@ bool CImageFile::LoadBitmapFromFile(const char *szFileName, HDC hdc)
 	return true;
 }
 
+#else // _WIN32
+
+namespace
+{
+	// Little endian fields of the file, wherever they happen to sit
+	inline DWORD ReadLE(const BYTE *p, int bytes)
+	{
+		DWORD v = 0;
+		for(int i = bytes - 1; i >= 0; i--)
+			v = (v << 8) | p[i];
+		return v;
+	}
+}
+
+bool CImageFile::LoadBitmapFromFile(const char *szFileName, HDC)
+{
+	snprintf(m_szFileName, MAX_PATH, "%s", szFileName);
+
+	// release previously loaded file data
+	if(m_pRGB)
+	{
+		delete[] m_pRGB;
+		m_pRGB = NULL;
+	}
+
+	FILE *f = fopen(szFileName, "rb");
+	if(!f)
+		return false;
+
+	std::vector<BYTE> file;
+	BYTE chunk[65536];
+	size_t n;
+	while((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+		file.insert(file.end(), chunk, chunk + n);
+	fclose(f);
+
+	// BITMAPFILEHEADER (14 bytes) then a BITMAPINFOHEADER or a later version
+	if(file.size() < 54 || file[0] != 'B' || file[1] != 'M')
+		return false;
+
+	const BYTE *pFile = &file[0];
+	DWORD offBits = ReadLE(pFile + 10, 4);
+	DWORD headerSize = ReadLE(pFile + 14, 4);
+	LONG fileWidth = (LONG)ReadLE(pFile + 18, 4);
+	LONG fileHeight = (LONG)ReadLE(pFile + 22, 4);
+	int bits = (int)ReadLE(pFile + 28, 2);
+	DWORD compression = ReadLE(pFile + 30, 4);
+	DWORD colors = ReadLE(pFile + 46, 4);
+
+	bool bTopDown = fileHeight < 0;
+	int w = fileWidth, h = bTopDown ? -fileHeight : fileHeight;
+	if(headerSize < 40 || compression != BI_RGB || w <= 0 || h <= 0 || w > 32768 || h > 32768 ||
+		(bits != 1 && bits != 4 && bits != 8 && bits != 24 && bits != 32))
+		return false;
+
+	size_t stride = ((size_t)w * bits + 31) / 32 * 4;
+	if(offBits > file.size() || file.size() - offBits < stride * h)
+		return false;
+
+	// Palette entries are RGBQUADs already
+	RGBQUAD palette[256];
+	ZeroMemory(palette, sizeof(palette));
+	if(bits <= 8)
+	{
+		if(colors == 0 || colors > (1u << bits))
+			colors = 1u << bits;
+		size_t palOffset = 14 + headerSize;
+		if(palOffset + colors * 4 > offBits)
+			return false;
+		memcpy(palette, pFile + palOffset, colors * 4);
+	}
+
+	m_pRGB = new RGBQUAD[w * h];
+
+	// Bottom-up, as GetDIBits gives them
+	for(int y = 0; y < h; y++)
+	{
+		const BYTE *pRow = pFile + offBits + stride * (bTopDown ? h - 1 - y : y);
+		RGBQUAD *c = m_pRGB + y * w;
+
+		for(int x = 0; x < w; x++, c++)
+		{
+			switch(bits)
+			{
+			case 1:		*c = palette[(pRow[x >> 3] >> (7 - (x & 7))) & 1]; break;
+			case 4:		*c = palette[(pRow[x >> 1] >> (x & 1 ? 0 : 4)) & 15]; break;
+			case 8:		*c = palette[pRow[x]]; break;
+			case 24:	c->rgbBlue = pRow[x * 3]; c->rgbGreen = pRow[x * 3 + 1]; c->rgbRed = pRow[x * 3 + 2]; break;
+			case 32:	memcpy(c, pRow + x * 4, 4); break;
+			}
+			c->rgbReserved = 0;
+		}
+	}
+
+	ZeroMemory(&m_biInfo, sizeof(BITMAPINFOHEADER));
+	m_biInfo.biSize = sizeof(BITMAPINFOHEADER);
+	m_biInfo.biWidth = w;
+	m_biInfo.biHeight = h;
+	m_biInfo.biPlanes = 1;
+	m_biInfo.biBitCount = 32;
+	m_biInfo.biCompression = BI_RGB;
+	m_biInfo.biSizeImage = w * h * sizeof(RGBQUAD);
+
+	return true;
+}
+
+#endif // !_WIN32
+
 void CImageFile::Reload(HDC hdc)
 {
 	LoadBitmapFromFile(m_szFileName, hdc);
 }
 
+void CImageFile::Release()
+{
+	// drop the pixels and the cached bitmap, the header keeps the size
+	if(m_pRGB)
+	{
+		delete[] m_pRGB;
+		m_pRGB = NULL;
+	}
+
+	DeleteBitmap();
+}
+
+void CImageFile::DeleteBitmap()
+{
+#ifdef _WIN32
+	if(m_hBMP)
+		DeleteObject(m_hBMP);
+#endif
+	m_hBMP = 0;
+}
+
+#ifdef _WIN32
+
 void CImageFile::Paint(HDC hdc, int x, int y)
 {
 	if(!m_pRGB)
@@ -107,16 +239,24 @@ void CImageFile::Paint(HDC hdc, int x, int y)
 	BitBlt(hdc, x, height - y, width, y, mdc, x, 0, SRCCOPY);
 
 	DeleteDC(mdc);
+}
 
+#else // _WIN32
+
+void CImageFile::Paint(HDC, int, int)
+{
+	// nothing to draw on
 }
 
+#endif // !_WIN32
+
 
 CImageFile::~CImageFile(void)
 {
 	if(m_pRGB)
 		delete[] m_pRGB;
 
-	DeleteObject(m_hBMP);
+	DeleteBitmap();
 }
 
 BYTE* CImageFile::CopyMonoImage(EColorChannel chn, const RECT* rc)
@@ -152,109 +292,22 @@ BYTE* CImageFile::CopyMonoImage(EColorChannel chn, const RECT* rc)
 	case ECC_HUE:
 		for(int i=0;i<imgHeight;i++)
 			for(int j=0;j<imgWidth;j++)
-			{
-				RGBQUAD &q = m_pRGB[(i+y)*width + j + x];
-				float r = q.rgbRed/255.0f;
-				float g = q.rgbGreen/255.0f;
-				float b = q.rgbBlue/255.0f;
-
-				float u = max(r, g);
-				u = max(b, u);
-				float d = min(r, g);
-				d = min(b, d);
-
-				BYTE v;
-
-				if(fabsf(u-d)<EPS)
-					v=0;
-				else
-				{
-					float f = 1/(u-d);
-
-					if(fabsf(u-r)<EPS)
-					{
-						f *= (g-b)*60.f;
-					}
-					else
-					if(fabsf(u-g)<EPS)
-					{
-						f *= (b-r)*60.f;
-						f += 120;
-					}
-					else
-					if(fabsf(u-b)<EPS)
-					{
-						f *= (r-g)*60.f;
-						f += 240;
-					}
-
-					v = (BYTE)(f*255.f/360.f);
-				}
-
-				img[i*imgWidth + j] = v;
-			}
+				img[i*imgWidth + j] = RGBToHue(m_pRGB[(i+y)*width + j + x]);
+		break;
 
 	case ECC_SATURATION:
 		for(int i=0;i<imgHeight;i++)
 			for(int j=0;j<imgWidth;j++)
-			{
-				RGBQUAD &q = m_pRGB[(i+y)*width + j + x];
-				float r = q.rgbRed/255.0f;
-				float g = q.rgbGreen/255.0f;
-				float b = q.rgbBlue/255.0f;
-
-				float u = max(r, g);
-				u = max(b, u);
-				float d = min(r, g);
-				d = min(b, d);
-
-				BYTE v;
-
-				if(fabsf(u-d)<EPS)
-					v=0;
-				else
-				{
-					float l = (u+d)/2;
-					float f = (u-d);
-
-					if(l<=0.5f)
-						f /= u+d;
-					else
-						f /= 2-u-d;
-
-					v = (BYTE)(f*255.f);
-				}
-
-				img[i*imgWidth + j] = v;
-			}
+				img[i*imgWidth + j] = RGBToSaturation(m_pRGB[(i+y)*width + j + x]);
 		break;
 
 	case ECC_LUMINOSITY:
 		for(int i=0;i<imgHeight;i++)
 			for(int j=0;j<imgWidth;j++)
-			{
-				RGBQUAD &q = m_pRGB[(i+y)*width + j + x];
-				float r = q.rgbRed/255.0f;
-				float g = q.rgbGreen/255.0f;
-				float b = q.rgbBlue/255.0f;
-
-				float u = max(r, g);
-				u = max(b, u);
-				float d = min(r, g);
-				d = min(b, d);
-
-				BYTE v;
-
-				if(fabsf(u-d)<EPS)
-					v=0;
-				else
-				{
-					float f = (u+d)/2;
-					v = (BYTE)(f*255.f);
-				}
-
-				img[i*imgWidth + j] = v;
-			}
+				img[i*imgWidth + j] = RGBToLuminosity(m_pRGB[(i+y)*width + j + x]);
+		break;
+
+	default:
 		break;
 	}
 
@@ -294,7 +347,94 @@ void CImageFile::PasteMonoImage(const BYTE *img, EColorChannel chn, const RECT*
 			for(int j=0;j<imgWidth;j++)
 				m_pRGB[(i+y)*width + j + x].rgbBlue = img[i*imgWidth + j];
 		break;
+
+	default:
+		break;
 	}
 
 }
 
+
+
+BYTE RGBToHue(const RGBQUAD &q)
+{
+	float r = q.rgbRed/255.0f;
+	float g = q.rgbGreen/255.0f;
+	float b = q.rgbBlue/255.0f;
+
+	float u = max(r, g);
+	u = max(b, u);
+	float d = min(r, g);
+	d = min(b, d);
+
+	if(fabsf(u-d)<EPS)
+		return 0;
+
+	float f = 1/(u-d);
+
+	if(fabsf(u-r)<EPS)
+	{
+		f *= (g-b)*60.f;
+	}
+	else
+	if(fabsf(u-g)<EPS)
+	{
+		f *= (b-r)*60.f;
+		f += 120;
+	}
+	else
+	if(fabsf(u-b)<EPS)
+	{
+		f *= (r-g)*60.f;
+		f += 240;
+	}
+
+	// reds leaning towards blue come out negative
+	if(f < 0)
+		f += 360;
+
+	return (BYTE)(f*255.f/360.f);
+}
+
+BYTE RGBToSaturation(const RGBQUAD &q)
+{
+	float r = q.rgbRed/255.0f;
+	float g = q.rgbGreen/255.0f;
+	float b = q.rgbBlue/255.0f;
+
+	float u = max(r, g);
+	u = max(b, u);
+	float d = min(r, g);
+	d = min(b, d);
+
+	if(fabsf(u-d)<EPS)
+		return 0;
+
+	float l = (u+d)/2;
+	float f = (u-d);
+
+	if(l<=0.5f)
+		f /= u+d;
+	else
+		f /= 2-u-d;
+
+	return (BYTE)(f*255.f);
+}
+
+BYTE RGBToLuminosity(const RGBQUAD &q)
+{
+	float r = q.rgbRed/255.0f;
+	float g = q.rgbGreen/255.0f;
+	float b = q.rgbBlue/255.0f;
+
+	float u = max(r, g);
+	u = max(b, u);
+	float d = min(r, g);
+	d = min(b, d);
+
+	if(fabsf(u-d)<EPS)
+		return 0;
+
+	float f = (u+d)/2;
+	return (BYTE)(f*255.f);
+}
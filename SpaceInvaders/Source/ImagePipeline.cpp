@@ -0,0 +1,501 @@
+// ImagePipeline.cpp
+// Single channel processing chains (extract, point operations, convolutions,
+// insert) executed strip by strip instead of one full image pass per step.
+//
+// For every strip of output rows the pipeline first works out, stage by
+// stage going backwards, which image rows each stage has to produce (a
+// convolution needs its radius worth of extra rows, mapped through its
+// border mode). The stages then run forwards over just those rows, ping
+// ponging between two small per thread buffers. Neighbouring strips
+// recompute the few rows they share, which is far cheaper than writing and
+// reading back a full plane per step.
+//
+// The convolution arithmetic is the same fixed point scheme CConvolution
+// uses, on one 8 bit channel instead of four, so the SSE2 and the plain C
+// paths agree bit for bit.
+#include "ImagePipeline.h"
+#include "ConvolutionMath.h"
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	// Position of image row y among the rows a buffer holds
+	inline int FindRow(const std::vector<int> &rows, int y)
+	{
+		return (int)(std::lower_bound(rows.begin(), rows.end(), y) - rows.begin());
+	}
+
+	// Copies a row with radius border pixels on both sides and zeroes the
+	// tail, so every 8 pixel block of taps can be read without checks.
+	void BuildLine(const BYTE *pRow, int width, int radius, EBorderMode border, BYTE *pLine, int lineSize)
+	{
+		for(int i = 0; i < radius; i++)
+			pLine[i] = pRow[CConvolution::MapBorder(i - radius, width, border)];
+		memcpy(pLine + radius, pRow, width);
+		for(int i = radius + width; i < width + 2 * radius; i++)
+			pLine[i] = pRow[CConvolution::MapBorder(i - radius, width, border)];
+		memset(pLine + width + 2 * radius, 0, lineSize - width - 2 * radius);
+	}
+
+#ifdef USE_SSE2
+	// Adds the taps for the 8 pixels starting at x to acc0 (x..x+3) and acc1 (x+4..x+7)
+	inline void DotLine(const BYTE *pLine, int x, const int *weights, int taps, __m128i &acc0, __m128i &acc1)
+	{
+		__m128i zero = _mm_setzero_si128();
+		const BYTE *p = pLine + x;
+		for(int k = 0; k < taps; k += 2, p += 2)
+		{
+			__m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), zero);
+			__m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p + 1)), zero);
+			__m128i w = PairWeights(weights, k / 2);
+			acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+			acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+		}
+	}
+#else
+	inline int DotLine(const BYTE *pLine, int x, const short *weights, int taps)
+	{
+		int acc = 0;
+		for(int k = 0; k < taps; k++)
+			acc += pLine[x + k] * weights[k];
+		return acc;
+	}
+#endif
+}
+
+CImagePipeline::CImagePipeline(CWorkerPool *pPool)
+{
+	m_pPool = pPool;
+	m_iStripHeight = 32;
+}
+
+CImagePipeline& CImagePipeline::Extract(EColorChannel chn)
+{
+	assert(chn <= ECC_LUMINOSITY && "Not a channel that can be extracted!");
+
+	SStage stage;
+	stage.type = EST_EXTRACT;
+	stage.channel = chn;
+	stage.border = EBM_CLAMP;
+	stage.radius = 0;
+	m_Stages.push_back(stage);
+	return *this;
+}
+
+CImagePipeline& CImagePipeline::Point(const BYTE lut[256])
+{
+	SStage stage;
+	stage.type = EST_POINT;
+	stage.channel = ECC_RED;
+	memcpy(stage.lut, lut, 256);
+	stage.border = EBM_CLAMP;
+	stage.radius = 0;
+	m_Stages.push_back(stage);
+	return *this;
+}
+
+CImagePipeline& CImagePipeline::Point(BYTE (*fn)(BYTE))
+{
+	BYTE lut[256];
+	for(int i = 0; i < 256; i++)
+		lut[i] = fn((BYTE)i);
+	return Point(lut);
+}
+
+CImagePipeline& CImagePipeline::Convolve(const CKernel &kernel, EBorderMode border)
+{
+	SStage stage;
+	stage.type = EST_CONVOLVE;
+	stage.channel = ECC_RED;
+	stage.kernel = kernel;
+	stage.border = border;
+	stage.radius = kernel.RadiusY();
+	m_Stages.push_back(stage);
+	return *this;
+}
+
+CImagePipeline& CImagePipeline::Insert(EColorChannel chn)
+{
+	assert((chn <= ECC_BLUE || chn >= ECC_EXCLUSIVERED) && "Not a channel that can be inserted!");
+
+	SStage stage;
+	stage.type = EST_INSERT;
+	stage.channel = chn;
+	stage.border = EBM_CLAMP;
+	stage.radius = 0;
+	m_Stages.push_back(stage);
+	return *this;
+}
+
+bool CImagePipeline::IsValid() const
+{
+	if(m_Stages.size() < 2 || m_Stages.front().type != EST_EXTRACT || m_Stages.back().type != EST_INSERT)
+		return false;
+
+	for(size_t i = 1; i + 1 < m_Stages.size(); i++)
+		if(m_Stages[i].type == EST_EXTRACT || m_Stages[i].type == EST_INSERT)
+			return false;
+
+	return true;
+}
+
+bool CImagePipeline::Run(CImageFile &img)
+{
+	return Run(img.Bits(), img.Bits(), img.Width(), img.Height());
+}
+
+bool CImagePipeline::Run(const CImageFile &src, CImageFile &dst)
+{
+	if(src.Width() != dst.Width() || src.Height() != dst.Height())
+		return false;
+
+	return Run(src.Bits(), dst.Bits(), src.Width(), src.Height());
+}
+
+bool CImagePipeline::Run(const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int height)
+{
+	if(!IsValid() || !pSrc || !pDst || width <= 0 || height <= 0)
+		return false;
+
+	int stripHeight = m_iStripHeight;
+	int strips = (height + stripHeight - 1) / stripHeight;
+
+	std::vector<RowPlan> plans(strips);
+	for(int i = 0; i < strips; i++)
+		PlanStrip(i * stripHeight, min((i + 1) * stripHeight, height), height, plans[i]);
+
+	// Working in place, a strip may read source rows that another strip
+	// overwrites. Only those rows are saved, which is nothing at all when
+	// the chain has no convolution.
+	std::vector<int> saved;
+	std::vector<RGBQUAD> savedRows;
+	if(pSrc == pDst)
+	{
+		int count = 0;
+		saved.assign(height, -1);
+		for(int i = 0; i < strips; i++)
+		{
+			int y0 = i * stripHeight, y1 = min(y0 + stripHeight, height);
+			const std::vector<int> &rows = plans[i][0];
+			for(size_t j = 0; j < rows.size(); j++)
+				if((rows[j] < y0 || rows[j] >= y1) && saved[rows[j]] < 0)
+					saved[rows[j]] = count++;
+		}
+
+		savedRows.resize(count * width);
+		for(int y = 0; y < height; y++)
+			if(saved[y] >= 0)
+				memcpy(&savedRows[saved[y] * width], pSrc + y * width, width * sizeof(RGBQUAD));
+	}
+
+	std::function<void(int)> run = [&](int strip)
+	{
+		int y0 = strip * stripHeight;
+		RunStrip(plans[strip], pSrc, pDst, width, height, saved, savedRows, y0, min(y0 + stripHeight, height));
+	};
+
+	if(m_pPool)
+		m_pPool->ParallelFor(strips, run);
+	else
+		for(int i = 0; i < strips; i++)
+			run(i);
+
+	return true;
+}
+
+void CImagePipeline::PlanStrip(int y0, int y1, int height, RowPlan &plan) const
+{
+	int stages = (int)m_Stages.size();
+
+	plan.resize(stages + 1);
+	plan[stages].clear();
+	for(int y = y0; y < y1; y++)
+		plan[stages].push_back(y);
+
+	for(int i = stages - 1; i >= 0; i--)
+	{
+		const SStage &stage = m_Stages[i];
+		const std::vector<int> &out = plan[i + 1];
+		std::vector<int> &in = plan[i];
+
+		if(stage.radius == 0)
+		{
+			in = out;
+			continue;
+		}
+
+		in.clear();
+		for(size_t j = 0; j < out.size(); j++)
+			for(int k = -stage.radius; k <= stage.radius; k++)
+				in.push_back(CConvolution::MapBorder(out[j] + k, height, stage.border));
+
+		std::sort(in.begin(), in.end());
+		in.erase(std::unique(in.begin(), in.end()), in.end());
+	}
+}
+
+void CImagePipeline::RunStrip(const RowPlan &plan, const RGBQUAD *pSrc, RGBQUAD *pDst, int width, int height,
+	const std::vector<int> &saved, const std::vector<RGBQUAD> &savedRows, int y0, int y1) const
+{
+	static thread_local std::vector<BYTE> bufA, bufB;
+
+	// Rows are padded so SSE2 code can always work on 8 pixels at a time
+	int stride = ((width + 7) & ~7) + 16;
+	std::vector<BYTE> *pCur = &bufA;
+
+	for(size_t i = 0; i < m_Stages.size(); i++)
+	{
+		const SStage &stage = m_Stages[i];
+		const std::vector<int> &out = plan[i + 1];
+
+		switch(stage.type)
+		{
+		case EST_EXTRACT:
+			pCur->resize(out.size() * stride);
+			for(size_t j = 0; j < out.size(); j++)
+			{
+				int y = out[j];
+				const RGBQUAD *pRow = (saved.empty() || saved[y] < 0 || (y >= y0 && y < y1)) ?
+					pSrc + y * width : &savedRows[saved[y] * width];
+				ExtractRow(pRow, &(*pCur)[j * stride], width, stage.channel);
+			}
+			break;
+
+		case EST_POINT:
+			// Same rows in and out, done in place
+			for(size_t j = 0; j < out.size(); j++)
+			{
+				BYTE *p = &(*pCur)[j * stride];
+				for(int x = 0; x < width; x++)
+					p[x] = stage.lut[p[x]];
+			}
+			break;
+
+		case EST_CONVOLVE:
+			{
+				std::vector<BYTE> *pNext = pCur == &bufA ? &bufB : &bufA;
+				pNext->resize(out.size() * stride);
+				ConvolveRows(stage, plan[i], &(*pCur)[0], out, &(*pNext)[0], width, stride, height);
+				pCur = pNext;
+			}
+			break;
+
+		case EST_INSERT:
+			for(size_t j = 0; j < out.size(); j++)
+				InsertRow(&(*pCur)[j * stride], pDst + out[j] * width, width, stage.channel);
+			break;
+		}
+	}
+}
+
+void CImagePipeline::ExtractRow(const RGBQUAD *pSrc, BYTE *pDst, int width, EColorChannel chn)
+{
+	switch(chn)
+	{
+	case ECC_RED:
+		for(int x = 0; x < width; x++)
+			pDst[x] = pSrc[x].rgbRed;
+		break;
+
+	case ECC_GREEN:
+		for(int x = 0; x < width; x++)
+			pDst[x] = pSrc[x].rgbGreen;
+		break;
+
+	case ECC_BLUE:
+		for(int x = 0; x < width; x++)
+			pDst[x] = pSrc[x].rgbBlue;
+		break;
+
+	default:
+		{
+			RGBQUAD_TO_BYTE convert = chn == ECC_HUE ? RGBToHue : (chn == ECC_SATURATION ? RGBToSaturation : RGBToLuminosity);
+			for(int x = 0; x < width; x++)
+				pDst[x] = convert(pSrc[x]);
+		}
+		break;
+	}
+}
+
+void CImagePipeline::InsertRow(const BYTE *pSrc, RGBQUAD *pDst, int width, EColorChannel chn)
+{
+	if(chn >= ECC_EXCLUSIVERED)
+		ZeroMemory(pDst, width * sizeof(RGBQUAD));
+
+	switch(chn)
+	{
+	case ECC_EXCLUSIVERED:
+	case ECC_RED:
+		for(int x = 0; x < width; x++)
+			pDst[x].rgbRed = pSrc[x];
+		break;
+
+	case ECC_EXCLUSIVEGREEN:
+	case ECC_GREEN:
+		for(int x = 0; x < width; x++)
+			pDst[x].rgbGreen = pSrc[x];
+		break;
+
+	case ECC_EXCLUSIVEBLUE:
+	case ECC_BLUE:
+		for(int x = 0; x < width; x++)
+			pDst[x].rgbBlue = pSrc[x];
+		break;
+
+	default:
+		break;
+	}
+}
+
+void CImagePipeline::ConvolveRows(const SStage &stage, const std::vector<int> &inRows, const BYTE *pIn,
+	const std::vector<int> &outRows, BYTE *pOut, int width, int stride, int height)
+{
+	static thread_local std::vector<BYTE> lines;
+	static thread_local std::vector<short> mid;
+	static thread_local std::vector<const BYTE*> lineRows;
+	static thread_local std::vector<const short*> midRows;
+
+	const CKernel &kernel = stage.kernel;
+	int rx = kernel.RadiusX(), ry = kernel.RadiusY();
+	int lineSize = ((width + 7) & ~7) + 2 * rx + 16;
+	int bias = kernel.m_iBias;
+
+	if(kernel.IsSeparable())
+	{
+		int rowTaps = (int)kernel.m_Row.size(), colTaps = (int)kernel.m_Col.size();
+		int midStride = ((width + 7) & ~7) + 8;
+		int hShift = kernel.m_iRowShift - CONV_MID_BITS;
+		int vShift = kernel.m_iColShift + CONV_MID_BITS;
+
+		lines.resize(lineSize);
+		mid.resize(inRows.size() * midStride);
+
+#ifdef USE_SSE2
+		static thread_local std::vector<int> rowWeights, colWeights;
+		SplatWeights(&kernel.m_Row[0], rowTaps, rowWeights);
+		SplatWeights(&kernel.m_Col[0], colTaps, colWeights);
+#endif
+
+		// Horizontal pass over every input row, kept with CONV_MID_BITS extra bits
+		for(size_t j = 0; j < inRows.size(); j++)
+		{
+			short *pMid = &mid[j * midStride];
+			BuildLine(pIn + j * stride, width, rx, stage.border, &lines[0], lineSize);
+
+#ifdef USE_SSE2
+			__m128i round = _mm_set1_epi32(hShift > 0 ? 1 << (hShift - 1) : 0);
+			__m128i shift = _mm_cvtsi32_si128(hShift);
+			for(int x = 0; x < width; x += 8)
+			{
+				__m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+				DotLine(&lines[0], x, &rowWeights[0], rowTaps, acc0, acc1);
+				acc0 = _mm_sra_epi32(_mm_add_epi32(acc0, round), shift);
+				acc1 = _mm_sra_epi32(_mm_add_epi32(acc1, round), shift);
+				_mm_storeu_si128((__m128i*)(pMid + x), _mm_packs_epi32(acc0, acc1));
+			}
+#else
+			int round = hShift > 0 ? 1 << (hShift - 1) : 0;
+			for(int x = 0; x < width; x++)
+				pMid[x] = (short)Saturate16((DotLine(&lines[0], x, &kernel.m_Row[0], rowTaps) + round) >> hShift);
+#endif
+		}
+
+		// Vertical pass, the padding tap of an odd kernel has a zero weight
+		midRows.resize(colTaps);
+		for(size_t o = 0; o < outRows.size(); o++)
+		{
+			for(int k = 0; k < kernel.m_iHeight; k++)
+				midRows[k] = &mid[FindRow(inRows, CConvolution::MapBorder(outRows[o] - ry + k, height, stage.border)) * midStride];
+			if(colTaps > kernel.m_iHeight)
+				midRows[colTaps - 1] = midRows[0];
+
+			BYTE *pDst = pOut + o * stride;
+
+#ifdef USE_SSE2
+			__m128i round = _mm_set1_epi32(1 << (vShift - 1));
+			__m128i shift = _mm_cvtsi32_si128(vShift);
+			__m128i vbias = _mm_set1_epi32(bias);
+			for(int x = 0; x < width; x += 8)
+			{
+				__m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+				for(int k = 0; k < colTaps; k += 2)
+				{
+					__m128i a = _mm_loadu_si128((const __m128i*)(midRows[k] + x));
+					__m128i b = _mm_loadu_si128((const __m128i*)(midRows[k + 1] + x));
+					__m128i w = PairWeights(&colWeights[0], k / 2);
+					acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+					acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+				}
+				acc0 = _mm_add_epi32(_mm_sra_epi32(_mm_add_epi32(acc0, round), shift), vbias);
+				acc1 = _mm_add_epi32(_mm_sra_epi32(_mm_add_epi32(acc1, round), shift), vbias);
+
+				__m128i out = _mm_packs_epi32(acc0, acc1);
+				_mm_storel_epi64((__m128i*)(pDst + x), _mm_packus_epi16(out, out));
+			}
+#else
+			int round = 1 << (vShift - 1);
+			for(int x = 0; x < width; x++)
+			{
+				int acc = 0;
+				for(int k = 0; k < colTaps; k++)
+					acc += midRows[k][x] * kernel.m_Col[k];
+				pDst[x] = Saturate8(Saturate16(((acc + round) >> vShift) + bias));
+			}
+#endif
+		}
+	}
+	else
+	{
+		int taps = kernel.m_iWidth + (kernel.m_iWidth & 1);
+		int shiftBits = kernel.m_iMatrixShift;
+
+		// Padded copies of every input row, then each output row sums the
+		// kernel rows over the lines it covers.
+		lines.resize(inRows.size() * lineSize);
+		for(size_t j = 0; j < inRows.size(); j++)
+			BuildLine(pIn + j * stride, width, rx, stage.border, &lines[j * lineSize], lineSize);
+
+#ifdef USE_SSE2
+		static thread_local std::vector<int> weights;
+		SplatWeights(&kernel.m_Matrix[0], (int)kernel.m_Matrix.size(), weights);
+#endif
+
+		lineRows.resize(kernel.m_iHeight);
+		for(size_t o = 0; o < outRows.size(); o++)
+		{
+			for(int j = 0; j < kernel.m_iHeight; j++)
+				lineRows[j] = &lines[FindRow(inRows, CConvolution::MapBorder(outRows[o] - ry + j, height, stage.border)) * lineSize];
+
+			BYTE *pDst = pOut + o * stride;
+
+#ifdef USE_SSE2
+			__m128i round = _mm_set1_epi32(1 << (shiftBits - 1));
+			__m128i shift = _mm_cvtsi32_si128(shiftBits);
+			__m128i vbias = _mm_set1_epi32(bias);
+			for(int x = 0; x < width; x += 8)
+			{
+				__m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+				for(int j = 0; j < kernel.m_iHeight; j++)
+					DotLine(lineRows[j], x, &weights[j * taps * 2], taps, acc0, acc1);
+
+				acc0 = _mm_add_epi32(_mm_sra_epi32(_mm_add_epi32(acc0, round), shift), vbias);
+				acc1 = _mm_add_epi32(_mm_sra_epi32(_mm_add_epi32(acc1, round), shift), vbias);
+
+				__m128i out = _mm_packs_epi32(acc0, acc1);
+				_mm_storel_epi64((__m128i*)(pDst + x), _mm_packus_epi16(out, out));
+			}
+#else
+			int round = 1 << (shiftBits - 1);
+			for(int x = 0; x < width; x++)
+			{
+				int acc = 0;
+				for(int j = 0; j < kernel.m_iHeight; j++)
+					acc += DotLine(lineRows[j], x, &kernel.m_Matrix[j * taps], taps);
+				pDst[x] = Saturate8(Saturate16(((acc + round) >> shiftBits) + bias));
+			}
+#endif
+		}
+	}
+}
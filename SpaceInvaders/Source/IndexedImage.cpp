@@ -0,0 +1,393 @@
+// IndexedImage.cpp
+// 8 bit palettized images, quantized at load and expanded while blitting.
+//
+// The game art uses few colours, so most images keep every colour exactly.
+// The rest (the explosion, the planes' antialiased edges) go through a
+// median cut: colours are binned into a 32x32x32 histogram, the box with
+// the most pixels is split at the median of its longest side until the
+// palette is full, and every bin maps straight to the mean colour of its
+// box. No nearest colour search is needed.
+//
+// Blitting expands four indices per step into a register. SSE2 has no
+// byte shuffle or gather, so the palette reads stay scalar (the palette is
+// 1 KB and lives in L1); the transparency test and the merge with the
+// surface are done on whole registers, and runs of 16 fully transparent
+// or fully opaque pixels skip the merge altogether.
+#include "IndexedImage.h"
+
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Histogram bin of a colour, 5 bits per channel
+#define BIN_OF(c) ((((c) >> 9) & 0x7C00) | (((c) >> 6) & 0x03E0) | (((c) >> 3) & 0x001F))
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CIndexedImage::CIndexedImage()
+{
+	m_iWidth = m_iHeight = 0;
+	m_iColors = 0;
+	m_bTransparent = false;
+	m_bExact = true;
+	ZeroMemory(m_Palette, sizeof(m_Palette));
+}
+
+void CIndexedImage::Release()
+{
+	std::vector<BYTE>().swap(m_Indices);
+	m_iWidth = m_iHeight = 0;
+	m_iColors = 0;
+}
+
+bool CIndexedImage::Create(const RGBQUAD *pPixels, int width, int height, const BYTE *pTransparent)
+{
+	if(!pPixels || width <= 0 || height <= 0)
+		return false;
+
+	m_iWidth = width;
+	m_iHeight = height;
+	m_bTransparent = false;
+	if(pTransparent)
+		for(int i = 0; i < width * height && !m_bTransparent; i++)
+			m_bTransparent = pTransparent[i] != 0;
+
+	m_Indices.assign(width * height, 0);
+	ZeroMemory(m_Palette, sizeof(m_Palette));
+	Quantize(pPixels, m_bTransparent ? pTransparent : NULL);
+	return true;
+}
+
+#ifdef _WIN32
+bool CIndexedImage::CreateFromBitmap(HBITMAP hImage, HBITMAP hMask, COLORREF crTransparent)
+{
+	BITMAP bm;
+	if(!hImage || !GetObject(hImage, sizeof(BITMAP), &bm))
+		return false;
+
+	int w = bm.bmWidth, h = bm.bmHeight;
+
+	BITMAPINFO bmi;
+	ZeroMemory(&bmi, sizeof(BITMAPINFO));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = w;
+	bmi.bmiHeader.biHeight = -h;	// top-down
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
+	std::vector<RGBQUAD> pixels(w * h), mask;
+	std::vector<BYTE> transparent(w * h, 0);
+
+	HDC mdc = CreateCompatibleDC(NULL);
+	bool bResult = GetDIBits(mdc, hImage, 0, h, &pixels[0], &bmi, DIB_RGB_COLORS) == h;
+
+	if(bResult && hMask)
+	{
+		// The mask is ANDed onto the surface, so only its black pixels are drawn
+		mask.resize(w * h);
+		bResult = GetDIBits(mdc, hMask, 0, h, &mask[0], &bmi, DIB_RGB_COLORS) == h;
+		for(int i = 0; bResult && i < w * h; i++)
+			transparent[i] = (mask[i].rgbRed + mask[i].rgbGreen + mask[i].rgbBlue) >= 3 * 128;
+	}
+	else if(bResult)
+	{
+		for(int i = 0; i < w * h; i++)
+			transparent[i] = pixels[i].rgbRed == GetRValue(crTransparent) &&
+				pixels[i].rgbGreen == GetGValue(crTransparent) &&
+				pixels[i].rgbBlue == GetBValue(crTransparent);
+	}
+
+	DeleteDC(mdc);
+
+	return bResult && Create(&pixels[0], w, h, &transparent[0]);
+}
+#endif // _WIN32
+
+bool CIndexedImage::CreateFromImage(const CImageFile &img)
+{
+	const RGBQUAD *pBits = img.Bits();
+	int w = img.Width(), h = img.Height();
+	if(!pBits || w <= 0 || h <= 0)
+		return false;
+
+	// CImageFile rows are bottom-up
+	std::vector<RGBQUAD> pixels(w * h);
+	for(int y = 0; y < h; y++)
+		memcpy(&pixels[y * w], pBits + (h - 1 - y) * w, w * sizeof(RGBQUAD));
+
+	return Create(&pixels[0], w, h);
+}
+
+void CIndexedImage::Quantize(const RGBQUAD *pPixels, const BYTE *pTransparent)
+{
+	int first = pTransparent ? 1 : 0;
+
+	m_bExact = BuildExactPalette(pPixels, pTransparent, first);
+	if(!m_bExact)
+		BuildMedianCutPalette(pPixels, pTransparent, first);
+
+	// Index 0 of a transparent image is never drawn, keep it black
+	if(pTransparent)
+		m_Palette[0] = 0;
+}
+
+bool CIndexedImage::BuildExactPalette(const RGBQUAD *pPixels, const BYTE *pTransparent, int first)
+{
+	// Small open addressing table, colours are 24 bit so ~0 marks a free slot
+	const int slots = 1024;
+	DWORD keys[slots];
+	BYTE values[slots];
+	memset(keys, 0xFF, sizeof(keys));
+
+	int count = m_iWidth * m_iHeight;
+	DWORD last = 0xFFFFFFFF;
+	BYTE lastIndex = 0;
+
+	m_iColors = first;
+	for(int i = 0; i < count; i++)
+	{
+		if(pTransparent && pTransparent[i])
+			continue;
+
+		DWORD c = *(const DWORD*)&pPixels[i] & 0x00FFFFFF;
+		if(c != last)
+		{
+			int slot = (int)((c * 2654435761u) >> 22);
+			while(keys[slot] != c && keys[slot] != 0xFFFFFFFF)
+				slot = (slot + 1) & (slots - 1);
+
+			if(keys[slot] != c)
+			{
+				if(m_iColors == 256)
+					return false;
+
+				keys[slot] = c;
+				values[slot] = (BYTE)m_iColors;
+				m_Palette[m_iColors++] = c;
+			}
+			last = c;
+			lastIndex = values[slot];
+		}
+		m_Indices[i] = lastIndex;
+	}
+
+	return true;
+}
+
+void CIndexedImage::BuildMedianCutPalette(const RGBQUAD *pPixels, const BYTE *pTransparent, int first)
+{
+	struct SBin { int count; int sum[3]; };
+	struct SBox { int lo[3], hi[3]; int count; };
+
+	std::vector<SBin> bins(32768);
+	ZeroMemory(&bins[0], bins.size() * sizeof(SBin));
+
+	int count = m_iWidth * m_iHeight;
+	for(int i = 0; i < count; i++)
+	{
+		if(pTransparent && pTransparent[i])
+			continue;
+
+		DWORD c = *(const DWORD*)&pPixels[i];
+		SBin &bin = bins[BIN_OF(c)];
+		bin.count++;
+		bin.sum[0] += (c >> 16) & 0xFF;
+		bin.sum[1] += (c >> 8) & 0xFF;
+		bin.sum[2] += c & 0xFF;
+	}
+
+	// Bin index of box coordinates, channels in r, g, b order
+	#define BIN_AT(r, g, b) (((r) << 10) | ((g) << 5) | (b))
+
+	std::vector<SBox> boxes;
+	SBox all = { { 0, 0, 0 }, { 31, 31, 31 }, 0 };
+	boxes.push_back(all);
+
+	int limit = 256 - first;
+	for(;;)
+	{
+		// Shrink the newest boxes to their occupied bins and count them
+		for(size_t b = 0; b < boxes.size(); b++)
+		{
+			SBox &box = boxes[b];
+			if(box.count)
+				continue;
+
+			int lo[3] = { 31, 31, 31 }, hi[3] = { 0, 0, 0 };
+			for(int r = box.lo[0]; r <= box.hi[0]; r++)
+				for(int g = box.lo[1]; g <= box.hi[1]; g++)
+					for(int bl = box.lo[2]; bl <= box.hi[2]; bl++)
+					{
+						int n = bins[BIN_AT(r, g, bl)].count;
+						if(!n)
+							continue;
+
+						box.count += n;
+						int v[3] = { r, g, bl };
+						for(int k = 0; k < 3; k++)
+						{
+							lo[k] = min(lo[k], v[k]);
+							hi[k] = max(hi[k], v[k]);
+						}
+					}
+
+			if(box.count)
+				for(int k = 0; k < 3; k++)
+				{
+					box.lo[k] = lo[k];
+					box.hi[k] = hi[k];
+				}
+		}
+
+		if((int)boxes.size() >= limit)
+			break;
+
+		// Split the most populated box that still spans more than one bin
+		int best = -1, axis = 0;
+		for(size_t b = 0; b < boxes.size(); b++)
+		{
+			const SBox &box = boxes[b];
+			int longest = 0, side = 0;
+			for(int k = 0; k < 3; k++)
+				if(box.hi[k] - box.lo[k] > side)
+				{
+					side = box.hi[k] - box.lo[k];
+					longest = k;
+				}
+
+			if(side > 0 && (best < 0 || box.count > boxes[best].count))
+			{
+				best = (int)b;
+				axis = longest;
+			}
+		}
+
+		if(best < 0)
+			break;
+
+		// Walk slices along the axis until half of the pixels are covered
+		SBox box = boxes[best];
+		int half = box.count / 2, seen = 0, cut = box.lo[axis];
+		for(int s = box.lo[axis]; s < box.hi[axis]; s++)
+		{
+			int v[3], lo[3], hi[3];
+			for(int k = 0; k < 3; k++)
+			{
+				lo[k] = k == axis ? s : box.lo[k];
+				hi[k] = k == axis ? s : box.hi[k];
+			}
+			for(v[0] = lo[0]; v[0] <= hi[0]; v[0]++)
+				for(v[1] = lo[1]; v[1] <= hi[1]; v[1]++)
+					for(v[2] = lo[2]; v[2] <= hi[2]; v[2]++)
+						seen += bins[BIN_AT(v[0], v[1], v[2])].count;
+
+			cut = s;
+			if(seen >= half)
+				break;
+		}
+
+		SBox a = box, b = box;
+		a.hi[axis] = cut;
+		b.lo[axis] = cut + 1;
+		a.count = b.count = 0;
+		boxes[best] = a;
+		boxes.push_back(b);
+	}
+
+	// Palette entries are the mean colour of each box, bins map to their box
+	std::vector<BYTE> table(32768, (BYTE)first);
+	m_iColors = first;
+	for(size_t b = 0; b < boxes.size(); b++)
+	{
+		const SBox &box = boxes[b];
+		if(!box.count)
+			continue;
+
+		double sum[3] = { 0, 0, 0 };
+		for(int r = box.lo[0]; r <= box.hi[0]; r++)
+			for(int g = box.lo[1]; g <= box.hi[1]; g++)
+				for(int bl = box.lo[2]; bl <= box.hi[2]; bl++)
+				{
+					const SBin &bin = bins[BIN_AT(r, g, bl)];
+					for(int k = 0; k < 3; k++)
+						sum[k] += bin.sum[k];
+					table[BIN_AT(r, g, bl)] = (BYTE)m_iColors;
+				}
+
+		DWORD red = (DWORD)(sum[0] / box.count + 0.5);
+		DWORD green = (DWORD)(sum[1] / box.count + 0.5);
+		DWORD blue = (DWORD)(sum[2] / box.count + 0.5);
+		m_Palette[m_iColors++] = (red << 16) | (green << 8) | blue;
+	}
+
+	#undef BIN_AT
+
+	for(int i = 0; i < count; i++)
+		if(!pTransparent || !pTransparent[i])
+			m_Indices[i] = table[BIN_OF(*(const DWORD*)&pPixels[i])];
+}
+
+void CIndexedImage::Blit(RGBQUAD *pDst, int dstWidth, int dstHeight, int x, int y, const RECT *pSrcRect) const
+{
+	if(!pDst || m_Indices.empty())
+		return;
+
+	int sx = 0, sy = 0, w = m_iWidth, h = m_iHeight;
+	if(pSrcRect)
+	{
+		sx = max(0, (int)pSrcRect->left);
+		sy = max(0, (int)pSrcRect->top);
+		w = min((int)pSrcRect->right, m_iWidth) - sx;
+		h = min((int)pSrcRect->bottom, m_iHeight) - sy;
+	}
+
+	// Clip against the surface
+	if(x < 0) { sx -= x; w += x; x = 0; }
+	if(y < 0) { sy -= y; h += y; y = 0; }
+	w = min(w, dstWidth - x);
+	h = min(h, dstHeight - y);
+	if(w <= 0 || h <= 0)
+		return;
+
+	for(int j = 0; j < h; j++)
+		ExpandRow(&m_Indices[(sy + j) * m_iWidth + sx], (DWORD*)(pDst + (y + j) * dstWidth + x), w, m_Palette, m_bTransparent);
+}
+
+void CIndexedImage::ExpandRow(const BYTE *pIndices, DWORD *pDst, int count, const DWORD *pPalette, bool bTransparent)
+{
+	int i = 0;
+
+#ifdef USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+
+	for(; i + 16 <= count; i += 16)
+	{
+		const BYTE *p = pIndices + i;
+		__m128i *d = (__m128i*)(pDst + i);
+		int skip = bTransparent ? _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), zero)) : 0;
+
+		if(skip == 0xFFFF)
+			continue;
+
+		for(int k = 0; k < 4; k++, p += 4)
+		{
+			__m128i c = _mm_setr_epi32(pPalette[p[0]], pPalette[p[1]], pPalette[p[2]], pPalette[p[3]]);
+
+			if(skip)
+			{
+				__m128i idx = _mm_cvtsi32_si128(*(const int*)p);
+				idx = _mm_unpacklo_epi16(_mm_unpacklo_epi8(idx, zero), zero);
+				__m128i keep = _mm_cmpeq_epi32(idx, zero);
+				c = _mm_or_si128(_mm_and_si128(keep, _mm_loadu_si128(d + k)), _mm_andnot_si128(keep, c));
+			}
+
+			_mm_storeu_si128(d + k, c);
+		}
+	}
+#endif
+
+	for(; i < count; i++)
+		if(!bTransparent || pIndices[i])
+			pDst[i] = pPalette[pIndices[i]];
+}
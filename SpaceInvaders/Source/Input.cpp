@@ -0,0 +1,135 @@
+//-----------------------------------------------------------------------------
+// File: Input.cpp
+//
+// Desc: Keyboard input as a stream of timestamped key transitions, turned
+//	   into STickInput one simulation tick at a time.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CInput Specific Includes
+//-----------------------------------------------------------------------------
+#include "Input.h"
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+// Name : CInput () (Constructor)
+// Desc : CInput Class Constructor
+//-----------------------------------------------------------------------------
+CInput::CInput()
+{
+	memset( m_Bindings, 0, sizeof(m_Bindings) );
+	memset( m_bHeld, 0, sizeof(m_bHeld) );
+	m_nLost		= 0;
+	m_fLatency	= 0.0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CInput () (Destructor)
+// Desc : CInput Class Destructor
+//-----------------------------------------------------------------------------
+CInput::~CInput()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : Bind ()
+// Desc : Assigns a key to a player's control. Key 0 leaves it unbound, it
+//		is never posted.
+//-----------------------------------------------------------------------------
+void CInput::Bind( int iPlayer, CONTROL eControl, uint8_t Key )
+{
+	m_Bindings[iPlayer][eControl] = Key;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Post ()
+// Desc : Queues a key transition. Called from the host's input thread only;
+//		false, and counted as lost, when the queue is full.
+//-----------------------------------------------------------------------------
+bool CInput::Post( uint8_t Key, EVENT eType, double fTime )
+{
+	SInputEvent Event;
+	Event.fTime = fTime;
+	Event.Key	= Key;
+	Event.Type	= (uint8_t)eType;
+
+	if ( m_Queue.Push( Event ) ) return true;
+
+	m_nLost++;
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Name : BuildTick ()
+// Desc : Builds the input for the tick ending at fTickEnd from the events
+//		stamped before then. Later events wait in the queue for their tick.
+//-----------------------------------------------------------------------------
+void CInput::BuildTick( double fTickEnd, STickInput& Input )
+{
+	bool bPressed[256];
+
+	memset( &Input, 0, sizeof(Input) );
+	memset( bPressed, 0, sizeof(bPressed) );
+
+	while ( const SInputEvent *pEvent = m_Queue.Peek() )
+	{
+		if ( pEvent->fTime >= fTickEnd ) break;
+		if ( !Apply( *pEvent, bPressed, Input ) ) break;
+
+		m_fLatency = m_fLatency * 0.95 + (fTickEnd - pEvent->fTime) * 1000.0 * 0.05;
+		m_Queue.Pop();
+	}
+
+	// Held keys, and keys tapped during the tick
+	for ( int i = 0; i < WORLD_PLAYERS; i++ )
+	{
+		const uint8_t *pKeys = m_Bindings[i];
+
+		if ( m_bHeld[pKeys[CONTROL_FORWARD]]  || bPressed[pKeys[CONTROL_FORWARD]] )  Input.Direction[i] |= SActor::DIR_FORWARD;
+		if ( m_bHeld[pKeys[CONTROL_BACKWARD]] || bPressed[pKeys[CONTROL_BACKWARD]] ) Input.Direction[i] |= SActor::DIR_BACKWARD;
+		if ( m_bHeld[pKeys[CONTROL_LEFT]]	  || bPressed[pKeys[CONTROL_LEFT]] )	 Input.Direction[i] |= SActor::DIR_LEFT;
+		if ( m_bHeld[pKeys[CONTROL_RIGHT]]	  || bPressed[pKeys[CONTROL_RIGHT]] )	 Input.Direction[i] |= SActor::DIR_RIGHT;
+
+		Input.bFire[i] = m_bHeld[pKeys[CONTROL_FIRE]] || bPressed[pKeys[CONTROL_FIRE]];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : Apply () (Private)
+// Desc : Applies one event to the key state and the tick's one shot actions.
+//		Returns false, leaving the event for the next tick, when its action
+//		was already triggered this tick and would otherwise be swallowed.
+//-----------------------------------------------------------------------------
+bool CInput::Apply( const SInputEvent& Event, bool bPressed[256], STickInput& Input )
+{
+	switch ( Event.Type )
+	{
+	case EVENT_DOWN:
+		for ( int i = 0; i < WORLD_PLAYERS; i++ )
+		{
+			uint32_t Actions = 0;
+			if ( Event.Key == m_Bindings[i][CONTROL_ROTATE] ) Actions |= CGameWorld::ACTION_ROTATE;
+			if ( Event.Key == m_Bindings[i][CONTROL_SELF_DESTRUCT] ) Actions |= CGameWorld::ACTION_SELF_DESTRUCT;
+			if ( Input.Actions[i] & Actions ) return false;
+		}
+
+		for ( int i = 0; i < WORLD_PLAYERS; i++ )
+		{
+			if ( Event.Key == m_Bindings[i][CONTROL_ROTATE] ) Input.Actions[i] |= CGameWorld::ACTION_ROTATE;
+			if ( Event.Key == m_Bindings[i][CONTROL_SELF_DESTRUCT] ) Input.Actions[i] |= CGameWorld::ACTION_SELF_DESTRUCT;
+		}
+
+		m_bHeld[Event.Key] = bPressed[Event.Key] = true;
+		break;
+
+	case EVENT_UP:
+		m_bHeld[Event.Key] = false;
+		break;
+
+	case EVENT_RELEASE_ALL:
+		memset( m_bHeld, 0, sizeof(m_bHeld) );
+		break;
+	}
+
+	return true;
+}
@@ -0,0 +1,504 @@
+//-----------------------------------------------------------------------------
+// File: Levels.cpp
+//
+// Desc: Wave and level definitions, written as text and compiled on first
+//	   load into a binary cache that later runs map and use as it is.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CLevelSet Specific Includes
+//-----------------------------------------------------------------------------
+#include "Levels.h"
+#include "Formation.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+static const char		LEVEL_MAGIC[4]		= { 'S', 'I', 'L', 'C' };
+static const uint16_t	LEVEL_VERSION		= 1;			// Bump with any change to the cache layout
+static const uint32_t	LEVEL_MAX_FIRE_MS	= 3600000;		// An hour between shots at most
+static const size_t		LEVEL_MAX_SOURCE	= 0x40000000;	// Neither file may pass a gigabyte
+
+// Keywords of the text, the spawn ones in SLevel::ESpawn order
+static const char *const LEVEL_KEYWORDS[] = { "level", "wave", "origin", "spacing", "march", "fire", "player", "star", "respawn", "jump" };
+enum { KEY_LEVEL, KEY_WAVE, KEY_ORIGIN, KEY_SPACING, KEY_MARCH, KEY_FIRE, KEY_SPAWN, KEY_COUNT = KEY_SPAWN + SLevel::SPAWN_COUNT };
+
+//-----------------------------------------------------------------------------
+// Name : SCacheHeader (Struct)
+// Desc : Start of the cache file and of every compiled image.
+//-----------------------------------------------------------------------------
+struct SCacheHeader
+{
+	char		Magic[4];
+	uint16_t	Version;
+	uint16_t	HeaderSize;
+	uint64_t	SourceHash;			// Of the text and the defaults it was compiled with
+	uint32_t	SourceSize;
+	uint32_t	LevelCount;
+	uint32_t	SpawnCount;
+	uint32_t	FileSize;
+};
+static_assert( sizeof(SCacheHeader) == 32, "SCacheHeader must stay packed" );
+
+//-----------------------------------------------------------------------------
+// Name : SourceHash () (Static)
+// Desc : What a cache is built from: the text and the wave fields of the
+//		defaults, which the compiler starts the first level from.
+//-----------------------------------------------------------------------------
+static uint64_t SourceHash( const char *pText, size_t nSize, const SLevel& Defaults )
+{
+	SLevel Wave = Defaults;
+	memset( Wave.First, 0, sizeof(Wave.First) );
+	memset( Wave.Count, 0, sizeof(Wave.Count) );
+	return CLevelSet::Hash( pText, nSize, CLevelSet::Hash( &Wave, sizeof(Wave) ) );
+}
+
+//-----------------------------------------------------------------------------
+// Name : IsValidWave () (Static)
+// Desc : Whether a level describes a wave the game can line up.
+//-----------------------------------------------------------------------------
+static bool IsValidWave( const SLevel& Level )
+{
+	if ( Level.Columns < 1 || Level.Columns > LEVEL_MAX_COLUMNS ) return false;
+	if ( Level.Rows < 1 || Level.Rows > FORMATION_MAX_ROWS ) return false;
+	if ( !(Level.Speed >= 0) || !(Level.Drop >= 0) ) return false;
+	if ( Level.FireMs < 1 || Level.FireMs > LEVEL_MAX_FIRE_MS || Level.FireSpreadMs > LEVEL_MAX_FIRE_MS ) return false;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ParseNumber () (Static)
+// Desc : A whole token as a finite number.
+//-----------------------------------------------------------------------------
+static bool ParseNumber( const char *pToken, size_t nLength, double& fValue )
+{
+	char Buffer[32];
+	if ( !nLength || nLength >= sizeof(Buffer) ) return false;
+
+	memcpy( Buffer, pToken, nLength );
+	Buffer[nLength] = '\0';
+
+	char *pEnd;
+	fValue = strtod( Buffer, &pEnd );
+	return pEnd == Buffer + nLength && fValue - fValue == 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : CLevelSet () (Constructor)
+// Desc : CLevelSet Class Constructor
+//-----------------------------------------------------------------------------
+CLevelSet::CLevelSet()
+{
+	m_pImage		= NULL;
+	m_nImage		= 0;
+	m_pView			= NULL;
+	m_nView			= 0;
+	m_bCached		= false;
+	m_nErrorLine	= 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CLevelSet () (Destructor)
+// Desc : CLevelSet Class Destructor
+//-----------------------------------------------------------------------------
+CLevelSet::~CLevelSet()
+{
+	Unmap();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Load ()
+// Desc : Reads the levels of szSource, from szCache if that was built from
+//		the same text and defaults, else compiled and written to szCache
+//		for next time. szCache may be NULL to always compile. False if the
+//		text could not be read, GetErrorLine 0, or has an error on the
+//		line GetErrorLine gives.
+//-----------------------------------------------------------------------------
+bool CLevelSet::Load( const char *szSource, const char *szCache, const SLevel& Defaults )
+{
+	Clear();
+
+	std::ifstream File( szSource, std::ios::binary );
+	if ( !File ) return false;
+
+	File.seekg( 0, std::ios::end );
+	std::streamoff nSize = File.tellg();
+	if ( nSize < 0 || (uint64_t)nSize > LEVEL_MAX_SOURCE ) return false;
+
+	std::string Text( (size_t)nSize, '\0' );
+	File.seekg( 0, std::ios::beg );
+	if ( nSize && !File.read( &Text[0], nSize ) ) return false;
+
+	uint64_t nHash = SourceHash( Text.data(), Text.size(), Defaults );
+	if ( szCache && Map( szCache ) )
+	{
+		if ( IsImage( m_pView, m_nView, nHash, Text.size() ) )
+		{
+			m_pImage	= (const uint8_t*)m_pView;
+			m_nImage	= m_nView;
+			m_bCached	= true;
+			return true;
+		}
+		Unmap();
+	}
+
+	if ( !Compile( Text.data(), Text.size(), Defaults ) ) return false;
+
+	// Without a cache the next run just compiles again
+	if ( szCache ) WriteCache( szCache );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Compile ()
+// Desc : Builds the image of the levels in pText. False, with no levels and
+//		GetErrorLine set, on an unknown keyword, a wrong value, a line
+//		before the first "level" or no level at all.
+//-----------------------------------------------------------------------------
+bool CLevelSet::Compile( const char *pText, size_t nSize, const SLevel& Defaults )
+{
+	std::vector<SLevel> Levels;
+	std::vector<SLevelSpawn> Spawns;
+	SLevel Level = Defaults;
+	bool bOpen = false;
+	int k, nLine = 0;
+
+	Clear();
+	for ( k = 0; k < SLevel::SPAWN_COUNT; k++ ) m_Spawns[k].clear();
+
+	// Each kind of spawn spot goes after those of the level's earlier kinds
+	auto Close = [&]()
+	{
+		for ( int s = 0; s < SLevel::SPAWN_COUNT; s++ )
+		{
+			Level.First[s] = (uint32_t)Spawns.size();
+			Level.Count[s] = (uint32_t)m_Spawns[s].size();
+			Spawns.insert( Spawns.end(), m_Spawns[s].begin(), m_Spawns[s].end() );
+			m_Spawns[s].clear();
+		}
+		Levels.push_back( Level );
+	};
+
+	const char *p = pText, *pEnd = pText + nSize;
+	while ( p < pEnd )
+	{
+		const char *pEol = (const char*)memchr( p, '\n', pEnd - p );
+		if ( !pEol ) pEol = pEnd;
+		const char *pComment = (const char*)memchr( p, '#', pEol - p );
+		const char *pLineEnd = pComment ? pComment : pEol;
+		nLine++;
+
+		// The keyword and up to two values
+		const char *Tokens[4];
+		size_t Lengths[4], nTokens = 0;
+		while ( p < pLineEnd )
+		{
+			if ( *p == ' ' || *p == '\t' || *p == '\r' ) { p++; continue; }
+			if ( nTokens == 4 ) break;
+
+			Tokens[nTokens] = p;
+			while ( p < pLineEnd && *p != ' ' && *p != '\t' && *p != '\r' ) p++;
+			Lengths[nTokens] = p - Tokens[nTokens];
+			nTokens++;
+		}
+		p = pEol + 1;
+		if ( !nTokens ) continue;
+
+		int iKey = 0;
+		while ( iKey < KEY_COUNT && (strlen( LEVEL_KEYWORDS[iKey] ) != Lengths[0] || memcmp( LEVEL_KEYWORDS[iKey], Tokens[0], Lengths[0] )) ) iKey++;
+
+		double Values[2] = { 0, 0 };
+		size_t nValues = iKey == KEY_LEVEL ? 0 : 2;
+		bool bValid = iKey < KEY_COUNT && nTokens == nValues + 1 && (bOpen || iKey == KEY_LEVEL);
+		for ( size_t i = 0; i < nValues && bValid; i++ ) bValid = ParseNumber( Tokens[i + 1], Lengths[i + 1], Values[i] );
+
+		// Whole numbers for the counts and times
+		if ( bValid && (iKey == KEY_WAVE || iKey == KEY_FIRE) )
+			bValid = Values[0] == floor( Values[0] ) && Values[1] == floor( Values[1] ) && Values[0] >= 0 && Values[1] >= 0 && Values[0] <= LEVEL_MAX_FIRE_MS && Values[1] <= LEVEL_MAX_FIRE_MS;
+
+		if ( bValid )
+		{
+			switch ( iKey )
+			{
+			case KEY_LEVEL:
+				if ( bOpen ) Close();
+				bOpen = true;
+				break;
+			case KEY_WAVE:		Level.Columns = (int32_t)Values[0]; Level.Rows = (int32_t)Values[1]; break;
+			case KEY_ORIGIN:	Level.Left = (float)Values[0]; Level.Top = (float)Values[1]; break;
+			case KEY_SPACING:	Level.SpacingX = (float)Values[0]; Level.SpacingY = (float)Values[1]; break;
+			case KEY_MARCH:		Level.Speed = (float)Values[0]; Level.Drop = (float)Values[1]; break;
+			case KEY_FIRE:		Level.FireMs = (uint32_t)Values[0]; Level.FireSpreadMs = (uint32_t)Values[1]; break;
+
+			default:
+			{
+				SLevelSpawn Spawn = { (float)Values[0], (float)Values[1] };
+				m_Spawns[iKey - KEY_SPAWN].push_back( Spawn );
+				break;
+			}
+			}
+
+			bValid = IsValidWave( Level );
+		}
+
+		if ( !bValid )
+		{
+			for ( k = 0; k < SLevel::SPAWN_COUNT; k++ ) m_Spawns[k].clear();
+			m_nErrorLine = nLine;
+			return false;
+		}
+	}
+
+	if ( !bOpen )
+	{
+		m_nErrorLine = nLine + 1;
+		return false;
+	}
+	Close();
+
+	// The image is exactly what the cache file holds
+	size_t nLevels = Levels.size() * sizeof(SLevel), nSpawns = Spawns.size() * sizeof(SLevelSpawn);
+	size_t nImage = sizeof(SCacheHeader) + nLevels + nSpawns;
+	if ( nImage > LEVEL_MAX_SOURCE )
+	{
+		m_nErrorLine = nLine;
+		return false;
+	}
+
+	SCacheHeader Header;
+	memcpy( Header.Magic, LEVEL_MAGIC, 4 );
+	Header.Version		= LEVEL_VERSION;
+	Header.HeaderSize	= (uint16_t)sizeof(SCacheHeader);
+	Header.SourceHash	= SourceHash( pText, nSize, Defaults );
+	Header.SourceSize	= (uint32_t)nSize;
+	Header.LevelCount	= (uint32_t)Levels.size();
+	Header.SpawnCount	= (uint32_t)Spawns.size();
+	Header.FileSize		= (uint32_t)nImage;
+
+	m_Compiled.assign( (nImage + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0 );
+	uint8_t *pImage = (uint8_t*)m_Compiled.data();
+	memcpy( pImage, &Header, sizeof(Header) );
+	memcpy( pImage + sizeof(Header), Levels.data(), nLevels );
+	if ( nSpawns ) memcpy( pImage + sizeof(Header) + nLevels, Spawns.data(), nSpawns );
+
+	m_pImage = pImage;
+	m_nImage = nImage;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Clear ()
+// Desc : Lets go of the levels, unmapping the cache.
+//-----------------------------------------------------------------------------
+void CLevelSet::Clear()
+{
+	Unmap();
+	m_Compiled.clear();
+	m_pImage		= NULL;
+	m_nImage		= 0;
+	m_bCached		= false;
+	m_nErrorLine	= 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetCount ()
+// Desc : Levels in the set, 0 before a successful Load or Compile.
+//-----------------------------------------------------------------------------
+size_t CLevelSet::GetCount() const
+{
+	return m_pImage ? ((const SCacheHeader*)m_pImage)->LevelCount : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetSourceHash ()
+// Desc : Hash of the text and defaults the levels were compiled from, the
+//		same whether they came from the cache or not. 0 with no levels.
+//-----------------------------------------------------------------------------
+uint64_t CLevelSet::GetSourceHash() const
+{
+	return m_pImage ? ((const SCacheHeader*)m_pImage)->SourceHash : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetLevel ()
+// Desc : Level iLevel, which has to be below GetCount.
+//-----------------------------------------------------------------------------
+const SLevel& CLevelSet::GetLevel( size_t iLevel ) const
+{
+	return ((const SLevel*)(m_pImage + sizeof(SCacheHeader)))[iLevel];
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetSpawns ()
+// Desc : A level's spawn spots of one kind, nCount of them.
+//-----------------------------------------------------------------------------
+const SLevelSpawn *CLevelSet::GetSpawns( const SLevel& Level, SLevel::ESpawn eKind, size_t& nCount ) const
+{
+	const SLevelSpawn *pSpawns = (const SLevelSpawn*)(m_pImage + sizeof(SCacheHeader) + GetCount() * sizeof(SLevel));
+	nCount = Level.Count[eKind];
+	return pSpawns + Level.First[eKind];
+}
+
+//-----------------------------------------------------------------------------
+// Name : Hash () (Static)
+// Desc : 64 bit hash of a block, eight bytes a step, so checking a large
+//		text costs next to nothing.
+//-----------------------------------------------------------------------------
+uint64_t CLevelSet::Hash( const void *pData, size_t nSize, uint64_t nSeed )
+{
+	const uint64_t K1 = 0x9E3779B97F4A7C15ull, K2 = 0xC2B2AE3D27D4EB4Full;
+	const uint8_t *p = (const uint8_t*)pData;
+	uint64_t h = nSeed ^ (nSize * K1), w;
+
+	for ( ; nSize >= 8; nSize -= 8, p += 8 )
+	{
+		memcpy( &w, p, 8 );
+		h = (h ^ (w * K2)) * K1;
+		h ^= h >> 29;
+	}
+
+	w = 0;
+	memcpy( &w, p, nSize );
+	h = (h ^ (w * K2)) * K1;
+
+	h ^= h >> 32;
+	h *= K2;
+	h ^= h >> 29;
+	return h;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Map () (Private)
+// Desc : Maps a whole file read only.
+//-----------------------------------------------------------------------------
+bool CLevelSet::Map( const char *szFileName )
+{
+	Unmap();
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA( szFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE ) return false;
+
+	// The view keeps the file open once it is made
+	LARGE_INTEGER Size;
+	HANDLE hMapping = NULL;
+	if ( GetFileSizeEx( hFile, &Size ) && Size.QuadPart > 0 && (uint64_t)Size.QuadPart <= LEVEL_MAX_SOURCE )
+		hMapping = CreateFileMappingA( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( hFile );
+	if ( !hMapping ) return false;
+
+	m_pView = MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( hMapping );
+	if ( !m_pView ) return false;
+	m_nView = (size_t)Size.QuadPart;
+#else
+	int hFile = open( szFileName, O_RDONLY );
+	if ( hFile < 0 ) return false;
+
+	struct stat Info;
+	void *pView = MAP_FAILED;
+	if ( !fstat( hFile, &Info ) && Info.st_size > 0 && (uint64_t)Info.st_size <= LEVEL_MAX_SOURCE )
+		pView = mmap( NULL, (size_t)Info.st_size, PROT_READ, MAP_PRIVATE, hFile, 0 );
+	close( hFile );
+	if ( pView == MAP_FAILED ) return false;
+
+	m_pView = pView;
+	m_nView = (size_t)Info.st_size;
+#endif
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Unmap () (Private)
+// Desc : Drops the mapping of the cache, if there is one.
+//-----------------------------------------------------------------------------
+void CLevelSet::Unmap()
+{
+	if ( !m_pView ) return;
+	if ( m_pImage == m_pView )
+	{
+		m_pImage = NULL;
+		m_nImage = 0;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile( m_pView );
+#else
+	munmap( m_pView, m_nView );
+#endif
+	m_pView = NULL;
+	m_nView = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : IsImage () (Private)
+// Desc : Whether a cache was compiled by this version from the text hashed
+//		and holds what its header says. Checks every level, not every spawn
+//		spot, since those are only ever read where the levels point.
+//-----------------------------------------------------------------------------
+bool CLevelSet::IsImage( const void *pImage, size_t nSize, uint64_t nHash, size_t nSource ) const
+{
+	const SCacheHeader *pHeader = (const SCacheHeader*)pImage;
+	if ( nSize < sizeof(SCacheHeader) || memcmp( pHeader->Magic, LEVEL_MAGIC, 4 ) ) return false;
+	if ( pHeader->Version != LEVEL_VERSION || pHeader->HeaderSize != sizeof(SCacheHeader) ) return false;
+	if ( pHeader->SourceHash != nHash || pHeader->SourceSize != nSource || pHeader->FileSize != nSize ) return false;
+	if ( !pHeader->LevelCount ) return false;
+	if ( nSize != sizeof(SCacheHeader) + (uint64_t)pHeader->LevelCount * sizeof(SLevel) + (uint64_t)pHeader->SpawnCount * sizeof(SLevelSpawn) ) return false;
+
+	const SLevel *pLevels = (const SLevel*)(pHeader + 1);
+	uint32_t nSpawns = pHeader->SpawnCount;
+	for ( uint32_t i = 0; i < pHeader->LevelCount; i++ )
+	{
+		const SLevel& Level = pLevels[i];
+		if ( !IsValidWave( Level ) ) return false;
+		for ( int k = 0; k < SLevel::SPAWN_COUNT; k++ )
+			if ( Level.First[k] > nSpawns || Level.Count[k] > nSpawns - Level.First[k] ) return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : WriteCache () (Private)
+// Desc : Writes the compiled image as the cache, through a temporary file
+//		so a run mapping the old one never sees half of the new.
+//-----------------------------------------------------------------------------
+bool CLevelSet::WriteCache( const char *szFileName ) const
+{
+	std::string TempName = std::string( szFileName ) + ".tmp";
+	{
+		std::ofstream File( TempName.c_str(), std::ios::binary | std::ios::trunc );
+		if ( !File.write( (const char*)m_pImage, m_nImage ) || !File.flush() )
+		{
+			File.close();
+			remove( TempName.c_str() );
+			return false;
+		}
+	}
+
+	// Windows will not rename over a file
+	remove( szFileName );
+	if ( rename( TempName.c_str(), szFileName ) )
+	{
+		remove( TempName.c_str() );
+		return false;
+	}
+
+	return true;
+}
@@ -11,10 +11,16 @@
 //-----------------------------------------------------------------------------
 #include "Main.h"
 #include "CGameApp.h"
+#include "AssetLoader.h"
 
 //-----------------------------------------------------------------------------
 // Global Variable Definitions
 //-----------------------------------------------------------------------------
+// The pool and the loader come first so they outlive g_App, whose
+// destructor shuts down again; ReleaseObjects stops the pool, which
+// finishes the queued loads while the loader is still there.
+CWorkerPool		g_Workers;	// Shared worker threads
+CAssetLoader	g_Assets(&g_Workers);	// Background asset loading
 CGameApp	g_App;	  // Core game application processing engine
 HINSTANCE	g_hInst;	// Global instance
 
@@ -0,0 +1,424 @@
+//-----------------------------------------------------------------------------
+// File: PostProcess.cpp
+//
+// Desc: Full screen effects applied to the back buffer right before it is
+//	   presented: CRT scanlines, bloom around explosions and a red flash
+//	   when a player takes damage. The bloom is a separable box blur of the
+//	   bright parts: a horizontal pass into a glow buffer, then a vertical
+//	   pass fused with the other effects into one read and write per row.
+//	   The passes watch their own cost against a per frame budget.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CPostProcess Specific Includes
+//-----------------------------------------------------------------------------
+#include "PostProcess.h"
+#include <functional>
+
+#ifdef _WIN32
+#include "CTimer.h"
+#else
+#include <chrono>
+#endif
+
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const int	PP_BANDS			= 16;	// row bands handed to the workers
+const int	PP_BLOOM_THRESHOLD	= 160;	// channel level where bloom starts
+const int	PP_SCANLINE			= 192;	// odd row brightness, 256 = unchanged
+const ULONG	PP_CALM_FRAMES		= 120;	// frames under half budget before raising quality
+
+//-----------------------------------------------------------------------------
+// Name : Now () (Static)
+// Desc : Seconds on a monotonic clock, for the deadline.
+//-----------------------------------------------------------------------------
+static double Now()
+{
+#ifdef _WIN32
+	return CTimer::GetAbsoluteTime();
+#else
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : SlideRows () (Static)
+// Desc : Moves column sums down a row: adds the n glow bytes of the row
+//		coming into the window and takes out those of the row leaving it.
+//-----------------------------------------------------------------------------
+static void SlideRows( WORD *pSums, const BYTE *pIn, const BYTE *pOut, int n )
+{
+	int i = 0;
+
+#ifdef USE_SSE2
+	__m128i Zero = _mm_setzero_si128();
+	for ( ; i + 16 <= n; i += 16 )
+	{
+		__m128i In	= _mm_loadu_si128( (const __m128i*)(pIn + i) );
+		__m128i Out	= _mm_loadu_si128( (const __m128i*)(pOut + i) );
+		__m128i lo	= _mm_loadu_si128( (const __m128i*)(pSums + i) );
+		__m128i hi	= _mm_loadu_si128( (const __m128i*)(pSums + i + 8) );
+		lo = _mm_sub_epi16( _mm_add_epi16( lo, _mm_unpacklo_epi8( In, Zero ) ), _mm_unpacklo_epi8( Out, Zero ) );
+		hi = _mm_sub_epi16( _mm_add_epi16( hi, _mm_unpackhi_epi8( In, Zero ) ), _mm_unpackhi_epi8( Out, Zero ) );
+		_mm_storeu_si128( (__m128i*)(pSums + i), lo );
+		_mm_storeu_si128( (__m128i*)(pSums + i + 8), hi );
+	}
+#endif
+
+	for ( ; i < n; i++ ) pSums[i] = (WORD)(pSums[i] + pIn[i] - pOut[i]);
+}
+
+//-----------------------------------------------------------------------------
+// Name : CPostProcess () (Constructor)
+// Desc : CPostProcess Class Constructor
+//-----------------------------------------------------------------------------
+CPostProcess::CPostProcess()
+{
+	m_pPool			= NULL;
+	m_bEnabled		= true;
+	m_dBudget		= 1.0;
+	m_eQuality		= PPQ_HIGH;
+	m_eMaxQuality	= PPQ_HIGH;
+	m_ulCalmFrames	= 0;
+	m_ulOverBudget	= 0;
+	m_fBloom		= 0.0f;
+	m_fFlash		= 0.0f;
+	m_dLastCost		= 0.0;
+	m_dAverageCost	= 0.0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CPostProcess () (Destructor)
+// Desc : CPostProcess Class Destructor
+//-----------------------------------------------------------------------------
+CPostProcess::~CPostProcess()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : TriggerBloom ()
+// Desc : Lights up the bright parts of the frame, fades out by itself.
+//-----------------------------------------------------------------------------
+void CPostProcess::TriggerBloom( float fIntensity )
+{
+	m_fBloom = max( m_fBloom, fIntensity );
+}
+
+//-----------------------------------------------------------------------------
+// Name : TriggerDamageFlash ()
+// Desc : Tints the frame red, fades out by itself.
+//-----------------------------------------------------------------------------
+void CPostProcess::TriggerDamageFlash( float fIntensity )
+{
+	m_fFlash = max( m_fFlash, fIntensity );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Apply ()
+// Desc : Runs the effect passes over the back buffer. Bands that start after
+//		the budget has already been spent only get the damage flash, which
+//		keeps the worst case bounded; the quality level is then adjusted
+//		for the next frames.
+//-----------------------------------------------------------------------------
+#ifdef _WIN32
+void CPostProcess::Apply( BackBuffer *pBuffer, float dt )
+{
+	// GDI batches its calls, make sure every sprite has landed first
+	GdiFlush();
+	Apply( pBuffer->bits(), pBuffer->width(), pBuffer->height(), dt );
+}
+#endif
+
+void CPostProcess::Apply( RGBQUAD *pBits, int iWidth, int iHeight, float dt )
+{
+	// Fade the effects
+	m_fBloom = max( 0.0f, m_fBloom - dt * 1.5f );
+	m_fFlash = max( 0.0f, m_fFlash - dt * 3.0f );
+
+	m_dLastCost = 0.0;
+	if ( !m_bEnabled || !pBits ) return;
+
+	SParams Full, Cheap;
+	Cheap.iScanline		= 256;
+	Cheap.iBloomRadius	= 0;
+	Cheap.iBloomGain	= 0;
+	Cheap.iFlash		= (int)(m_fFlash * 160.0f);
+
+	Full = Cheap;
+	if ( m_eQuality >= PPQ_LOW ) Full.iScanline = PP_SCANLINE;
+	if ( m_eQuality >= PPQ_MEDIUM && m_fBloom > 0.0f )
+	{
+		Full.iBloomRadius	= m_eQuality == PPQ_HIGH ? 8 : 3;
+		Full.iBloomGain		= (int)(m_fBloom * 256.0f);
+	}
+
+	// Nothing to do this frame ?
+	if ( Full.iScanline == 256 && Full.iBloomGain == 0 && Full.iFlash == 0 ) return;
+
+	double dStart = Now();
+	double dDeadline = dStart + m_dBudget * 0.001;
+	int r = Full.iBloomGain > 0 ? Full.iBloomRadius : 0;
+	int n = iWidth * 4;
+
+	// First pass, the horizontal half of the bloom for every row. Bands it
+	// could not get to in time go without bloom in the second pass.
+	if ( r > 0 )
+	{
+		m_Glow.resize( (size_t)iHeight * n );
+		m_GlowReady.assign( PP_BANDS, 0 );
+
+		std::function<void(int)> GlowBand = [&]( int iBand )
+		{
+			if ( Now() >= dDeadline ) return;
+			int y0 = iHeight * iBand / PP_BANDS, y1 = iHeight * (iBand + 1) / PP_BANDS;
+
+			// Two rows at a time, the last one alone given as both
+			for ( int y = y0; y < y1; y += 2 )
+			{
+				int iLast = min( y + 1, y1 - 1 );
+				const RGBQUAD *pRows[2] = { pBits + y * iWidth, pBits + iLast * iWidth };
+				BYTE *pGlow[2] = { &m_Glow[(size_t)y * n], &m_Glow[(size_t)iLast * n] };
+				GlowRows( pRows, iWidth, r, pGlow );
+			}
+			m_GlowReady[iBand] = 1;
+		};
+
+		if ( m_pPool )
+			m_pPool->ParallelFor( PP_BANDS, GlowBand );
+		else
+			for ( int i = 0; i < PP_BANDS; i++ ) GlowBand( i );
+	}
+
+	// Second pass, the vertical half as column sums slid down the band,
+	// fused with the scanlines and the flash
+	std::function<void(int)> Band = [&]( int iBand )
+	{
+		static thread_local std::vector<WORD> Sums;
+		static thread_local std::vector<BYTE> Dark;
+
+		const SParams &Params = Now() < dDeadline ? Full : Cheap;
+		int y0 = iHeight * iBand / PP_BANDS, y1 = iHeight * (iBand + 1) / PP_BANDS;
+		int y;
+
+		if ( Params.iBloomGain == 0 || !IsGlowReady( y0 - r, y1 + r, iHeight ) )
+		{
+			for ( y = y0; y < y1; y++ )
+				ProcessRow( pBits + y * iWidth, iWidth, y, Params, NULL );
+			return;
+		}
+
+		// Rows off the frame are dark, as the first pass takes them
+		Dark.assign( n, 0 );
+		Sums.assign( n, 0 );
+		for ( y = max( 0, y0 - r ); y <= min( iHeight - 1, y0 + r ); y++ )
+			SlideRows( Sums.data(), &m_Glow[(size_t)y * n], Dark.data(), n );
+
+		for ( y = y0; y < y1; y++ )
+		{
+			ProcessRow( pBits + y * iWidth, iWidth, y, Params, Sums.data() );
+
+			const BYTE *pIn = y + r + 1 < iHeight ? &m_Glow[(size_t)(y + r + 1) * n] : Dark.data();
+			const BYTE *pOut = y - r >= 0 ? &m_Glow[(size_t)(y - r) * n] : Dark.data();
+			SlideRows( Sums.data(), pIn, pOut, n );
+		}
+	};
+
+	if ( m_pPool )
+		m_pPool->ParallelFor( PP_BANDS, Band );
+	else
+		for ( int i = 0; i < PP_BANDS; i++ ) Band( i );
+
+	m_dLastCost		= (Now() - dStart) * 1000.0;
+	m_dAverageCost	= m_dAverageCost * 0.9 + m_dLastCost * 0.1;
+
+	UpdateQuality();
+}
+
+//-----------------------------------------------------------------------------
+// Name : IsGlowReady () (Private)
+// Desc : Whether the first pass did every band that rows y0 to y1 touch.
+//-----------------------------------------------------------------------------
+bool CPostProcess::IsGlowReady( int y0, int y1, int iHeight ) const
+{
+	for ( int i = 0; i < PP_BANDS; i++ )
+	{
+		int b0 = iHeight * i / PP_BANDS, b1 = iHeight * (i + 1) / PP_BANDS;
+		if ( b1 > y0 && b0 < y1 && !m_GlowReady[i] ) return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : UpdateQuality () (Private)
+// Desc : Drops a level straight away when the budget was exceeded, climbs
+//		back slowly once the pass has been comfortably cheap for a while.
+//-----------------------------------------------------------------------------
+void CPostProcess::UpdateQuality()
+{
+	if ( m_dLastCost > m_dBudget )
+	{
+		m_ulOverBudget++;
+		m_ulCalmFrames = 0;
+		if ( m_eQuality > PPQ_FLASH_ONLY ) m_eQuality = (EQuality)(m_eQuality - 1);
+		return;
+	}
+
+	if ( m_dAverageCost < m_dBudget * 0.5 )
+	{
+		if ( ++m_ulCalmFrames >= PP_CALM_FRAMES && m_eQuality < m_eMaxQuality )
+		{
+			m_eQuality = (EQuality)(m_eQuality + 1);
+			m_ulCalmFrames = 0;
+		}
+	}
+	else
+	{
+		m_ulCalmFrames = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : GlowRows () (Private)
+// Desc : The bright pass of two rows averaged over 2 * iRadius + 1 pixels,
+//		as running sums over copies padded with dark pixels; the last row
+//		of a band comes alone, given as both. The mean is rounded through a
+//		16 bit reciprocal as CConvolution's box blur does, so the SSE2 and
+//		the plain C path agree.
+//-----------------------------------------------------------------------------
+void CPostProcess::GlowRows( const RGBQUAD *pRows[2], int iWidth, int iRadius, BYTE *pGlow[2] ) const
+{
+	static thread_local std::vector<WORD> Pairs;
+
+	int iWindow	= 2 * iRadius + 1;
+	int iRecip	= (65536 + iWindow - 1) / iWindow;
+	int x;
+
+#ifdef USE_SSE2
+	// Both rows side by side, eight channels in 16 bit lanes, each pixel's
+	// bright pass worked out once rather than on the way in and out
+	__m128i Zero		= _mm_setzero_si128();
+	__m128i Threshold	= _mm_set1_epi32( (int)(0xFF000000u | PP_BLOOM_THRESHOLD * 0x010101u) );
+
+	Pairs.resize( (iWidth + iWindow) * 8 );
+	WORD *pPairs = Pairs.data();
+	memset( pPairs, 0, iRadius * 8 * sizeof(WORD) );
+	memset( pPairs + (iRadius + iWidth) * 8, 0, (iRadius + 1) * 8 * sizeof(WORD) );
+
+	for ( x = 0; x + 4 <= iWidth; x += 4 )
+	{
+		__m128i a	= _mm_subs_epu8( _mm_loadu_si128( (const __m128i*)(pRows[0] + x) ), Threshold );
+		__m128i b	= _mm_subs_epu8( _mm_loadu_si128( (const __m128i*)(pRows[1] + x) ), Threshold );
+		__m128i lo	= _mm_unpacklo_epi32( a, b ), hi = _mm_unpackhi_epi32( a, b );
+		WORD *p = pPairs + (iRadius + x) * 8;
+		_mm_storeu_si128( (__m128i*)p, _mm_unpacklo_epi8( lo, Zero ) );
+		_mm_storeu_si128( (__m128i*)(p + 8), _mm_unpackhi_epi8( lo, Zero ) );
+		_mm_storeu_si128( (__m128i*)(p + 16), _mm_unpacklo_epi8( hi, Zero ) );
+		_mm_storeu_si128( (__m128i*)(p + 24), _mm_unpackhi_epi8( hi, Zero ) );
+	}
+	for ( ; x < iWidth; x++ )
+	{
+		__m128i a = _mm_cvtsi32_si128( *(const int*)(pRows[0] + x) ), b = _mm_cvtsi32_si128( *(const int*)(pRows[1] + x) );
+		__m128i v = _mm_subs_epu8( _mm_unpacklo_epi32( a, b ), Threshold );
+		_mm_storeu_si128( (__m128i*)(pPairs + (iRadius + x) * 8), _mm_unpacklo_epi8( v, Zero ) );
+	}
+
+	__m128i Sum = Zero;
+	for ( x = 0; x < iWindow - 1; x++ )
+		Sum = _mm_add_epi16( Sum, _mm_loadu_si128( (const __m128i*)(pPairs + x * 8) ) );
+
+	__m128i Half	= _mm_set1_epi16( (short)iRadius );
+	__m128i Recip	= _mm_set1_epi16( (short)iRecip );
+	for ( x = 0; x < iWidth; x++ )
+	{
+		Sum = _mm_add_epi16( Sum, _mm_loadu_si128( (const __m128i*)(pPairs + (x + iWindow - 1) * 8) ) );
+		__m128i Mean = _mm_mulhi_epu16( _mm_add_epi16( Sum, Half ), Recip );
+		Mean = _mm_packus_epi16( Mean, Mean );
+		*(int*)(pGlow[1] + x * 4) = _mm_cvtsi128_si32( _mm_srli_si128( Mean, 4 ) );
+		*(int*)(pGlow[0] + x * 4) = _mm_cvtsi128_si32( Mean );
+		Sum = _mm_sub_epi16( Sum, _mm_loadu_si128( (const __m128i*)(pPairs + x * 8) ) );
+	}
+#else
+	Pairs.assign( iWidth + iWindow, 0 );
+	WORD *pBright = Pairs.data() + iRadius;
+
+	for ( int j = 0; j < (pGlow[1] != pGlow[0] ? 2 : 1); j++ )
+	{
+		for ( int k = 0; k < 3; k++ )
+		{
+			for ( x = 0; x < iWidth; x++ )
+				pBright[x] = (WORD)max( 0, (&pRows[j][x].rgbBlue)[k] - PP_BLOOM_THRESHOLD );
+
+			int iSum = 0;
+			for ( x = 0; x < iWindow - 1; x++ ) iSum += Pairs[x];
+
+			for ( x = 0; x < iWidth; x++ )
+			{
+				iSum += Pairs[x + iWindow - 1];
+				pGlow[j][x * 4 + k] = (BYTE)(((iSum + iRadius) * iRecip) >> 16);
+				iSum -= Pairs[x];
+			}
+		}
+
+		for ( x = 0; x < iWidth; x++ ) pGlow[j][x * 4 + 3] = 0;
+	}
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : ProcessRow () (Private)
+// Desc : All effects for one row in a single read and write of the row.
+//		pSums are the bloom's column sums around the row, 4 per pixel, NULL
+//		for no bloom; they are scaled by the gain over the window here.
+//-----------------------------------------------------------------------------
+void CPostProcess::ProcessRow( RGBQUAD *pRow, int iWidth, int y, const SParams &Params, const WORD *pSums ) const
+{
+	int  iScan	= (y & 1) ? Params.iScanline : 256;
+	bool bBloom	= pSums != NULL;
+	int  iGain	= bBloom ? (Params.iBloomGain << 8) / (2 * Params.iBloomRadius + 1) : 0;	// gain / window, 16.16
+	int  iFlashR = Params.iFlash, iFlashGB = Params.iFlash / 4;
+	int  x = 0;
+
+#ifdef USE_SSE2
+	__m128i Zero	= _mm_setzero_si128();
+	__m128i Scan	= _mm_set1_epi16( (short)iScan );
+	__m128i Flash	= _mm_setr_epi16( (short)iFlashGB, (short)iFlashGB, (short)iFlashR, 0,
+									  (short)iFlashGB, (short)iFlashGB, (short)iFlashR, 0 );
+	__m128i Gain	= _mm_set1_epi16( (short)iGain );
+	__m128i Top		= _mm_set1_epi16( 255 );
+
+	for ( ; x + 4 <= iWidth; x += 4 )
+	{
+		__m128i v  = _mm_loadu_si128( (const __m128i*)(pRow + x) );
+		__m128i lo = _mm_srli_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( v, Zero ), Scan ), 8 );
+		__m128i hi = _mm_srli_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( v, Zero ), Scan ), 8 );
+
+		if ( bBloom )
+		{
+			lo = _mm_adds_epu16( lo, _mm_min_epi16( _mm_mulhi_epu16( _mm_loadu_si128( (const __m128i*)(pSums + x * 4) ), Gain ), Top ) );
+			hi = _mm_adds_epu16( hi, _mm_min_epi16( _mm_mulhi_epu16( _mm_loadu_si128( (const __m128i*)(pSums + x * 4 + 8) ), Gain ), Top ) );
+		}
+
+		lo = _mm_adds_epu16( lo, Flash );
+		hi = _mm_adds_epu16( hi, Flash );
+		_mm_storeu_si128( (__m128i*)(pRow + x), _mm_packus_epi16( lo, hi ) );
+	}
+#endif
+
+	for ( ; x < iWidth; x++ )
+	{
+		BYTE *c = &pRow[x].rgbBlue;
+		int  add[3] = { iFlashGB, iFlashGB, iFlashR };
+
+		for ( int k = 0; k < 3; k++ )
+		{
+			int v = ((c[k] * iScan) >> 8) + add[k] + (bBloom ? min( (pSums[x * 4 + k] * iGain) >> 16, 255 ) : 0);
+			c[k] = (BYTE)min( v, 255 );
+		}
+	}
+}
@@ -0,0 +1,406 @@
+//-----------------------------------------------------------------------------
+// File: Projectiles.cpp
+//
+// Desc: Shots in flight, kept as parallel float arrays, and the emitters
+//	   that spawn them in patterns.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CProjectiles Specific Includes
+//-----------------------------------------------------------------------------
+#include "Projectiles.h"
+#include <math.h>
+#include <string.h>
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+static const float HALF_PI	= 1.57079632679f;
+static const float TWO_PI	= 6.28318530718f;
+
+//-----------------------------------------------------------------------------
+// Name : SProjectileState (Struct)
+// Desc : Fixed part of saved projectiles, followed by Count floats for each
+//		of x, y, previous x and y, velocity x and y, acceleration x and y,
+//		then Count keep flags, then padding to a multiple of 8 bytes.
+//-----------------------------------------------------------------------------
+struct SProjectileState
+{
+	uint32_t	Count;
+	uint32_t	Reserved;
+};
+
+//-----------------------------------------------------------------------------
+// Name : StateSize () (Static)
+//-----------------------------------------------------------------------------
+static size_t StateSize( size_t nCount )
+{
+	return (sizeof(SProjectileState) + nCount * (8 * sizeof(float) + sizeof(uint32_t)) + 7) & ~(size_t)7;
+}
+
+//-----------------------------------------------------------------------------
+// Name : CProjectiles () (Constructor)
+// Desc : CProjectiles Class Constructor
+//-----------------------------------------------------------------------------
+CProjectiles::CProjectiles()
+{
+	m_nCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CProjectiles () (Destructor)
+// Desc : CProjectiles Class Destructor
+//-----------------------------------------------------------------------------
+CProjectiles::~CProjectiles()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : Resize () (Private)
+// Desc : Sets the number of slots of every array, a multiple of 4.
+//-----------------------------------------------------------------------------
+void CProjectiles::Resize( size_t nSlots )
+{
+	m_X.resize( nSlots );
+	m_Y.resize( nSlots );
+	m_PrevX.resize( nSlots );
+	m_PrevY.resize( nSlots );
+	m_VX.resize( nSlots );
+	m_VY.resize( nSlots );
+	m_AX.resize( nSlots );
+	m_AY.resize( nSlots );
+	m_Keep.resize( nSlots );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Reserve ()
+// Desc : Makes room for nCount shots, so spawning that many does not allocate.
+//-----------------------------------------------------------------------------
+void CProjectiles::Reserve( size_t nCount )
+{
+	if ( nCount > m_X.size() ) Resize( (nCount + 3) & ~(size_t)3 );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Spawn ()
+// Desc : Adds one shot. It starts out where it was, so it is not drawn
+//		sliding in from elsewhere.
+//-----------------------------------------------------------------------------
+void CProjectiles::Spawn( float x, float y, float vx, float vy, float ax, float ay )
+{
+	if ( m_nCount == m_X.size() ) Resize( m_X.size() < 16 ? 16 : m_X.size() * 2 );
+
+	size_t i = m_nCount++;
+	m_X[i]		= m_PrevX[i] = x;
+	m_Y[i]		= m_PrevY[i] = y;
+	m_VX[i]		= vx;
+	m_VY[i]		= vy;
+	m_AX[i]		= ax;
+	m_AY[i]		= ay;
+	m_Keep[i]	= ~0u;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Emit ()
+// Desc : Spawns the emitter's pattern at Origin, Target being what an aimed
+//		pattern aims at. Returns the number of shots spawned.
+//-----------------------------------------------------------------------------
+int CProjectiles::Emit( const SEmitter& Emitter, const Vec2& Origin, const Vec2& Target )
+{
+	if ( Emitter.Count <= 0 ) return 0;
+
+	// Unit vector of the centre of a fan, or of the first shot
+	float dx, dy;
+	if ( Emitter.Pattern == SEmitter::PATTERN_AIMED )
+	{
+		dx = (float)(Target.x - Origin.x);
+		dy = (float)(Target.y - Origin.y);
+		float fLength = sqrtf( dx * dx + dy * dy );
+		if ( fLength > 0.0f ) { dx /= fLength; dy /= fLength; }
+		else { dx = 0.0f; dy = 1.0f; }
+	}
+	else SinCos( Emitter.Angle, dx, dy );
+
+	float fStart = 0.0f, fStep = 0.0f;
+	switch ( Emitter.Pattern )
+	{
+	case SEmitter::PATTERN_SPREAD:
+	case SEmitter::PATTERN_AIMED:
+		if ( Emitter.Count > 1 )
+		{
+			fStart	= -Emitter.Arc * 0.5f;
+			fStep	= Emitter.Arc / (Emitter.Count - 1);
+		}
+		break;
+	case SEmitter::PATTERN_RING:	fStep = TWO_PI / Emitter.Count; break;
+	case SEmitter::PATTERN_SPIRAL:	fStep = Emitter.Arc; break;
+	}
+
+	Reserve( m_nCount + Emitter.Count );
+
+	float x = (float)Origin.x, y = (float)Origin.y;
+	for ( int k = 0; k < Emitter.Count; k++ )
+	{
+		float s, c;
+		SinCos( fStart + k * fStep, s, c );
+
+		// (dx, dy) turned by the shot's offset
+		float ux = dx * c + dy * s, uy = dy * c - dx * s;
+		float fSpeed = Emitter.Speed + k * Emitter.SpeedStep;
+		Spawn( x, y, ux * fSpeed, uy * fSpeed, ux * Emitter.Accel, uy * Emitter.Accel );
+	}
+
+	return Emitter.Count;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Integrate ()
+// Desc : Semi-implicit Euler step of every shot, four at a time: velocity
+//		first, then position with the new velocity.
+//-----------------------------------------------------------------------------
+void CProjectiles::Integrate( float dt )
+{
+	size_t nSlots = (m_nCount + 3) & ~(size_t)3;
+
+	float *pX = m_X.data(), *pY = m_Y.data();
+	float *pPrevX = m_PrevX.data(), *pPrevY = m_PrevY.data();
+	float *pVX = m_VX.data(), *pVY = m_VY.data();
+	const float *pAX = m_AX.data(), *pAY = m_AY.data();
+
+#ifdef USE_SSE2
+	const __m128 Dt = _mm_set1_ps( dt );
+	for ( size_t i = 0; i < nSlots; i += 4 )
+	{
+		__m128 x = _mm_loadu_ps( pX + i ), y = _mm_loadu_ps( pY + i );
+		_mm_storeu_ps( pPrevX + i, x );
+		_mm_storeu_ps( pPrevY + i, y );
+
+		__m128 vx = _mm_add_ps( _mm_loadu_ps( pVX + i ), _mm_mul_ps( _mm_loadu_ps( pAX + i ), Dt ) );
+		__m128 vy = _mm_add_ps( _mm_loadu_ps( pVY + i ), _mm_mul_ps( _mm_loadu_ps( pAY + i ), Dt ) );
+		_mm_storeu_ps( pVX + i, vx );
+		_mm_storeu_ps( pVY + i, vy );
+
+		_mm_storeu_ps( pX + i, _mm_add_ps( x, _mm_mul_ps( vx, Dt ) ) );
+		_mm_storeu_ps( pY + i, _mm_add_ps( y, _mm_mul_ps( vy, Dt ) ) );
+	}
+#else
+	for ( size_t i = 0; i < nSlots; i++ )
+	{
+		pPrevX[i] = pX[i];
+		pPrevY[i] = pY[i];
+		pVX[i] += pAX[i] * dt;
+		pVY[i] += pAY[i] * dt;
+		pX[i] += pVX[i] * dt;
+		pY[i] += pVY[i] * dt;
+	}
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : Cull ()
+// Desc : Drops the killed shots and those outside the box, keeping the order
+//		of the rest. The box test runs four shots at a time into a bit mask;
+//		in a group with a shot to drop, every shot is copied to the write
+//		position, which only moves on for the ones kept. Returns the number
+//		dropped.
+//-----------------------------------------------------------------------------
+size_t CProjectiles::Cull( float fLeft, float fTop, float fRight, float fBottom )
+{
+	std::vector<float> *Arrays[] = { &m_X, &m_Y, &m_PrevX, &m_PrevY, &m_VX, &m_VY, &m_AX, &m_AY };
+	size_t nCount = m_nCount, w = 0;
+
+#ifdef USE_SSE2
+	const __m128 Left = _mm_set1_ps( fLeft ), Top = _mm_set1_ps( fTop );
+	const __m128 Right = _mm_set1_ps( fRight ), Bottom = _mm_set1_ps( fBottom );
+#endif
+
+	for ( size_t i = 0; i < nCount; i += 4 )
+	{
+#ifdef USE_SSE2
+		__m128 x = _mm_loadu_ps( &m_X[i] ), y = _mm_loadu_ps( &m_Y[i] );
+		__m128 In = _mm_and_ps( _mm_and_ps( _mm_cmpge_ps( x, Left ), _mm_cmple_ps( x, Right ) ),
+								_mm_and_ps( _mm_cmpge_ps( y, Top ), _mm_cmple_ps( y, Bottom ) ) );
+		In = _mm_and_ps( In, _mm_castsi128_ps( _mm_loadu_si128( (const __m128i*)&m_Keep[i] ) ) );
+
+		int nKeep = _mm_movemask_ps( In );
+#else
+		int nKeep = 0;
+		for ( size_t k = 0; k < 4; k++ )
+		{
+			size_t j = i + k;
+			bool bIn = m_X[j] >= fLeft && m_X[j] <= fRight && m_Y[j] >= fTop && m_Y[j] <= fBottom && m_Keep[j];
+			nKeep |= (int)bIn << k;
+		}
+#endif
+		if ( nCount - i < 4 ) nKeep &= (1 << (nCount - i)) - 1;
+
+		// Nearly every group is kept whole: four shots move as one, or stay put
+		if ( nKeep == 15 )
+		{
+			if ( w != i )
+			{
+#ifdef USE_SSE2
+				for ( int a = 0; a < 8; a++ ) _mm_storeu_ps( &(*Arrays[a])[w], _mm_loadu_ps( &(*Arrays[a])[i] ) );
+				_mm_storeu_si128( (__m128i*)&m_Keep[w], _mm_set1_epi32( -1 ) );
+#else
+				for ( int a = 0; a < 8; a++ )
+					for ( size_t k = 0; k < 4; k++ ) (*Arrays[a])[w + k] = (*Arrays[a])[i + k];
+				for ( size_t k = 0; k < 4; k++ ) m_Keep[w + k] = ~0u;
+#endif
+			}
+			w += 4;
+			continue;
+		}
+
+		for ( size_t k = 0; k < 4; k++ )
+		{
+			size_t j = i + k;
+			for ( int a = 0; a < 8; a++ ) (*Arrays[a])[w] = (*Arrays[a])[j];
+			m_Keep[w] = ~0u;
+			w += (nKeep >> k) & 1;
+		}
+	}
+
+	m_nCount = w;
+	return nCount - w;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Sweep ()
+// Desc : The live iWidth x iHeight shot that touched Target first during
+//		the last Integrate, Target having moved by TargetMove meanwhile, and
+//		when; -1 if none did. Each shot is swept by its movement relative
+//		to Target, against where Target is now.
+//-----------------------------------------------------------------------------
+int CProjectiles::Sweep( const SBox& Target, const Vec2& TargetMove, int iWidth, int iHeight, float& fTime ) const
+{
+	int iFirst = -1;
+	float fMoveX = (float)TargetMove.x, fMoveY = (float)TargetMove.y;
+
+	for ( size_t i = 0; i < m_nCount; i++ )
+	{
+		if ( !m_Keep[i] ) continue;
+
+		float x = m_PrevX[i] + fMoveX, y = m_PrevY[i] + fMoveY, t;
+		SBox Box = CBoxSet::MakeBox( Vec2( x, y ), iWidth, iHeight );
+		if ( !CBoxSet::Sweep( Box, m_X[i] - x, m_Y[i] - y, Target, t ) || (iFirst >= 0 && t >= fTime) ) continue;
+
+		iFirst = (int)i;
+		fTime = t;
+	}
+
+	return iFirst;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SinCos () (Static)
+// Desc : Sine and cosine from plain float arithmetic, so every build and
+//		every CPU spawns the same pattern. Good to about 1e-6 near zero,
+//		plenty for aiming shots.
+//-----------------------------------------------------------------------------
+void CProjectiles::SinCos( float fAngle, float& fSin, float& fCos )
+{
+	// Quadrant and the remainder within +/- 45 degrees
+	float q = floorf( fAngle / HALF_PI + 0.5f );
+	float r = fAngle - q * HALF_PI, r2 = r * r;
+
+	float s = r * (1.0f - r2 * (1.0f / 6.0f - r2 * (1.0f / 120.0f - r2 * (1.0f / 5040.0f))));
+	float c = 1.0f - r2 * (0.5f - r2 * (1.0f / 24.0f - r2 * (1.0f / 720.0f - r2 * (1.0f / 40320.0f))));
+
+	switch ( (int)q & 3 )
+	{
+	case 0: fSin = s;  fCos = c;  break;
+	case 1: fSin = c;  fCos = -s; break;
+	case 2: fSin = -s; fCos = -c; break;
+	case 3: fSin = -c; fCos = s;  break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetStateSize ()
+// Desc : Bytes SaveState writes, a multiple of 8.
+//-----------------------------------------------------------------------------
+size_t CProjectiles::GetStateSize() const
+{
+	return StateSize( m_nCount );
+}
+
+//-----------------------------------------------------------------------------
+// Name : SaveState ()
+// Desc : Copies the shots to pBuffer, which must hold GetStateSize bytes.
+//-----------------------------------------------------------------------------
+void CProjectiles::SaveState( void *pBuffer ) const
+{
+	SProjectileState *pState = (SProjectileState*)pBuffer;
+	pState->Count		= (uint32_t)m_nCount;
+	pState->Reserved	= 0;
+
+	const std::vector<float> *Arrays[] = { &m_X, &m_Y, &m_PrevX, &m_PrevY, &m_VX, &m_VY, &m_AX, &m_AY };
+	size_t nBytes = m_nCount * sizeof(float);
+	uint8_t *p = (uint8_t*)(pState + 1);
+
+	if ( !m_nCount ) return;
+	for ( int a = 0; a < 8; a++, p += nBytes ) memcpy( p, Arrays[a]->data(), nBytes );
+	memcpy( p, m_Keep.data(), m_nCount * sizeof(uint32_t) );
+}
+
+//-----------------------------------------------------------------------------
+// Name : IsState () (Static)
+// Desc : Whether the nSize bytes at pBuffer can be loaded.
+//-----------------------------------------------------------------------------
+bool CProjectiles::IsState( const void *pBuffer, size_t nSize )
+{
+	const SProjectileState *pState = (const SProjectileState*)pBuffer;
+	return nSize >= sizeof(SProjectileState) && StateSize( pState->Count ) == nSize;
+}
+
+//-----------------------------------------------------------------------------
+// Name : LoadState ()
+// Desc : Restores shots saved by SaveState. False, with nothing changed, if
+//		the size does not match.
+//-----------------------------------------------------------------------------
+bool CProjectiles::LoadState( const void *pBuffer, size_t nSize )
+{
+	const SProjectileState *pState = (const SProjectileState*)pBuffer;
+	if ( !IsState( pBuffer, nSize ) ) return false;
+
+	m_nCount = pState->Count;
+	Reserve( m_nCount );
+
+	std::vector<float> *Arrays[] = { &m_X, &m_Y, &m_PrevX, &m_PrevY, &m_VX, &m_VY, &m_AX, &m_AY };
+	size_t nBytes = m_nCount * sizeof(float);
+	const uint8_t *p = (const uint8_t*)(pState + 1);
+
+	if ( !m_nCount ) return true;
+	for ( int a = 0; a < 8; a++, p += nBytes ) memcpy( Arrays[a]->data(), p, nBytes );
+	memcpy( m_Keep.data(), p, m_nCount * sizeof(uint32_t) );
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Checksum ()
+// Desc : Carries CGameWorld's FNV-1a hash h on over the shots.
+//-----------------------------------------------------------------------------
+uint32_t CProjectiles::Checksum( uint32_t h ) const
+{
+	auto Mix = [&h]( const void *p, size_t n )
+	{
+		const unsigned char *b = (const unsigned char*)p;
+		for ( size_t i = 0; i < n; i++ ) h = (h ^ b[i]) * 16777619u;
+	};
+
+	uint32_t nCount = (uint32_t)m_nCount;
+	Mix( &nCount, sizeof(nCount) );
+	if ( !m_nCount ) return h;
+
+	Mix( m_X.data(), m_nCount * sizeof(float) );
+	Mix( m_Y.data(), m_nCount * sizeof(float) );
+	Mix( m_VX.data(), m_nCount * sizeof(float) );
+	Mix( m_VY.data(), m_nCount * sizeof(float) );
+
+	return h;
+}
@@ -0,0 +1,234 @@
+//-----------------------------------------------------------------------------
+// File: Random.cpp
+//
+// Desc: Seedable random number streams for the simulation: one generator
+//	   per subsystem or object, and a four lane one for filling arrays.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CRandom Specific Includes
+//-----------------------------------------------------------------------------
+#include "Random.h"
+#include <string.h>
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Name : Mix64 ()
+// Desc : The splitmix64 finaliser: every input bit moves about half the
+//		output bits.
+//-----------------------------------------------------------------------------
+static uint64_t Mix64( uint64_t z )
+{
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+//-----------------------------------------------------------------------------
+// Name : Seed ()
+// Desc : Starts stream nStream of seed nSeed. Different streams of one seed
+//		and the same stream of different seeds are unrelated generators.
+//-----------------------------------------------------------------------------
+void CRandom::Seed( uint64_t nSeed, uint64_t nStream )
+{
+	// splitmix64 from a key that mixes both, as its authors suggest
+	uint64_t x = Mix64( nSeed ) ^ Mix64( nStream ^ 0x6A09E667F3BCC909ull );
+	for ( int i = 0; i < 4; i += 2 )
+	{
+		x += 0x9E3779B97F4A7C15ull;
+		uint64_t z = Mix64( x );
+		m_s[i]		= (uint32_t)z;
+		m_s[i + 1]	= (uint32_t)(z >> 32);
+	}
+
+	// The one state xoshiro never leaves
+	if ( !(m_s[0] | m_s[1] | m_s[2] | m_s[3]) ) m_s[0] = 1;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Split ()
+// Desc : A new stream seeded from where this one is, leaving this one as it
+//		was. Splitting the same state with the same nStream always gives the
+//		same stream.
+//-----------------------------------------------------------------------------
+CRandom CRandom::Split( uint64_t nStream ) const
+{
+	uint64_t nLow  = ((uint64_t)m_s[1] << 32) | m_s[0];
+	uint64_t nHigh = ((uint64_t)m_s[3] << 32) | m_s[2];
+	return CRandom( nLow ^ Mix64( nHigh ), nStream );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Checksum ()
+// Desc : Carries CGameWorld's FNV-1a hash h on over the state.
+//-----------------------------------------------------------------------------
+uint32_t CRandom::Checksum( uint32_t h ) const
+{
+	const unsigned char *b = (const unsigned char*)m_s;
+	for ( size_t i = 0; i < sizeof(m_s); i++ ) h = (h ^ b[i]) * 16777619u;
+	return h;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Generate ()
+// Desc : Steps all four lanes of State ceil(n / 4) times, handing each step
+//		to Out with the index of its first element. Out gets an __m128i with
+//		SSE2 and four uint32_t otherwise, lane 0 first.
+//-----------------------------------------------------------------------------
+template <class Store>
+static void Generate( uint32_t State[4][RANDOM_LANES], size_t n, Store Out )
+{
+#ifdef USE_SSE2
+	__m128i s0 = _mm_loadu_si128( (const __m128i*)State[0] );
+	__m128i s1 = _mm_loadu_si128( (const __m128i*)State[1] );
+	__m128i s2 = _mm_loadu_si128( (const __m128i*)State[2] );
+	__m128i s3 = _mm_loadu_si128( (const __m128i*)State[3] );
+
+	for ( size_t i = 0; i < n; i += RANDOM_LANES )
+	{
+		// CRandom::Next on four lanes, rotates made of two shifts
+		__m128i Sum = _mm_add_epi32( s0, s3 );
+		__m128i Result = _mm_add_epi32( _mm_or_si128( _mm_slli_epi32( Sum, 7 ), _mm_srli_epi32( Sum, 25 ) ), s0 );
+		__m128i t = _mm_slli_epi32( s1, 9 );
+
+		s2 = _mm_xor_si128( s2, s0 );
+		s3 = _mm_xor_si128( s3, s1 );
+		s1 = _mm_xor_si128( s1, s2 );
+		s0 = _mm_xor_si128( s0, s3 );
+		s2 = _mm_xor_si128( s2, t );
+		s3 = _mm_or_si128( _mm_slli_epi32( s3, 11 ), _mm_srli_epi32( s3, 21 ) );
+
+		Out( i, Result );
+	}
+
+	_mm_storeu_si128( (__m128i*)State[0], s0 );
+	_mm_storeu_si128( (__m128i*)State[1], s1 );
+	_mm_storeu_si128( (__m128i*)State[2], s2 );
+	_mm_storeu_si128( (__m128i*)State[3], s3 );
+#else
+	for ( size_t i = 0; i < n; i += RANDOM_LANES )
+	{
+		uint32_t Result[RANDOM_LANES];
+		for ( int k = 0; k < RANDOM_LANES; k++ )
+		{
+			uint32_t& s0 = State[0][k], & s1 = State[1][k], & s2 = State[2][k], & s3 = State[3][k];
+			Result[k] = CRandom::Rotate( s0 + s3, 7 ) + s0;
+			uint32_t t = s1 << 9;
+
+			s2 ^= s0;
+			s3 ^= s1;
+			s1 ^= s2;
+			s0 ^= s3;
+			s2 ^= t;
+			s3 = CRandom::Rotate( s3, 11 );
+		}
+
+		Out( i, Result );
+	}
+#endif
+}
+
+#ifdef USE_SSE2
+//-----------------------------------------------------------------------------
+// Name : Store ()
+// Desc : Writes the first min(n, 4) lanes of x to p.
+//-----------------------------------------------------------------------------
+static inline void Store( void *p, __m128i x, size_t n )
+{
+	if ( n >= RANDOM_LANES ) { _mm_storeu_si128( (__m128i*)p, x ); return; }
+
+	uint32_t Lanes[RANDOM_LANES];
+	_mm_storeu_si128( (__m128i*)Lanes, x );
+	memcpy( p, Lanes, n * sizeof(uint32_t) );
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// Name : Seed ()
+// Desc : Lane k starts as CRandom( nSeed, nStream ).Split( k ).
+//-----------------------------------------------------------------------------
+void CRandomBatch::Seed( uint64_t nSeed, uint64_t nStream )
+{
+	CRandom Base( nSeed, nStream );
+	for ( int k = 0; k < RANDOM_LANES; k++ )
+	{
+		CRandom Lane = Base.Split( k );
+		for ( int j = 0; j < 4; j++ ) m_s[j][k] = Lane.m_s[j];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetLane ()
+// Desc : Where one lane is, as a CRandom that goes on the same way.
+//-----------------------------------------------------------------------------
+CRandom CRandomBatch::GetLane( int iLane ) const
+{
+	CRandom Lane;
+	for ( int j = 0; j < 4; j++ ) Lane.m_s[j] = m_s[j][iLane];
+	return Lane;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Fill ()
+// Desc : n times 32 random bits, as CRandom::Next gives them.
+//-----------------------------------------------------------------------------
+void CRandomBatch::Fill( uint32_t *pOut, size_t n )
+{
+#ifdef USE_SSE2
+	Generate( m_s, n, [=]( size_t i, __m128i x ) { Store( pOut + i, x, n - i ); } );
+#else
+	Generate( m_s, n, [=]( size_t i, const uint32_t *x )
+	{
+		for ( size_t k = 0; k < RANDOM_LANES && i + k < n; k++ ) pOut[i + k] = x[k];
+	} );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : FillFloats ()
+// Desc : n floats in [0, 1), as CRandom::NextFloat gives them.
+//-----------------------------------------------------------------------------
+void CRandomBatch::FillFloats( float *pOut, size_t n )
+{
+#ifdef USE_SSE2
+	const __m128 Scale = _mm_set1_ps( 1.0f / 16777216.0f );
+	Generate( m_s, n, [=]( size_t i, __m128i x )
+	{
+		// 24 bits convert to float exactly, as signed ints
+		__m128 f = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( x, 8 ) ), Scale );
+		Store( pOut + i, _mm_castps_si128( f ), n - i );
+	} );
+#else
+	Generate( m_s, n, [=]( size_t i, const uint32_t *x )
+	{
+		for ( size_t k = 0; k < RANDOM_LANES && i + k < n; k++ ) pOut[i + k] = (float)(x[k] >> 8) * (1.0f / 16777216.0f);
+	} );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : FillBelow ()
+// Desc : n values from 0 to nBound - 1, as CRandom::Below gives them.
+//-----------------------------------------------------------------------------
+void CRandomBatch::FillBelow( uint32_t *pOut, size_t n, uint32_t nBound )
+{
+#ifdef USE_SSE2
+	const __m128i Bound = _mm_set1_epi32( (int)nBound );
+	const __m128i OddLanes = _mm_set_epi32( -1, 0, -1, 0 );
+	Generate( m_s, n, [=]( size_t i, __m128i x )
+	{
+		// SSE2 multiplies lanes 0 and 2 to 64 bits; the high halves are the
+		// results, so lanes 1 and 3 go through a second multiply shifted down
+		__m128i Even = _mm_srli_epi64( _mm_mul_epu32( x, Bound ), 32 );
+		__m128i Odd  = _mm_and_si128( _mm_mul_epu32( _mm_srli_epi64( x, 32 ), Bound ), OddLanes );
+		Store( pOut + i, _mm_or_si128( Even, Odd ), n - i );
+	} );
+#else
+	Generate( m_s, n, [=]( size_t i, const uint32_t *x )
+	{
+		for ( size_t k = 0; k < RANDOM_LANES && i + k < n; k++ ) pOut[i + k] = (uint32_t)(((uint64_t)x[k] * nBound) >> 32);
+	} );
+#endif
+}
@@ -0,0 +1,294 @@
+//-----------------------------------------------------------------------------
+// File: Replay.cpp
+//
+// Desc: Recording of a game as its seed plus the input of every tick, and
+//	   playback of such a recording.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CReplay Specific Includes
+//-----------------------------------------------------------------------------
+#include "Replay.h"
+#include <string.h>
+#include <fstream>
+#include <iterator>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+static const char	REPLAY_MAGIC[4]	= { 'S', 'I', 'R', 'P' };
+static const uint8_t REPLAY_VERSION	= 10;		// Bump whenever the same input plays a different game
+
+//-----------------------------------------------------------------------------
+// Name : PutVarint () (Static)
+// Desc : Appends n, seven bits per byte, low bits first.
+//-----------------------------------------------------------------------------
+static void PutVarint( std::vector<uint8_t>& Data, uint32_t n )
+{
+	while ( n >= 0x80 )
+	{
+		Data.push_back( (uint8_t)(n | 0x80) );
+		n >>= 7;
+	}
+	Data.push_back( (uint8_t)n );
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetVarint () (Static)
+// Desc : Reads a varint at nPos and moves past it, false if it runs off the
+//		end of the data or is too long for 32 bits.
+//-----------------------------------------------------------------------------
+static bool GetVarint( const std::vector<uint8_t>& Data, size_t& nPos, uint32_t& n )
+{
+	n = 0;
+	for ( int nShift = 0; nShift < 35 && nPos < Data.size(); nShift += 7 )
+	{
+		uint8_t b = Data[nPos++];
+		n |= (uint32_t)(b & 0x7F) << nShift;
+		if ( !(b & 0x80) ) return true;
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Name : LevelHash () (Static)
+// Desc : Which levels the world plays from its next Reset on, 0 for the
+//		built in wave.
+//-----------------------------------------------------------------------------
+static uint64_t LevelHash( const CGameWorld& World )
+{
+	return World.GetLevels() ? World.GetLevels()->GetSourceHash() : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : EncodeInput () (Static)
+//-----------------------------------------------------------------------------
+static uint32_t EncodeInput( const STickInput& Input )
+{
+	uint32_t nCode = 0;
+	for ( int i = 0; i < WORLD_PLAYERS; i++ )
+	{
+		uint32_t nPlayer = (Input.Direction[i] & 15) | (Input.bFire[i] ? 16 : 0) | ((Input.Actions[i] & 3) << 5);
+		nCode |= nPlayer << (i * 8);
+	}
+	return nCode;
+}
+
+//-----------------------------------------------------------------------------
+// Name : DecodeInput () (Static)
+//-----------------------------------------------------------------------------
+static void DecodeInput( uint32_t nCode, STickInput& Input )
+{
+	for ( int i = 0; i < WORLD_PLAYERS; i++ )
+	{
+		uint32_t nPlayer = nCode >> (i * 8);
+		Input.Direction[i]	= nPlayer & 15;
+		Input.bFire[i]		= (nPlayer & 16) != 0;
+		Input.Actions[i]	= (nPlayer >> 5) & 3;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : CReplayWriter () (Constructor)
+// Desc : CReplayWriter Class Constructor
+//-----------------------------------------------------------------------------
+CReplayWriter::CReplayWriter()
+{
+	m_bRecording	= false;
+	m_nSeed			= 0;
+	m_nLevelHash	= 0;
+	m_nTicks		= 0;
+	m_nRunCode		= 0;
+	m_nRunLength	= 0;
+	memset( m_Size, 0, sizeof(m_Size) );
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CReplayWriter () (Destructor)
+// Desc : CReplayWriter Class Destructor
+//-----------------------------------------------------------------------------
+CReplayWriter::~CReplayWriter()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : Begin ()
+// Desc : Starts a new recording, dropping whatever was recorded before.
+//-----------------------------------------------------------------------------
+void CReplayWriter::Begin( unsigned int nSeed, const CGameWorld& World )
+{
+	m_bRecording	= true;
+	m_nSeed			= nSeed;
+	m_nLevelHash	= LevelHash( World );
+	m_nTicks		= 0;
+	m_nRunCode		= 0;
+	m_nRunLength	= 0;
+	m_Runs.clear();
+
+	for ( int i = 0; i < CGameWorld::KIND_COUNT; i++ )
+		World.GetSpriteSize( (CGameWorld::ESpriteKind)i, m_Size[i][0], m_Size[i][1] );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Record ()
+// Desc : Adds the input of one tick. Ignored once the recording stopped.
+//-----------------------------------------------------------------------------
+void CReplayWriter::Record( const STickInput& Input )
+{
+	if ( !m_bRecording ) return;
+
+	uint32_t nCode = EncodeInput( Input );
+	if ( m_nRunLength && nCode != m_nRunCode )
+	{
+		PutVarint( m_Runs, m_nRunCode );
+		PutVarint( m_Runs, m_nRunLength );
+		m_nRunLength = 0;
+	}
+
+	m_nRunCode = nCode;
+	m_nRunLength++;
+	m_nTicks++;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Save ()
+// Desc : Writes the recording so far. nChecksum is CGameWorld::Checksum
+//		after the last recorded tick, playback checks against it.
+//-----------------------------------------------------------------------------
+bool CReplayWriter::Save( const char *szFileName, uint32_t nChecksum ) const
+{
+	std::vector<uint8_t> Data( REPLAY_MAGIC, REPLAY_MAGIC + 4 );
+	Data.push_back( REPLAY_VERSION );
+
+	PutVarint( Data, SIM_TICK_RATE );
+	PutVarint( Data, m_nSeed );
+	for ( int i = 0; i < 8; i++ ) Data.push_back( (uint8_t)(m_nLevelHash >> (i * 8)) );
+	for ( int i = 0; i < CGameWorld::KIND_COUNT; i++ )
+	{
+		PutVarint( Data, (uint32_t)m_Size[i][0] );
+		PutVarint( Data, (uint32_t)m_Size[i][1] );
+	}
+	PutVarint( Data, m_nTicks );
+	for ( int i = 0; i < 4; i++ ) Data.push_back( (uint8_t)(nChecksum >> (i * 8)) );
+
+	Data.insert( Data.end(), m_Runs.begin(), m_Runs.end() );
+	if ( m_nRunLength )
+	{
+		PutVarint( Data, m_nRunCode );
+		PutVarint( Data, m_nRunLength );
+	}
+
+	std::ofstream File( szFileName, std::ios::binary | std::ios::trunc );
+	if ( !File ) return false;
+
+	File.write( (const char*)Data.data(), Data.size() );
+	return File.good();
+}
+
+//-----------------------------------------------------------------------------
+// Name : CReplayReader () (Constructor)
+// Desc : CReplayReader Class Constructor
+//-----------------------------------------------------------------------------
+CReplayReader::CReplayReader()
+{
+	m_nSeed		= 0;
+	m_nLevelHash = 0;
+	m_nTicks	= 0;
+	m_nChecksum	= 0;
+	m_nRunsStart = 0;
+	m_nRead		= 0;
+	m_nRunCode	= 0;
+	m_nRunLeft	= 0;
+	m_nPlayed	= 0;
+	memset( m_Size, 0, sizeof(m_Size) );
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CReplayReader () (Destructor)
+// Desc : CReplayReader Class Destructor
+//-----------------------------------------------------------------------------
+CReplayReader::~CReplayReader()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : Load ()
+// Desc : Reads a recording, false if the file is missing, not a recording,
+//		or made at another tick rate.
+//-----------------------------------------------------------------------------
+bool CReplayReader::Load( const char *szFileName )
+{
+	std::ifstream File( szFileName, std::ios::binary );
+	if ( !File ) return false;
+
+	m_Data.assign( std::istreambuf_iterator<char>( File ), std::istreambuf_iterator<char>() );
+	if ( m_Data.size() < 5 || memcmp( m_Data.data(), REPLAY_MAGIC, 4 ) || m_Data[4] != REPLAY_VERSION ) return false;
+
+	size_t   nPos = 5;
+	uint32_t nRate, n;
+
+	if ( !GetVarint( m_Data, nPos, nRate ) || nRate != SIM_TICK_RATE ) return false;
+	if ( !GetVarint( m_Data, nPos, m_nSeed ) || nPos + 8 > m_Data.size() ) return false;
+
+	m_nLevelHash = 0;
+	for ( int i = 0; i < 8; i++ ) m_nLevelHash |= (uint64_t)m_Data[nPos++] << (i * 8);
+
+	for ( int i = 0; i < CGameWorld::KIND_COUNT; i++ )
+	{
+		if ( !GetVarint( m_Data, nPos, n ) ) return false;
+		m_Size[i][0] = (int)n;
+		if ( !GetVarint( m_Data, nPos, n ) ) return false;
+		m_Size[i][1] = (int)n;
+	}
+	if ( !GetVarint( m_Data, nPos, m_nTicks ) || nPos + 4 > m_Data.size() ) return false;
+
+	m_nChecksum = 0;
+	for ( int i = 0; i < 4; i++ ) m_nChecksum |= (uint32_t)m_Data[nPos++] << (i * 8);
+
+	m_nRunsStart = m_nRead = nPos;
+	m_nRunLeft	= 0;
+	m_nPlayed	= 0;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Start ()
+// Desc : Puts the world where the recording started and rewinds to tick 0.
+//		False, leaving the world alone, if the levels set on it are not the
+//		ones the recording was made with (GetLevelHash): the same input
+//		would play another game.
+//-----------------------------------------------------------------------------
+bool CReplayReader::Start( CGameWorld& World )
+{
+	if ( LevelHash( World ) != m_nLevelHash ) return false;
+
+	for ( int i = 0; i < CGameWorld::KIND_COUNT; i++ )
+		World.SetSpriteSize( (CGameWorld::ESpriteKind)i, m_Size[i][0], m_Size[i][1] );
+	World.Reset( m_nSeed );
+
+	m_nRead		= m_nRunsStart;
+	m_nRunLeft	= 0;
+	m_nPlayed	= 0;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Next ()
+// Desc : The input of the next tick, false once the recording is over (or
+//		found to be cut short).
+//-----------------------------------------------------------------------------
+bool CReplayReader::Next( STickInput& Input )
+{
+	if ( m_nPlayed == m_nTicks ) return false;
+
+	if ( !m_nRunLeft )
+	{
+		if ( !GetVarint( m_Data, m_nRead, m_nRunCode ) || !GetVarint( m_Data, m_nRead, m_nRunLeft ) || !m_nRunLeft ) return false;
+	}
+
+	DecodeInput( m_nRunCode, Input );
+	m_nRunLeft--;
+	m_nPlayed++;
+	return true;
+}
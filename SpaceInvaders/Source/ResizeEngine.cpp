@@ -1,5 +1,12 @@
 #include "ResizeEngine.h"
 
+// Rounds an accumulated channel value back into a byte. Sharpening filters
+// (bicubic, Lanczos) have negative lobes and can overshoot either way.
+static inline BYTE ClampChannel(double v)
+{
+	return (BYTE)(v <= 0.0 ? 0 : (v >= 255.0 ? 255 : (int)(v + 0.5)));
+}
+
 CWeightsTable::CWeightsTable(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrcSize) 
 {
 	DWORD u;
@@ -26,12 +33,12 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrc
 	// window size is the number of sampled pixels
 	m_WindowSize = 2 * (int)ceil(dWidth) + 1;
 	m_LineLength = uDstSize;
-	// allocate list of contributions
+	// allocate list of contributions, the weights of every pixel share one block
 	m_WeightTable = new sContribution[m_LineLength];
+	m_Weights = new double[m_LineLength * m_WindowSize];
 	for(u = 0 ; u < m_LineLength ; u++) 
 	{
-		// allocate contributions for every pixel
-		m_WeightTable[u].Weights = new double[m_WindowSize];
+		m_WeightTable[u].Weights = &m_Weights[u * m_WindowSize];
 	}
 
 	for(u = 0; u < m_LineLength; u++) 
@@ -45,7 +52,7 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrc
 		// cut edge points to fit in filter window in case of spill-off
 		if((iRight - iLeft + 1) > int(m_WindowSize)) 
 		{
-			if(iLeft < (int(uSrcSize) - 1 / 2)) 
+			if(iLeft < (int(uSrcSize) - 1) / 2) 
 			{
 				iLeft++;
 			} 
@@ -82,13 +89,8 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, DWORD uDstSize, DWORD uSrc
 
 CWeightsTable::~CWeightsTable() 
 {
-		for(DWORD u = 0; u < m_LineLength; u++) 
-		{
-				// free contributions for every pixel
-				delete []m_WeightTable[u].Weights;
-		}
-
-		// free list of pixels contributions
+		// free contributions and the list of pixels contributions
+		delete []m_Weights;
 		delete []m_WeightTable;
 }
 
@@ -101,23 +103,24 @@ void CResizableImage::ScaleRow(unsigned int dst_width, unsigned int /*dst_height
 	for (UINT x = 0; x < dst_width; x++) 
 	{
 		// Loop through row
-		BYTE r = 0;
-		BYTE g = 0;
-		BYTE b = 0;
+		double r = 0;
+		double g = 0;
+		double b = 0;
 		int iLeft = m_pWeights->getLeftBoundary(x);	// Retrieve left boundries
 		int iRight = m_pWeights->getRightBoundary(x);  // Retrieve right boundries
 		for (int i = iLeft; i <= iRight; i++)
 		{
 			// Scan between boundries
 			// Accumulate weighted effect of each neighboring pixel
-			r += (BYTE)(m_pWeights->getWeight(x, i-iLeft) * (double)(pSrcRow[i].rgbRed)); 
-			g += (BYTE)(m_pWeights->getWeight(x, i-iLeft) * (double)(pSrcRow[i].rgbGreen)); 
-			b += (BYTE)(m_pWeights->getWeight(x, i-iLeft) * (double)(pSrcRow[i].rgbBlue)); 
+			double w = m_pWeights->getWeight(x, i-iLeft);
+			r += w * (double)(pSrcRow[i].rgbRed); 
+			g += w * (double)(pSrcRow[i].rgbGreen); 
+			b += w * (double)(pSrcRow[i].rgbBlue); 
 		} 
 		// set destination row
-		pDstRow[x].rgbRed = r;
-		pDstRow[x].rgbGreen = g;
-		pDstRow[x].rgbBlue = b;
+		pDstRow[x].rgbRed = ClampChannel(r);
+		pDstRow[x].rgbGreen = ClampChannel(g);
+		pDstRow[x].rgbBlue = ClampChannel(b);
 		pDstRow[x].rgbReserved = 0;
 	}
 }
@@ -125,10 +128,11 @@ void CResizableImage::ScaleRow(unsigned int dst_width, unsigned int /*dst_height
 void CResizableImage::HorizontalFilter(unsigned int dst_width, unsigned int dst_height)
 {
 
-	if (dst_width == width)
+	if (dst_width == (unsigned)width)
 	{
 		// No scaling required, just copy
 		memcpy (m_pResImg, m_pRGB, sizeof(RGBQUAD) * width * height);
+		return;
 	}
 	
 	m_pWeights = new CWeightsTable(m_pFilter, dst_width, width);
@@ -147,9 +151,9 @@ void CResizableImage::ScaleCol(unsigned int dst_width, unsigned int dst_height,
 	for (UINT y = 0; y < dst_height; y++) 
 	{
 		// Loop through column
-		BYTE r = 0;
-		BYTE g = 0;
-		BYTE b = 0;
+		double r = 0;
+		double g = 0;
+		double b = 0;
 		int iLeft = m_pWeights->getLeftBoundary(y);	// Retrieve left boundries
 		int iRight = m_pWeights->getRightBoundary(y);  // Retrieve right boundries
 		for (int i = iLeft; i <= iRight; i++)
@@ -157,15 +161,16 @@ void CResizableImage::ScaleCol(unsigned int dst_width, unsigned int dst_height,
 			// Scan between boundries
 			// Accumulate weighted effect of each neighboring pixel
 			RGBQUAD &src = m_pRGB[i * width + col];
-			r += (BYTE)(m_pWeights->getWeight(y, i-iLeft) * (double)(src.rgbRed));
-			g += (BYTE)(m_pWeights->getWeight(y, i-iLeft) * (double)(src.rgbGreen));
-			b += (BYTE)(m_pWeights->getWeight(y, i-iLeft) * (double)(src.rgbBlue));
+			double w = m_pWeights->getWeight(y, i-iLeft);
+			r += w * (double)(src.rgbRed);
+			g += w * (double)(src.rgbGreen);
+			b += w * (double)(src.rgbBlue);
 		}
 
 		RGBQUAD &dst = m_pResImg[y * dst_width + col];
-		dst.rgbRed = r;
-		dst.rgbGreen = g;
-		dst.rgbBlue = b;
+		dst.rgbRed = ClampChannel(r);
+		dst.rgbGreen = ClampChannel(g);
+		dst.rgbBlue = ClampChannel(b);
 		dst.rgbReserved = 0;
 	}
 }
@@ -173,10 +178,11 @@ void CResizableImage::ScaleCol(unsigned int dst_width, unsigned int dst_height,
 
 void CResizableImage::VerticalFilter(unsigned int dst_width, unsigned int dst_height)
 {
-	if (height == dst_height)
+	if ((unsigned)height == dst_height)
 	{
 		// No scaling required, just copy
 		memcpy(m_pResImg, m_pRGB, sizeof (RGBQUAD) * width * height);
+		return;
 	}
 	
 	m_pWeights = new CWeightsTable(m_pFilter, dst_height, height);
@@ -199,7 +205,7 @@ void CResizableImage::Resample(unsigned dst_width, unsigned dst_height)
 
 		HorizontalFilter(dst_width, height);
 		
-		delete m_pRGB;
+		delete[] m_pRGB;
 		m_pRGB = m_pResImg;
 		width = dst_width;
 		m_pResImg = new RGBQUAD[dst_width * dst_height];
@@ -211,7 +217,7 @@ void CResizableImage::Resample(unsigned dst_width, unsigned dst_height)
 		m_pResImg = new RGBQUAD[width * dst_height];
 		VerticalFilter(width, dst_height);
 		
-		delete m_pRGB;
+		delete[] m_pRGB;
 		m_pRGB = m_pResImg;
 		height = dst_height;
 		m_pResImg = new RGBQUAD[dst_width * dst_height];
@@ -219,11 +225,10 @@ void CResizableImage::Resample(unsigned dst_width, unsigned dst_height)
 		HorizontalFilter(dst_width, dst_height);
 	}
 
-	delete m_pRGB;
+	delete[] m_pRGB;
 	m_pRGB = m_pResImg;
 	width = dst_width;
 	height = dst_height;
 
-	DeleteObject(m_hBMP);
-	m_hBMP = 0;
+	DeleteBitmap();
 }
\ No newline at end of file
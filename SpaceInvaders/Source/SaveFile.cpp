@@ -0,0 +1,173 @@
+//-----------------------------------------------------------------------------
+// File: SaveFile.cpp
+//
+// Desc: Save game files, versioned, checksummed and replaced atomically.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CSaveFile Specific Includes
+//-----------------------------------------------------------------------------
+#include "SaveFile.h"
+#include <string.h>
+#include <string>
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+static const char	SAVE_MAGIC[4]		= { 'S', 'I', 'S', 'V' };
+
+//-----------------------------------------------------------------------------
+// Name : PutU16 / PutU32 / GetU16 / GetU32 () (Static)
+// Desc : Little endian fields, whatever the machine.
+//-----------------------------------------------------------------------------
+static void PutU16( uint8_t *p, uint16_t n ) { p[0] = (uint8_t)n; p[1] = (uint8_t)(n >> 8); }
+static void PutU32( uint8_t *p, uint32_t n ) { PutU16( p, (uint16_t)n ); PutU16( p + 2, (uint16_t)(n >> 16) ); }
+static uint16_t GetU16( const uint8_t *p ) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t GetU32( const uint8_t *p ) { return GetU16( p ) | ((uint32_t)GetU16( p + 2 ) << 16); }
+
+//-----------------------------------------------------------------------------
+// Name : Crc32c () (Static)
+// Desc : CRC-32C (Castagnoli), the table built on first use.
+//-----------------------------------------------------------------------------
+uint32_t CSaveFile::Crc32c( const void *pData, size_t nSize, uint32_t nCrc )
+{
+	struct STable
+	{
+		uint32_t Entry[256];
+		STable()
+		{
+			for ( uint32_t i = 0; i < 256; i++ )
+			{
+				uint32_t c = i;
+				for ( int k = 0; k < 8; k++ ) c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1)));
+				Entry[i] = c;
+			}
+		}
+	};
+	static const STable Table;
+
+	const uint8_t *p = (const uint8_t*)pData;
+	nCrc = ~nCrc;
+	while ( nSize-- ) nCrc = Table.Entry[(nCrc ^ *p++) & 0xFF] ^ (nCrc >> 8);
+	return ~nCrc;
+}
+
+//-----------------------------------------------------------------------------
+// Name : EncodeHeader () (Static)
+// Desc : Fills the SAVE_HEADER_SIZE bytes at pHeader for a version 2 save of
+//		the given state block.
+//-----------------------------------------------------------------------------
+void CSaveFile::EncodeHeader( uint8_t *pHeader, const void *pState, size_t nSize )
+{
+	memcpy( pHeader, SAVE_MAGIC, 4 );
+	PutU16( pHeader + 4, SAVE_VERSION );
+	PutU16( pHeader + 6, (uint16_t)SAVE_HEADER_SIZE );
+	PutU32( pHeader + 8, (uint32_t)nSize );
+	PutU32( pHeader + 12, Crc32c( pState, nSize ) );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Verify () (Static)
+// Desc : Checks a whole save file held in memory. On LOAD_OK the state block
+//		is the nSize bytes from pData + nHeader.
+//-----------------------------------------------------------------------------
+CSaveFile::ELoadResult CSaveFile::Verify( const uint8_t *pData, size_t nBytes, size_t& nHeader, size_t& nSize )
+{
+	if ( nBytes < 8 || memcmp( pData, SAVE_MAGIC, 4 ) ) return LOAD_CORRUPT;
+	if ( GetU16( pData + 4 ) > SAVE_VERSION ) return LOAD_NEWER;
+
+	// Later versions may grow the header, the payload starts where it says
+	nHeader = GetU16( pData + 6 );
+	if ( nHeader < SAVE_HEADER_SIZE || nBytes < nHeader ) return LOAD_CORRUPT;
+
+	nSize = GetU32( pData + 8 );
+	if ( nBytes - nHeader != nSize ) return LOAD_CORRUPT;
+	if ( Crc32c( pData + nHeader, nSize ) != GetU32( pData + 12 ) ) return LOAD_CORRUPT;
+
+	return LOAD_OK;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Write () (Static)
+// Desc : Writes a version 2 save of the given state block. The old save
+//		stays untouched unless the new one made it to disk completely.
+//-----------------------------------------------------------------------------
+bool CSaveFile::Write( const char *szFileName, const void *pState, size_t nSize )
+{
+	uint8_t Header[SAVE_HEADER_SIZE];
+	EncodeHeader( Header, pState, nSize );
+
+	std::string TempName = std::string( szFileName ) + ".tmp";
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFile( TempName.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE ) return false;
+
+	DWORD dwWritten1 = 0, dwWritten2 = 0;
+	bool bResult = WriteFile( hFile, Header, SAVE_HEADER_SIZE, &dwWritten1, NULL ) && dwWritten1 == SAVE_HEADER_SIZE &&
+				   WriteFile( hFile, pState, (DWORD)nSize, &dwWritten2, NULL ) && dwWritten2 == nSize &&
+				   FlushFileBuffers( hFile );
+	CloseHandle( hFile );
+
+	if ( bResult ) bResult = MoveFileEx( TempName.c_str(), szFileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) != FALSE;
+	if ( !bResult ) DeleteFile( TempName.c_str() );
+#else
+	int hFile = open( TempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if ( hFile < 0 ) return false;
+
+	bool bResult = write( hFile, Header, SAVE_HEADER_SIZE ) == (ssize_t)SAVE_HEADER_SIZE &&
+				   write( hFile, pState, nSize ) == (ssize_t)nSize &&
+				   fsync( hFile ) == 0;
+	if ( close( hFile ) != 0 ) bResult = false;
+
+	if ( bResult ) bResult = rename( TempName.c_str(), szFileName ) == 0;
+	if ( !bResult ) unlink( TempName.c_str() );
+#endif
+
+	return bResult;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Read () (Static)
+// Desc : Reads and checks a save written by Write. On LOAD_OK State holds
+//		the state block, nSize bytes, aligned for CGameWorld::LoadState.
+//-----------------------------------------------------------------------------
+CSaveFile::ELoadResult CSaveFile::Read( const char *szFileName, std::vector<double>& State, size_t& nSize )
+{
+	std::ifstream File( szFileName, std::ios::binary );
+	if ( !File ) return LOAD_MISSING;
+
+	std::vector<uint8_t> Data( (std::istreambuf_iterator<char>( File )), std::istreambuf_iterator<char>() );
+	size_t nHeader = 0;
+	ELoadResult eResult = Verify( Data.data(), Data.size(), nHeader, nSize );
+	if ( eResult != LOAD_OK ) return eResult;
+
+	State.resize( nSize / sizeof(double) + 1 );
+	memcpy( State.data(), Data.data() + nHeader, nSize );
+	return LOAD_OK;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ReadLegacy () (Static)
+// Desc : Reads a version 1 text save.
+//-----------------------------------------------------------------------------
+CSaveFile::ELoadResult CSaveFile::ReadLegacy( const char *szFileName, SLegacySave& Save )
+{
+	std::ifstream File( szFileName );
+	if ( !File ) return LOAD_MISSING;
+
+	File >> Save.Lives[0] >> Save.Lives[1];
+	File >> Save.Position[0].x >> Save.Position[0].y;
+	File >> Save.Position[1].x >> Save.Position[1].y;
+	File >> Save.Score[0] >> Save.Score[1];
+
+	return File.fail() ? LOAD_CORRUPT : LOAD_OK;
+}
@@ -0,0 +1,429 @@
+//-----------------------------------------------------------------------------
+// File: SpatialGrid.cpp
+//
+// Desc: Points sorted into the cells of a grid each tick, for finding the
+//	   targets nearest to a position, around it or ahead of it.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CSpatialGrid Specific Includes
+//-----------------------------------------------------------------------------
+#include "SpatialGrid.h"
+#include <math.h>
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+const size_t SPATIAL_MAX_K		= 32;		// Most KNearest finds at once
+const float  SPATIAL_FAR		= 1e6f;		// Cells further out than this are as good as infinitely far
+const float  SPATIAL_SLACK		= 0.25f;	// Cells widened by this much of one when ruled out
+
+//-----------------------------------------------------------------------------
+// Name : BoxDistance2 ()
+// Desc : How far x, y is from the nearest point of a box, squared.
+//-----------------------------------------------------------------------------
+static inline float BoxDistance2( float x, float y, float x0, float y0, float x1, float y1 )
+{
+	float dx = x < x0 ? x0 - x : x > x1 ? x - x1 : 0.0f;
+	float dy = y < y0 ? y0 - y : y > y1 ? y - y1 : 0.0f;
+	return dx * dx + dy * dy;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SNearestScan (Struct)
+// Desc : Keeps the closest point in range. fBound is how close a point
+//		has to be to still count, squared. Every scan says whether a box of
+//		cells could hold anything for it before it is handed their points.
+//-----------------------------------------------------------------------------
+struct SNearestScan
+{
+	const float		*pX, *pY;
+	const int32_t	*pId;
+	float			x, y;
+	float			fBound;
+	int32_t			iBest;
+
+	bool Reaches( float x0, float y0, float x1, float y1 ) const
+	{
+		return BoxDistance2( x, y, x0, y0, x1, y1 ) <= fBound;
+	}
+
+	void operator()( size_t b, size_t e )
+	{
+		for ( size_t i = b; i < e; i++ )
+		{
+			float dx = pX[i] - x, dy = pY[i] - y;
+			float d2 = dx * dx + dy * dy;
+			if ( d2 > fBound || (d2 == fBound && iBest >= 0 && pId[i] > iBest) ) continue;
+			fBound	= d2;
+			iBest	= pId[i];
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Name : SConeScan (Struct)
+// Desc : Keeps the closest point in range within a cone around a unit
+//		direction. A cone no wider than a half circle lies in front of both
+//		its edges, Normals pointing inwards from them, so boxes wholly
+//		behind either are passed over.
+//-----------------------------------------------------------------------------
+struct SConeScan
+{
+	const float		*pX, *pY;
+	const int32_t	*pId;
+	float			x, y;
+	float			fDirX, fDirY, fCos;
+	float			fBound;
+	int32_t			iBest;
+	float			Normals[2][2];
+	bool			bNarrow;
+
+	bool Reaches( float x0, float y0, float x1, float y1 ) const
+	{
+		if ( BoxDistance2( x, y, x0, y0, x1, y1 ) > fBound ) return false;
+		for ( int i = 0; i < 2 && bNarrow; i++ )
+		{
+			float nx = Normals[i][0], ny = Normals[i][1];
+			if ( nx * ((nx > 0 ? x1 : x0) - x) + ny * ((ny > 0 ? y1 : y0) - y) < 0 ) return false;
+		}
+		return true;
+	}
+
+	void operator()( size_t b, size_t e )
+	{
+		for ( size_t i = b; i < e; i++ )
+		{
+			float dx = pX[i] - x, dy = pY[i] - y;
+			float d2 = dx * dx + dy * dy;
+			if ( d2 > fBound || (d2 == fBound && iBest >= 0 && pId[i] > iBest) ) continue;
+			if ( dx * fDirX + dy * fDirY < fCos * sqrtf( d2 ) ) continue;
+			fBound	= d2;
+			iBest	= pId[i];
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Name : SKNearestScan (Struct)
+// Desc : Keeps the k closest points in range, closest first. Once it has k
+//		of them, fBound is the distance of the last one, squared.
+//-----------------------------------------------------------------------------
+struct SKNearestScan
+{
+	const float		*pX, *pY;
+	const int32_t	*pId;
+	float			x, y;
+	float			fBound;
+	size_t			k, nFound;
+	float			Distance[SPATIAL_MAX_K];
+	int32_t			Ids[SPATIAL_MAX_K];
+
+	bool Reaches( float x0, float y0, float x1, float y1 ) const
+	{
+		return BoxDistance2( x, y, x0, y0, x1, y1 ) <= fBound;
+	}
+
+	void operator()( size_t b, size_t e )
+	{
+		for ( size_t i = b; i < e; i++ )
+		{
+			float dx = pX[i] - x, dy = pY[i] - y;
+			float d2 = dx * dx + dy * dy;
+			if ( d2 > fBound ) continue;
+			if ( nFound == k && d2 == Distance[k - 1] && pId[i] > Ids[k - 1] ) continue;
+
+			// Slides the further ones up a place, dropping the last if full
+			size_t j = nFound < k ? nFound++ : k - 1;
+			for ( ; j > 0 && (d2 < Distance[j - 1] || (d2 == Distance[j - 1] && pId[i] < Ids[j - 1])); j-- )
+			{
+				Distance[j]	= Distance[j - 1];
+				Ids[j]		= Ids[j - 1];
+			}
+			Distance[j]	= d2;
+			Ids[j]		= pId[i];
+			if ( nFound == k ) fBound = Distance[k - 1];
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Name : CSpatialGrid () (Constructor)
+// Desc : CSpatialGrid Class Constructor
+//-----------------------------------------------------------------------------
+CSpatialGrid::CSpatialGrid()
+{
+	m_fLeft		= 0.0f;
+	m_fTop		= 0.0f;
+	m_fCell		= 1.0f;
+	m_fInvCell	= 1.0f;
+	m_nColumns	= 0;
+	m_nRows		= 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CSpatialGrid () (Destructor)
+// Desc : CSpatialGrid Class Destructor
+//-----------------------------------------------------------------------------
+CSpatialGrid::~CSpatialGrid()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : Build ()
+// Desc : Replaces the points. pIds gives each one the id the queries answer
+//		with, NULL numbers them from 0.
+//-----------------------------------------------------------------------------
+void CSpatialGrid::Build( const float *pX, const float *pY, const int32_t *pIds, size_t nPoints )
+{
+	size_t i;
+
+	m_X.resize( nPoints );
+	m_Y.resize( nPoints );
+	m_Id.resize( nPoints );
+	m_Cells.resize( nPoints );
+	if ( !nPoints )
+	{
+		m_nColumns = m_nRows = 0;
+		return;
+	}
+
+	float fLeft = pX[0], fRight = pX[0], fTop = pY[0], fBottom = pY[0];
+	for ( i = 1; i < nPoints; i++ )
+	{
+		if ( pX[i] < fLeft ) fLeft = pX[i];
+		if ( pX[i] > fRight ) fRight = pX[i];
+		if ( pY[i] < fTop ) fTop = pY[i];
+		if ( pY[i] > fBottom ) fBottom = pY[i];
+	}
+
+	// Points in a line or all in one place still get a sensible grid
+	float fWidth = fRight - fLeft, fHeight = fBottom - fTop;
+	float fArea = (fWidth > 1.0f ? fWidth : 1.0f) * (fHeight > 1.0f ? fHeight : 1.0f);
+	m_fLeft		= fLeft;
+	m_fTop		= fTop;
+	m_fCell		= sqrtf( fArea * SPATIAL_CELL_POINTS / nPoints );
+	m_fInvCell	= 1.0f / m_fCell;
+	m_nColumns	= (int)(fWidth * m_fInvCell) + 1;
+	m_nRows		= (int)(fHeight * m_fInvCell) + 1;
+
+	// Counted into the slot after each cell, summed into where each ends
+	size_t nCells = (size_t)m_nColumns * m_nRows;
+	m_Start.assign( nCells + 1, 0 );
+	for ( i = 0; i < nPoints; i++ )
+	{
+		m_Cells[i] = Row( pY[i] ) * m_nColumns + Column( pX[i] );
+		m_Start[m_Cells[i] + 1]++;
+	}
+	for ( i = 1; i <= nCells; i++ ) m_Start[i] += m_Start[i - 1];
+
+	// Placing each point moves its cell's start up to the next cell's
+	for ( i = 0; i < nPoints; i++ )
+	{
+		uint32_t j = m_Start[m_Cells[i]]++;
+		m_X[j]	= pX[i];
+		m_Y[j]	= pY[i];
+		m_Id[j]	= pIds ? pIds[i] : (int32_t)i;
+	}
+	for ( i = nCells; i > 0; i-- ) m_Start[i] = m_Start[i - 1];
+	m_Start[0] = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Nearest ()
+// Desc : Id of the point closest to x, y no further than fMaxRadius, -1 if
+//		there is none.
+//-----------------------------------------------------------------------------
+int32_t CSpatialGrid::Nearest( float x, float y, float fMaxRadius ) const
+{
+	SNearestScan Scanner = { m_X.data(), m_Y.data(), m_Id.data(), x, y, fMaxRadius * fMaxRadius, -1 };
+	Search( x, y, fMaxRadius, Scanner );
+	return Scanner.iBest;
+}
+
+//-----------------------------------------------------------------------------
+// Name : NearestInCone ()
+// Desc : Id of the closest point no further than fMaxRadius whose direction
+//		from x, y is within the half angle of the unit direction fDirX,
+//		fDirY, given by its cosine. -1 if there is none.
+//-----------------------------------------------------------------------------
+int32_t CSpatialGrid::NearestInCone( float x, float y, float fDirX, float fDirY, float fCosHalfAngle, float fMaxRadius ) const
+{
+	// The edges are the direction turned either way by the half angle
+	float fSin = sqrtf( fCosHalfAngle < 1.0f ? 1.0f - fCosHalfAngle * fCosHalfAngle : 0.0f );
+	SConeScan Scanner = { m_X.data(), m_Y.data(), m_Id.data(), x, y, fDirX, fDirY, fCosHalfAngle, fMaxRadius * fMaxRadius, -1,
+		{ { fSin * fDirX - fCosHalfAngle * fDirY, fCosHalfAngle * fDirX + fSin * fDirY },
+		  { fSin * fDirX + fCosHalfAngle * fDirY, fSin * fDirY - fCosHalfAngle * fDirX } },
+		fCosHalfAngle >= 0.0f };
+	Search( x, y, fMaxRadius, Scanner );
+	return Scanner.iBest;
+}
+
+//-----------------------------------------------------------------------------
+// Name : KNearest ()
+// Desc : Writes the ids of the k points closest to x, y, no further than
+//		fMaxRadius, closest first. k is capped at 32. Returns how many there
+//		were.
+//-----------------------------------------------------------------------------
+size_t CSpatialGrid::KNearest( float x, float y, size_t k, int32_t *pIds, float fMaxRadius ) const
+{
+	if ( k > SPATIAL_MAX_K ) k = SPATIAL_MAX_K;
+	if ( !k ) return 0;
+
+	SKNearestScan Scanner;
+	Scanner.pX		= m_X.data();
+	Scanner.pY		= m_Y.data();
+	Scanner.pId		= m_Id.data();
+	Scanner.x		= x;
+	Scanner.y		= y;
+	Scanner.fBound	= fMaxRadius * fMaxRadius;
+	Scanner.k		= k;
+	Scanner.nFound	= 0;
+	Search( x, y, fMaxRadius, Scanner );
+
+	for ( size_t i = 0; i < Scanner.nFound; i++ ) pIds[i] = Scanner.Ids[i];
+	return Scanner.nFound;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Radius ()
+// Desc : Writes the ids of up to nMax points no further than fRadius from
+//		x, y, in no particular order. Returns how many there were, which
+//		can be more than nMax.
+//-----------------------------------------------------------------------------
+size_t CSpatialGrid::Radius( float x, float y, float fRadius, int32_t *pIds, size_t nMax ) const
+{
+	if ( m_Id.empty() ) return 0;
+
+	float fRadius2 = fRadius * fRadius;
+	int c0 = Column( x - fRadius ), c1 = Column( x + fRadius );
+	int r0 = Row( y - fRadius ), r1 = Row( y + fRadius );
+	if ( c0 < 0 ) c0 = 0;
+	if ( r0 < 0 ) r0 = 0;
+	if ( c1 >= m_nColumns ) c1 = m_nColumns - 1;
+	if ( r1 >= m_nRows ) r1 = m_nRows - 1;
+
+	size_t nFound = 0;
+	for ( int r = r0; r <= r1 && c0 <= c1; r++ )
+	{
+		size_t e = m_Start[r * m_nColumns + c1 + 1];
+		for ( size_t i = m_Start[r * m_nColumns + c0]; i < e; i++ )
+		{
+			float dx = m_X[i] - x, dy = m_Y[i] - y;
+			if ( dx * dx + dy * dy > fRadius2 ) continue;
+			if ( nFound < nMax ) pIds[nFound] = m_Id[i];
+			nFound++;
+		}
+	}
+
+	return nFound;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Column / Row () (Private)
+// Desc : Cell a coordinate falls in, outside the grid for those outside it.
+//-----------------------------------------------------------------------------
+int CSpatialGrid::Column( float x ) const
+{
+	float f = (x - m_fLeft) * m_fInvCell;
+	return f < -SPATIAL_FAR ? -(int)SPATIAL_FAR : f > SPATIAL_FAR ? (int)SPATIAL_FAR : (int)floorf( f );
+}
+
+int CSpatialGrid::Row( float y ) const
+{
+	float f = (y - m_fTop) * m_fInvCell;
+	return f < -SPATIAL_FAR ? -(int)SPATIAL_FAR : f > SPATIAL_FAR ? (int)SPATIAL_FAR : (int)floorf( f );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Search () (Private)
+// Desc : Hands the points to Scanner ring by ring of cells around the one
+//		x, y is in: a row above and below and a column either side. Every
+//		point of ring R is more than R - 1 cells away, so once that is
+//		further than Scanner.fBound nothing beyond can count.
+//-----------------------------------------------------------------------------
+template <class Scan>
+void CSpatialGrid::Search( float x, float y, float fMaxRadius, Scan& Scanner ) const
+{
+	if ( m_Id.empty() ) return;
+
+	// Nothing to find anywhere, as when a cone points away from every point
+	float fSlack = m_fCell * SPATIAL_SLACK;
+	if ( !Scanner.Reaches( m_fLeft - fSlack, m_fTop - fSlack, m_fLeft + m_nColumns * m_fCell + fSlack, m_fTop + m_nRows * m_fCell + fSlack ) ) return;
+
+	int qc = Column( x ), qr = Row( y );
+	int nFirst = 0, nLast = 0;
+	const int Outside[4] = { -qc, qc - (m_nColumns - 1), -qr, qr - (m_nRows - 1) };
+	const int Across[4] = { qc, m_nColumns - 1 - qc, qr, m_nRows - 1 - qr };
+	for ( int i = 0; i < 4; i++ )
+	{
+		if ( Outside[i] > nFirst ) nFirst = Outside[i];
+		if ( Across[i] > nLast ) nLast = Across[i];
+	}
+
+	for ( int R = nFirst; R <= nLast; R++ )
+	{
+		if ( R > 0 )
+		{
+			float fGap = (R - 1) * m_fCell;
+			if ( fGap > fMaxRadius || fGap * fGap > Scanner.fBound ) return;
+		}
+
+		if ( R == 0 )
+		{
+			ScanRow( qr, qc, qc, Scanner );
+			continue;
+		}
+
+		ScanRow( qr - R, qc - R, qc + R, Scanner );
+		ScanRow( qr + R, qc - R, qc + R, Scanner );
+
+		ScanColumn( qc - R, qr - R + 1, qr + R - 1, Scanner );
+		ScanColumn( qc + R, qr - R + 1, qr + R - 1, Scanner );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : ScanColumn () (Private)
+// Desc : Hands Scanner the points of rows r0 to r1 of column c, the part of
+//		them inside the grid, cell by cell unless none of them Reaches.
+//-----------------------------------------------------------------------------
+template <class Scan>
+void CSpatialGrid::ScanColumn( int c, int r0, int r1, Scan& Scanner ) const
+{
+	if ( c < 0 || c >= m_nColumns ) return;
+	if ( r0 < 0 ) r0 = 0;
+	if ( r1 >= m_nRows ) r1 = m_nRows - 1;
+	if ( r0 > r1 ) return;
+
+	float fSlack = m_fCell * SPATIAL_SLACK;
+	float x0 = m_fLeft + c * m_fCell - fSlack, x1 = m_fLeft + (c + 1) * m_fCell + fSlack;
+	float y0 = m_fTop + r0 * m_fCell - fSlack, y1 = m_fTop + (r1 + 1) * m_fCell + fSlack;
+	if ( !Scanner.Reaches( x0, y0, x1, y1 ) ) return;
+
+	for ( int r = r0; r <= r1; r++ ) ScanRow( r, c, c, Scanner );
+}
+
+//-----------------------------------------------------------------------------
+// Name : ScanRow () (Private)
+// Desc : Hands Scanner the points of cells c0 to c1 of row r, the part of
+//		them inside the grid: one run of the sorted points. The cells are
+//		widened a little for Reaches, so rounding never rules out a point
+//		that lies on their edge.
+//-----------------------------------------------------------------------------
+template <class Scan>
+void CSpatialGrid::ScanRow( int r, int c0, int c1, Scan& Scanner ) const
+{
+	if ( r < 0 || r >= m_nRows ) return;
+	if ( c0 < 0 ) c0 = 0;
+	if ( c1 >= m_nColumns ) c1 = m_nColumns - 1;
+	if ( c0 > c1 ) return;
+
+	float fSlack = m_fCell * SPATIAL_SLACK;
+	float x0 = m_fLeft + c0 * m_fCell - fSlack, x1 = m_fLeft + (c1 + 1) * m_fCell + fSlack;
+	float y0 = m_fTop + r * m_fCell - fSlack, y1 = m_fTop + (r + 1) * m_fCell + fSlack;
+	if ( !Scanner.Reaches( x0, y0, x1, y1 ) ) return;
+
+	size_t nRow = (size_t)r * m_nColumns;
+	Scanner( m_Start[nRow + c0], m_Start[nRow + c1 + 1] );
+}
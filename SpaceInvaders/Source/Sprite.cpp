@@ -1,6 +1,12 @@
 #include "Sprite.h"
+#include "AssetLoader.h"
 
 extern HINSTANCE g_hInst;
+extern CAssetLoader g_Assets;
+
+bool Sprite::sbIndexedStorage = true;
+size_t Sprite::sTotalMemory = 0;
+float Sprite::sfAlpha = 1.0f;
 
 Sprite::Sprite(int imageID, int maskID)
 {
@@ -18,12 +24,16 @@ Sprite::Sprite(int imageID, int maskID)
 
 	mcTransparentColor = 0;
 	mhSpriteDC = 0;
+
+	makeIndexed();
 }
 
 Sprite::Sprite(const char *szImageFile, const char *szMaskFile)
 {
-	mhImage = (HBITMAP)LoadImage(g_hInst, szImageFile, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE);
-	mhMask = (HBITMAP)LoadImage(g_hInst, szMaskFile, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE);
+	// Bitmaps come from the asset cache, already decoded if they were
+	// requested up front, otherwise they are loaded from disk right here.
+	mhImage = g_Assets.AcquireBitmap(szImageFile);
+	mhMask = g_Assets.AcquireBitmap(szMaskFile);
 
 	// Get the BITMAP structure for each of the bitmaps.
 	GetObject(mhImage, sizeof(BITMAP), &mImageBM);
@@ -35,11 +45,13 @@ Sprite::Sprite(const char *szImageFile, const char *szMaskFile)
 
 	mcTransparentColor = 0;
 	mhSpriteDC = 0;
+
+	makeIndexed();
 }
 
 Sprite::Sprite(const char *szImageFile, COLORREF crTransparentColor)
 {
-	mhImage = (HBITMAP)LoadImage(g_hInst, szImageFile, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION | LR_LOADFROMFILE);
+	mhImage = g_Assets.AcquireBitmap(szImageFile);
 
 	mhMask = 0;
 	mhSpriteDC = 0;
@@ -47,6 +59,8 @@ Sprite::Sprite(const char *szImageFile, COLORREF crTransparentColor)
 
 	// Get the BITMAP structure for the bitmap.
 	GetObject(mhImage, sizeof(BITMAP), &mImageBM);
+
+	makeIndexed();
 }
 
 Sprite::~Sprite()
@@ -54,6 +68,8 @@ Sprite::~Sprite()
 	// Free the resources we created in the constructor.
 	DeleteObject(mhImage);
 	DeleteObject(mhMask);
+	delete mpIndexed;
+	sTotalMemory -= mMemory;
 
 	DeleteDC(mhSpriteDC);
 }
@@ -76,9 +92,42 @@ void Sprite::setBackBuffer(const BackBuffer *pBackBuffer)
 	}
 }
 
-void Sprite::draw()
+void Sprite::makeIndexed()
 {
+	mpIndexed = NULL;
+
+	// What the bitmaps hold, the mask being a one bit bitmap or not
+	mMemory = mImageBM.bmWidthBytes * mImageBM.bmHeight;
 	if( mhMask != 0 )
+		mMemory += mMaskBM.bmWidthBytes * mMaskBM.bmHeight;
+
+	if( sbIndexedStorage )
+	{
+		CIndexedImage *pIndexed = new CIndexedImage;
+		if( pIndexed->CreateFromBitmap(mhImage, mhMask, mcTransparentColor) )
+		{
+			// Only the sizes are needed from here on, and they are
+			// already in the BITMAP structures.
+			DeleteObject(mhImage);
+			DeleteObject(mhMask);
+			mhImage = 0;
+			mhMask = 0;
+
+			mpIndexed = pIndexed;
+			mMemory = pIndexed->GetMemorySize();
+		}
+		else
+			delete pIndexed;
+	}
+
+	sTotalMemory += mMemory;
+}
+
+void Sprite::draw()
+{
+	if( mpIndexed != NULL )
+		drawIndexed(NULL, width(), height());
+	else if( mhMask != 0 )
 		drawMask();
 	else
 		drawTransparent();
@@ -98,8 +147,9 @@ void Sprite::drawMask()
 	int h = height();
 
 	// Upper-left corner.
-	int x = (int)mPosition.x - (w / 2);
-	int y = (int)mPosition.y - (h / 2);
+	Vec2 pos = drawPosition();
+	int x = (int)pos.x - (w / 2);
+	int y = (int)pos.y - (h / 2);
 
 	// Note: For this masking technique to work, it is assumed
 	// the backbuffer bitmap has been cleared to some
@@ -125,6 +175,22 @@ void Sprite::drawMask()
 	SelectObject(mhSpriteDC, oldObj);
 }
 
+void Sprite::drawIndexed(const RECT *pSrcRect, int w, int h)
+{
+	if( mpBackBuffer == NULL || mpBackBuffer->bits() == NULL )
+		return;
+
+	// Make sure GDI is done with the surface before writing to it.
+	GdiFlush();
+
+	// Upper-left corner.
+	Vec2 pos = drawPosition();
+	int x = (int)pos.x - (w / 2);
+	int y = (int)pos.y - (h / 2);
+
+	mpIndexed->Blit(mpBackBuffer->bits(), mpBackBuffer->width(), mpBackBuffer->height(), x, y, pSrcRect);
+}
+
 void Sprite::drawTransparent()
 {
 	if( mpBackBuffer == NULL )
@@ -136,8 +202,9 @@ void Sprite::drawTransparent()
 	int h = height();
 
 	// Upper-left corner.
-	int x = (int)mPosition.x - (w / 2);
-	int y = (int)mPosition.y - (h / 2);
+	Vec2 pos = drawPosition();
+	int x = (int)pos.x - (w / 2);
+	int y = (int)pos.y - (h / 2);
 
 	COLORREF crOldBack = SetBkColor(hBackBuffer, RGB(255, 255, 255));
 	COLORREF crOldText = SetTextColor(hBackBuffer, RGB(0, 0, 0));
@@ -210,11 +277,19 @@ void AnimatedSprite::draw()
 	int w = miFrameWidth;
 	int h = miFrameHeight;
 
+	if( mpIndexed != NULL )
+	{
+		RECT rcFrame = { mptFrameCrop.x, mptFrameCrop.y, mptFrameCrop.x + w, mptFrameCrop.y + h };
+		drawIndexed(&rcFrame, w, h);
+		return;
+	}
+
 	HDC hBackBufferDC = mpBackBuffer->getDC();
 
 	// Upper-left corner.
-	int x = (int)mPosition.x - (w / 2);
-	int y = (int)mPosition.y - (h / 2);
+	Vec2 pos = drawPosition();
+	int x = (int)pos.x - (w / 2);
+	int y = (int)pos.y - (h / 2);
 
 	// Note: For this masking technique to work, it is assumed
 	// the backbuffer bitmap has been cleared to some
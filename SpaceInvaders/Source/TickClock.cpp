@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------------
+// File: TickClock.cpp
+//
+// Desc: The fixed tick accumulator: turns real frame times, however long or
+//	   uneven, into whole simulation ticks.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CTickClock Specific Includes
+//-----------------------------------------------------------------------------
+#include "TickClock.h"
+#include <math.h>
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Name : CTickClock () (Constructor)
+// Desc : CTickClock Class Constructor
+//-----------------------------------------------------------------------------
+CTickClock::CTickClock()
+{
+	Reset( 0.0 );
+	m_nDropped = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Reset ()
+// Desc : Starts counting from fNow with nothing accumulated.
+//-----------------------------------------------------------------------------
+void CTickClock::Reset( double fNow )
+{
+	m_fAccumulator	= 0.0;
+	m_fLastTime		= fNow;
+	m_nTicks		= 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Advance ()
+// Desc : Adds the real time passed since the previous call.
+//-----------------------------------------------------------------------------
+void CTickClock::Advance( double fNow )
+{
+	m_fAccumulator += std::min( fNow - m_fLastTime, SIM_MAX_FRAME_TIME );
+	m_fLastTime = fNow;
+	m_nTicks = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : NextTick ()
+// Desc : Takes the oldest whole tick out of the accumulator. fTickEnd is the
+//		time the tick ends at, input stamped before then belongs to it.
+//		False when no whole tick is left, or the cap was hit.
+//-----------------------------------------------------------------------------
+bool CTickClock::NextTick( double& fTickEnd )
+{
+	if ( m_fAccumulator < SIM_TICK ) return false;
+
+	if ( m_nTicks == SIM_MAX_TICKS )
+	{
+		m_nDropped += (uint32_t)(m_fAccumulator / SIM_TICK);
+		m_fAccumulator = fmod( m_fAccumulator, (double)SIM_TICK );
+		return false;
+	}
+
+	fTickEnd = m_fLastTime - m_fAccumulator + SIM_TICK;
+	m_fAccumulator -= SIM_TICK;
+	m_nTicks++;
+	return true;
+}
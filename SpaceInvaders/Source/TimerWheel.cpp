@@ -0,0 +1,443 @@
+//-----------------------------------------------------------------------------
+// File: TimerWheel.cpp
+//
+// Desc: Timers counted in simulation ticks: cooldowns, delayed spawns and
+//	   periodic emitters, kept in a hierarchical timing wheel.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CTimerWheel Specific Includes
+//-----------------------------------------------------------------------------
+#include "TimerWheel.h"
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Definitions, Macros & Constants
+//-----------------------------------------------------------------------------
+static const int		INDEX_BITS	= 20;						// Up to a million timers
+static const uint32_t	INDEX_MASK	= (1u << INDEX_BITS) - 1;
+static const int32_t	TIMER_FREE	= -2;						// Slot of a timer not in use
+
+//-----------------------------------------------------------------------------
+// Name : SWheelState (Struct)
+// Desc : Fixed part of a saved wheel, followed by Heads slot heads in slot
+//		order and then Count timers.
+//-----------------------------------------------------------------------------
+struct SWheelState
+{
+	uint32_t	Tick;
+	uint32_t	Pending;
+	int32_t		Free;
+	uint32_t	Count;
+	uint32_t	Heads;
+	uint32_t	Reserved;		// Keeps the size a multiple of 8
+};
+
+//-----------------------------------------------------------------------------
+// Name : SSlotHead (Struct)
+// Desc : A slot in use and the first timer in it.
+//-----------------------------------------------------------------------------
+struct SSlotHead
+{
+	int32_t		Slot;
+	int32_t		Head;
+};
+
+//-----------------------------------------------------------------------------
+// Name : LowestBit () (Static)
+// Desc : Index of the lowest set bit, n must not be 0.
+//-----------------------------------------------------------------------------
+static inline int LowestBit( uint32_t n )
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward( &i, n );
+	return (int)i;
+#else
+	return __builtin_ctz( n );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Name : CTimerWheel () (Constructor)
+// Desc : CTimerWheel Class Constructor
+//-----------------------------------------------------------------------------
+CTimerWheel::CTimerWheel()
+{
+	Clear();
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CTimerWheel () (Destructor)
+// Desc : CTimerWheel Class Destructor
+//-----------------------------------------------------------------------------
+CTimerWheel::~CTimerWheel()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name : Clear ()
+// Desc : Drops every timer and sets the clock to nTick. Keeps the memory.
+//-----------------------------------------------------------------------------
+void CTimerWheel::Clear( uint32_t nTick )
+{
+	m_nTick		= nTick;
+	m_nPending	= 0;
+	m_iFree		= -1;
+	m_nHeads	= 0;
+	memset( m_Slots, -1, sizeof(m_Slots) );
+	memset( m_Occupied, 0, sizeof(m_Occupied) );
+	m_Timers.clear();
+	m_Expired.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Reserve ()
+// Desc : Room for nTimers pending at once without allocating.
+//-----------------------------------------------------------------------------
+void CTimerWheel::Reserve( size_t nTimers )
+{
+	m_Timers.reserve( nTimers );
+	m_Expired.reserve( nTimers );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Start ()
+// Desc : Sets a timer off nDelay ticks from now, at least 1, and every
+//		nPeriod ticks after that if nPeriod is not 0. Returns its handle, 0
+//		if the pool is full.
+//-----------------------------------------------------------------------------
+uint32_t CTimerWheel::Start( uint32_t nDelay, int32_t iKind, int32_t iData, uint32_t nPeriod )
+{
+	int32_t i = m_iFree;
+	if ( i >= 0 )
+		m_iFree = m_Timers[i].Next;
+	else
+	{
+		if ( m_Timers.size() > INDEX_MASK ) return 0;
+
+		STimer Timer;
+		Timer.Handle = (uint32_t)m_Timers.size();		// Generation 0, so the first use is 1
+		i = (int32_t)m_Timers.size();
+		m_Timers.push_back( Timer );
+	}
+
+	STimer& Timer = m_Timers[i];
+	uint32_t nGeneration = ((Timer.Handle >> INDEX_BITS) + 1) & (0xFFFFFFFFu >> INDEX_BITS);
+	if ( !nGeneration ) nGeneration = 1;
+
+	Timer.Handle	= (nGeneration << INDEX_BITS) | (uint32_t)i;
+	Timer.Expire	= m_nTick + (nDelay ? nDelay : 1);
+	Timer.Period	= nPeriod;
+	Timer.Kind		= iKind;
+	Timer.Data		= iData;
+	Link( i );
+
+	m_nPending++;
+	return Timer.Handle;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Cancel ()
+// Desc : Stops a pending timer. False if the handle is not one.
+//-----------------------------------------------------------------------------
+bool CTimerWheel::Cancel( uint32_t hTimer )
+{
+	int32_t i = Find( hTimer );
+	if ( i < 0 ) return false;
+
+	Unlink( i );
+	m_Timers[i].Slot = TIMER_FREE;
+	m_Timers[i].Next = m_iFree;
+	m_iFree = i;
+	m_nPending--;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : IsPending / GetRemaining ()
+// Desc : Whether the timer is still to go off, and in how many ticks.
+//-----------------------------------------------------------------------------
+bool CTimerWheel::IsPending( uint32_t hTimer ) const
+{
+	return Find( hTimer ) >= 0;
+}
+
+uint32_t CTimerWheel::GetRemaining( uint32_t hTimer ) const
+{
+	int32_t i = Find( hTimer );
+	return i < 0 ? 0 : m_Timers[i].Expire - m_nTick;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Find () (Private)
+// Desc : Pool index of a pending timer, -1 if the handle is stale or junk.
+//-----------------------------------------------------------------------------
+int32_t CTimerWheel::Find( uint32_t hTimer ) const
+{
+	uint32_t i = hTimer & INDEX_MASK;
+	if ( i >= m_Timers.size() ) return -1;
+
+	const STimer& Timer = m_Timers[i];
+	return Timer.Handle == hTimer && Timer.Slot != TIMER_FREE ? (int32_t)i : -1;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Link () (Private)
+// Desc : Hangs a timer in the slot its expiry falls in: the lowest level
+//		whose span covers the time left, at that level's digit of the tick.
+//-----------------------------------------------------------------------------
+void CTimerWheel::Link( int32_t i )
+{
+	STimer& Timer = m_Timers[i];
+	uint32_t nLeft = Timer.Expire - m_nTick;
+
+	int iLevel = 0;
+	while ( iLevel < TIMER_WHEEL_LEVELS - 1 && nLeft >> (TIMER_WHEEL_BITS * (iLevel + 1)) ) iLevel++;
+
+	int32_t iSlot = iLevel * TIMER_WHEEL_SLOTS + ((Timer.Expire >> (TIMER_WHEEL_BITS * iLevel)) & (TIMER_WHEEL_SLOTS - 1));
+	Timer.Slot = iSlot;
+	Timer.Prev = -1;
+	Timer.Next = m_Slots[iSlot];
+	if ( Timer.Next >= 0 ) m_Timers[Timer.Next].Prev = i;
+	SetHead( iSlot, i );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Unlink () (Private)
+// Desc : Takes a timer out of its slot list.
+//-----------------------------------------------------------------------------
+void CTimerWheel::Unlink( int32_t i )
+{
+	STimer& Timer = m_Timers[i];
+	if ( Timer.Prev >= 0 ) m_Timers[Timer.Prev].Next = Timer.Next;
+	else SetHead( Timer.Slot, Timer.Next );
+	if ( Timer.Next >= 0 ) m_Timers[Timer.Next].Prev = Timer.Prev;
+}
+
+//-----------------------------------------------------------------------------
+// Name : SetHead () (Private)
+// Desc : Points a slot at its first timer, -1 for none, and keeps the
+//		occupied bits in step.
+//-----------------------------------------------------------------------------
+void CTimerWheel::SetHead( int32_t iSlot, int32_t i )
+{
+	bool bWas = m_Slots[iSlot] >= 0;
+	m_Slots[iSlot] = i;
+	if ( bWas == (i >= 0) ) return;
+
+	m_Occupied[iSlot >> 5] ^= 1u << (iSlot & 31);
+	if ( bWas ) m_nHeads--; else m_nHeads++;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Cascade () (Private)
+// Desc : Empties the current slot of a level into the levels below, now that
+//		its timers are due within one turn of the level below.
+//-----------------------------------------------------------------------------
+void CTimerWheel::Cascade( int iLevel )
+{
+	int32_t iSlot = iLevel * TIMER_WHEEL_SLOTS + ((m_nTick >> (TIMER_WHEEL_BITS * iLevel)) & (TIMER_WHEEL_SLOTS - 1));
+	int32_t i = m_Slots[iSlot];
+	SetHead( iSlot, -1 );
+
+	while ( i >= 0 )
+	{
+		int32_t iNext = m_Timers[i].Next;
+		Link( i );
+		i = iNext;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : Advance ()
+// Desc : Moves the clock on one tick and collects the timers that go off on
+//		it, for GetExpired, in a fixed order. One-shot timers are done with;
+//		periodic ones are already set for their next time. Returns how many
+//		went off.
+//-----------------------------------------------------------------------------
+size_t CTimerWheel::Advance()
+{
+	m_Expired.clear();
+	m_nTick++;
+
+	for ( int iLevel = 1; iLevel < TIMER_WHEEL_LEVELS; iLevel++ )
+	{
+		if ( m_nTick & ((1u << (TIMER_WHEEL_BITS * iLevel)) - 1) ) break;
+		Cascade( iLevel );
+	}
+
+	int32_t iSlot = m_nTick & (TIMER_WHEEL_SLOTS - 1);
+	int32_t i = m_Slots[iSlot];
+	SetHead( iSlot, -1 );
+
+	while ( i >= 0 )
+	{
+		STimer& Timer = m_Timers[i];
+		int32_t iNext = Timer.Next;
+
+		STimerEvent Event;
+		Event.Handle	= Timer.Handle;
+		Event.Kind		= Timer.Kind;
+		Event.Data		= Timer.Data;
+		m_Expired.push_back( Event );
+
+		if ( Timer.Period )
+		{
+			Timer.Expire += Timer.Period;
+			Link( i );
+		}
+		else
+		{
+			Timer.Slot = TIMER_FREE;
+			Timer.Next = m_iFree;
+			m_iFree = i;
+			m_nPending--;
+		}
+
+		i = iNext;
+	}
+
+	return m_Expired.size();
+}
+
+//-----------------------------------------------------------------------------
+// Name : GetStateSize ()
+// Desc : Bytes SaveState writes, a multiple of 8.
+//-----------------------------------------------------------------------------
+size_t CTimerWheel::GetStateSize() const
+{
+	return sizeof(SWheelState) + m_nHeads * sizeof(SSlotHead) + m_Timers.size() * sizeof(STimer);
+}
+
+//-----------------------------------------------------------------------------
+// Name : SaveState ()
+// Desc : Copies the wheel to pBuffer, which must hold GetStateSize bytes.
+//		The timers of the last Advance are not part of it.
+//-----------------------------------------------------------------------------
+void CTimerWheel::SaveState( void *pBuffer ) const
+{
+	SWheelState *pState = (SWheelState*)pBuffer;
+	pState->Tick	= m_nTick;
+	pState->Pending	= m_nPending;
+	pState->Free	= m_iFree;
+	pState->Count	= (uint32_t)m_Timers.size();
+	pState->Heads	= m_nHeads;
+	pState->Reserved = 0;
+
+	// Only the slots in use, found a word of bits at a time
+	SSlotHead *pHead = (SSlotHead*)(pState + 1);
+	for ( int w = 0; w < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS / 32; w++ )
+	{
+		for ( uint32_t nBits = m_Occupied[w]; nBits; nBits &= nBits - 1 )
+		{
+			int32_t iSlot = w * 32 + LowestBit( nBits );
+			pHead->Slot = iSlot;
+			pHead->Head = m_Slots[iSlot];
+			pHead++;
+		}
+	}
+
+	if ( !m_Timers.empty() ) memcpy( pHead, m_Timers.data(), m_Timers.size() * sizeof(STimer) );
+}
+
+//-----------------------------------------------------------------------------
+// Name : IsState () (Static)
+// Desc : Whether the nSize bytes at pBuffer can be loaded: the size adds up,
+//		the heads come in slot order and every link points at a timer or a
+//		slot there is.
+//-----------------------------------------------------------------------------
+bool CTimerWheel::IsState( const void *pBuffer, size_t nSize )
+{
+	const SWheelState *pState = (const SWheelState*)pBuffer;
+	if ( nSize < sizeof(SWheelState) || pState->Count > INDEX_MASK + 1 ) return false;
+	if ( pState->Heads > TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS ) return false;
+	if ( sizeof(SWheelState) + pState->Heads * sizeof(SSlotHead) + (size_t)pState->Count * sizeof(STimer) != nSize ) return false;
+
+	int32_t nCount = (int32_t)pState->Count;
+	const SSlotHead *pHeads = (const SSlotHead*)(pState + 1);
+	const STimer *pTimers = (const STimer*)(pHeads + pState->Heads);
+
+	if ( pState->Free < -1 || pState->Free >= nCount || pState->Pending > pState->Count ) return false;
+	int32_t iLast = -1;
+	for ( uint32_t h = 0; h < pState->Heads; h++ )
+	{
+		const SSlotHead& Head = pHeads[h];
+		if ( Head.Slot <= iLast || Head.Slot >= TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS ) return false;
+		if ( Head.Head < 0 || Head.Head >= nCount ) return false;
+		iLast = Head.Slot;
+	}
+	for ( int32_t i = 0; i < nCount; i++ )
+	{
+		const STimer& Timer = pTimers[i];
+		if ( Timer.Next < -1 || Timer.Next >= nCount || Timer.Prev < -1 || Timer.Prev >= nCount ) return false;
+		if ( Timer.Slot != TIMER_FREE && (Timer.Slot < 0 || Timer.Slot >= TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS) ) return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : LoadState ()
+// Desc : Restores a wheel saved by SaveState. False, with nothing changed,
+//		if it is not one.
+//-----------------------------------------------------------------------------
+bool CTimerWheel::LoadState( const void *pBuffer, size_t nSize )
+{
+	if ( !IsState( pBuffer, nSize ) ) return false;
+
+	const SWheelState *pState = (const SWheelState*)pBuffer;
+	const SSlotHead *pHeads = (const SSlotHead*)(pState + 1);
+	const STimer *pTimers = (const STimer*)(pHeads + pState->Heads);
+
+	m_nTick		= pState->Tick;
+	m_nPending	= pState->Pending;
+	m_iFree		= pState->Free;
+
+	// Empty the slots in use now rather than all of them
+	for ( int w = 0; w < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS / 32; w++ )
+	{
+		for ( uint32_t nBits = m_Occupied[w]; nBits; nBits &= nBits - 1 )
+			m_Slots[w * 32 + LowestBit( nBits )] = -1;
+		m_Occupied[w] = 0;
+	}
+
+	for ( uint32_t h = 0; h < pState->Heads; h++ )
+	{
+		m_Slots[pHeads[h].Slot] = pHeads[h].Head;
+		m_Occupied[pHeads[h].Slot >> 5] |= 1u << (pHeads[h].Slot & 31);
+	}
+
+	m_nHeads	= pState->Heads;
+	m_Timers.assign( pTimers, pTimers + pState->Count );
+	m_Expired.clear();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name : Checksum ()
+// Desc : Carries CGameWorld's FNV-1a hash h on over the pending timers.
+//-----------------------------------------------------------------------------
+uint32_t CTimerWheel::Checksum( uint32_t h ) const
+{
+	auto Mix = [&h]( const void *p, size_t n )
+	{
+		const unsigned char *b = (const unsigned char*)p;
+		for ( size_t i = 0; i < n; i++ ) h = (h ^ b[i]) * 16777619u;
+	};
+
+	Mix( &m_nTick, sizeof(m_nTick) );
+	for ( size_t i = 0; i < m_Timers.size(); i++ )
+	{
+		const STimer& Timer = m_Timers[i];
+		if ( Timer.Slot == TIMER_FREE ) continue;
+
+		// Expire through Data, the part that decides what happens
+		Mix( &Timer.Expire, 4 * sizeof(uint32_t) );
+	}
+
+	return h;
+}
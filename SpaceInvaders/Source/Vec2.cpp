@@ -10,7 +10,15 @@
 // Vec2 Specific Includes
 //-----------------------------------------------------------------------------
 #include "Vec2.h"
-#include "main.h"
+#include <math.h>
+
+// Not taken from Main.h, Vec2 is shared with the portable simulation core
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+#ifndef EPS
+#define EPS 1e-3
+#endif
 
 Vec2& Vec2::operator-()
 {
@@ -0,0 +1,169 @@
+//-----------------------------------------------------------------------------
+// File: WorkerPool.cpp
+//
+// Desc: Small fixed size thread pool. Tasks are queued with a priority and
+//	   picked up by the workers most urgent first (lower value = sooner),
+//	   in submission order among tasks of the same priority.
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CWorkerPool Specific Includes
+//-----------------------------------------------------------------------------
+#include "WorkerPool.h"
+#include <atomic>
+
+//-----------------------------------------------------------------------------
+// Name : CWorkerPool () (Constructor)
+// Desc : CWorkerPool Class Constructor
+//-----------------------------------------------------------------------------
+CWorkerPool::CWorkerPool()
+{
+	m_bStop			= false;
+	m_ulSequence	= 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name : ~CWorkerPool () (Destructor)
+// Desc : CWorkerPool Class Destructor
+//-----------------------------------------------------------------------------
+CWorkerPool::~CWorkerPool()
+{
+	Stop();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Start ()
+// Desc : Spawns the worker threads. Passing 0 uses one thread per hardware
+//		thread, minus the one the game loop is running on.
+//-----------------------------------------------------------------------------
+void CWorkerPool::Start( UINT nThreads )
+{
+	if ( !m_Threads.empty() ) return;
+
+	if ( nThreads == 0 )
+	{
+		UINT nHardware = std::thread::hardware_concurrency();
+		nThreads = nHardware > 1 ? nHardware - 1 : 1;
+	}
+
+	m_bStop = false;
+	for ( UINT i = 0; i < nThreads; i++ )
+		m_Threads.push_back( std::thread( &CWorkerPool::WorkerLoop, this ) );
+}
+
+//-----------------------------------------------------------------------------
+// Name : Stop ()
+// Desc : Lets the workers drain the queue and joins them.
+//-----------------------------------------------------------------------------
+void CWorkerPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_Lock );
+		m_bStop = true;
+	}
+	m_Wake.notify_all();
+
+	for ( size_t i = 0; i < m_Threads.size(); i++ )
+		m_Threads[i].join();
+	m_Threads.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Name : Enqueue () (Private)
+// Desc : Pushes a task and wakes up one worker. With no workers running the
+//		task is executed straight away on the calling thread.
+//-----------------------------------------------------------------------------
+void CWorkerPool::Enqueue( int iPriority, std::function<void()> fn )
+{
+	if ( m_Threads.empty() )
+	{
+		fn();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( m_Lock );
+		STask task;
+		task.iPriority	= iPriority;
+		task.ulSequence	= m_ulSequence++;
+		task.fn			= fn;
+		m_Tasks.push( task );
+	}
+	m_Wake.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+// Name : WorkerLoop () (Private)
+// Desc : Body of every worker thread.
+//-----------------------------------------------------------------------------
+void CWorkerPool::WorkerLoop()
+{
+	for ( ;; )
+	{
+		std::function<void()> fn;
+		{
+			std::unique_lock<std::mutex> lock( m_Lock );
+			m_Wake.wait( lock, [this]() { return m_bStop || !m_Tasks.empty(); } );
+
+			if ( m_Tasks.empty() ) return;
+
+			fn = m_Tasks.top().fn;
+			m_Tasks.pop();
+		}
+		fn();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name : ParallelFor ()
+// Desc : Indices are handed out through a shared counter, so helpers that get
+//		scheduled late simply find nothing left to do. The caller works too
+//		and only waits for indices that are actually in flight.
+//-----------------------------------------------------------------------------
+void CWorkerPool::ParallelFor( int iCount, const std::function<void(int)>& fn, int iPriority )
+{
+	if ( iCount <= 0 ) return;
+
+	if ( m_Threads.empty() || iCount == 1 )
+	{
+		for ( int i = 0; i < iCount; i++ ) fn( i );
+		return;
+	}
+
+	struct SJob
+	{
+		std::function<void(int)>	fn;
+		int							iCount;
+		std::atomic<int>			iNext;
+		std::atomic<int>			iDone;
+		std::mutex					lock;
+		std::condition_variable		finished;
+
+		void Run()
+		{
+			int i, nRun = 0;
+			while ( (i = iNext++) < iCount ) { fn( i ); nRun++; }
+
+			if ( nRun && (iDone += nRun) == iCount )
+			{
+				std::lock_guard<std::mutex> guard( lock );
+				finished.notify_all();
+			}
+		}
+	};
+
+	std::shared_ptr<SJob> job = std::make_shared<SJob>();
+	job->fn		= fn;
+	job->iCount	= iCount;
+	job->iNext	= 0;
+	job->iDone	= 0;
+
+	int nHelpers = (std::min)( (int)m_Threads.size(), iCount - 1 );
+	for ( int i = 0; i < nHelpers; i++ )
+		Enqueue( iPriority, [job]() { job->Run(); } );
+
+	job->Run();
+
+	std::unique_lock<std::mutex> lock( job->lock );
+	job->finished.wait( lock, [&job]() { return job->iDone == job->iCount; } );
+}